@@ -6,6 +6,7 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "adler32_simd.h"
 
 local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 
@@ -64,6 +65,20 @@ uLong ZEXPORT adler32_z(adler, buf, len)
     uLong adler;
     const Bytef *buf;
     z_size_t len;
+{
+#ifdef Z_X86_SIMD
+    if (buf != Z_NULL && len >= Z_ADLER32_SIMD_MINIMUM_LENGTH &&
+        (cpu_simd_features() & Z_SIMD_ADLER32))
+        return adler32_avx2(adler, buf, len);
+#endif
+    return adler32_portable(adler, buf, len);
+}
+
+/* ========================================================================= */
+uLong ZEXPORT adler32_portable(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
 {
     unsigned long sum2;
     unsigned n;
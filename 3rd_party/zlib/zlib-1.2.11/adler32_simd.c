@@ -0,0 +1,77 @@
+/* adler32_simd.c -- Adler-32 by AVX2
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * For n bytes d[0..n-1] added to the sums (a, b):
+ *   a' = a + sum(d[i])
+ *   b' = b + n * a + sum((n - i) * d[i])
+ * Every 32-byte block adds its byte sum (VPSADBW) to a, and its sum weighted
+ * by 32..1 (VPMADDUBSW, VPMADDWD) to b, the a before the block is counted
+ * 32 times in b. The lanes are reduced modulo BASE once per NMAX bytes, like
+ * the scalar code does.
+ */
+
+#include "adler32_simd.h"
+
+#ifdef Z_X86_SIMD
+
+#include <immintrin.h>
+
+#define BASE 65521U     /* largest prime smaller than 65536 */
+#define NMAX 5552       /* as in adler32.c, the sums of the lanes fit 32 bits */
+#define BLOCK 32
+
+/* Sum of the 32-bit lanes */
+Z_TARGET("avx2")
+local unsigned hsum(__m256i x)
+{
+    __m128i y = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 0, 3, 2)));
+    y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned)_mm_cvtsi128_si32(y);
+}
+
+Z_TARGET("avx2")
+uLong ZLIB_INTERNAL adler32_avx2(uLong adler, const Bytef *buf, z_size_t len)
+{
+    const __m256i weights = _mm256_setr_epi8(
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned long sum1 = adler & 0xffff;
+    unsigned long sum2 = (adler >> 16) & 0xffff;
+
+    while (len >= BLOCK) {
+        z_size_t n = (len < NMAX ? len : NMAX) / BLOCK;
+        __m256i a = _mm256_setzero_si256();     /* byte sums */
+        __m256i b = _mm256_setzero_si256();     /* weighted sums */
+        __m256i prefix = _mm256_setzero_si256(); /* byte sums before every block */
+
+        len -= n * BLOCK;
+        sum2 += sum1 * n * BLOCK;
+        do {
+            const __m256i data = _mm256_loadu_si256((const __m256i *)buf);
+            prefix = _mm256_add_epi32(prefix, a);
+            a = _mm256_add_epi32(a, _mm256_sad_epu8(data, zero));
+            b = _mm256_add_epi32(b, _mm256_madd_epi16(_mm256_maddubs_epi16(data, weights), ones));
+            buf += BLOCK;
+        } while (--n);
+
+        b = _mm256_add_epi32(b, _mm256_slli_epi32(prefix, 5));
+        sum1 += hsum(a);
+        sum2 += hsum(b);
+        sum1 %= BASE;
+        sum2 %= BASE;
+    }
+
+    /* the tail is shorter than a block, no overflow before the modulo */
+    while (len--) {
+        sum1 += *buf++;
+        sum2 += sum1;
+    }
+    sum1 %= BASE;
+    sum2 %= BASE;
+    return sum1 | (sum2 << 16);
+}
+
+#endif /* Z_X86_SIMD */
@@ -0,0 +1,20 @@
+/* adler32_simd.h -- Adler-32 by AVX2
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ADLER32_SIMD_H
+#define ADLER32_SIMD_H
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+
+/* Shorter buffers are summed faster by the scalar code */
+#define Z_ADLER32_SIMD_MINIMUM_LENGTH 64
+
+/* Update the Adler-32 with the buffer of any length */
+uLong ZLIB_INTERNAL adler32_avx2 OF((uLong adler, const Bytef *buf, z_size_t len));
+
+#endif /* Z_X86_SIMD */
+
+#endif /* ADLER32_SIMD_H */
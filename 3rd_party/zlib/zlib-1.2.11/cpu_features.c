@@ -0,0 +1,115 @@
+/* cpu_features.c -- runtime selection of the SIMD checksum kernels
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#    include <immintrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+local int simd_features = 0;
+
+#ifdef Z_X86_SIMD
+
+local void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, (int)leaf, (int)subleaf);
+    regs[0] = (unsigned)info[0];
+    regs[1] = (unsigned)info[1];
+    regs[2] = (unsigned)info[2];
+    regs[3] = (unsigned)info[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* Register state enabled by the OS in XCR0 */
+local unsigned long long xgetbv0(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+#endif /* Z_X86_SIMD */
+
+local void detect_features(void)
+{
+#ifdef Z_X86_SIMD
+    unsigned regs[4];
+    unsigned max_leaf;
+    int features = 0;
+
+    cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    cpuid(1, 0, regs);
+
+    /* CRC-32 folding: PCLMULQDQ and SSE4.1 for the final extraction */
+    if ((regs[2] & (1u << 1)) && (regs[2] & (1u << 19)))
+        features |= Z_SIMD_CRC32;
+
+    /* Adler-32: AVX2, and the OS saving the YMM registers (OSXSAVE, AVX, XCR0 bits 1 and 2) */
+    if ((regs[2] & (1u << 27)) && (regs[2] & (1u << 28)) && max_leaf >= 7 &&
+        (xgetbv0() & 6) == 6) {
+        cpuid(7, 0, regs);
+        if (regs[1] & (1u << 5))
+            features |= Z_SIMD_ADLER32;
+    }
+    simd_features = features;
+#endif /* Z_X86_SIMD */
+}
+
+#if defined(_WIN32)
+
+local INIT_ONCE features_once = INIT_ONCE_STATIC_INIT;
+
+local BOOL CALLBACK detect_features_once(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+    (void)once;
+    (void)parameter;
+    (void)context;
+    detect_features();
+    return TRUE;
+}
+
+int ZLIB_INTERNAL cpu_simd_features()
+{
+    InitOnceExecuteOnce(&features_once, detect_features_once, NULL, NULL);
+    return simd_features;
+}
+
+#else
+
+local pthread_once_t features_once = PTHREAD_ONCE_INIT;
+
+int ZLIB_INTERNAL cpu_simd_features()
+{
+    pthread_once(&features_once, detect_features);
+    return simd_features;
+}
+
+#endif
+
+/* ========================================================================= */
+int ZEXPORT zlib_simd_features()
+{
+    return cpu_simd_features();
+}
@@ -0,0 +1,26 @@
+/* cpu_features.h -- runtime selection of the SIMD checksum kernels
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include "zutil.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define Z_X86_SIMD
+#endif
+
+/* The kernels are compiled for their instruction sets by the function
+   attributes, the rest of zlib keeps the baseline target */
+#if defined(__GNUC__) || defined(__clang__)
+#  define Z_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define Z_TARGET(isa)
+#endif
+
+/* Z_SIMD_CRC32 and Z_SIMD_ADLER32 bits of the kernels usable on this CPU,
+   detected once, safe to call from any thread */
+int ZLIB_INTERNAL cpu_simd_features OF((void));
+
+#endif /* CPU_FEATURES_H */
@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "crc32_simd.h"
 
 /* Definitions for doing the crc four data bytes at a time. */
 #if !defined(NOBYFOUR) && defined(Z_U4)
@@ -206,6 +207,27 @@ unsigned long ZEXPORT crc32_z(crc, buf, len)
 {
     if (buf == Z_NULL) return 0UL;
 
+#ifdef Z_X86_SIMD
+    /* whole 16-byte blocks are folded, the tail goes to the tables */
+    if (len >= Z_CRC32_SIMD_MINIMUM_LENGTH && (cpu_simd_features() & Z_SIMD_CRC32)) {
+        z_size_t chunk = len & ~(z_size_t)Z_CRC32_SIMD_CHUNK_MASK;
+        crc = crc32_pclmul(crc ^ 0xffffffffUL, buf, chunk) ^ 0xffffffffUL;
+        buf += chunk;
+        len -= chunk;
+        if (len == 0) return crc;
+    }
+#endif
+    return crc32_portable(crc, buf, len);
+}
+
+/* ========================================================================= */
+unsigned long ZEXPORT crc32_portable(crc, buf, len)
+    unsigned long crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    if (buf == Z_NULL) return 0UL;
+
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
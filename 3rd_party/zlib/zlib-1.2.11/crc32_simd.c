@@ -0,0 +1,102 @@
+/* crc32_simd.c -- CRC-32 by carry-less multiplication
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Folding of 64-byte blocks by PCLMULQDQ and the Barrett reduction, as in
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction",
+ * V. Gopal et al., Intel, 2009. The constants are of the bit-reflected
+ * CRC-32 polynomial 0xEDB88320.
+ */
+
+#include "crc32_simd.h"
+
+#ifdef Z_X86_SIMD
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+/* x^(4*128+32) mod P and x^(4*128-32) mod P, fold by 64 bytes */
+local const unsigned char k1k2[16] = {
+    0xd4, 0x2b, 0x44, 0x54, 0x01, 0x00, 0x00, 0x00,
+    0x96, 0x15, 0xe4, 0xc6, 0x01, 0x00, 0x00, 0x00 };
+
+/* x^(128+32) mod P and x^(128-32) mod P, fold by 16 bytes */
+local const unsigned char k3k4[16] = {
+    0xd0, 0x97, 0x19, 0x75, 0x01, 0x00, 0x00, 0x00,
+    0x9e, 0x00, 0xaa, 0xcc, 0x00, 0x00, 0x00, 0x00 };
+
+/* x^64 mod P, fold 96 bits to 64 */
+local const unsigned char k5k0[16] = {
+    0x24, 0x61, 0xcd, 0x63, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+/* P and mu = x^64 / P of the Barrett reduction */
+local const unsigned char poly[16] = {
+    0x41, 0x06, 0x71, 0xdb, 0x01, 0x00, 0x00, 0x00,
+    0x41, 0x16, 0x01, 0xf7, 0x01, 0x00, 0x00, 0x00 };
+
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+
+/* x = x.low * k.low ^ x.high * k.high ^ next, one 128-bit lane folded over the distance of k */
+#define FOLD(x, k, next) \
+    _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), \
+                                _mm_clmulepi64_si128(x, k, 0x11)), next)
+
+Z_TARGET("pclmul,sse4.1")
+unsigned long ZLIB_INTERNAL crc32_pclmul(unsigned long crc, const unsigned char FAR *buf, z_size_t len)
+{
+    __m128i x0, x1, x2, x3, x4, mask;
+
+    /* four lanes of the first block, the register is added to the first one */
+    x1 = _mm_xor_si128(LOAD(buf), _mm_cvtsi32_si128((int)crc));
+    x2 = LOAD(buf + 16);
+    x3 = LOAD(buf + 32);
+    x4 = LOAD(buf + 48);
+    buf += 64;
+    len -= 64;
+
+    /* the lanes are folded over the next block independently, the multiplications overlap */
+    x0 = LOAD(k1k2);
+    while (len >= 64) {
+        x1 = FOLD(x1, x0, LOAD(buf));
+        x2 = FOLD(x2, x0, LOAD(buf + 16));
+        x3 = FOLD(x3, x0, LOAD(buf + 32));
+        x4 = FOLD(x4, x0, LOAD(buf + 48));
+        buf += 64;
+        len -= 64;
+    }
+
+    /* four lanes into one, then the rest of 16-byte blocks */
+    x0 = LOAD(k3k4);
+    x1 = FOLD(x1, x0, x2);
+    x1 = FOLD(x1, x0, x3);
+    x1 = FOLD(x1, x0, x4);
+    while (len >= 16) {
+        x1 = FOLD(x1, x0, LOAD(buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = LOAD(poly);
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (unsigned long)(unsigned)_mm_extract_epi32(x1, 1);
+}
+
+#endif /* Z_X86_SIMD */
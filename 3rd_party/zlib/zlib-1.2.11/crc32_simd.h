@@ -0,0 +1,24 @@
+/* crc32_simd.h -- CRC-32 by carry-less multiplication
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+
+/* The kernel takes at least 64 bytes, whole 16-byte blocks,
+   shorter lengths and the tail go to the tables */
+#define Z_CRC32_SIMD_MINIMUM_LENGTH 64
+#define Z_CRC32_SIMD_CHUNK_MASK 15
+
+/* Update the bit-inverted CRC-32 (the register, not the final value) with the buffer,
+   len should be a multiple of 16 and at least Z_CRC32_SIMD_MINIMUM_LENGTH */
+unsigned long ZLIB_INTERNAL crc32_pclmul OF((unsigned long crc,
+                            const unsigned char FAR *buf, z_size_t len));
+
+#endif /* Z_X86_SIMD */
+
+#endif /* CRC32_SIMD_H */
@@ -1745,6 +1745,27 @@ ZEXTERN uLong ZEXPORT crc32_z OF((uLong adler, const Bytef *buf,
      Same as crc32(), but with a size_t length.
 */
 
+                        /* SIMD checksums */
+
+#define Z_SIMD_CRC32    1   /* CRC-32 by PCLMULQDQ folding */
+#define Z_SIMD_ADLER32  2   /* Adler-32 by AVX2 */
+
+ZEXTERN int ZEXPORT zlib_simd_features OF((void));
+/*
+     Return the Z_SIMD_* bits of the checksum kernels used on this CPU.
+   crc32(), adler32() and their _z variants, and so deflate and inflate,
+   select the kernels at runtime; the CPU is checked once, on the first call.
+*/
+
+ZEXTERN uLong ZEXPORT adler32_portable OF((uLong adler, const Bytef *buf,
+                                           z_size_t len));
+ZEXTERN uLong ZEXPORT crc32_portable OF((uLong crc, const Bytef *buf,
+                                         z_size_t len));
+/*
+     Same as adler32_z() and crc32_z(), but always by the portable code, the
+   reference of the SIMD kernels.
+*/
+
 /*
 ZEXTERN uLong ZEXPORT crc32_combine OF((uLong crc1, uLong crc2, z_off_t len2));
 
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <winapi-helpers/byte_streambuf.h>
+
+namespace helpers {
+
+class thread_pool;
+class async_read_engine;
+
+/// @brief I/O backend of async_file_reader
+enum class async_read_backend
+{
+    /// io_uring if the kernel supports it, thread pool otherwise
+    automatic,
+
+    /// Linux io_uring over raw system calls, no liburing dependency
+    io_uring,
+
+    /// Positional reads (pread() under POSIX, ReadFile() with offset under Windows) in the thread pool
+    pool
+};
+
+/// @brief Options of async_file_reader
+struct async_read_options
+{
+    /// Size of one read request
+    size_t block_size = byte_stream_buffer_size;
+
+    /// Reads kept in flight ahead of the consumer, every one has its own block buffer
+    size_t queue_depth = 4;
+
+    async_read_backend backend = async_read_backend::automatic;
+
+    /// Thread pool of the pool backend, should outlive the reader.
+    /// If nullptr, the reader starts own pool of queue_depth threads
+    thread_pool* pool = nullptr;
+};
+
+
+/// @brief Sequential file reader with prefetch
+/// Keeps queue_depth block reads in flight while the consumer processes the current block,
+/// so reading of large dumps (SMBIOS tables, memory dumps, registry hives) overlaps their parsing.
+/// Blocks are delivered in the file order to the thread calling next_block() or read().
+/// The reader itself is not thread-safe
+class async_file_reader
+{
+public:
+
+    /// @brief Block consumer, gets the file offset and the block content
+    /// @return: false to stop reading
+    using callback = std::function<bool(std::uint64_t offset, byte_view block)>;
+
+    async_file_reader();
+
+    /// @brief Wait for reads in flight and close the file
+    ~async_file_reader();
+
+    async_file_reader(const async_file_reader&) = delete;
+    async_file_reader& operator=(const async_file_reader&) = delete;
+
+    /// @brief Open the file (path is UTF-8) and start reading from its beginning
+    /// @return: false if the file could not be opened or the requested backend is unavailable
+    bool open(const std::string& path, const async_read_options& options = async_read_options());
+
+    /// @brief Wait for reads in flight and close the file
+    void close();
+
+    /// @brief Check whether the file is opened
+    bool is_open() const;
+
+    /// @brief File size at the moment of open()
+    std::uint64_t size() const;
+
+    /// @brief Backend selected by open()
+    async_read_backend backend() const;
+
+    /// @brief Drop reads in flight and restart reading from the offset
+    bool seek(std::uint64_t offset);
+
+    /// @brief Next block in the file order, waits only if it is not read yet
+    /// The view refers the block buffer and stays valid until the next call,
+    /// then the buffer is reused to prefetch the next block.
+    /// Empty view means the end of file or the read error, see failed()
+    byte_view next_block();
+
+    /// @brief File offset of the block returned by next_block()
+    std::uint64_t block_offset() const;
+
+    /// @brief Read the rest of the file, calling on_block for every block in the file order
+    /// @return: false on read error, true at the end of file or if on_block stopped reading
+    bool read(const callback& on_block);
+
+    /// @brief Check whether a read failed
+    bool failed() const;
+
+    /// @brief OS error code of the failed read (errno or GetLastError()), 0 if none
+    int error() const;
+
+    /// @brief Check whether io_uring backend is supported by the running kernel
+    static bool io_uring_available();
+
+private:
+
+    /// Block buffer and its read request
+    struct block
+    {
+        aligned_buffer buffer;
+        std::uint64_t offset = 0;
+        size_t length = 0;
+        bool pending = false;
+    };
+
+    /// Submit read of the next file block into the block buffer, if the file is not over
+    void submit(size_t index);
+
+    /// Wait for all reads in flight
+    void drain();
+
+    /// PImpl to the backend-specific implementation
+    std::unique_ptr<async_read_engine> engine_;
+
+    /// OS file handle (HANDLE under Windows, descriptor under POSIX), -1 if not opened
+    std::intptr_t file_ = -1;
+
+    std::uint64_t file_size_ = 0;
+    async_read_backend backend_ = async_read_backend::automatic;
+    size_t block_size_ = 0;
+
+    /// Ring of blocks, blocks are submitted and delivered in the same order
+    std::vector<block> blocks_;
+
+    /// Block delivered next
+    size_t head_ = 0;
+
+    /// Block returned by the last next_block(), resubmitted on the next call
+    size_t delivered_ = static_cast<size_t>(-1);
+
+    /// File offset of the next block to submit
+    std::uint64_t next_offset_ = 0;
+
+    std::uint64_t block_offset_ = 0;
+    int error_ = 0;
+};
+
+} // namespace helpers
@@ -0,0 +1,259 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <winapi-helpers/byte_view.h>
+
+namespace helpers {
+
+/// Default buffer size, large enough to amortize system calls
+constexpr size_t byte_stream_buffer_size = 1024 * 1024;
+
+/// Buffers are aligned to the page, friendly to the OS cache and DMA
+constexpr size_t byte_stream_buffer_alignment = 4096;
+
+/// @brief Read mode of byte_istreambuf
+enum class byte_read_mode
+{
+    /// Read by large blocks into the aligned buffer
+    buffered,
+
+    /// Map the whole file into memory, the get area and windows refer the mapping directly
+    mapped
+};
+
+
+/// @brief Page-aligned byte buffer
+struct aligned_buffer_deleter
+{
+    void operator()(std::uint8_t* buffer) const;
+};
+
+using aligned_buffer = std::unique_ptr<std::uint8_t[], aligned_buffer_deleter>;
+
+/// @brief Allocate page-aligned buffer
+aligned_buffer make_aligned_buffer(size_t size);
+
+
+/// @brief Binary file input buffer, works with std::basic_istream<uint8_t>
+/// Reads go directly to the OS file, bypassing locale and codecvt.
+/// Large reads bypass the buffer, mapped mode does not copy at all
+class byte_istreambuf : public std::basic_streambuf<std::uint8_t>
+{
+public:
+
+    byte_istreambuf() = default;
+    ~byte_istreambuf() override;
+
+    byte_istreambuf(const byte_istreambuf&) = delete;
+    byte_istreambuf& operator=(const byte_istreambuf&) = delete;
+
+    /// @brief Open the file, path is UTF-8
+    /// @param buffer_size: read block size in buffered mode
+    /// @return: false if the file could not be opened or mapped
+    bool open(const std::string& path, byte_read_mode mode = byte_read_mode::buffered,
+        size_t buffer_size = byte_stream_buffer_size);
+
+    /// @brief Close the file and unmap it, invalidates all the windows
+    void close();
+
+    /// @brief Check whether the file is opened
+    bool is_open() const;
+
+    /// @brief Check whether the file is opened in mapped mode
+    bool is_mapped() const;
+
+    /// @brief File size at the moment of open()
+    std::uint64_t size() const;
+
+    /// @brief Next (up to max_length) bytes without copying, advances the read position
+    /// Mapped mode: the view refers the mapping and stays valid until close().
+    /// Buffered mode: the view refers the internal buffer and stays valid until the next read.
+    /// Empty view means the end of file
+    byte_view next_window(size_t max_length = static_cast<size_t>(-1));
+
+    /// @brief Whole file mapping, empty view in buffered mode
+    byte_view mapped_view() const;
+
+protected:
+
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+    std::streamsize showmanyc() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+
+    /// Current read position in the file
+    std::uint64_t position() const;
+
+    /// OS file handle (HANDLE under Windows, descriptor under POSIX), -1 if not opened
+    std::intptr_t file_ = -1;
+
+    /// File mapping object, Windows only
+    void* mapping_handle_ = nullptr;
+
+    /// Mapped file content, nullptr in buffered mode
+    std::uint8_t* mapping_ = nullptr;
+
+    std::uint64_t file_size_ = 0;
+
+    /// File offset of eback() in buffered mode
+    std::uint64_t buffer_offset_ = 0;
+
+    aligned_buffer buffer_;
+    size_t buffer_size_ = 0;
+};
+
+
+/// @brief Binary file output buffer, works with std::basic_ostream<uint8_t>
+/// Small writes are collected in the large aligned buffer, large writes go directly to the file
+class byte_ostreambuf : public std::basic_streambuf<std::uint8_t>
+{
+public:
+
+    byte_ostreambuf() = default;
+
+    /// @brief Flush and close
+    ~byte_ostreambuf() override;
+
+    byte_ostreambuf(const byte_ostreambuf&) = delete;
+    byte_ostreambuf& operator=(const byte_ostreambuf&) = delete;
+
+    /// @brief Create or truncate the file (or append to it), path is UTF-8
+    bool open(const std::string& path, bool append = false, size_t buffer_size = byte_stream_buffer_size);
+
+    /// @brief Flush the buffer and close the file
+    /// @return: false if the buffered data could not be written
+    bool close();
+
+    /// @brief Check whether the file is opened
+    bool is_open() const;
+
+protected:
+
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::out) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::out) override;
+
+private:
+
+    /// Write the buffer content to the file
+    bool flush_buffer();
+
+    /// OS file handle (HANDLE under Windows, descriptor under POSIX), -1 if not opened
+    std::intptr_t file_ = -1;
+
+    /// File offset of pbase()
+    std::uint64_t buffer_offset_ = 0;
+
+    aligned_buffer buffer_;
+    size_t buffer_size_ = 0;
+};
+
+
+/// @brief Input stream over byte_istreambuf, drop-in replacement of std::basic_ifstream<uint8_t>
+class byte_ifstream : public std::basic_istream<std::uint8_t>
+{
+public:
+
+    /// Base class keeps only the pointer, so the buffer could be constructed later
+    byte_ifstream() : std::basic_istream<std::uint8_t>(&buffer_) {}
+
+    explicit byte_ifstream(const std::string& path, byte_read_mode mode = byte_read_mode::buffered,
+        size_t buffer_size = byte_stream_buffer_size) : byte_ifstream()
+    {
+        open(path, mode, buffer_size);
+    }
+
+    /// @brief Open the file, set failbit on error
+    void open(const std::string& path, byte_read_mode mode = byte_read_mode::buffered,
+        size_t buffer_size = byte_stream_buffer_size)
+    {
+        if (buffer_.open(path, mode, buffer_size)) {
+            clear();
+        }
+        else {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    void close()
+    {
+        buffer_.close();
+    }
+
+    bool is_open() const
+    {
+        return buffer_.is_open();
+    }
+
+    byte_istreambuf* rdbuf() const
+    {
+        return const_cast<byte_istreambuf*>(&buffer_);
+    }
+
+private:
+
+    byte_istreambuf buffer_;
+};
+
+
+/// @brief Output stream over byte_ostreambuf, drop-in replacement of std::basic_ofstream<uint8_t>
+class byte_ofstream : public std::basic_ostream<std::uint8_t>
+{
+public:
+
+    /// Base class keeps only the pointer, so the buffer could be constructed later
+    byte_ofstream() : std::basic_ostream<std::uint8_t>(&buffer_) {}
+
+    explicit byte_ofstream(const std::string& path, bool append = false,
+        size_t buffer_size = byte_stream_buffer_size) : byte_ofstream()
+    {
+        open(path, append, buffer_size);
+    }
+
+    /// @brief Open the file, set failbit on error
+    void open(const std::string& path, bool append = false, size_t buffer_size = byte_stream_buffer_size)
+    {
+        if (buffer_.open(path, append, buffer_size)) {
+            clear();
+        }
+        else {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    /// @brief Flush and close, set failbit if the data could not be written
+    void close()
+    {
+        if (!buffer_.close()) {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    bool is_open() const
+    {
+        return buffer_.is_open();
+    }
+
+    byte_ostreambuf* rdbuf() const
+    {
+        return const_cast<byte_ostreambuf*>(&buffer_);
+    }
+
+private:
+
+    byte_ostreambuf buffer_;
+};
+
+} // namespace helpers
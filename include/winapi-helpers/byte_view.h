@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <winapi-helpers/uint8_codecvt.h>
+
+namespace helpers {
+
+/// @brief Non-owning view of bytes, e.g. the window of the memory-mapped file or the blob column
+using byte_view = std::basic_string_view<std::uint8_t>;
+
+} // namespace helpers
@@ -0,0 +1,281 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <cstdint>
+#include <functional>
+#include <winapi-helpers/dynamic_handler_map.h>
+
+namespace helpers {
+
+/// @brief Epoch-based reclamation domain shared by all ConcurrentHandlerMap instances
+/// Every reader thread owns a record with the epoch it entered the read section in,
+/// writer may delete retired snapshot only when all records are idle or entered later.
+/// Reader enter/leave are a couple of stores, no locks, no CAS loops
+class ReclamationDomain
+{
+public:
+
+    /// Epoch value of the thread out of any read section
+    static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+    /// @brief Per-thread reader record, records are never deleted, only reused
+    struct alignas(64) ReaderRecord
+    {
+        std::atomic<std::uint64_t> epoch{ idle };
+        std::atomic<bool> in_use{ false };
+        ReaderRecord* next = nullptr;
+
+        /// Nested read sections of the owner thread (handler calls other map)
+        unsigned nesting = 0;
+    };
+
+    /// @brief RAII read section guard
+    class ReadGuard
+    {
+    public:
+
+        explicit ReadGuard(ReclamationDomain& domain) : record_(domain.thread_record())
+        {
+            if (0 == record_->nesting++) {
+                record_->epoch.store(domain.epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+            }
+        }
+
+        ~ReadGuard()
+        {
+            if (0 == --record_->nesting) {
+                record_->epoch.store(idle, std::memory_order_release);
+            }
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+
+        ReaderRecord* record_;
+    };
+
+    /// @brief Construct on the first call, return "Meyers singleton" afterwards
+    static ReclamationDomain& instance()
+    {
+        static ReclamationDomain domain;
+        return domain;
+    }
+
+    /// @brief Advance global epoch, objects unpublished before the call are tagged with result
+    std::uint64_t advance()
+    {
+        return epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+
+    /// @brief Check whether object retired with retire_epoch tag is not visible for any reader
+    bool is_safe(std::uint64_t retire_epoch) const
+    {
+        for (ReaderRecord* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+            if (r->epoch.load(std::memory_order_seq_cst) < retire_epoch) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+
+    ReclamationDomain() = default;
+    ReclamationDomain(const ReclamationDomain&) = delete;
+    ReclamationDomain& operator=(const ReclamationDomain&) = delete;
+
+    /// Release the record on thread exit, so that the next thread could reuse it
+    struct RecordHolder
+    {
+        ReaderRecord* record = nullptr;
+
+        ~RecordHolder()
+        {
+            if (record) {
+                record->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    ReaderRecord* thread_record()
+    {
+        thread_local RecordHolder holder;
+        if (nullptr == holder.record) {
+            holder.record = acquire_record();
+        }
+        return holder.record;
+    }
+
+    /// Reuse free record or push new one to the lock-free list, once per thread
+    ReaderRecord* acquire_record()
+    {
+        for (ReaderRecord* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load(std::memory_order_relaxed) &&
+                r->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return r;
+            }
+        }
+
+        ReaderRecord* r = new ReaderRecord;
+        r->in_use.store(true, std::memory_order_relaxed);
+        r->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(r->next, r, std::memory_order_acq_rel)) {}
+        return r;
+    }
+
+    /// Global epoch counter
+    std::atomic<std::uint64_t> epoch_{ 0 };
+
+    /// Lock-free list of reader records
+    std::atomic<ReaderRecord*> records_{ nullptr };
+};
+
+
+/// @brief Read-mostly concurrent HandlerMap
+/// Readers call handlers from the immutable snapshot without locks (wait-free lookup),
+/// insert() copies the snapshot, publishes the new one and retires the old one.
+/// Retired snapshots are deleted by writers when no reader could see them anymore
+/// @typename Key: any param that satisfies std::map key prerequisites (int, enum etc)
+/// @typename Handler: any callable object (should have the same signature for one Map; Could be null)
+/// @typename NoKeyPolicy: action when Key is not found
+/// @typename NullHandlePolicy: action when Handle is NULL
+template <typename Key, typename Handler,
+    template <typename RetType> class NoKeyPolicy = ThrowPolicy,
+    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy>
+class ConcurrentHandlerMap
+{
+public:
+
+    using snapshot_type = std::map<Key, Handler>;
+
+    /// @brief Empty handlers map
+    ConcurrentHandlerMap() : ConcurrentHandlerMap(snapshot_type{}) {}
+
+    /// @brief Initialize handlers map with {}-notation
+    ConcurrentHandlerMap(snapshot_type other) : snapshot_(new snapshot_type(std::move(other)))
+    {
+        static_assert(helpers::IsCallable<Handler>::value,
+            "Second ConcurrentHandlerMap<> template param should be callable");
+    }
+
+    /// @brief Delete current and retired snapshots
+    /// Map should not be destroyed while any thread calls it
+    ~ConcurrentHandlerMap()
+    {
+        delete snapshot_.load(std::memory_order_acquire);
+        for (const Retired& r : retired_) {
+            delete r.snapshot;
+        }
+    }
+
+    ConcurrentHandlerMap(const ConcurrentHandlerMap&) = delete;
+    ConcurrentHandlerMap& operator=(const ConcurrentHandlerMap&) = delete;
+
+    /// @brief Add new handler, publishing new snapshot copy-on-write
+    /// Writers are serialized, readers are never blocked
+    void insert(const Key key, Handler handler)
+    {
+        update([&](snapshot_type& snapshot) { snapshot[key] = std::move(handler); });
+    }
+
+    /// @brief Remove the handler, publishing new snapshot copy-on-write
+    void erase(const Key& key)
+    {
+        update([&](snapshot_type& snapshot) { snapshot.erase(key); });
+    }
+
+    /// @brief Handler invoke point. Lookup handler by the key, pass params pack,
+    /// return handler value. Perform Policy actions on non-existent Key and nullptr Handle
+    /// Handler is executed inside read section, so it could call insert() safely
+    template <typename... Args>
+    auto call(const Key& key, Args&&... args) -> std::result_of_t<Handler(Args...)>
+    {
+        using ResultType = std::result_of_t<Handler(Args...)>;
+
+        ReclamationDomain::ReadGuard guard(ReclamationDomain::instance());
+        const snapshot_type* snapshot = snapshot_.load(std::memory_order_seq_cst);
+
+        auto it = snapshot->find(key);
+        if (it == snapshot->end()) {
+            return NoKeyPolicy<ResultType>::no_handler();
+        }
+
+        const Handler& callback = it->second;
+        if (nullptr == callback) {
+            return NullHandlePolicy<ResultType>::null_handler();
+        }
+        return callback(std::forward<Args>(args)...);
+    }
+
+    /// @brief Handlers count in the current snapshot
+    size_t size() const
+    {
+        ReclamationDomain::ReadGuard guard(ReclamationDomain::instance());
+        return snapshot_.load(std::memory_order_seq_cst)->size();
+    }
+
+    /// @brief Delete retired snapshots which are not visible for readers anymore
+    /// Called on every update, could be called explicitly after the burst of inserts
+    /// @return: number of snapshots waiting for reclamation
+    size_t reclaim()
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        return reclaim_locked();
+    }
+
+private:
+
+    /// Snapshot unpublished in the retire_epoch
+    struct Retired
+    {
+        const snapshot_type* snapshot;
+        std::uint64_t retire_epoch;
+    };
+
+    template <typename Modifier>
+    void update(Modifier modify)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        const snapshot_type* current = snapshot_.load(std::memory_order_relaxed);
+        std::unique_ptr<snapshot_type> next = std::make_unique<snapshot_type>(*current);
+        modify(*next);
+
+        const snapshot_type* old = snapshot_.exchange(next.release(), std::memory_order_seq_cst);
+        retired_.push_back({ old, ReclamationDomain::instance().advance() });
+        reclaim_locked();
+    }
+
+    size_t reclaim_locked()
+    {
+        ReclamationDomain& domain = ReclamationDomain::instance();
+        auto it = retired_.begin();
+        while (it != retired_.end()) {
+            if (domain.is_safe(it->retire_epoch)) {
+                delete it->snapshot;
+                it = retired_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        return retired_.size();
+    }
+
+    /// Current published snapshot
+    std::atomic<const snapshot_type*> snapshot_;
+
+    /// Serialize writers
+    std::mutex writer_mutex_;
+
+    /// Snapshots waiting for readers to leave
+    std::vector<Retired> retired_;
+};
+
+} // namespace helpers
@@ -1,7 +1,24 @@
 #pragma once
 #include <map>
+#include <mutex>
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <future>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <exception>
+#include <algorithm>
 #include <functional>
+#include <condition_variable>
+#include <stdexcept>
+#include <type_traits>
 #include <winapi-helpers/is_callable.h>
+#include <winapi-helpers/thread_pool.h>
+#include <winapi-helpers/handler_statistics.h>
 
 namespace helpers {
 
@@ -49,14 +66,55 @@ struct ThrowPolicy
 };
 
 
+namespace handler_map_details {
+
+template <typename T>
+struct IsTuple : std::false_type {};
+
+template <typename... T>
+struct IsTuple<std::tuple<T...>> : std::true_type {};
+
+/// Result of the handler called with batch message arguments
+/// Arguments are either single value or std::tuple of values
+template <typename Handler, typename Arguments>
+struct BatchResult
+{
+    using type = std::result_of_t<const Handler&(const Arguments&)>;
+};
+
+template <typename Handler, typename... T>
+struct BatchResult<Handler, std::tuple<T...>>
+{
+    using type = std::result_of_t<const Handler&(const T&...)>;
+};
+
+template <typename Handler, typename Arguments>
+decltype(auto) batch_invoke(const Handler& handler, const Arguments& args)
+{
+    if constexpr (IsTuple<Arguments>::value) {
+        return std::apply(handler, args);
+    }
+    else {
+        return handler(args);
+    }
+}
+
+} // namespace handler_map_details
+
+
 /// @brief Perform universal mapping Key type to executable Handler
 /// @typename Key: any param that satisfies std::map key prerequisites (int, enum etc)
 /// @typename Handler: any callable object (should have the same signature for one Map; Could be null)
 /// @typename NoKeyPolicy: action when Key is not found
 /// @typename NullHandlePolicy: action when Handle is NULL
+/// @typename Compare: keys comparator, transparent one (std::less<>) enables lookup
+/// by any comparable type, e.g. std::string_view or const char* for std::string keys
+/// @typename StatsPolicy: per-key calls instrumentation, CallStatistics to enable
 template <typename Key, typename Handler, 
     template <typename RetType> class NoKeyPolicy = ThrowPolicy,
-    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy>
+    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy,
+    typename Compare = std::less<Key>,
+    template <typename StatsKey> class StatsPolicy = NoCallStatistics>
 class HandlerMap
 {
 public:
@@ -69,10 +127,10 @@ public:
     }
 
     /// @brief Initialize handlers map with {}-notation
-    HandlerMap(std::map<Key, Handler> other) : handler_map_(std::move(other)) {}
+    HandlerMap(std::map<Key, Handler, Compare> other) : handler_map_(std::move(other)) {}
 
     /// @brief Initialize handlers map std::move() operation
-    HandlerMap(std::map<Key, Handler>&& other) : handler_map_(std::move(other)) {}
+    HandlerMap(std::map<Key, Handler, Compare>&& other) : handler_map_(std::move(other)) {}
 
     /// @brief Add new handler
     void insert(const Key key, Handler handler)
@@ -90,8 +148,9 @@ public:
 
     /// @brief Handler invoke point. Lookup handler by the key, pass params pack,
     /// return handler value. Perform Policy actions on non-existent Key and nullptr Handle
-    template <typename... Args>
-    auto call(const Key& key, Args&&... args) -> std::result_of_t<Handler(Args...)>
+    /// With transparent Compare LookupKey is compared to Key as is, without conversion
+    template <typename LookupKey, typename... Args>
+    auto call(const LookupKey& key, Args&&... args) -> std::result_of_t<Handler(Args...)>
     {
         /// Check whether we have a return type in our handler
         using ResultType = std::result_of_t <Handler(Args...)>;
@@ -99,17 +158,181 @@ public:
         // If handler does not exist just leave
         auto it = handler_map_.find(key);
         if (it == handler_map_.end()) {
+            statistics_.no_handler(key);
             return NoKeyPolicy<ResultType>::no_handler();
         }
 
-        // call handler if not 0
-        auto callback = handler_map_.at(key);
+        // call handler if not 0; the copy is called, so the handler could replace itself
+        auto callback = it->second;
         if (nullptr == callback) {
+            statistics_.null_handler(it->first);
             return NullHandlePolicy<ResultType>::null_handler();
         }
+
+        [[maybe_unused]] auto probe = statistics_.probe(it->first);
         return callback(std::forward<Args>(args)...);
     }
 
+    /// @brief Batch invoke point. Messages are grouped by the key, every handler is looked up once
+    /// and called for all messages of the group back to back, which is friendly to instruction cache.
+    /// Messages of the same key are executed in the arrival order
+    /// @param batch: array of (key, arguments) messages, arguments are either single value
+    /// or std::tuple unpacked to the handler params
+    /// @param count: number of messages in the batch
+    /// @param pool: optional thread pool to spread the groups across, nullptr to run in the caller thread.
+    /// The caller takes the groups too and runs the ones no worker picked up, so a busy or stopped pool
+    /// only slows the batch down. Calls from the tasks of the same pool are not supported:
+    /// they complete, but get no help from the workers waiting for them
+    /// @return: handlers results in the input order, nothing for void() handlers
+    /// Policy actions are performed for every message of non-existent Key or nullptr Handle
+    template <typename Arguments>
+    auto call_batch(const std::pair<Key, Arguments>* batch, size_t count, thread_pool* pool = nullptr)
+    {
+        using ResultType = typename handler_map_details::BatchResult<Handler, Arguments>::type;
+
+        // Stable sort of message indices by the key keeps arrival order inside the group
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), size_t(0));
+        const Compare& less = handler_map_.key_comp();
+        std::stable_sort(order.begin(), order.end(), [batch, &less](size_t l, size_t r) {
+            return less(batch[l].first, batch[r].first);
+        });
+
+        // [first, last) ranges of the order array with equal keys
+        std::vector<std::pair<size_t, size_t>> groups;
+        for (size_t first = 0; first < count;) {
+            size_t last = first + 1;
+            while (last < count && !less(batch[order[first]].first, batch[order[last]].first)) {
+                ++last;
+            }
+            groups.emplace_back(first, last);
+            first = last;
+        }
+
+        // void() handlers have nothing to store
+        using StoredType = std::conditional_t<std::is_void_v<ResultType>, char, ResultType>;
+        std::vector<std::optional<StoredType>> results;
+        if constexpr (!std::is_void_v<ResultType>) {
+            results.resize(count);
+        }
+
+        auto run_group = [this, batch, &order, &results](size_t first, size_t last) {
+            auto it = handler_map_.find(batch[order[first]].first);
+            for (size_t i = first; i < last; ++i) {
+                const size_t index = order[i];
+                if (it == handler_map_.end()) {
+                    statistics_.no_handler(batch[index].first);
+                }
+                else if (nullptr == it->second) {
+                    statistics_.null_handler(it->first);
+                }
+
+                if constexpr (std::is_void_v<ResultType>) {
+                    if (it == handler_map_.end()) {
+                        NoKeyPolicy<ResultType>::no_handler();
+                    }
+                    else if (nullptr == it->second) {
+                        NullHandlePolicy<ResultType>::null_handler();
+                    }
+                    else {
+                        [[maybe_unused]] auto probe = statistics_.probe(it->first);
+                        handler_map_details::batch_invoke(it->second, batch[index].second);
+                    }
+                }
+                else {
+                    if (it == handler_map_.end()) {
+                        results[index].emplace(NoKeyPolicy<ResultType>::no_handler());
+                    }
+                    else if (nullptr == it->second) {
+                        results[index].emplace(NullHandlePolicy<ResultType>::null_handler());
+                    }
+                    else {
+                        [[maybe_unused]] auto probe = statistics_.probe(it->first);
+                        results[index].emplace(handler_map_details::batch_invoke(it->second, batch[index].second));
+                    }
+                }
+            }
+        };
+
+        if (nullptr == pool || groups.size() < 2) {
+            for (const auto& group : groups) {
+                run_group(group.first, group.second);
+            }
+        }
+        else {
+            // Helpers and the caller take groups by the shared counter. A helper started after the caller
+            // has closed the batch returns at once, so queued helpers never touch the local data later
+            struct BatchState
+            {
+                std::atomic<size_t> next_group{ 0 };
+                std::mutex mutex;
+                std::condition_variable finished;
+                size_t active_helpers = 0;
+                bool closed = false;
+                std::exception_ptr error;
+            };
+            auto state = std::make_shared<BatchState>();
+
+            // All the groups run even if some throw, the first exception is rethrown
+            auto take_groups = [&state, &groups, &run_group]() {
+                for (size_t i = state->next_group++; i < groups.size(); i = state->next_group++) {
+                    try {
+                        run_group(groups[i].first, groups[i].second);
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (!state->error) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                }
+            };
+
+            const size_t helpers_count = std::min(pool->threads_number(), groups.size() - 1);
+            for (size_t i = 0; i < helpers_count; ++i) {
+                // stopped pool does not take the task, the caller runs its groups
+                pool->enqueue([state, &take_groups]() {
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (state->closed) {
+                            return;
+                        }
+                        ++state->active_helpers;
+                    }
+                    take_groups();
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (0 == --state->active_helpers) {
+                        state->finished.notify_all();
+                    }
+                });
+            }
+
+            take_groups();
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->closed = true;
+            state->finished.wait(lock, [&state] { return 0 == state->active_helpers; });
+            if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+        }
+
+        if constexpr (!std::is_void_v<ResultType>) {
+            std::vector<ResultType> ordered_results;
+            ordered_results.reserve(count);
+            for (std::optional<StoredType>& r : results) {
+                ordered_results.push_back(std::move(*r));
+            }
+            return ordered_results;
+        }
+    }
+
+    /// @brief Batch invoke point, see above
+    template <typename Arguments>
+    auto call_batch(const std::vector<std::pair<Key, Arguments>>& batch, thread_pool* pool = nullptr)
+    {
+        return call_batch(batch.data(), batch.size(), pool);
+    }
+
     /// @brief Sometimes we have to deal with fixed number of handlers
     /// This method provide us simple runtime-check
     void throw_if_unexpected(size_t s)
@@ -125,10 +348,128 @@ public:
         return handler_map_.size();
     }
 
+    /// @brief Calls instrumentation, e.g. statistics().snapshot() for CallStatistics policy
+    StatsPolicy<Key>& statistics()
+    {
+        return statistics_;
+    }
+
 private:
 
     /// Map of callable objects
-    std::map<Key, Handler> handler_map_;
+    std::map<Key, Handler, Compare> handler_map_;
+
+    /// Calls instrumentation
+    StatsPolicy<Key> statistics_;
+};
+
+
+/// @brief HandlerMap with std::string keys, lookup by std::string_view 
+/// or const char* does not create temporary std::string
+template <typename Handler,
+    template <typename RetType> class NoKeyPolicy = ThrowPolicy,
+    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy>
+using StringHandlerMap = HandlerMap<std::string, Handler, NoKeyPolicy, NullHandlePolicy, std::less<>>;
+
+
+/// @brief HandlerMap flavor with interned keys
+/// Every key gets small integer id at registration, hot path dispatches by id,
+/// which is vector index instead of key comparison
+/// @typename Key: any param that satisfies std::map key prerequisites (int, enum, string etc)
+/// @typename Handler: any callable object (should have the same signature for one Map; Could be null)
+/// @typename NoKeyPolicy: action when Key or id is not found
+/// @typename NullHandlePolicy: action when Handle is NULL
+/// @typename Compare: keys comparator, transparent by default
+template <typename Key, typename Handler,
+    template <typename RetType> class NoKeyPolicy = ThrowPolicy,
+    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy,
+    typename Compare = std::less<>>
+class InternedHandlerMap
+{
+public:
+
+    /// Interned key representation
+    using key_id = std::uint32_t;
+
+    /// @brief Empty handlers map
+    InternedHandlerMap()
+    {
+        static_assert(helpers::IsCallable<Handler>::value,
+            "Second InternedHandlerMap<> template param should be callable");
+    }
+
+    /// @brief Add new handler or replace existing one
+    /// @return: key id, the same for the same key for the map lifetime
+    key_id insert(const Key& key, Handler handler)
+    {
+        auto it = ids_.find(key);
+        if (it != ids_.end()) {
+            handlers_[it->second] = std::move(handler);
+            return it->second;
+        }
+
+        const key_id id = static_cast<key_id>(handlers_.size());
+        handlers_.push_back(std::move(handler));
+        ids_.emplace(key, id);
+        return id;
+    }
+
+    /// @brief Find key id, to be resolved once out of the hot path
+    template <typename LookupKey>
+    std::optional<key_id> find_id(const LookupKey& key) const
+    {
+        auto it = ids_.find(key);
+        if (it == ids_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    /// @brief Handler invoke point by the interned id
+    /// Perform Policy actions on unknown id and nullptr Handle
+    template <typename... Args>
+    auto call_id(key_id id, Args&&... args) -> std::result_of_t<Handler(Args...)>
+    {
+        using ResultType = std::result_of_t<Handler(Args...)>;
+
+        if (id >= handlers_.size()) {
+            return NoKeyPolicy<ResultType>::no_handler();
+        }
+
+        // the copy is called, insert() from the handler could reallocate the handlers
+        auto callback = handlers_[id];
+        if (nullptr == callback) {
+            return NullHandlePolicy<ResultType>::null_handler();
+        }
+        return callback(std::forward<Args>(args)...);
+    }
+
+    /// @brief Handler invoke point by the key, same as HandlerMap::call()
+    template <typename LookupKey, typename... Args>
+    auto call(const LookupKey& key, Args&&... args) -> std::result_of_t<Handler(Args...)>
+    {
+        using ResultType = std::result_of_t<Handler(Args...)>;
+
+        auto it = ids_.find(key);
+        if (it == ids_.end()) {
+            return NoKeyPolicy<ResultType>::no_handler();
+        }
+        return call_id(it->second, std::forward<Args>(args)...);
+    }
+
+    /// @brief Handlers count
+    size_t size() const
+    {
+        return handlers_.size();
+    }
+
+private:
+
+    /// Key to id mapping, used at registration and by-key calls only
+    std::map<Key, key_id, Compare> ids_;
+
+    /// Handlers indexed by key id
+    std::vector<Handler> handlers_;
 };
 
 } // namespace helpers 
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include <winapi-helpers/byte_view.h>
+
+namespace helpers {
+
+class thread_pool;
+
+/// @brief Options of gzip_writer
+struct gzip_writer_options
+{
+    /// Input compressed by one task, smaller blocks lose a little of ratio on their boundaries
+    size_t block_size = 128 * 1024;
+
+    /// zlib level: 1 is the fastest, 9 is the smallest, -1 is the default 6
+    int level = -1;
+
+    /// Blocks kept in flight ahead of the output, every one holds its input and output.
+    /// If 0, twice the threads of the pool
+    size_t queue_depth = 0;
+
+    /// Thread pool compressing the blocks, should outlive the writer.
+    /// If nullptr, the writer starts own pool of hardware threads
+    thread_pool* pool = nullptr;
+};
+
+
+/// @brief Parallel gzip compressor, like pigz
+/// Input is split into blocks compressed concurrently in the thread pool as raw deflate,
+/// every block is primed with the last 32 KB of the previous one, so the ratio stays close to the
+/// single-threaded deflate. Blocks end byte-aligned and are written in order, CRC-32 of the blocks
+/// are combined, so the output is the standard single-member gzip stream read by any gunzip.
+/// Memory is bounded by queue_depth blocks. The writer itself is not thread-safe
+class gzip_writer
+{
+public:
+
+    /// @brief Output consumer, gets the compressed stream piece by piece in order
+    /// @return: false to fail the writer
+    using sink = std::function<bool(byte_view)>;
+
+    gzip_writer();
+
+    /// @brief Finish the stream, if it is not closed yet
+    ~gzip_writer();
+
+    gzip_writer(const gzip_writer&) = delete;
+    gzip_writer& operator=(const gzip_writer&) = delete;
+
+    /// @brief Start the stream written to the sink
+    /// @return: false if the options are invalid
+    bool open(const sink& output, const gzip_writer_options& options = gzip_writer_options());
+
+    /// @brief Start the stream written to the byte stream, e.g. byte_ofstream
+    /// The stream should outlive the writer
+    bool open(std::basic_ostream<std::uint8_t>& output, const gzip_writer_options& options = gzip_writer_options());
+
+    /// @brief Compress the data, full blocks are queued to the pool and the ready ones are written
+    /// @return: false if the writer is failed or not opened
+    bool write(byte_view data);
+
+    /// @brief Compress the rest, wait for all the blocks and write the gzip trailer
+    /// @return: false if any block or output failed
+    bool close();
+
+    /// @brief Check whether the stream is opened and not closed yet
+    bool is_open() const;
+
+    /// @brief Check whether compression or output failed
+    bool failed() const;
+
+    /// @brief Uncompressed bytes written so far
+    std::uint64_t size() const;
+
+    /// @brief Compressed bytes passed to the sink so far
+    std::uint64_t compressed_size() const;
+
+private:
+
+    /// Compression task of one block
+    struct block
+    {
+        /// Input of the block
+        std::vector<std::uint8_t> input;
+
+        /// Input of the previous block, its tail is the dictionary
+        std::shared_ptr<const block> previous;
+
+        /// Raw deflate of the block, byte-aligned, final for the last block
+        std::vector<std::uint8_t> output;
+
+        std::uint32_t crc = 0;
+        bool last = false;
+
+        /// Taken by the pool task or by the writer, whichever comes first, so a busy or stopped
+        /// pool does not hold the output back
+        std::atomic<bool> claimed{ false };
+    };
+
+    /// Queue the current block and start the next one
+    void submit(bool last);
+
+    /// Wait for the oldest block in flight, or compress it here if the pool has not started it, and write it
+    void drain_one();
+
+    /// Pass the bytes to the sink
+    void emit(byte_view data);
+
+    /// Compress the block in the pool thread
+    static bool deflate_block(block& task, int level);
+
+    /// Own pool, if no pool is given in the options
+    std::unique_ptr<thread_pool> own_pool_;
+    thread_pool* pool_ = nullptr;
+
+    sink output_;
+    gzip_writer_options options_;
+
+    /// Block being filled by write()
+    std::shared_ptr<block> current_;
+
+    /// Last queued block, the dictionary of the current one
+    std::shared_ptr<const block> previous_;
+
+    /// Blocks in flight in the output order
+    std::deque<std::pair<std::shared_ptr<block>, std::future<bool>>> queue_;
+
+    /// CRC-32 of the blocks written so far
+    std::uint32_t crc_ = 0;
+
+    std::uint64_t size_ = 0;
+    std::uint64_t compressed_size_ = 0;
+    bool open_ = false;
+    bool failed_ = false;
+};
+
+/// @brief Compress the whole buffer into the gzip stream with gzip_writer
+/// @return: false on failure
+bool gzip_compress(byte_view data, std::vector<std::uint8_t>& compressed,
+    const gzip_writer_options& options = gzip_writer_options());
+
+} // namespace helpers
@@ -0,0 +1,366 @@
+#pragma once
+#include <map>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+namespace helpers {
+
+/// @brief Statistics policy class that passed to HandlerMap
+/// Does not collect anything, all calls are optimized out
+template <typename Key>
+class NoCallStatistics
+{
+public:
+
+    /// @brief Call measurement scope, nothing to measure
+    struct Probe {};
+
+    /// @brief Start measurement of the handler call
+    Probe probe(const Key&)
+    {
+        return Probe{};
+    }
+
+    /// @brief Key is not found
+    template <typename LookupKey>
+    void no_handler(const LookupKey&) {}
+
+    /// @brief Handler is NULL
+    void null_handler(const Key&) {}
+};
+
+
+/// @brief Snapshot of one handler call statistics
+struct HandlerStatistics
+{
+    /// Log2 latency histogram, bucket N contains calls of [2^(N-1), 2^N) nanoseconds
+    static constexpr size_t histogram_buckets = 64;
+
+    /// Successful handler calls
+    std::uint64_t calls = 0;
+
+    /// Calls of the NULL handler
+    std::uint64_t null_handler_calls = 0;
+
+    /// Calls with measured latency
+    std::uint64_t sampled_calls = 0;
+
+    /// Total latency of sampled calls
+    std::chrono::nanoseconds sampled_time{};
+
+    /// Latency histogram of sampled calls
+    std::array<std::uint64_t, histogram_buckets> histogram{};
+
+    /// @brief Estimated total time of all calls, extrapolated from the sampled ones
+    std::chrono::nanoseconds total_time() const
+    {
+        if (0 == sampled_calls) {
+            return std::chrono::nanoseconds{};
+        }
+        return std::chrono::nanoseconds(static_cast<std::int64_t>(
+            static_cast<double>(sampled_time.count()) * calls / sampled_calls));
+    }
+
+    /// @brief Upper bound of the latency percentile, e.g. percentile(0.99)
+    std::chrono::nanoseconds percentile(double fraction) const
+    {
+        const double threshold = fraction * sampled_calls;
+        std::uint64_t accumulated = 0;
+        for (size_t i = 0; i < histogram_buckets; ++i) {
+            accumulated += histogram[i];
+            if (accumulated > 0 && accumulated >= threshold) {
+                return std::chrono::nanoseconds(i == 0 ? 0 : (std::int64_t(1) << (i < 63 ? i : 62)));
+            }
+        }
+        return std::chrono::nanoseconds{};
+    }
+};
+
+
+/// @brief Snapshot of all the calls of HandlerMap
+template <typename Key>
+struct CallStatisticsSnapshot
+{
+    /// Statistics of the keys in the map
+    std::map<Key, HandlerStatistics> handlers;
+
+    /// Calls of the keys not found in the map, not split by key:
+    /// the keys could come from outside and are not kept
+    std::uint64_t no_handler_calls = 0;
+};
+
+
+/// @brief Statistics policy class that passed to HandlerMap
+/// Collects per-key call count, sampled latency histogram and miss counts.
+/// Every thread writes its own counters, so the hot path has neither locks
+/// nor contended atomic operations; snapshot() sums all threads counters
+template <typename Key>
+class CallStatistics
+{
+    /// Counters of one key written by the single thread, read by snapshot()
+    struct Counters
+    {
+        std::atomic<std::uint64_t> calls{ 0 };
+        std::atomic<std::uint64_t> null_handler_calls{ 0 };
+        std::atomic<std::uint64_t> sampled_calls{ 0 };
+        std::atomic<std::uint64_t> sampled_nanoseconds{ 0 };
+        std::array<std::atomic<std::uint64_t>, HandlerStatistics::histogram_buckets> histogram{};
+    };
+
+    /// Counters of all the keys called from one thread
+    struct Shard
+    {
+        /// Protects keys insertion by the owner against snapshot()
+        std::mutex mutex;
+
+        std::map<Key, std::unique_ptr<Counters>> counters;
+
+        /// Calls of the keys not found in the map
+        std::atomic<std::uint64_t> no_handler_calls{ 0 };
+
+        /// Owner thread calls sequence, to select calls for sampling
+        std::uint64_t sequence = 0;
+
+        /// Owner thread has exited, the counters are final and could be merged
+        std::atomic<bool> retired{ false };
+    };
+
+    /// Shard of the instance in the thread cache
+    struct CachedShard
+    {
+        Shard* shard;
+
+        /// Expires with the instance, so the entry could be pruned
+        std::weak_ptr<Shard> alive;
+    };
+
+    /// Shards of all the instances called from one thread
+    struct ThreadCache
+    {
+        /// Last called instance, the map is searched only when the thread switches instances
+        std::uint64_t last_id = 0;
+        Shard* last_shard = nullptr;
+
+        std::unordered_map<std::uint64_t, CachedShard> shards;
+
+        /// Entries of the destroyed instances are pruned when the map grows to this size
+        size_t prune_size = 16;
+
+        /// The thread exits, its shards of the live instances are merged by the next registering thread
+        ~ThreadCache()
+        {
+            for (auto& entry : shards) {
+                if (std::shared_ptr<Shard> shard = entry.second.alive.lock()) {
+                    shard->retired.store(true, std::memory_order_release);
+                }
+            }
+        }
+    };
+
+    /// Single writer increment, cheaper than fetch_add()
+    static void increment(std::atomic<std::uint64_t>& counter, std::uint64_t value = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+public:
+
+    /// @brief Call measurement scope, records the call on destruction
+    class Probe
+    {
+    public:
+
+        Probe(Counters* counters, bool sampled) :
+            counters_(counters),
+            start_(sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{})
+        {
+        }
+
+        ~Probe()
+        {
+            increment(counters_->calls);
+            if (start_ == std::chrono::steady_clock::time_point{}) {
+                return;
+            }
+
+            const std::uint64_t elapsed = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+            size_t bucket = 0;
+            while (bucket + 1 < HandlerStatistics::histogram_buckets && (elapsed >> bucket) != 0) {
+                ++bucket;
+            }
+            increment(counters_->sampled_calls);
+            increment(counters_->sampled_nanoseconds, elapsed);
+            increment(counters_->histogram[bucket]);
+        }
+
+        Probe(const Probe&) = delete;
+        Probe& operator=(const Probe&) = delete;
+
+    private:
+
+        Counters* counters_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    CallStatistics() : id_(next_id()) {}
+
+    CallStatistics(const CallStatistics&) = delete;
+    CallStatistics& operator=(const CallStatistics&) = delete;
+
+    /// @brief Start measurement of the handler call
+    Probe probe(const Key& key)
+    {
+        Shard& shard = local_shard();
+        const bool sampled = 0 == (shard.sequence++ & sample_mask_.load(std::memory_order_relaxed));
+        return Probe(&counters(shard, key), sampled);
+    }
+
+    /// @brief Key is not found
+    /// Unknown keys are counted together, so they do not grow the statistics
+    template <typename LookupKey>
+    void no_handler(const LookupKey&)
+    {
+        increment(local_shard().no_handler_calls);
+    }
+
+    /// @brief Handler is NULL
+    void null_handler(const Key& key)
+    {
+        increment(counters(local_shard(), key).null_handler_calls);
+    }
+
+    /// @brief Measure latency of every period-th call (rounded up to the power of 2)
+    /// 1 means every call, default is 16
+    void set_sample_period(std::uint64_t period)
+    {
+        std::uint64_t rounded = 1;
+        while (rounded < period) {
+            rounded <<= 1;
+        }
+        sample_mask_.store(rounded - 1, std::memory_order_relaxed);
+    }
+
+    /// @brief Sum counters of all threads
+    CallStatisticsSnapshot<Key> snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex_);
+        CallStatisticsSnapshot<Key> result = retired_;
+        for (const std::shared_ptr<Shard>& shard : shards_) {
+            add_counters(result, *shard);
+        }
+        return result;
+    }
+
+    /// @brief Threads with own counters, the counters of the exited threads are merged
+    /// when the next thread makes its first call
+    size_t threads_count() const
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex_);
+        return shards_.size();
+    }
+
+private:
+
+    static void add_counters(CallStatisticsSnapshot<Key>& result, Shard& shard)
+    {
+        result.no_handler_calls += shard.no_handler_calls.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> shard_lock(shard.mutex);
+        for (const auto& key_counters : shard.counters) {
+            const Counters& c = *key_counters.second;
+            HandlerStatistics& s = result.handlers[key_counters.first];
+            s.calls += c.calls.load(std::memory_order_relaxed);
+            s.null_handler_calls += c.null_handler_calls.load(std::memory_order_relaxed);
+            s.sampled_calls += c.sampled_calls.load(std::memory_order_relaxed);
+            s.sampled_time += std::chrono::nanoseconds(c.sampled_nanoseconds.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < HandlerStatistics::histogram_buckets; ++i) {
+                s.histogram[i] += c.histogram[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static std::uint64_t next_id()
+    {
+        static std::atomic<std::uint64_t> id{ 0 };
+        return ++id;
+    }
+
+    /// Find thread shard in the thread-local cache, register new one on the first call
+    /// Instance ids are never reused, so the cache never refers destroyed instance,
+    /// and its entries are pruned as the instances are destroyed, so the lookup stays O(1)
+    Shard& local_shard()
+    {
+        thread_local ThreadCache cache;
+        if (cache.last_id == id_) {
+            return *cache.last_shard;
+        }
+
+        auto found = cache.shards.find(id_);
+        if (found == cache.shards.end()) {
+            if (cache.shards.size() >= cache.prune_size) {
+                for (auto it = cache.shards.begin(); it != cache.shards.end();) {
+                    it = it->second.alive.expired() ? cache.shards.erase(it) : std::next(it);
+                }
+                cache.prune_size = std::max<size_t>(16, 2 * cache.shards.size());
+            }
+
+            std::shared_ptr<Shard> shard = std::make_shared<Shard>();
+            {
+                // shards of the exited threads are merged, so the shards follow the live threads
+                std::lock_guard<std::mutex> lock(shards_mutex_);
+                for (size_t i = 0; i < shards_.size();) {
+                    if (shards_[i]->retired.load(std::memory_order_acquire)) {
+                        add_counters(retired_, *shards_[i]);
+                        shards_[i] = std::move(shards_.back());
+                        shards_.pop_back();
+                    }
+                    else {
+                        ++i;
+                    }
+                }
+                shards_.push_back(shard);
+            }
+            found = cache.shards.emplace(id_, CachedShard{ shard.get(), shard }).first;
+        }
+
+        cache.last_id = id_;
+        cache.last_shard = found->second.shard;
+        return *cache.last_shard;
+    }
+
+    /// Only the owner thread inserts, so the lookup is lock-free
+    static Counters& counters(Shard& shard, const Key& key)
+    {
+        auto it = shard.counters.find(key);
+        if (it != shard.counters.end()) {
+            return *it->second;
+        }
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return *shard.counters.emplace(key, std::make_unique<Counters>()).first->second;
+    }
+
+    /// Unique instance id for thread-local cache
+    const std::uint64_t id_;
+
+    /// Sample call if (sequence & mask) == 0
+    std::atomic<std::uint64_t> sample_mask_{ 15 };
+
+    /// Per-thread counters, the thread caches keep weak references
+    mutable std::mutex shards_mutex_;
+    std::vector<std::shared_ptr<Shard>> shards_;
+
+    /// Sum of the counters of the exited threads
+    CallStatisticsSnapshot<Key> retired_;
+};
+
+} // namespace helpers
@@ -0,0 +1,267 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <winapi-helpers/byte_streambuf.h>
+
+struct z_stream_s;
+
+namespace helpers {
+
+/// @brief Options of seekable_archive_writer
+struct seekable_archive_options
+{
+    /// Uncompressed size of the frame: random access decodes one frame, smaller frames lose some ratio
+    size_t frame_size = 1024 * 1024;
+
+    /// zlib level: 1 is the fastest, 9 is the smallest, -1 is the default 6
+    int level = -1;
+};
+
+/// @brief Index entry of the archive frame
+struct seekable_archive_frame
+{
+    /// Offset of the frame data in the uncompressed stream
+    std::uint64_t offset = 0;
+
+    /// Offset of the frame in the archive
+    std::uint64_t compressed_offset = 0;
+
+    /// CRC-32 of the frame data
+    std::uint32_t crc = 0;
+};
+
+
+/// @brief Writer of the seekable archive
+/// The archive is a gzip file any gunzip reads: every frame is an independent gzip member,
+/// the frame index and its locator follow as empty members keeping the data in the extra field:
+///
+///   frame member ... frame member
+///   index member ... index member     "SX" subfield: up to 3276 entries of
+///                                     uncompressed offset (8), compressed offset (8), CRC-32 (4)
+///   locator member                    "SX" subfield: offset of the first index member (8),
+///                                     uncompressed size (8); the last 42 bytes of the archive
+///
+/// All the numbers are little-endian. The writer itself is not thread-safe
+class seekable_archive_writer
+{
+public:
+
+    /// @brief Output consumer, gets the archive piece by piece in order
+    /// @return: false to fail the writer
+    using sink = std::function<bool(byte_view)>;
+
+    seekable_archive_writer();
+
+    /// @brief Finish the archive, if it is not closed yet
+    ~seekable_archive_writer();
+
+    seekable_archive_writer(const seekable_archive_writer&) = delete;
+    seekable_archive_writer& operator=(const seekable_archive_writer&) = delete;
+
+    /// @brief Start the archive written to the sink
+    /// @return: false if the options are invalid
+    bool open(const sink& output, const seekable_archive_options& options = seekable_archive_options());
+
+    /// @brief Start the archive written to the byte stream, e.g. byte_ofstream
+    /// The stream should outlive the writer
+    bool open(std::basic_ostream<std::uint8_t>& output,
+        const seekable_archive_options& options = seekable_archive_options());
+
+    /// @brief Append the data, every full frame is compressed and written
+    /// @return: false if the writer is failed or not opened
+    bool write(byte_view data);
+
+    /// @brief Write the last frame, the index and the locator
+    /// @return: false if any output failed
+    bool close();
+
+    /// @brief Check whether the archive is opened and not closed yet
+    bool is_open() const;
+
+    /// @brief Check whether compression or output failed
+    bool failed() const;
+
+    /// @brief Uncompressed bytes written so far
+    std::uint64_t size() const;
+
+    /// @brief Archive bytes passed to the sink so far
+    std::uint64_t compressed_size() const;
+
+    /// @brief Index of the frames written so far
+    const std::vector<seekable_archive_frame>& frames() const;
+
+private:
+
+    /// Compress the collected frame into the gzip member
+    void write_frame();
+
+    /// Pass the bytes to the sink
+    void emit(byte_view data);
+
+    sink output_;
+    seekable_archive_options options_;
+    std::unique_ptr<z_stream_s> stream_;
+
+    /// Data of the current frame
+    std::vector<std::uint8_t> frame_;
+
+    /// Compressed member of the frame
+    std::vector<std::uint8_t> member_;
+
+    std::vector<seekable_archive_frame> frames_;
+    std::uint64_t size_ = 0;
+    std::uint64_t compressed_size_ = 0;
+    bool failed_ = false;
+};
+
+
+/// @brief Random access input buffer of the seekable archive, works with std::basic_istream<uint8_t>
+/// Opening reads only the locator and the index. Seeking to any offset decodes the only frame
+/// holding it into the get area, reading goes on frame by frame; the frames are checked by CRC-32.
+/// The mapped archive is inflated right from the mapping
+class seekable_archive_istreambuf : public std::basic_streambuf<std::uint8_t>
+{
+public:
+
+    seekable_archive_istreambuf();
+    ~seekable_archive_istreambuf() override;
+
+    seekable_archive_istreambuf(const seekable_archive_istreambuf&) = delete;
+    seekable_archive_istreambuf& operator=(const seekable_archive_istreambuf&) = delete;
+
+    /// @brief Open the archive file, path is UTF-8
+    /// @return: false if the file could not be opened or it is not the seekable archive
+    bool open(const std::string& path, byte_read_mode mode = byte_read_mode::mapped);
+
+    /// @brief Open the archive in memory, it should outlive the buffer
+    bool open(byte_view archive);
+
+    /// @brief Close the archive, invalidates all the windows
+    void close();
+
+    /// @brief Check whether the archive is opened
+    bool is_open() const;
+
+    /// @brief Check whether a frame is damaged, the data of the other frames is still readable
+    bool failed() const;
+
+    /// @brief Uncompressed size of the archive
+    std::uint64_t size() const;
+
+    /// @brief Index of the archive frames
+    const std::vector<seekable_archive_frame>& frames() const;
+
+    /// @brief Next (up to max_length) bytes of the current frame without copying, advances the read position
+    /// The view refers the decoded frame and stays valid until the next read or seek.
+    /// Empty view means the end of archive or the damaged frame
+    byte_view next_window(size_t max_length = static_cast<size_t>(-1));
+
+protected:
+
+    int_type underflow() override;
+    std::streamsize showmanyc() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+
+    /// Read and check the locator and the index
+    bool read_index();
+
+    /// Bytes of the archive, from the mapping or the memory without copying, read into the buffer otherwise
+    bool read_at(std::uint64_t offset, size_t length, byte_view& data);
+
+    /// Uncompressed size of the frame
+    size_t frame_size(size_t frame) const;
+
+    /// Decode the frame into the get area
+    bool load_frame(size_t frame);
+
+    /// File of the archive, unless it is opened in memory
+    byte_istreambuf file_;
+
+    /// Whole archive, if it is mapped or in memory
+    byte_view archive_;
+    std::uint64_t archive_size_ = 0;
+
+    /// Compressed frame read from the file in buffered mode
+    std::vector<std::uint8_t> compressed_;
+
+    std::vector<seekable_archive_frame> frames_;
+    std::uint64_t size_ = 0;
+
+    /// Offset of the first index member, the end of the last frame
+    std::uint64_t index_offset_ = 0;
+
+    std::unique_ptr<z_stream_s> stream_;
+
+    /// Decoded frame, the get area
+    std::vector<std::uint8_t> frame_data_;
+
+    /// Frame in frame_data_, npos if none
+    size_t loaded_ = static_cast<size_t>(-1);
+
+    /// Frame decoded by the next underflow()
+    size_t next_frame_ = 0;
+
+    /// Uncompressed offset of eback()
+    std::uint64_t buffer_offset_ = 0;
+
+    bool failed_ = false;
+};
+
+
+/// @brief Input stream over seekable_archive_istreambuf, e.g.
+/// seekable_archive_ifstream in(path); in.seekg(offset); in.read(data, size);
+class seekable_archive_ifstream : public std::basic_istream<std::uint8_t>
+{
+public:
+
+    /// Base class keeps only the pointer, so the buffer could be constructed later
+    seekable_archive_ifstream() : std::basic_istream<std::uint8_t>(&buffer_) {}
+
+    explicit seekable_archive_ifstream(const std::string& path, byte_read_mode mode = byte_read_mode::mapped)
+        : seekable_archive_ifstream()
+    {
+        open(path, mode);
+    }
+
+    /// @brief Open the archive, set failbit on error
+    void open(const std::string& path, byte_read_mode mode = byte_read_mode::mapped)
+    {
+        if (buffer_.open(path, mode)) {
+            clear();
+        }
+        else {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    void close()
+    {
+        buffer_.close();
+    }
+
+    bool is_open() const
+    {
+        return buffer_.is_open();
+    }
+
+    seekable_archive_istreambuf* rdbuf() const
+    {
+        return const_cast<seekable_archive_istreambuf*>(&buffer_);
+    }
+
+private:
+
+    seekable_archive_istreambuf buffer_;
+};
+
+} // namespace helpers
@@ -0,0 +1,232 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <winapi-helpers/sqlite3_helper.h>
+
+namespace helpers {
+
+/// @brief Options of sqlite3_batch_writer
+struct sqlite3_batch_options
+{
+    /// Rows committed in one transaction
+    size_t rows_per_transaction = 1000;
+
+    /// Transaction is committed by the write() coming later than max_delay after its first row,
+    /// zero disables the time limit
+    std::chrono::milliseconds max_delay{ 100 };
+
+    /// Rows in one multi-row INSERT, limited by 999 parameters per statement
+    size_t rows_per_statement = 64;
+};
+
+
+/// @brief Bulk insert of typed rows into one table
+/// Rows are collected and inserted by the multi-row INSERT prepared once and taken from the cache,
+/// rows_per_transaction rows (or rows of max_delay) go into one transaction, so the commit
+/// and its fsync are paid once per batch, not per row.
+/// Columns are stored until the statement is executed, so the types should own their data:
+/// int, std::int64_t, double, std::string; views must stay valid until the rows are inserted.
+/// Like sqlite3_helper, does not throw exceptions and returns SQLite error codes (0 is SQLITE_OK).
+/// The writer owns the transaction, the database should not be in another one,
+/// and the writer should be destroyed before the database is closed
+template <typename... Columns>
+class sqlite3_batch_writer
+{
+public:
+
+    using row = std::tuple<Columns...>;
+
+    /// @brief Create the writer of the table columns, names are quoted as identifiers
+    sqlite3_batch_writer(sqlite3_helper& db, const std::string& table, const std::vector<std::string>& columns,
+        const sqlite3_batch_options& options = sqlite3_batch_options()) :
+        db_(db),
+        options_(options)
+    {
+        static_assert(sizeof...(Columns) > 0, "at least one column is required");
+
+        // SQLITE_MAX_VARIABLE_NUMBER of the older SQLite versions
+        const size_t max_rows = 999 / sizeof...(Columns);
+        rows_per_statement_ = std::max<size_t>(1, std::min({ options_.rows_per_statement, max_rows,
+            std::max<size_t>(options_.rows_per_transaction, 1) }));
+        rows_.reserve(rows_per_statement_);
+
+        insert_prefix_ = "INSERT INTO " + quote(table) + " (";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            insert_prefix_ += (i ? ", " : "") + quote(columns[i]);
+        }
+        insert_prefix_ += ") VALUES ";
+        full_insert_ = insert_sql(rows_per_statement_);
+    }
+
+    /// @brief Insert and commit the rest of rows
+    ~sqlite3_batch_writer()
+    {
+        flush();
+    }
+
+    sqlite3_batch_writer(const sqlite3_batch_writer&) = delete;
+    sqlite3_batch_writer& operator=(const sqlite3_batch_writer&) = delete;
+
+    /// @brief Add the row, inserts and commits it when the batch is full
+    /// On error the transaction is rolled back and its rows are lost
+    /// @return: SQLite error code
+    int write(Columns... values)
+    {
+        if (!in_transaction_) {
+            if (0 != (last_error_ = db_.execute("BEGIN"))) {
+                return last_error_;
+            }
+            in_transaction_ = true;
+            transaction_rows_ = 0;
+            transaction_start_ = std::chrono::steady_clock::now();
+        }
+
+        rows_.emplace_back(std::move(values)...);
+        ++transaction_rows_;
+        if (rows_.size() == rows_per_statement_ && 0 != insert_rows()) {
+            return last_error_;
+        }
+
+        if (transaction_rows_ >= options_.rows_per_transaction || (options_.max_delay.count() > 0 &&
+            std::chrono::steady_clock::now() - transaction_start_ >= options_.max_delay)) {
+            return flush();
+        }
+        return last_error_;
+    }
+
+    /// @brief Add the row given as tuple
+    int write(const row& values)
+    {
+        return std::apply([this](const Columns&... columns) { return write(columns...); }, values);
+    }
+
+    /// @brief Insert collected rows and commit the transaction
+    /// @return: SQLite error code
+    int flush()
+    {
+        if (!rows_.empty() && 0 != insert_rows()) {
+            return last_error_;
+        }
+        if (in_transaction_) {
+            in_transaction_ = false;
+            last_error_ = db_.execute("COMMIT");
+            if (0 == last_error_) {
+                committed_ += transaction_rows_;
+            }
+            else {
+                db_.execute("ROLLBACK");
+            }
+        }
+        return last_error_;
+    }
+
+    /// @brief Rows written, but not committed yet
+    size_t pending() const
+    {
+        return in_transaction_ ? transaction_rows_ : 0;
+    }
+
+    /// @brief Rows committed by the writer
+    std::uint64_t committed() const
+    {
+        return committed_;
+    }
+
+    /// @brief Return last error code
+    int get_last_error() const
+    {
+        return last_error_;
+    }
+
+private:
+
+    static std::string quote(const std::string& identifier)
+    {
+        std::string quoted = "\"";
+        for (char c : identifier) {
+            quoted += (c == '"') ? "\"\"" : std::string(1, c);
+        }
+        return quoted + "\"";
+    }
+
+    /// INSERT of rows_count rows, (?, ?), (?, ?), ...
+    std::string insert_sql(size_t rows_count) const
+    {
+        std::string values = "(";
+        for (size_t i = 0; i < sizeof...(Columns); ++i) {
+            values += i ? ", ?" : "?";
+        }
+        values += ")";
+
+        std::string sql = insert_prefix_;
+        sql.reserve(sql.size() + rows_count * (values.size() + 2));
+        for (size_t i = 0; i < rows_count; ++i) {
+            sql += (i ? ", " : "") + values;
+        }
+        return sql;
+    }
+
+    template <size_t... Index>
+    static int bind_row(sqlite3_statement& statement, int first, const row& values, std::index_sequence<Index...>)
+    {
+        int result = 0;
+        ((result = (0 == result) ? statement.bind(first + static_cast<int>(Index), std::get<Index>(values)) : result), ...);
+        return result;
+    }
+
+    /// Insert collected rows by one statement, roll the transaction back on error
+    int insert_rows()
+    {
+        sqlite3_statement insert = db_.prepare_cached(
+            rows_.size() == rows_per_statement_ ? full_insert_ : insert_sql(rows_.size()));
+
+        last_error_ = insert.get_last_error();
+        for (size_t i = 0; i < rows_.size() && 0 == last_error_; ++i) {
+            last_error_ = bind_row(insert, static_cast<int>(i * sizeof...(Columns)) + 1, rows_[i],
+                std::index_sequence_for<Columns...>());
+        }
+        if (0 == last_error_) {
+            last_error_ = insert.execute();
+        }
+
+        if (0 != last_error_) {
+            rows_.clear();
+            if (in_transaction_) {
+                in_transaction_ = false;
+                db_.execute("ROLLBACK");
+            }
+            return last_error_;
+        }
+
+        rows_.clear();
+        return last_error_;
+    }
+
+    sqlite3_helper& db_;
+    sqlite3_batch_options options_;
+    size_t rows_per_statement_ = 1;
+
+    /// "INSERT INTO table (columns) VALUES "
+    std::string insert_prefix_;
+
+    /// INSERT of rows_per_statement_ rows
+    std::string full_insert_;
+
+    /// Rows waiting for the multi-row INSERT
+    std::vector<row> rows_;
+
+    bool in_transaction_ = false;
+    size_t transaction_rows_ = 0;
+    std::chrono::steady_clock::time_point transaction_start_;
+
+    std::uint64_t committed_ = 0;
+    int last_error_ = 0;
+};
+
+} // namespace helpers
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <winapi-helpers/byte_view.h>
+
+struct sqlite3;
+
+namespace helpers {
+
+/// @brief Settings of the compressed blobs
+struct sqlite3_compression_options
+{
+    /// Blobs shorter than the threshold are stored as is, compression does not pay off for them
+    size_t threshold = 512;
+
+    /// zlib level: 1 is the fastest, 9 is the smallest, -1 is the default 6
+    int level = -1;
+};
+
+/// @brief Blob compressed when it is bound, e.g.
+/// db.execute("INSERT INTO dumps VALUES (?, ?)", id, sqlite3_compressed_blob(data))
+/// The view should stay valid until the statement is bound
+struct sqlite3_compressed_blob
+{
+    explicit sqlite3_compressed_blob(byte_view data,
+        const sqlite3_compression_options& options = sqlite3_compression_options())
+        : data(data), options(options)
+    {
+    }
+
+    byte_view data;
+    sqlite3_compression_options options;
+};
+
+/// @brief Stored form of the blob: zlib stream after the header of the format and the original size,
+/// or the data as is if it is shorter than the threshold or does not compress.
+/// Stored blobs of both kinds could be mixed in the same column, uncompress_blob() tells them apart
+/// @return: SQLite error code
+int compress_blob(byte_view data, std::vector<std::uint8_t>& stored,
+    const sqlite3_compression_options& options = sqlite3_compression_options());
+
+/// @brief Original data of the stored blob, blobs stored as is are copied
+/// @return: SQLite error code, SQLITE_CORRUPT if the compressed blob is damaged
+int uncompress_blob(byte_view stored, std::vector<std::uint8_t>& data);
+
+/// @brief Check whether the stored blob is compressed
+bool is_compressed_blob(byte_view stored);
+
+/// @brief Register SQL functions of the stored blob format on the connection:
+/// compress(x) and compress(x, level) return the stored form of x with the threshold of options,
+/// uncompress(x) returns the original blob, so the column is read the same way either it is compressed or not.
+/// NULL stays NULL, text is compressed as bytes and is read back by CAST(uncompress(x) AS TEXT)
+/// @return: SQLite error code
+int register_compression_functions(sqlite3* db,
+    const sqlite3_compression_options& options = sqlite3_compression_options());
+
+} // namespace helpers
@@ -1,4 +1,14 @@
 #pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <winapi-helpers/byte_view.h>
+#include <winapi-helpers/sqlite3_compression.h>
+#include <winapi-helpers/sqlite3_profiler.h>
+#include <winapi-helpers/sqlite3_statement.h>
 
 typedef int(*sqlite3_callback)(void*, int, char**, char**);
 
@@ -6,6 +16,65 @@ struct sqlite3;
 
 namespace helpers{
 
+/// @brief Open settings tuned for the workload
+enum class sqlite3_profile
+{
+    /// sqlite3_open() defaults: rollback journal, synchronous FULL, no memory mapping
+    defaults,
+
+    /// Large imports: WAL without fsync, big page cache, temp tables in memory.
+    /// The last transactions could be lost on power failure, the database stays consistent
+    bulk_load,
+
+    /// Inventory queries: WAL with synchronous NORMAL, memory-mapped reads, big page cache
+    read_mostly,
+
+    /// Every committed transaction survives power failure: WAL with synchronous FULL
+    durable
+};
+
+/// @brief Connection flags and PRAGMA settings applied by sqlite3_helper::open()
+/// Negative or empty values keep SQLite defaults
+struct sqlite3_open_options
+{
+    /// Settings of the profile
+    sqlite3_open_options(sqlite3_profile profile = sqlite3_profile::defaults);
+
+    /// SQLITE_OPEN_READONLY instead of SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+    bool read_only = false;
+
+    /// SQLITE_OPEN_NOMUTEX, the connection should be used by one thread at a time
+    bool no_mutex = false;
+
+    /// SQLITE_OPEN_SHAREDCACHE, connections of the process share the page cache.
+    /// Saves memory, but locks tables between the connections, so profiles do not use it
+    bool shared_cache = false;
+
+    /// PRAGMA page_size, takes effect only for the new database before WAL is enabled
+    int page_size = -1;
+
+    /// PRAGMA journal_mode: DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF
+    std::string journal_mode;
+
+    /// PRAGMA synchronous: 0 OFF, 1 NORMAL, 2 FULL, 3 EXTRA
+    int synchronous = -1;
+
+    /// PRAGMA cache_size: pages if positive, KiB if negative, 0 keeps the default
+    int cache_size = 0;
+
+    /// PRAGMA mmap_size in bytes, 0 disables memory mapping
+    std::int64_t mmap_size = -1;
+
+    /// PRAGMA temp_store: 0 DEFAULT, 1 FILE, 2 MEMORY
+    int temp_store = -1;
+
+    /// sqlite3_busy_timeout(), 0 fails with SQLITE_BUSY at once
+    int busy_timeout_ms = 0;
+
+    /// Run PRAGMA optimize before close, it updates statistics of the queries run by the connection
+    bool optimize_on_close = false;
+};
+
 /// @briefVery lightweight header-only C++ RAII wrapper under SQlite3 ANSI C API
 /// Class does not throw exceptions. It could be considered as not C++ way, 
 /// however it increases safety in low-level application like drivers
@@ -19,6 +88,9 @@ public:
     /// @brief Open or create sqlite3 database
     sqlite3_helper(const char* database_name);
 
+    /// @brief Open sqlite3 database with the settings, e.g. sqlite3_helper db(path, sqlite3_profile::read_mostly)
+    sqlite3_helper(const char* database_name, const sqlite3_open_options& options);
+
     /// @brief Close database handle
     /// Important, if sqlite3_close() in close() method returned error, database remain opened
     /// This situation may occur if database is under backup right now.
@@ -35,16 +107,21 @@ public:
     /// without closing the database handle
     sqlite3_helper(sqlite3_helper&& rhs);
 
-    /// @brief Assignment operator leaves rhs-object in empty state
+    /// @brief Assignment operator closes own database and leaves rhs-object in empty state
     /// without closing the database handle
     sqlite3_helper& operator=(sqlite3_helper&& rhs);
 
 
-    /// @brief Open or create sqlite3 database
+    /// @brief Open or create sqlite3 database, the opened one is closed first
     /// @return: SQLite error code
     /// See https://www.sqlite.org/rescode.html for details
     int open(const char* database_name);
 
+    /// @brief Open sqlite3 database by sqlite3_open_v2() with the flags and apply the PRAGMA settings
+    /// The database stays opened if a setting fails, the error code is returned
+    /// @return: SQLite error code
+    int open(const char* database_name, const sqlite3_open_options& options);
+
     /// @brief Close database handle
     /// If sqlite3_close() in close() method returned error, database remain opened
     /// It could be checked with get_last_error() and handle by the caller, 
@@ -54,10 +131,106 @@ public:
     /// See https://www.sqlite.org/rescode.html for details
     int close();
 
-    /// @brief Execute SQL query
+    /// @brief Execute SQL query, callback gets context as the first argument
+    /// Columns are passed to callback as text, query() reads them natively
     /// @return: SQLite error code
     /// See https://www.sqlite.org/rescode.html for details
-    int exec(const char* sql, sqlite3_callback callback = nullptr);
+    int exec(const char* sql, sqlite3_callback callback = nullptr, void* context = nullptr);
+
+    /// @brief Prepare the statement, it is finalized on destruction
+    /// Check the statement with operator bool or get_last_error()
+    sqlite3_statement prepare(std::string_view sql);
+
+    /// @brief Prepare the statement using LRU cache of the database
+    /// SQL is compiled only on the first call, the statement returns to the cache on destruction.
+    /// Statements should be destroyed before the database is closed
+    sqlite3_statement prepare_cached(std::string_view sql);
+
+    /// @brief Execute the cached statement with bound parameters, e.g.
+    /// db.execute("INSERT INTO t VALUES (?, ?)", id, name)
+    /// @return: SQLite error code
+    template <typename... Args>
+    int execute(std::string_view sql, const Args&... args)
+    {
+        sqlite3_statement statement = prepare_cached(sql);
+        if (statement) {
+            statement.bind_values(args...);
+        }
+        if (statement) {
+            statement.execute();
+        }
+        current_return_code_ = statement.get_last_error();
+        return current_return_code_;
+    }
+
+    /// @brief Cached statement with bound parameters to iterate its rows, e.g.
+    /// for (const sqlite3_row& row : db.query("SELECT id, name FROM t WHERE id > ?", 10))
+    /// Check the statement after the loop for the error
+    template <typename... Args>
+    sqlite3_statement query(std::string_view sql, const Args&... args)
+    {
+        sqlite3_statement statement = prepare_cached(sql);
+        if (statement) {
+            statement.bind_values(args...);
+        }
+        current_return_code_ = statement.get_last_error();
+        return statement;
+    }
+
+    /// @brief Change capacity of the statement cache, 0 disables caching
+    void set_statement_cache_capacity(size_t capacity);
+
+    /// @brief Statement cache, nullptr if the database is not opened
+    sqlite3_statement_cache* statement_cache() const;
+
+    /// @brief Backup progress, called after every step with the pages left and the pages total
+    /// @return: false to abort the backup
+    using backup_progress = std::function<bool(int remaining, int total)>;
+
+    /// @brief Copy the main database into the file (UTF-8 path) by the online backup API
+    /// The source is locked only during a step of pages_per_step pages, so other connections
+    /// could write between the steps; their writes restart the backup, writes of this connection
+    /// are copied to the backup as they happen. Negative pages_per_step copies all at once.
+    /// In-memory database is saved to the file this way too. The destination is overwritten,
+    /// it is left incomplete if the backup fails
+    /// @return: SQLite error code, SQLITE_ABORT if progress aborted the backup
+    int backup_to(const char* path, int pages_per_step = 256, const backup_progress& progress = nullptr);
+
+    /// @brief Copy the database content into the buffer, the same bytes as its file would have
+    /// Requires SQLite built with SQLITE_ENABLE_DESERIALIZE
+    /// @return: SQLite error code
+    int serialize(std::vector<std::uint8_t>& data, const char* schema = "main");
+
+    /// @brief Replace the database by the in-memory copy of the serialized content
+    /// The content is copied, the database could grow unless it is read-only.
+    /// Requires SQLite built with SQLITE_ENABLE_DESERIALIZE
+    /// @return: SQLite error code
+    int deserialize(byte_view data, bool read_only = false, const char* schema = "main");
+
+    /// @brief Start collecting statistics of the queries, the previous profiler is replaced
+    /// The profiler stays attached when the database is reopened
+    /// @return: the profiler, nullptr if the database is not opened
+    sqlite3_profiler* enable_profiling(const sqlite3_profiler_options& options = sqlite3_profiler_options());
+
+    /// @brief Stop collecting statistics and destroy the profiler
+    void disable_profiling();
+
+    /// @brief Query profiler, nullptr if profiling is not enabled
+    sqlite3_profiler* profiler() const;
+
+    /// @brief Register virtual tables of the system inventory: processes, mounts, cpu_topology and env,
+    /// see register_system_tables(). Modules belong to the connection, so they are registered again after reopening
+    /// @return: SQLite error code
+    int register_system_tables();
+
+    /// @brief Register compress() and uncompress() SQL functions of the compressed blobs,
+    /// see register_compression_functions(). Blobs are compressed in C++ by binding sqlite3_compressed_blob
+    /// and read by sqlite3_statement::column_uncompressed()
+    /// @return: SQLite error code
+    int register_compression_functions(const sqlite3_compression_options& options = sqlite3_compression_options());
+
+    /// @brief Native database handle
+    sqlite3* handle() const;
 
     /// @brief Is database in valid state
     operator bool() const;
@@ -82,6 +255,16 @@ private:
 
     /// Last returned error code
     int current_return_code_ = 0;
+
+    /// Prepared statements of db_, the pointer is kept by the cached statements, so it should not move
+    std::unique_ptr<sqlite3_statement_cache> statement_cache_;
+    size_t statement_cache_capacity_ = sqlite3_statement_cache::default_capacity;
+
+    /// Run PRAGMA optimize on close
+    bool optimize_on_close_ = false;
+
+    /// Trace callback context, so the pointer should not move
+    std::unique_ptr<sqlite3_profiler> profiler_;
 };
 
 } // namespace helpers
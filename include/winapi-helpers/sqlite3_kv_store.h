@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include <winapi-helpers/sqlite3_helper.h>
+
+namespace helpers {
+
+/// @brief Value of the key-value store: integer, real, text or blob, std::monostate if the key is absent
+using kv_value = std::variant<std::monostate, std::int64_t, double, std::string, std::vector<std::uint8_t>>;
+
+/// @brief Options of sqlite3_kv_store
+struct sqlite3_kv_options
+{
+    /// Connection settings, the profile defines durability of the flushed writes
+    sqlite3_open_options open_options{ sqlite3_profile::durable };
+
+    /// Table of the store, several stores could share the database
+    std::string table = "kv";
+
+    /// Values cached by all the shards, split evenly between them, 0 disables the cache
+    size_t cache_capacity = 100000;
+
+    /// Cache shards, every shard has its own lock
+    size_t cache_shards = 16;
+
+    /// Writes buffered before they are flushed in one transaction, 1 writes through
+    size_t flush_rows = 1000;
+
+    /// Buffered writes are flushed by the write coming later than max_delay after the first one,
+    /// zero disables the time limit
+    std::chrono::milliseconds max_delay{ 100 };
+};
+
+
+/// @brief Key-value store in the SQLite table with the sharded LRU read cache and write-back buffer
+/// Writes go to the cache and to the buffer, which is flushed to the database in one transaction
+/// when it is full, it is old enough, on flush() and on close, so reads always see the last write.
+/// Cached reads take only the lock of the shard, all the database access is serialized.
+/// The store is thread-safe, open() and close() should not race with other calls.
+/// Like sqlite3_helper, the store does not throw exceptions and returns SQLite error codes
+class sqlite3_kv_store
+{
+public:
+
+    /// @brief Prefix scan consumer
+    /// @return: false to stop the scan
+    using scan_callback = std::function<bool(std::string_view key, const kv_value& value)>;
+
+    sqlite3_kv_store() = default;
+
+    /// @brief Flush the buffered writes and close the database
+    ~sqlite3_kv_store();
+
+    sqlite3_kv_store(const sqlite3_kv_store&) = delete;
+    sqlite3_kv_store& operator=(const sqlite3_kv_store&) = delete;
+
+    /// @brief Open the database and create the table if it does not exist
+    /// @return: SQLite error code
+    int open(const char* database_name, const sqlite3_kv_options& options = sqlite3_kv_options());
+
+    /// @brief Flush the buffered writes and close the database
+    /// @return: SQLite error code
+    int close();
+
+    /// @brief Value of the key if it exists and has the type T:
+    /// std::int64_t, double, std::string or std::vector<std::uint8_t>
+    template <typename T>
+    std::optional<T> get(std::string_view key)
+    {
+        kv_value value;
+        load(key, value);
+        if (T* typed = std::get_if<T>(&value)) {
+            return std::optional<T>(std::move(*typed));
+        }
+        return std::nullopt;
+    }
+
+    /// @brief Value of the key of any type, std::monostate if the key is absent
+    kv_value get_value(std::string_view key);
+
+    /// @brief Check whether the key exists
+    bool contains(std::string_view key);
+
+    /// @brief Set the value of the key
+    /// @return: SQLite error code of the flush, if the write caused it
+    int put(std::string_view key, std::int64_t value);
+    int put(std::string_view key, double value);
+    int put(std::string_view key, std::string_view value);
+    int put(std::string_view key, const char* value);
+    int put(std::string_view key, byte_view value);
+
+    /// @brief Store other integer types as 64-bit integer
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    int put(std::string_view key, T value)
+    {
+        return put(key, static_cast<std::int64_t>(value));
+    }
+
+    /// @brief Delete the key
+    /// @return: SQLite error code of the flush, if the write caused it
+    int erase(std::string_view key);
+
+    /// @brief Call on_item for the keys starting with the prefix in the key order
+    /// Buffered writes are flushed first, on_item runs under the database lock and should not call the store
+    /// @return: SQLite error code
+    int scan(std::string_view prefix, const scan_callback& on_item);
+
+    /// @brief Write the buffered writes to the database in one transaction
+    /// If the transaction fails, the writes stay buffered
+    /// @return: SQLite error code
+    int flush();
+
+    /// @brief Buffered writes
+    size_t pending() const;
+
+    /// @brief Reads served from the cache
+    std::uint64_t cache_hits() const;
+
+    /// @brief Reads that went to the buffer or the database
+    std::uint64_t cache_misses() const;
+
+    /// @brief Return last error code of the database
+    int get_last_error() const;
+
+private:
+
+    /// LRU list of the shard, most recently used first
+    using cache_list = std::list<std::pair<std::string, kv_value>>;
+
+    struct cache_shard
+    {
+        std::mutex mutex;
+        cache_list entries;
+
+        /// Keys refer strings of the entries
+        std::unordered_map<std::string_view, cache_list::iterator> index;
+
+        /// Incremented by every write, so a read racing with the write does not cache the old value
+        std::uint64_t generation = 0;
+
+        /// Counted under the lock of the shard, so the readers of different shards do not share the counter
+        std::uint64_t hits = 0;
+    };
+
+    /// Read the value: cache, then the write buffer, then the database
+    void load(std::string_view key, kv_value& value);
+
+    /// Write the value, std::monostate deletes the key
+    int store(std::string_view key, kv_value value);
+
+    cache_shard& shard_of(std::string_view key);
+
+    /// Insert or update the cached value, the least recently used ones above the capacity are dropped
+    void cache(cache_shard& shard, std::string_view key, const kv_value& value);
+
+    /// Flush with db_mutex_ held
+    int flush_locked();
+
+    sqlite3_kv_options options_;
+    size_t shard_capacity_ = 0;
+    std::vector<std::unique_ptr<cache_shard>> shards_;
+
+    /// Database and its statements
+    sqlite3_helper db_;
+    std::string select_sql_;
+    std::string upsert_sql_;
+    std::string delete_sql_;
+    std::string scan_sql_;
+    mutable std::mutex db_mutex_;
+
+    /// Buffered writes, the last write of the key wins
+    std::unordered_map<std::string, kv_value> pending_;
+    std::chrono::steady_clock::time_point pending_since_;
+    mutable std::mutex pending_mutex_;
+
+    std::atomic<std::uint64_t> cache_misses_{ 0 };
+};
+
+} // namespace helpers
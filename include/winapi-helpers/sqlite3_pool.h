@@ -0,0 +1,222 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <winapi-helpers/sqlite3_helper.h>
+#include <winapi-helpers/thread_pool.h>
+
+namespace helpers {
+
+/// @brief Options of sqlite3_pool
+struct sqlite3_pool_options
+{
+    /// Reader connections, 0 means one per CPU core
+    size_t readers = 0;
+
+    /// Thread pool running read tasks, should outlive the connection pool.
+    /// If nullptr, the connection pool starts own pool with a thread per reader
+    thread_pool* pool = nullptr;
+
+    /// Time a connection waits for the database lock before SQLITE_BUSY
+    int busy_timeout_ms = 5000;
+
+    /// PRAGMA synchronous of the writer: 1 NORMAL syncs WAL on checkpoints, 2 FULL syncs every commit
+    int synchronous = 1;
+};
+
+
+/// @brief Connection pool over the database file in WAL mode
+/// Reads go to N read-only connections, every one is checked out by a single thread at a time,
+/// so readers run in parallel and do not wait for the writer. Writes are queued to
+/// the only writer connection owned by its own thread, so they stay serialized.
+/// Every connection keeps its own statement cache.
+/// Small writes could be coalesced, the ones queued while the writer is busy are committed together.
+/// open() and close() should not race with other calls, the rest of methods are thread-safe.
+/// Like sqlite3_helper, the pool returns SQLite error codes; futures keep exceptions thrown by the tasks
+class sqlite3_pool
+{
+public:
+
+    /// @brief Reader connection checked out of the pool, returned on destruction
+    class reader_lease
+    {
+    public:
+
+        reader_lease() = default;
+        ~reader_lease();
+
+        reader_lease(const reader_lease&) = delete;
+        reader_lease& operator=(const reader_lease&) = delete;
+
+        reader_lease(reader_lease&& rhs);
+        reader_lease& operator=(reader_lease&& rhs);
+
+        sqlite3_helper& operator*() const
+        {
+            return *connection_;
+        }
+
+        sqlite3_helper* operator->() const
+        {
+            return connection_;
+        }
+
+        /// @brief Is the connection checked out, false if the pool is closed
+        explicit operator bool() const
+        {
+            return connection_ != nullptr;
+        }
+
+    private:
+
+        friend class sqlite3_pool;
+
+        reader_lease(sqlite3_pool* pool, sqlite3_helper* connection);
+
+        /// Return the connection to the pool
+        void release();
+
+        sqlite3_pool* pool_ = nullptr;
+        sqlite3_helper* connection_ = nullptr;
+    };
+
+    sqlite3_pool() = default;
+
+    /// @brief Finish queued writes and close the connections
+    ~sqlite3_pool();
+
+    sqlite3_pool(const sqlite3_pool&) = delete;
+    sqlite3_pool& operator=(const sqlite3_pool&) = delete;
+
+    /// @brief Open the database file (UTF-8 path), switch it to WAL mode and open readers
+    /// In-memory databases have no WAL mode and are not supported
+    /// @return: SQLite error code
+    int open(const std::string& path, const sqlite3_pool_options& options = sqlite3_pool_options());
+
+    /// @brief Finish queued writes, wait for readers to return and close the connections
+    /// Reads queued to the external thread pool should be finished before
+    void close();
+
+    /// @brief Check whether the pool is opened
+    bool is_open() const;
+
+    /// @brief Reader connections in the pool
+    size_t readers_count() const;
+
+    /// @brief Check the reader out, waits while all of them are in use
+    /// Empty lease if the pool is closed
+    reader_lease acquire_reader();
+
+    /// @brief Run f(sqlite3_helper&) with a reader in the thread pool
+    /// Runs inline if the thread pool is stopped.
+    /// @return: future of f result, invalid future if the connection pool is closed
+    template <typename F>
+    auto read(F f) -> std::future<std::invoke_result_t<F, sqlite3_helper&>>
+    {
+        using result_type = std::invoke_result_t<F, sqlite3_helper&>;
+        if (!is_open()) {
+            return std::future<result_type>();
+        }
+
+        auto task = [this, f]() mutable -> result_type {
+            reader_lease reader = acquire_reader();
+            if (!reader) {
+                throw std::runtime_error("sqlite3_pool is closed");
+            }
+            return f(*reader);
+        };
+
+        std::future<result_type> result = pool_->enqueue(task);
+        if (!result.valid()) {
+            std::packaged_task<result_type()> inline_task(std::move(task));
+            result = inline_task.get_future();
+            inline_task();
+        }
+        return result;
+    }
+
+    /// @brief Queue f(sqlite3_helper&) to the writer connection
+    /// Writes are executed one by one in the queue order
+    /// @return: future of f result, invalid future if the connection pool is closed
+    template <typename F>
+    auto write(F f) -> std::future<std::invoke_result_t<F, sqlite3_helper&>>
+    {
+        using result_type = std::invoke_result_t<F, sqlite3_helper&>;
+        if (!is_open()) {
+            return std::future<result_type>();
+        }
+
+        return writer_thread_->enqueue([this, f]() mutable -> result_type {
+            return f(writer_);
+        });
+    }
+
+    /// @brief Queue f(sqlite3_helper&), returning SQLite error code, to be committed with other queued writes
+    /// Writes queued while the writer is busy run in one transaction, so a burst costs one commit.
+    /// Every write runs in its own savepoint: the failed one (error code or exception) is rolled back alone.
+    /// f should not commit or roll back the transaction.
+    /// @return: future of f result or the commit error, invalid future if the connection pool is closed
+    std::future<int> write_coalesced(std::function<int(sqlite3_helper&)> f);
+
+    /// @brief Coalesced write of one statement, e.g. pool.execute("INSERT INTO t VALUES (?, ?)", id, name)
+    /// Arguments are copied until the write is executed, so text should be passed as std::string
+    template <typename... Args>
+    std::future<int> execute(std::string sql, Args... args)
+    {
+        return write_coalesced([sql = std::move(sql), args...](sqlite3_helper& db) {
+            return db.execute(sql, args...);
+        });
+    }
+
+    /// @brief Return last error code of open()
+    int get_last_error() const;
+
+private:
+
+    /// Put the reader back and wake up a waiting thread
+    void release_reader(sqlite3_helper* connection);
+
+    /// Write waiting to be coalesced
+    struct coalesced_write
+    {
+        std::function<int(sqlite3_helper&)> f;
+        std::promise<int> result;
+    };
+
+    /// Run the queued coalesced writes in one transaction, called in the writer thread
+    void commit_coalesced();
+
+    /// Writer connection, used only by writer_thread_
+    sqlite3_helper writer_;
+    std::unique_ptr<thread_pool> writer_thread_;
+
+    /// Coalesced writes, commit_coalesced() is queued to the writer when the first one comes
+    std::vector<coalesced_write> coalesced_;
+    std::mutex coalesced_mutex_;
+
+    /// Reader connections, the vector is not resized while the pool is opened
+    std::vector<sqlite3_helper> readers_;
+
+    /// Readers not checked out
+    std::vector<sqlite3_helper*> free_readers_;
+    std::mutex readers_mutex_;
+    std::condition_variable readers_condition_;
+
+    /// Thread pool of read tasks and the owned one, if the external pool is not given
+    thread_pool* pool_ = nullptr;
+    std::unique_ptr<thread_pool> own_pool_;
+
+    std::atomic<bool> opened_{ false };
+    int current_return_code_ = 0;
+};
+
+} // namespace helpers
@@ -0,0 +1,154 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace helpers {
+
+/// @brief Counters of one execution of the statement
+struct sqlite3_query_counters
+{
+    /// Rows returned by step()
+    std::uint64_t rows_returned = 0;
+
+    /// Rows stepped over by full table scans, the rows scanned without index
+    std::uint64_t fullscan_steps = 0;
+
+    /// Sort operations, ORDER BY or GROUP BY without index
+    std::uint64_t sorts = 0;
+
+    /// Rows inserted into automatic indexes, an index is missing
+    std::uint64_t autoindex_rows = 0;
+
+    /// Virtual machine operations, the total work of the statement
+    std::uint64_t vm_steps = 0;
+};
+
+/// @brief Aggregated statistics of the SQL text
+struct sqlite3_query_stats
+{
+    std::string sql;
+    std::uint64_t executions = 0;
+    std::chrono::nanoseconds total_time{ 0 };
+    std::chrono::nanoseconds max_time{ 0 };
+
+    /// 99th percentile of the execution time, estimated by the sample of executions
+    std::chrono::nanoseconds p99_time{ 0 };
+
+    /// Sums over all executions
+    sqlite3_query_counters counters;
+};
+
+/// @brief Execution slower than the threshold
+struct sqlite3_slow_query
+{
+    /// SQL text with bound parameters expanded, if the profiler expands them
+    std::string sql;
+    std::chrono::nanoseconds time{ 0 };
+    sqlite3_query_counters counters;
+};
+
+/// @brief Options of sqlite3_profiler
+struct sqlite3_profiler_options
+{
+    /// Executions slower than the threshold are logged, zero disables the log
+    std::chrono::milliseconds slow_query_threshold{ 100 };
+
+    /// Slow queries kept by the profiler, the oldest are dropped
+    size_t slow_log_capacity = 100;
+
+    /// Called for every slow query in the thread executing it, the log is not kept if set
+    std::function<void(const sqlite3_slow_query&)> on_slow_query;
+
+    /// Log slow SQL with parameter values, sqlite3_expanded_sql() allocates the copy
+    bool expand_slow_sql = true;
+
+    /// Count returned rows, it costs a trace callback for every row
+    bool count_rows = true;
+};
+
+
+/// @brief Query statistics of the connection collected by sqlite3_trace_v2() and sqlite3_stmt_status()
+/// Executions are timed from their first step() to reset or finalization, counters of the statement
+/// are read and reset at the end of every execution. Statistics are keyed by the SQL text,
+/// so all the statements of the same SQL are counted together.
+/// Trace callbacks run in the thread executing the statement, the profiler is not thread-safe
+/// and should be used by the thread owning the connection.
+/// Created by sqlite3_helper::enable_profiling()
+class sqlite3_profiler
+{
+public:
+
+    sqlite3_profiler(sqlite3* db, const sqlite3_profiler_options& options);
+
+    /// @brief Detach from the connection
+    ~sqlite3_profiler();
+
+    sqlite3_profiler(const sqlite3_profiler&) = delete;
+    sqlite3_profiler& operator=(const sqlite3_profiler&) = delete;
+
+    /// @brief Register the trace callback on the connection, nullptr detaches
+    /// @return: SQLite error code
+    int attach(sqlite3* db);
+
+    /// @brief Statistics of all the SQL executed, most time consuming first
+    std::vector<sqlite3_query_stats> statistics() const;
+
+    /// @brief Slow queries, the oldest first
+    const std::deque<sqlite3_slow_query>& slow_queries() const;
+
+    /// @brief Forget the statistics and the slow queries
+    void reset();
+
+    const sqlite3_profiler_options& options() const;
+
+private:
+
+    /// Execution in progress
+    struct execution
+    {
+        std::chrono::steady_clock::time_point start;
+        std::uint64_t rows = 0;
+    };
+
+    /// Statistics of the SQL text with the sample of execution times
+    struct query
+    {
+        sqlite3_query_stats stats;
+        std::vector<std::int64_t> samples;
+    };
+
+    static int trace(unsigned type, void* context, void* p, void* x);
+
+    void on_statement(sqlite3_stmt* stmt, const char* sql);
+    void on_row(sqlite3_stmt* stmt);
+    void on_profile(sqlite3_stmt* stmt);
+
+    /// Put the execution time into the reservoir sample of the query
+    void sample(query& q, std::int64_t nanoseconds);
+
+    sqlite3* db_ = nullptr;
+    sqlite3_profiler_options options_;
+
+    /// Executions in progress keyed by statement, removed when they end
+    std::unordered_map<sqlite3_stmt*, execution> running_;
+
+    /// Statistics keyed by SQL text, keys refer the strings of the statistics
+    std::unordered_map<std::string_view, std::unique_ptr<query>> queries_;
+
+    std::deque<sqlite3_slow_query> slow_queries_;
+
+    /// State of the sample replacement generator
+    std::uint64_t random_ = 0x9E3779B97F4A7C15ull;
+};
+
+} // namespace helpers
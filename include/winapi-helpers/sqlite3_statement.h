@@ -0,0 +1,399 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <winapi-helpers/byte_view.h>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace helpers {
+
+class sqlite3_statement;
+class sqlite3_row_iterator;
+struct sqlite3_compressed_blob;
+
+/// @brief LRU cache of prepared statements keyed by SQL text
+/// Statement is taken out of the cache while it is in use, so the same SQL could be used
+/// by nested queries, and returned back on destruction, reset and unbound.
+/// The least recently used statements above the capacity are finalized.
+/// Taking and returning the cached statement moves the list node, nothing is allocated
+class sqlite3_statement_cache
+{
+public:
+
+    /// Default number of cached statements
+    static constexpr size_t default_capacity = 32;
+
+    sqlite3_statement_cache(sqlite3* db, size_t capacity = default_capacity);
+
+    /// @brief Finalize all the cached statements, statements in use should be destroyed before
+    ~sqlite3_statement_cache();
+
+    sqlite3_statement_cache(const sqlite3_statement_cache&) = delete;
+    sqlite3_statement_cache& operator=(const sqlite3_statement_cache&) = delete;
+
+    /// @brief Cached statement or the newly prepared one
+    /// The statement returns to the cache on destruction
+    sqlite3_statement prepare(std::string_view sql);
+
+    /// @brief Finalize all the cached statements
+    /// Statements in use are not affected and return to the cache later
+    void clear();
+
+    /// @brief Change the capacity, 0 disables caching
+    void set_capacity(size_t capacity);
+
+    size_t capacity() const;
+
+    /// @brief Statements in the cache, not counting the ones in use
+    size_t size() const;
+
+    /// @brief prepare() calls served from the cache
+    std::uint64_t hits() const;
+
+    /// @brief prepare() calls that compiled the SQL
+    std::uint64_t misses() const;
+
+private:
+
+    friend class sqlite3_statement;
+
+    struct entry
+    {
+        std::string sql;
+        sqlite3_stmt* stmt = nullptr;
+        bool in_use = false;
+    };
+
+    using entry_iterator = std::list<entry>::iterator;
+
+    /// Put the statement back, called by sqlite3_statement
+    void release(entry_iterator statement);
+
+    /// Finalize the least recently used statements above the capacity
+    void evict();
+
+    /// Remove the entry and finalize its statement
+    void erase(entry_iterator statement);
+
+    sqlite3* db_;
+    size_t capacity_;
+
+    /// Idle statements, most recently used first
+    std::list<entry> entries_;
+
+    /// Statements in use, nodes are spliced between the lists
+    std::list<entry> in_use_;
+
+    /// Keys refer strings of the entries, both idle and in use
+    std::unordered_map<std::string_view, entry_iterator> index_;
+
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+};
+
+
+/// @brief RAII wrapper of the prepared SQLite statement with typed bind and column access
+/// Like sqlite3_helper, does not throw exceptions, every method returns SQLite error code.
+/// The statement should not outlive its database
+class sqlite3_statement
+{
+public:
+
+    /// @brief Empty statement
+    sqlite3_statement() = default;
+
+    /// @brief Prepare the statement, check get_last_error() or operator bool for the result
+    /// Only the first statement of sql is prepared
+    sqlite3_statement(sqlite3* db, std::string_view sql);
+
+    /// @brief Finalize the statement or return it to the cache it came from
+    ~sqlite3_statement();
+
+    /// No copy
+    sqlite3_statement(const sqlite3_statement&) = delete;
+    sqlite3_statement& operator=(const sqlite3_statement&) = delete;
+
+    /// @brief Move c-tor leaves rhs-object in empty state
+    sqlite3_statement(sqlite3_statement&& rhs);
+
+    /// @brief Assignment operator finalizes own statement and leaves rhs-object in empty state
+    sqlite3_statement& operator=(sqlite3_statement&& rhs);
+
+
+    /// @brief Bind parameter, indexes start from 1
+    /// Text and blobs are copied by SQLite, so the value could be destroyed right after the call
+    /// @return: SQLite error code
+    int bind(int index, int value);
+    int bind(int index, std::int64_t value);
+    int bind(int index, double value);
+    int bind(int index, const char* value);
+    int bind(int index, std::string_view value);
+    int bind(int index, const std::string& value);
+    int bind(int index, byte_view value);
+    int bind(int index, std::nullptr_t);
+
+    /// @brief Bind the blob compressed by compress_blob() (sqlite3_compression.h)
+    int bind(int index, const sqlite3_compressed_blob& value);
+
+    /// @brief Bind other integer types (unsigned, size_t, ...) as 64-bit integer
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    int bind(int index, T value)
+    {
+        return bind(index, static_cast<std::int64_t>(value));
+    }
+
+    /// @brief Bind all the parameters starting from index 1
+    /// @return: SQLite error code of the first failed bind, SQLITE_OK otherwise
+    template <typename... Args>
+    int bind_values(const Args&... args)
+    {
+        int index = 0;
+        int result = 0;
+        // left-to-right evaluation of the braced initializer
+        const int results[] = { 0, (result = (0 == result) ? bind(++index, args) : result)... };
+        (void) results;
+        return result;
+    }
+
+    /// @brief Unbind all the parameters, they become NULL
+    int clear_bindings();
+
+    /// @brief Evaluate the statement
+    /// @return: SQLITE_ROW if the row is ready, SQLITE_DONE when finished, error code otherwise
+    int step();
+
+    /// @brief Step to the next row of the result set
+    /// @return: false at the end or on error, check get_last_error() to tell them apart
+    bool next_row();
+
+    /// @brief Reset the statement to be evaluated again, bindings are kept
+    int reset();
+
+    /// @brief Step until SQLITE_DONE and reset, convenient for INSERT, UPDATE and DELETE
+    /// @return: SQLITE_OK or error code
+    int execute();
+
+    /// @brief Iterate the result set, for (const sqlite3_row& row : statement)
+    /// begin() steps the statement, so the loop continues a partly read result set; reset() starts it again.
+    /// The loop stops at the end or on error, check get_last_error() to tell them apart
+    sqlite3_row_iterator begin();
+    sqlite3_row_iterator end();
+
+    /// @brief Column value of the current row, indexes start from 0
+    /// T is int, std::int64_t, double, std::string, std::string_view or byte_view.
+    /// Views refer SQLite buffers and are valid until the next step(), reset() or column<T>() of another type
+    template <typename T>
+    T column(int index) const;
+
+    /// @brief Original data of the blob column stored by compress_blob(), blobs stored as is are copied
+    /// @return: SQLite error code, SQLITE_CORRUPT if the compressed blob is damaged
+    int column_uncompressed(int index, std::vector<std::uint8_t>& value) const;
+
+    /// @brief Columns in the result set
+    int column_count() const;
+
+    /// @brief Column type: SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL
+    int column_type(int index) const;
+
+    /// @brief Column name in the result set
+    const char* column_name(int index) const;
+
+    /// @brief Check whether the column of the current row is NULL
+    bool is_null(int index) const;
+
+    /// @brief Parameters of the statement
+    int parameter_count() const;
+
+    /// @brief SQL text of the statement
+    const char* sql() const;
+
+    /// @brief Native statement handle
+    sqlite3_stmt* handle() const;
+
+    /// @brief Is statement prepared and last operation succeeded
+    operator bool() const;
+
+    /// @brief Return last error code, SQLITE_ROW and SQLITE_DONE of step() are not errors
+    int get_last_error() const;
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const;
+
+private:
+
+    friend class sqlite3_statement_cache;
+
+    /// Wrap the statement of the cache
+    sqlite3_statement(sqlite3_statement_cache* cache, sqlite3_statement_cache::entry_iterator cache_entry);
+
+    /// Finalize or return to the cache
+    void release();
+
+    /// Remember the code, SQLITE_ROW and SQLITE_DONE are successful step() results
+    int check(int return_code);
+
+    /// SQLite3 statement handle
+    sqlite3_stmt* stmt_ = nullptr;
+
+    /// The cache to return the statement to, nullptr if the statement is not cached
+    sqlite3_statement_cache* cache_ = nullptr;
+    sqlite3_statement_cache::entry_iterator cache_entry_;
+
+    /// Last returned error code
+    int current_return_code_ = 0;
+};
+
+template <>
+int sqlite3_statement::column<int>(int index) const;
+
+template <>
+std::int64_t sqlite3_statement::column<std::int64_t>(int index) const;
+
+template <>
+double sqlite3_statement::column<double>(int index) const;
+
+template <>
+std::string sqlite3_statement::column<std::string>(int index) const;
+
+template <>
+std::string_view sqlite3_statement::column<std::string_view>(int index) const;
+
+template <>
+byte_view sqlite3_statement::column<byte_view>(int index) const;
+
+
+/// @brief View of the current row of the statement, nothing is copied or allocated
+/// Numbers are read natively, text and blobs are views of SQLite buffers
+/// valid until the statement steps to the next row
+class sqlite3_row
+{
+public:
+
+    explicit sqlite3_row(const sqlite3_statement* statement = nullptr) :
+        statement_(statement)
+    {
+    }
+
+    /// @brief Column value, the same types as sqlite3_statement::column<T>()
+    template <typename T>
+    T get(int index) const
+    {
+        return statement_->column<T>(index);
+    }
+
+    std::int64_t as_int64(int index) const
+    {
+        return get<std::int64_t>(index);
+    }
+
+    double as_double(int index) const
+    {
+        return get<double>(index);
+    }
+
+    std::string_view as_text(int index) const
+    {
+        return get<std::string_view>(index);
+    }
+
+    byte_view as_blob(int index) const
+    {
+        return get<byte_view>(index);
+    }
+
+    /// @brief Original data of the blob stored by compress_blob()
+    /// @return: SQLite error code
+    int as_uncompressed(int index, std::vector<std::uint8_t>& value) const
+    {
+        return statement_->column_uncompressed(index, value);
+    }
+
+    /// @brief Columns in the row
+    int size() const
+    {
+        return statement_->column_count();
+    }
+
+    /// @brief Column type: SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL
+    int type(int index) const
+    {
+        return statement_->column_type(index);
+    }
+
+    bool is_null(int index) const
+    {
+        return statement_->is_null(index);
+    }
+
+    const char* name(int index) const
+    {
+        return statement_->column_name(index);
+    }
+
+private:
+    const sqlite3_statement* statement_;
+};
+
+
+/// @brief Input iterator stepping the statement, dereferences to the view of the current row
+/// All the iterators of one statement share its current row
+class sqlite3_row_iterator
+{
+public:
+
+    using iterator_category = std::input_iterator_tag;
+    using value_type = sqlite3_row;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const sqlite3_row*;
+    using reference = const sqlite3_row&;
+
+    /// @brief End iterator
+    sqlite3_row_iterator() = default;
+
+    /// @brief Step the statement to its next row, end iterator if there is none
+    explicit sqlite3_row_iterator(sqlite3_statement* statement);
+
+    reference operator*() const
+    {
+        return row_;
+    }
+
+    pointer operator->() const
+    {
+        return &row_;
+    }
+
+    sqlite3_row_iterator& operator++();
+
+    sqlite3_row_iterator operator++(int)
+    {
+        sqlite3_row_iterator previous(*this);
+        ++(*this);
+        return previous;
+    }
+
+    bool operator==(const sqlite3_row_iterator& rhs) const
+    {
+        return statement_ == rhs.statement_;
+    }
+
+    bool operator!=(const sqlite3_row_iterator& rhs) const
+    {
+        return statement_ != rhs.statement_;
+    }
+
+private:
+    sqlite3_statement* statement_ = nullptr;
+    sqlite3_row row_;
+};
+
+
+} // namespace helpers
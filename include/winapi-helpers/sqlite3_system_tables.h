@@ -0,0 +1,28 @@
+#pragma once
+
+struct sqlite3;
+
+namespace helpers {
+
+/// @brief Register read-only virtual tables of the live system inventory on the connection
+/// The tables are eponymous, they are queried without CREATE VIRTUAL TABLE:
+///
+///   processes(pid, ppid, name, state, threads, rss, cmdline)
+///     /proc/<pid>/stat and cmdline under Linux, Toolhelp32 snapshot under Windows
+///   mounts(path, device, filesystem, options, placement, disk_type, total_bytes, free_bytes, available_bytes)
+///     /proc/self/mounts and /sys/class/block under Linux, PartititonInformation under Windows
+///   cpu_topology(cpu, package, core, online)
+///     /sys/devices/system/cpu under Linux, GetLogicalProcessorInformation() under Windows
+///   env(name, value)
+///     environment of the process
+///
+/// Rows are produced one by one while the cursor steps, nothing is collected in advance,
+/// and the costly columns (cmdline, sizes of the file system) are read only when selected.
+/// Equality on the key (pid, path, cpu, name) is pushed down: processes, cpu_topology and env
+/// read the only row directly, mounts skips the rest of rows before reading their details.
+/// Data unavailable on the platform is NULL. The tables are not thread-safe by themselves,
+/// they follow threading of the connection
+/// @return: SQLite error code
+int register_system_tables(sqlite3* db);
+
+} // namespace helpers
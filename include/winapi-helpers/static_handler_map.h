@@ -0,0 +1,330 @@
+#pragma once
+#include <array>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <winapi-helpers/dynamic_handler_map.h>
+
+namespace helpers {
+
+
+/// @brief Compile-time association of the Key value with the free function or static method
+/// @typename KeyValue: integral or enum constant
+/// @typename Function: pointer to function, nullptr means "null handler"
+template <auto KeyValue, auto Function>
+struct StaticHandler
+{
+    static constexpr auto key = KeyValue;
+
+    static constexpr bool is_null = std::is_same_v<decltype(Function), std::nullptr_t>;
+
+    template <typename... Args>
+    static decltype(auto) invoke(Args&&... args)
+    {
+        return Function(std::forward<Args>(args)...);
+    }
+};
+
+/// @brief Compile-time association of the Key value with the stateless functor type
+/// Functor is default-constructed on every call, so the call is inlined
+/// @example: using Entry = StaticFunctor<MyKey::First, FirstHandler>;
+template <auto KeyValue, typename Functor>
+struct StaticFunctor
+{
+    static_assert(std::is_empty_v<Functor> && std::is_default_constructible_v<Functor>,
+        "StaticFunctor<> should be stateless default-constructible callable");
+
+    static constexpr auto key = KeyValue;
+
+    static constexpr bool is_null = false;
+
+    template <typename... Args>
+    static decltype(auto) invoke(Args&&... args)
+    {
+        return Functor{}(std::forward<Args>(args)...);
+    }
+};
+
+/// @brief Compile-time list of StaticHandler<> or StaticFunctor<> entries
+template <typename... Entries>
+struct StaticHandlerList {};
+
+
+namespace static_handler_map_details {
+
+/// Map integral or enum key to unsigned 64-bit value
+template <typename Key>
+constexpr std::uint64_t key_bits(Key key)
+{
+    if constexpr (std::is_enum_v<Key>) {
+        return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<Key>>(key));
+    }
+    else {
+        return static_cast<std::uint64_t>(key);
+    }
+}
+
+/// Multiplicative hash, the seed is picked in compile time so that the hash is perfect
+constexpr std::size_t perfect_hash(std::uint64_t key, std::uint64_t seed, unsigned bits)
+{
+    return static_cast<std::size_t>(((key ^ seed) * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+constexpr std::size_t no_slot = std::numeric_limits<std::size_t>::max();
+
+/// Longest hash table we are ready to search a seed for (log2 of slots count)
+constexpr unsigned max_hash_bits = 12;
+
+/// Dense keys are dispatched by the plain jump table, no hashing at all
+constexpr std::size_t max_jump_table_gap = 4;
+
+/// @brief Lookup parameters generated in compile time
+/// Either direct jump table indexed by (key - min_key), or perfect hash table
+struct DispatchParams
+{
+    bool direct = true;
+    std::uint64_t min_key = 0;
+    std::uint64_t seed = 0;
+    unsigned bits = 0;
+    std::size_t slots_count = 1;
+
+    constexpr std::size_t slot(std::uint64_t key) const
+    {
+        if (direct) {
+            const std::uint64_t offset = key - min_key;
+            return offset < slots_count ? static_cast<std::size_t>(offset) : no_slot;
+        }
+        return perfect_hash(key, seed, bits);
+    }
+};
+
+template <std::size_t N>
+constexpr bool keys_unique(const std::array<std::uint64_t, N>& keys)
+{
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = i + 1; j < N; ++j) {
+            if (keys[i] == keys[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <std::size_t N>
+constexpr bool is_perfect(const std::array<std::uint64_t, N>& keys, std::uint64_t seed, unsigned bits)
+{
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = i + 1; j < N; ++j) {
+            if (perfect_hash(keys[i], seed, bits) == perfect_hash(keys[j], seed, bits)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <std::size_t N>
+constexpr DispatchParams make_dispatch_params(const std::array<std::uint64_t, N>& keys)
+{
+    DispatchParams params{};
+    if (0 == N) {
+        return params;
+    }
+
+    std::uint64_t min_key = keys[0];
+    std::uint64_t max_key = keys[0];
+    for (std::size_t i = 1; i < N; ++i) {
+        min_key = keys[i] < min_key ? keys[i] : min_key;
+        max_key = keys[i] > max_key ? keys[i] : max_key;
+    }
+
+    // Keys are dense enough, make jump table (key - min_key) -> handler index
+    const std::uint64_t range = max_key - min_key;
+    if (range < N * max_jump_table_gap) {
+        params.direct = true;
+        params.min_key = min_key;
+        params.slots_count = static_cast<std::size_t>(range) + 1;
+        return params;
+    }
+
+    // Search collision-free seed, doubling the table if the load is too high
+    params.direct = false;
+    unsigned bits = 1;
+    while ((std::size_t(1) << bits) < 2 * N) {
+        ++bits;
+    }
+    for (; bits <= max_hash_bits; ++bits) {
+        for (std::uint64_t seed = 0; seed < 256; ++seed) {
+            if (is_perfect(keys, seed, bits)) {
+                params.seed = seed;
+                params.bits = bits;
+                params.slots_count = std::size_t(1) << bits;
+                return params;
+            }
+        }
+    }
+    throw std::logic_error("Unable to build perfect hash for StaticHandlerMap keys");
+}
+
+/// Slot -> handler index table, no_slot for empty slots
+template <std::size_t SlotsCount, std::size_t N>
+constexpr std::array<std::size_t, SlotsCount> make_slots(
+    const std::array<std::uint64_t, N>& keys, const DispatchParams& params)
+{
+    std::array<std::size_t, SlotsCount> slots{};
+    for (std::size_t& slot : slots) {
+        slot = no_slot;
+    }
+    for (std::size_t i = 0; i < N; ++i) {
+        slots[params.slot(keys[i])] = i;
+    }
+    return slots;
+}
+
+template <auto KeyValue, typename... Entries>
+constexpr std::size_t index_of()
+{
+    constexpr bool matches[] = { (Entries::key == KeyValue)..., false };
+    for (std::size_t i = 0; i < sizeof...(Entries); ++i) {
+        if (matches[i]) {
+            return i;
+        }
+    }
+    return no_slot;
+}
+
+template <typename Entry, typename Signature,
+    template <typename RetType> class NullHandlePolicy>
+struct Thunk;
+
+template <typename Entry, typename RetType, typename... Args,
+    template <typename> class NullHandlePolicy>
+struct Thunk<Entry, RetType(Args...), NullHandlePolicy>
+{
+    static RetType call(Args... args)
+    {
+        if constexpr (Entry::is_null) {
+            return NullHandlePolicy<RetType>::null_handler();
+        }
+        else {
+            return static_cast<RetType>(Entry::invoke(std::forward<Args>(args)...));
+        }
+    }
+};
+
+} // namespace static_handler_map_details
+
+
+/// @brief Compile-time counterpart of HandlerMap for the fixed set of keys
+/// Handlers are stored as plain function pointers in the constexpr table,
+/// lookup by the runtime key is either jump table (dense keys) or perfect hash,
+/// lookup by the compile-time key is a direct call, and unknown key is a compile error
+/// @typename Key: integral or enum type
+/// @typename Signature: handler signature, e.g. int(const std::string&)
+/// @typename Entries: StaticHandlerList<> of StaticHandler<> or StaticFunctor<> entries
+/// @typename NoKeyPolicy: action when runtime Key is not found
+/// @typename NullHandlePolicy: action when Handler is nullptr
+/// @example:
+/// using Map = StaticHandlerMap<Command, int(int), StaticHandlerList<
+///     StaticHandler<Command::Start, &start>,
+///     StaticHandler<Command::Stop, &stop>>>;
+/// Map::call<Command::Start>(1);
+/// Map::call(command, 1);
+template <typename Key, typename Signature, typename Entries,
+    template <typename RetType> class NoKeyPolicy = ThrowPolicy,
+    template <typename RetType> class NullHandlePolicy = DefaultValuePolicy>
+class StaticHandlerMap;
+
+template <typename Key, typename RetType, typename... Args, typename... Entries,
+    template <typename> class NoKeyPolicy,
+    template <typename> class NullHandlePolicy>
+class StaticHandlerMap<Key, RetType(Args...), StaticHandlerList<Entries...>, NoKeyPolicy, NullHandlePolicy>
+{
+    static_assert(std::is_integral_v<Key> || std::is_enum_v<Key>,
+        "StaticHandlerMap<> key should be integral or enum type");
+
+    static_assert((std::is_same_v<std::remove_cv_t<decltype(Entries::key)>, Key> && ...),
+        "All StaticHandlerMap<> entries should have the same key type");
+
+    using handler_pointer = RetType(*)(Args...);
+
+    static constexpr std::array<std::uint64_t, sizeof...(Entries)> keys_{
+        { static_handler_map_details::key_bits(Entries::key)... } };
+
+    static_assert(static_handler_map_details::keys_unique(keys_),
+        "StaticHandlerMap<> keys should be unique");
+
+    static constexpr static_handler_map_details::DispatchParams params_ =
+        static_handler_map_details::make_dispatch_params(keys_);
+
+    static constexpr std::array<std::size_t, params_.slots_count> slots_ =
+        static_handler_map_details::make_slots<params_.slots_count>(keys_, params_);
+
+    static constexpr std::array<handler_pointer, sizeof...(Entries)> handlers_{
+        { &static_handler_map_details::Thunk<Entries, RetType(Args...), NullHandlePolicy>::call... } };
+
+public:
+
+    /// @brief Handler invoke point for the key known in compile time
+    /// Unknown key does not compile, the call is direct (inlinable) handler call
+    template <auto KeyValue, typename... CallArgs>
+    static RetType call(CallArgs&&... args)
+    {
+        constexpr std::size_t index = static_handler_map_details::index_of<KeyValue, Entries...>();
+        static_assert(index != static_handler_map_details::no_slot,
+            "StaticHandlerMap<> does not contain handler for the key");
+
+        using Entry = std::tuple_element_t<index, std::tuple<Entries...>>;
+        return static_handler_map_details::Thunk<Entry, RetType(Args...), NullHandlePolicy>::call(
+            std::forward<CallArgs>(args)...);
+    }
+
+    /// @brief Handler invoke point for the runtime key
+    /// Lookup is a table index, perform NoKeyPolicy action on non-existent Key
+    template <typename... CallArgs>
+    static RetType call(Key key, CallArgs&&... args)
+    {
+        std::size_t index = find(key);
+        if (static_handler_map_details::no_slot == index) {
+            return NoKeyPolicy<RetType>::no_handler();
+        }
+        return handlers_[index](std::forward<CallArgs>(args)...);
+    }
+
+    /// @brief Check if the key has associated entry
+    static constexpr bool contains(Key key)
+    {
+        return find(key) != static_handler_map_details::no_slot;
+    }
+
+    /// @brief Handlers count, compile-time replacement of HandlerMap::throw_if_unexpected()
+    static constexpr std::size_t size()
+    {
+        return sizeof...(Entries);
+    }
+
+private:
+
+    /// Return index of the handler or no_slot
+    static constexpr std::size_t find(Key key)
+    {
+        const std::uint64_t bits = static_handler_map_details::key_bits(key);
+        const std::size_t slot = params_.slot(bits);
+        if (static_handler_map_details::no_slot == slot) {
+            return static_handler_map_details::no_slot;
+        }
+
+        const std::size_t index = slots_[slot];
+        if (static_handler_map_details::no_slot == index || keys_[index] != bits) {
+            return static_handler_map_details::no_slot;
+        }
+        return index;
+    }
+};
+
+} // namespace helpers
@@ -51,7 +51,8 @@ namespace std
 
         static int compare(const char_type* ptr1, const char_type* ptr2, std::size_t count)
         {
-            return std::memcmp(ptr1, ptr2, count);
+            // empty views could have null pointers, memcmp() does not accept them even for zero count
+            return (0 == count) ? 0 : std::memcmp(ptr1, ptr2, count);
         }
 
         static const char_type* find(const char_type* ptr, std::size_t count, const char_type& value)
@@ -103,7 +104,8 @@ namespace std
         using external_type = char;
         using state_type = std::mbstate_t;
 
-        static std::locale::id id;
+        // inline variable, so that the header could be included from several translation units
+        static inline std::locale::id id;
 
         codecvt(std::size_t refs = 0)
             : locale::facet(refs)
@@ -155,9 +157,7 @@ namespace std
         virtual bool do_always_noconv() const noexcept;
     }; // class codecvt
 
-    locale::id codecvt< std::uint8_t, char, std::mbstate_t >::id;
-
-    codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_out(state_type& state, const internal_type* from, const internal_type* from_end, const internal_type*& from_next, external_type* to, external_type* to_end, external_type*& to_next) const
+    inline codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_out(state_type& state, const internal_type* from, const internal_type* from_end, const internal_type*& from_next, external_type* to, external_type* to_end, external_type*& to_next) const
     {
         (void) state; (void) from_end; (void) to_end; // Unused parameters
         from_next = from;
@@ -165,7 +165,7 @@ namespace std
        return codecvt_base::noconv;
     }
 
-    codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_in(state_type& state, const external_type* from, const external_type* from_end, const external_type*& from_next, internal_type* to, internal_type* to_end, internal_type*& to_next) const
+    inline codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_in(state_type& state, const external_type* from, const external_type* from_end, const external_type*& from_next, internal_type* to, internal_type* to_end, internal_type*& to_next) const
     {
         (void) state; (void) from_end; (void) to_end; // Unused parameters
         from_next = from;
@@ -173,30 +173,30 @@ namespace std
         return std::codecvt_base::noconv;
     }
 
-    codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_unshift(state_type& state, external_type* to, external_type* to_end, external_type*& to_next) const
+    inline codecvt_base::result codecvt< std::uint8_t, char, std::mbstate_t >::do_unshift(state_type& state, external_type* to, external_type* to_end, external_type*& to_next) const
     {
         (void) state; (void) to_end; // Unused perameters
         to_next = to;
         return std::codecvt_base::noconv;
     }
 
-    int codecvt< std::uint8_t, char, std::mbstate_t >::do_length(state_type& state, const external_type* from, const external_type* from_end, std::size_t max) const
+    inline int codecvt< std::uint8_t, char, std::mbstate_t >::do_length(state_type& state, const external_type* from, const external_type* from_end, std::size_t max) const
     {
         (void) state; // Unused parameter
         return static_cast<int>(std::min< std::size_t >(max, static_cast<std::size_t>(from_end - from)));
     }
 
-    int codecvt< std::uint8_t, char, std::mbstate_t >::do_max_length() const noexcept
+    inline int codecvt< std::uint8_t, char, std::mbstate_t >::do_max_length() const noexcept
     {
         return 1;
     }
 
-    int codecvt< std::uint8_t, char, std::mbstate_t >::do_encoding() const noexcept
+    inline int codecvt< std::uint8_t, char, std::mbstate_t >::do_encoding() const noexcept
     {
         return 1;
     }
 
-    bool codecvt< std::uint8_t, char, std::mbstate_t >::do_always_noconv() const noexcept
+    inline bool codecvt< std::uint8_t, char, std::mbstate_t >::do_always_noconv() const noexcept
     {
         return true;
     }
@@ -0,0 +1,261 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace helpers {
+
+class thread_pool;
+
+/// @brief Status of UTF conversion
+enum class utf_status
+{
+    /// Whole input is converted
+    ok,
+
+    /// Overlong form, surrogate code point, code point above U+10FFFF,
+    /// unexpected continuation byte or unpaired UTF-16 surrogate
+    invalid_sequence,
+
+    /// Input ends in the middle of multi-unit sequence
+    truncated_sequence,
+
+    /// Output buffer is too small
+    output_overflow
+};
+
+/// @brief Validation mode of UTF conversion
+enum class utf_validation
+{
+    /// Reject every ill-formed sequence, report its offset
+    validating,
+
+    /// Input is trusted to be well-formed, only buffer bounds are checked.
+    /// Ill-formed input never causes out-of-bounds access, but produces unspecified output
+    non_validating
+};
+
+/// @brief Result of UTF conversion
+struct utf_result
+{
+    /// Conversion status
+    utf_status status = utf_status::ok;
+
+    /// Offset of the first invalid code unit in the input, input length on success
+    size_t input_offset = 0;
+
+    /// Code units written to the output, required output length on output_overflow
+    size_t output_count = 0;
+
+    /// @brief Conversion succeeded
+    explicit operator bool() const
+    {
+        return utf_status::ok == status;
+    }
+};
+
+/// Worst-case output length ratio, output buffer of (input length * ratio) is always enough
+constexpr size_t utf16_per_utf8_max = 1;
+constexpr size_t utf32_per_utf8_max = 1;
+constexpr size_t utf8_per_utf16_max = 3;
+constexpr size_t utf8_per_utf32_max = 4;
+constexpr size_t utf8_per_wide_max = (sizeof(wchar_t) == 2) ? utf8_per_utf16_max : utf8_per_utf32_max;
+
+/// @brief Check whether the input is well-formed UTF-8
+utf_result validate_utf8(const char* input, size_t length);
+
+/// @brief Convert UTF-8 to UTF-16, output should fit (length * utf16_per_utf8_max) code units
+utf_result utf8_to_utf16(const char* input, size_t length, char16_t* output,
+    utf_validation validation = utf_validation::validating);
+
+/// @brief Convert UTF-8 to UTF-32, output should fit (length * utf32_per_utf8_max) code units
+utf_result utf8_to_utf32(const char* input, size_t length, char32_t* output,
+    utf_validation validation = utf_validation::validating);
+
+/// @brief Convert UTF-16 to UTF-8, output should fit (length * utf8_per_utf16_max) code units
+utf_result utf16_to_utf8(const char16_t* input, size_t length, char* output,
+    utf_validation validation = utf_validation::validating);
+
+/// @brief Convert UTF-32 to UTF-8, output should fit (length * utf8_per_utf32_max) code units
+utf_result utf32_to_utf8(const char32_t* input, size_t length, char* output,
+    utf_validation validation = utf_validation::validating);
+
+/// @brief Convert UTF-8 to wchar_t string: UTF-16 under Windows, UTF-32 under POSIX
+/// Output should fit (length) code units
+utf_result utf8_to_wide(const char* input, size_t length, wchar_t* output,
+    utf_validation validation = utf_validation::validating);
+
+/// @brief Convert wchar_t string (UTF-16 under Windows, UTF-32 under POSIX) to UTF-8
+/// Output should fit (length * utf8_per_wide_max) code units
+utf_result wide_to_utf8(const wchar_t* input, size_t length, char* output,
+    utf_validation validation = utf_validation::validating);
+
+
+/// @brief Output length of UTF-8 input conversion to OutputChar (char16_t, char32_t or wchar_t) string
+/// Exact for the well-formed input, upper bound for the ill-formed one.
+/// Code units are counted with SIMD, much cheaper than the conversion itself
+template <typename OutputChar>
+size_t required_length(const char* input, size_t length);
+
+template <>
+size_t required_length<char16_t>(const char* input, size_t length);
+
+template <>
+size_t required_length<char32_t>(const char* input, size_t length);
+
+template <>
+size_t required_length<wchar_t>(const char* input, size_t length);
+
+/// @brief UTF-8 output length of UTF-16 input conversion
+/// Exact for the well-formed input, upper bound for the ill-formed one
+size_t required_length(const char16_t* input, size_t length);
+
+/// @brief UTF-8 output length of UTF-32 input conversion
+size_t required_length(const char32_t* input, size_t length);
+
+/// @brief UTF-8 output length of wchar_t input conversion
+size_t required_length(const wchar_t* input, size_t length);
+
+
+/// @brief Conversions into the caller buffer of (capacity) code units
+/// If the worst-case output does not fit, required_length() is checked first,
+/// output_overflow is returned with required length in output_count and nothing is written
+utf_result utf8_to_utf16(const char* input, size_t length, char16_t* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf8_to_utf32(const char* input, size_t length, char32_t* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf16_to_utf8(const char16_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf32_to_utf8(const char32_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf8_to_wide(const char* input, size_t length, wchar_t* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+utf_result wide_to_utf8(const wchar_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation = utf_validation::validating);
+
+
+/// @brief Conversions into the reusable string buffer
+/// The buffer is resized to output_count, its capacity is kept, so the loop
+/// converting many strings into the same buffer allocates only while the buffer grows.
+/// On error the buffer contains the output converted before the invalid sequence
+utf_result utf8_to_utf16(const char* input, size_t length, std::u16string& output,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf8_to_utf32(const char* input, size_t length, std::u32string& output,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf16_to_utf8(const char16_t* input, size_t length, std::string& output,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf32_to_utf8(const char32_t* input, size_t length, std::string& output,
+    utf_validation validation = utf_validation::validating);
+
+utf_result utf8_to_wide(const char* input, size_t length, std::wstring& output,
+    utf_validation validation = utf_validation::validating);
+
+utf_result wide_to_utf8(const wchar_t* input, size_t length, std::string& output,
+    utf_validation validation = utf_validation::validating);
+
+
+/// @brief Strings converted by transcode_batch(), packed back to back into one buffer
+/// String i occupies [offsets[i], offsets[i + 1]) of data, there are neither separators nor terminators,
+/// so both arrays could be written to the file or mapped as is
+template <typename Char>
+struct packed_strings
+{
+    /// All the strings, one allocation for the whole batch
+    std::basic_string<Char> data;
+
+    /// size() + 1 offsets in code units, the first one is 0
+    std::vector<std::uint64_t> offsets;
+
+    /// Conversion status, data and offsets are empty on error
+    utf_status status = utf_status::ok;
+
+    /// Index of the first ill-formed input string
+    size_t failed_index = 0;
+
+    /// Offset of the first invalid code unit in that string
+    size_t input_offset = 0;
+
+    /// @brief Conversion succeeded
+    explicit operator bool() const
+    {
+        return utf_status::ok == status;
+    }
+
+    /// @brief Strings count
+    size_t size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    /// @brief View of the string, valid while the packed_strings is alive and unchanged
+    std::basic_string_view<Char> operator[](size_t index) const
+    {
+        return std::basic_string_view<Char>(data.data() + offsets[index],
+            static_cast<size_t>(offsets[index + 1] - offsets[index]));
+    }
+};
+
+/// @brief Convert the batch of UTF-8 strings to OutputChar (char16_t, char32_t or wchar_t) strings
+/// Output lengths are counted with required_length(), then every string is converted right into
+/// its place of the single output buffer. Large batches are split across the pool if passed
+/// @param pool: optional thread pool for batches of many kilobytes, nullptr to run in the caller thread.
+/// The caller converts the ranges no worker picked up, so a busy or stopped pool only slows the batch down
+template <typename OutputChar>
+packed_strings<OutputChar> transcode_batch(const std::string_view* inputs, size_t count,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating);
+
+template <>
+packed_strings<char16_t> transcode_batch<char16_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool, utf_validation validation);
+
+template <>
+packed_strings<char32_t> transcode_batch<char32_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool, utf_validation validation);
+
+template <>
+packed_strings<wchar_t> transcode_batch<wchar_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool, utf_validation validation);
+
+/// @brief Convert the batch of UTF-16 strings to UTF-8, see above
+packed_strings<char> transcode_batch(const std::u16string_view* inputs, size_t count,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating);
+
+/// @brief Convert the batch of UTF-32 strings to UTF-8, see above
+packed_strings<char> transcode_batch(const std::u32string_view* inputs, size_t count,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating);
+
+/// @brief Convert the batch of wchar_t strings to UTF-8, see above
+packed_strings<char> transcode_batch(const std::wstring_view* inputs, size_t count,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating);
+
+/// @brief Batch conversion of the vector, see above
+template <typename OutputChar>
+packed_strings<OutputChar> transcode_batch(const std::vector<std::string_view>& inputs,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating)
+{
+    return transcode_batch<OutputChar>(inputs.data(), inputs.size(), pool, validation);
+}
+
+/// @brief Batch conversion of the vector, see above
+template <typename InputChar>
+packed_strings<char> transcode_batch(const std::vector<std::basic_string_view<InputChar>>& inputs,
+    thread_pool* pool = nullptr, utf_validation validation = utf_validation::validating)
+{
+    return transcode_batch(inputs.data(), inputs.size(), pool, validation);
+}
+
+
+/// @brief Name of the SIMD kernel selected in runtime: "avx2", "sse2", "neon" or "scalar"
+const char* utf_kernel_name();
+
+} // namespace helpers
@@ -11,8 +11,22 @@ namespace helpers
 void set_memory_profiling();
 void set_console_ctrl_handler(PHANDLER_ROUTINE ctrl_handler);
 
+/// @brief UTF-16 to UTF-8 conversion, empty string if the input is ill-formed
+/// Use wide_to_utf8() from utf_transcoder.h for the error offset
 std::string wstring_to_utf8(const std::wstring& var);
+
+/// @brief UTF-8 to UTF-16 conversion, empty string if the input is ill-formed
+/// Use utf8_to_wide() from utf_transcoder.h for the error offset
 std::wstring utf8_to_wstring(const std::string& var);
+
+/// @brief UTF-16 to UTF-8 conversion into the reusable buffer, no allocation once the buffer is large enough
+/// @return: code units written, 0 and empty buffer if the input is ill-formed
+size_t wstring_to_utf8(const wchar_t* var, size_t length, std::string& result);
+
+/// @brief UTF-8 to UTF-16 conversion into the reusable buffer, no allocation once the buffer is large enough
+/// @return: code units written, 0 and empty buffer if the input is ill-formed
+size_t utf8_to_wstring(const char* var, size_t length, std::wstring& result);
+
 std::string wstring_to_string(const std::wstring& var);
 std::wstring string_to_wstring(const std::string& var);
 
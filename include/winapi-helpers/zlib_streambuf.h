@@ -0,0 +1,296 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <winapi-helpers/byte_streambuf.h>
+
+struct z_stream_s;
+
+namespace helpers {
+
+/// @brief Container of the compressed stream
+enum class zlib_format
+{
+    /// Input: gzip or zlib by the header, anything else is passed through as is. Output: gzip
+    automatic,
+
+    /// gzip members (RFC 1952), concatenated members are read as one stream
+    gzip,
+
+    /// zlib stream (RFC 1950)
+    zlib,
+
+    /// Raw deflate (RFC 1951)
+    raw,
+
+    /// Data as is, no compression
+    none
+};
+
+
+/// @brief Decompressing input buffer, works with std::basic_istream<uint8_t>
+/// Reads the compressed bytes from the source buffer and inflates them into the large get area,
+/// so memory is bounded by two buffers and the zlib state whatever the size of the stream.
+/// Nothing is copied on the way: the compressed input is taken by windows if the source is
+/// byte_istreambuf (a mapped file is inflated right from the mapping), large reads are inflated
+/// directly into the destination, and passed through input is handed over without copying
+class zlib_istreambuf : public std::basic_streambuf<std::uint8_t>
+{
+public:
+
+    zlib_istreambuf();
+    ~zlib_istreambuf() override;
+
+    zlib_istreambuf(const zlib_istreambuf&) = delete;
+    zlib_istreambuf& operator=(const zlib_istreambuf&) = delete;
+
+    /// @brief Decompress the source, the source should outlive the buffer or its close()
+    /// @param buffer_size: size of the get area, and of the read block if the source is not byte_istreambuf
+    /// @return: false if the source is nullptr or the buffer could not be allocated
+    bool open(std::basic_streambuf<std::uint8_t>* source, zlib_format format = zlib_format::automatic,
+        size_t buffer_size = byte_stream_buffer_size);
+
+    /// @brief Decompress the bytes in memory, e.g. the mapped view or the blob; they should outlive the buffer
+    bool open(byte_view data, zlib_format format = zlib_format::automatic,
+        size_t buffer_size = byte_stream_buffer_size);
+
+    /// @brief Release zlib and the buffers, the source is not closed
+    void close();
+
+    /// @brief Check whether the buffer is opened
+    bool is_open() const;
+
+    /// @brief Format of the stream, detected on the first read if opened as automatic
+    zlib_format format() const;
+
+    /// @brief Check whether the compressed stream is damaged or truncated
+    /// The data decompressed before the damage is still delivered
+    bool failed() const;
+
+    /// @brief Next (up to max_length) decompressed bytes without copying, advances the read position
+    /// The view refers the get area, or the source window in pass-through mode,
+    /// and stays valid until the next read. Empty view means the end of stream or the error
+    byte_view next_window(size_t max_length = static_cast<size_t>(-1));
+
+protected:
+
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+
+    /// Common part of open()
+    void start(zlib_format format, size_t buffer_size);
+
+    /// Take the next input window if the current one is consumed
+    /// @return: false at the end of source
+    bool fill_input();
+
+    /// Choose the format by the first bytes of input and initialize inflate
+    bool detect();
+
+    /// Inflate or copy up to size bytes into the destination
+    /// @return: bytes produced, 0 at the end of stream or on error
+    size_t produce(std::uint8_t* destination, size_t size);
+
+    std::basic_streambuf<std::uint8_t>* source_ = nullptr;
+
+    /// The source taken by windows, without copying
+    byte_istreambuf* windows_ = nullptr;
+
+    /// Unconsumed part of the input window
+    byte_view input_;
+    bool input_end_ = false;
+
+    /// Read block of the source which does not give windows
+    aligned_buffer input_buffer_;
+
+    /// First bytes collected for the format detection, if the first windows are too short
+    std::vector<std::uint8_t> head_;
+
+    /// Get area
+    aligned_buffer buffer_;
+    size_t buffer_size_ = 0;
+
+    std::unique_ptr<z_stream_s> stream_;
+    zlib_format format_ = zlib_format::automatic;
+    bool detected_ = false;
+    bool finished_ = false;
+    bool failed_ = false;
+
+    /// Stream offset of eback()
+    std::uint64_t buffer_offset_ = 0;
+};
+
+
+/// @brief Compressing output buffer, works with std::basic_ostream<uint8_t>
+/// Collects the writes in the large put area and deflates them into the target buffer,
+/// large writes are deflated directly from the caller's memory
+class zlib_ostreambuf : public std::basic_streambuf<std::uint8_t>
+{
+public:
+
+    zlib_ostreambuf();
+
+    /// @brief Finish the stream
+    ~zlib_ostreambuf() override;
+
+    zlib_ostreambuf(const zlib_ostreambuf&) = delete;
+    zlib_ostreambuf& operator=(const zlib_ostreambuf&) = delete;
+
+    /// @brief Compress into the target, the target should outlive the buffer or its close()
+    /// @param level: zlib level, 1 is the fastest, 9 is the smallest, -1 is the default 6
+    /// @param buffer_size: size of the put area and of the compressed block written to the target
+    /// @return: false if the target is nullptr or zlib could not be initialized
+    bool open(std::basic_streambuf<std::uint8_t>* target, zlib_format format = zlib_format::gzip, int level = -1,
+        size_t buffer_size = byte_stream_buffer_size);
+
+    /// @brief Finish the stream and release zlib, the target is flushed but not closed
+    /// @return: false if the stream could not be written
+    bool close();
+
+    /// @brief Check whether the buffer is opened
+    bool is_open() const;
+
+protected:
+
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+
+    /// Flush is the zlib sync flush: everything written so far could be decompressed,
+    /// flushing often costs compression ratio
+    int sync() override;
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which = std::ios_base::out) override;
+
+private:
+
+    /// Compress the data with the zlib flush mode and write the output to the target
+    bool consume(const std::uint8_t* data, size_t size, int flush);
+
+    /// Compress the put area
+    bool flush_buffer(int flush);
+
+    std::basic_streambuf<std::uint8_t>* target_ = nullptr;
+
+    /// Put area
+    aligned_buffer buffer_;
+
+    /// Compressed block written to the target
+    aligned_buffer output_;
+    size_t buffer_size_ = 0;
+
+    std::unique_ptr<z_stream_s> stream_;
+    zlib_format format_ = zlib_format::gzip;
+    bool failed_ = false;
+
+    /// Stream offset of pbase()
+    std::uint64_t buffer_offset_ = 0;
+};
+
+
+/// @brief Decompressing input stream over zlib_istreambuf, e.g.
+/// byte_ifstream file(path, byte_read_mode::mapped); zlib_istream in(file);
+class zlib_istream : public std::basic_istream<std::uint8_t>
+{
+public:
+
+    /// Base class keeps only the pointer, so the buffer could be constructed later
+    zlib_istream() : std::basic_istream<std::uint8_t>(&buffer_) {}
+
+    explicit zlib_istream(std::basic_istream<std::uint8_t>& source, zlib_format format = zlib_format::automatic,
+        size_t buffer_size = byte_stream_buffer_size) : zlib_istream()
+    {
+        open(source, format, buffer_size);
+    }
+
+    /// @brief Decompress the source stream, set failbit on error
+    void open(std::basic_istream<std::uint8_t>& source, zlib_format format = zlib_format::automatic,
+        size_t buffer_size = byte_stream_buffer_size)
+    {
+        if (buffer_.open(source.rdbuf(), format, buffer_size)) {
+            clear();
+        }
+        else {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    void close()
+    {
+        buffer_.close();
+    }
+
+    bool is_open() const
+    {
+        return buffer_.is_open();
+    }
+
+    zlib_istreambuf* rdbuf() const
+    {
+        return const_cast<zlib_istreambuf*>(&buffer_);
+    }
+
+private:
+
+    zlib_istreambuf buffer_;
+};
+
+
+/// @brief Compressing output stream over zlib_ostreambuf, e.g.
+/// byte_ofstream file(path); zlib_ostream out(file); out.write(data, size); out.close();
+class zlib_ostream : public std::basic_ostream<std::uint8_t>
+{
+public:
+
+    /// Base class keeps only the pointer, so the buffer could be constructed later
+    zlib_ostream() : std::basic_ostream<std::uint8_t>(&buffer_) {}
+
+    explicit zlib_ostream(std::basic_ostream<std::uint8_t>& target, zlib_format format = zlib_format::gzip,
+        int level = -1, size_t buffer_size = byte_stream_buffer_size) : zlib_ostream()
+    {
+        open(target, format, level, buffer_size);
+    }
+
+    /// @brief Compress into the target stream, set failbit on error
+    void open(std::basic_ostream<std::uint8_t>& target, zlib_format format = zlib_format::gzip,
+        int level = -1, size_t buffer_size = byte_stream_buffer_size)
+    {
+        if (buffer_.open(target.rdbuf(), format, level, buffer_size)) {
+            clear();
+        }
+        else {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    /// @brief Finish the stream, set failbit if it could not be written
+    void close()
+    {
+        if (!buffer_.close()) {
+            setstate(std::ios_base::failbit);
+        }
+    }
+
+    bool is_open() const
+    {
+        return buffer_.is_open();
+    }
+
+    zlib_ostreambuf* rdbuf() const
+    {
+        return const_cast<zlib_ostreambuf*>(&buffer_);
+    }
+
+private:
+
+    zlib_ostreambuf buffer_;
+};
+
+} // namespace helpers
@@ -1,27 +1,45 @@
 set(WINAPI_HELPERS_CPP
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/async_file_reader.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/bios.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/byte_streambuf.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/co_initializer.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/gzip_writer.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/one_instance.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/partition_information.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/physical_memory.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/process_helper.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/registry_helper.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/seekable_archive.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/service_helper.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_compression.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_helper.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_kv_store.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_pool.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_profiler.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_statement.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/sqlite3_system_tables.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/special_path_helper.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/system_information.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/user_information.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/utilities.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/utf_transcoder.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/win_partition_information.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/win_special_path_helper.cpp
   ${CMAKE_CURRENT_SOURCE_DIR}/src/win_user_information.cpp
+  ${CMAKE_CURRENT_SOURCE_DIR}/src/zlib_streambuf.cpp
 )
 
 set(WINAPI_HELPERS_H
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/async_file_reader.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/bios.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/byte_streambuf.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/byte_view.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/co_initializer.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/concurrent_handler_map.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/dynamic_handler_map.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/gzip_writer.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/handle_ptr.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/handler_statistics.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/hardware_information.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/md5.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/native_api_helper.h
@@ -30,16 +48,29 @@ set(WINAPI_HELPERS_H
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/physical_memory.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/process_helper.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/registry_helper.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/seekable_archive.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/service_helper.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/special_path_helper.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_batch_writer.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_compression.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_helper.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_kv_store.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_pool.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_profiler.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_statement.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/sqlite3_system_tables.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/static_handler_map.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/system_information.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/uint8_codecvt.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/user_information.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/utilities.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/utf_transcoder.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/win_errors.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/win_partition_information.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/win_ptrs.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/win_special_path_helper.h
   ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/win_user_information.h
+  ${CMAKE_CURRENT_SOURCE_DIR}/include/winapi-helpers/zlib_streambuf.h
 )
 
 set(WINAPI_HELPERS_SOURCES 
@@ -0,0 +1,702 @@
+#include <winapi-helpers/async_file_reader.h>
+#include <winapi-helpers/thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <memory>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#include <winapi-helpers/utf_transcoder.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HELPERS_IO_URING 1
+#endif
+#endif
+#endif
+#endif
+
+using namespace helpers;
+
+namespace {
+
+/// INVALID_HANDLE_VALUE under Windows, invalid descriptor under POSIX
+constexpr std::intptr_t invalid_file = -1;
+
+/// Single system call limit, DWORD under Windows, ssize_t under POSIX
+constexpr size_t max_io_chunk = size_t(1) << 30;
+
+/// More reads in flight give nothing but memory consumption
+constexpr size_t max_queue_depth = 256;
+
+/// Read result of one block
+struct read_completion
+{
+    /// Bytes read, less than requested only at the end of file
+    size_t bytes = 0;
+
+    /// OS error code, 0 on success
+    int error = 0;
+};
+
+#if defined(_WIN32) || defined(_WIN64)
+
+HANDLE to_handle(std::intptr_t file)
+{
+    return reinterpret_cast<HANDLE>(file);
+}
+
+std::intptr_t open_file(const std::string& path)
+{
+    std::wstring wide_path;
+    if (!utf8_to_wide(path.data(), path.size(), wide_path)) {
+        return invalid_file;
+    }
+
+    // synchronous handle, ReadFile() with OVERLAPPED offset is the positional read
+    return reinterpret_cast<std::intptr_t>(CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+}
+
+void close_file(std::intptr_t file)
+{
+    CloseHandle(to_handle(file));
+}
+
+std::int64_t file_size(std::intptr_t file)
+{
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(to_handle(file), &size)) {
+        return -1;
+    }
+    return size.QuadPart;
+}
+
+read_completion read_at(std::intptr_t file, std::uint8_t* buffer, std::uint64_t offset, size_t size)
+{
+    read_completion result;
+    while (result.bytes < size) {
+        const std::uint64_t position = offset + result.bytes;
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+        DWORD chunk = 0;
+        if (!ReadFile(to_handle(file), buffer + result.bytes,
+            static_cast<DWORD>(std::min(size - result.bytes, max_io_chunk)), &chunk, &overlapped)) {
+            const DWORD error = GetLastError();
+            if (ERROR_HANDLE_EOF != error) {
+                result.error = static_cast<int>(error);
+            }
+            break;
+        }
+        if (0 == chunk) {
+            break;
+        }
+        result.bytes += chunk;
+    }
+    return result;
+}
+
+#else
+
+int to_descriptor(std::intptr_t file)
+{
+    return static_cast<int>(file);
+}
+
+std::intptr_t open_file(const std::string& path)
+{
+    const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (descriptor >= 0) {
+        ::posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return descriptor;
+}
+
+void close_file(std::intptr_t file)
+{
+    ::close(to_descriptor(file));
+}
+
+std::int64_t file_size(std::intptr_t file)
+{
+    struct stat info {};
+    if (0 != ::fstat(to_descriptor(file), &info)) {
+        return -1;
+    }
+    return static_cast<std::int64_t>(info.st_size);
+}
+
+read_completion read_at(std::intptr_t file, std::uint8_t* buffer, std::uint64_t offset, size_t size)
+{
+    read_completion result;
+    while (result.bytes < size) {
+        const ssize_t chunk = ::pread(to_descriptor(file), buffer + result.bytes,
+            std::min(size - result.bytes, max_io_chunk), static_cast<off_t>(offset + result.bytes));
+        if (chunk < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            result.error = errno;
+            break;
+        }
+        if (0 == chunk) {
+            break;
+        }
+        result.bytes += static_cast<size_t>(chunk);
+    }
+    return result;
+}
+
+#endif
+
+} // namespace
+
+
+/// @brief Backend interface, every block index has at most one read in flight
+class helpers::async_read_engine
+{
+public:
+
+    virtual ~async_read_engine() = default;
+
+    /// @brief Start reading of length bytes at offset into the buffer
+    virtual void submit(size_t index, std::uint8_t* buffer, std::uint64_t offset, size_t length) = 0;
+
+    /// @brief Wait for the read of the block
+    virtual read_completion wait(size_t index) = 0;
+};
+
+
+namespace {
+
+/// Blocking positional reads in the thread pool
+class pool_engine : public async_read_engine
+{
+public:
+
+    pool_engine(std::intptr_t file, size_t queue_depth, thread_pool* pool) :
+        file_(file),
+        pool_(pool),
+        reads_(queue_depth)
+    {
+        if (!pool_) {
+            own_pool_ = std::make_unique<thread_pool>(queue_depth);
+            pool_ = own_pool_.get();
+        }
+    }
+
+    void submit(size_t index, std::uint8_t* buffer, std::uint64_t offset, size_t length) override
+    {
+        // the read is claimed by the pool task or by wait(), whichever comes first; the task claimed
+        // by wait() returns at once, so it never touches the buffer after wait()
+        read& r = reads_[index];
+        r.claimed = std::make_shared<std::atomic<bool>>(false);
+        r.buffer = buffer;
+        r.offset = offset;
+        r.length = length;
+
+        const std::intptr_t file = file_;
+        const std::shared_ptr<std::atomic<bool>> claimed = r.claimed;
+        r.future = pool_->enqueue([file, buffer, offset, length, claimed] {
+            return claimed->exchange(true) ? read_completion() : read_at(file, buffer, offset, length);
+        });
+    }
+
+    read_completion wait(size_t index) override
+    {
+        // the read the pool has not started (busy, stopped or cleared pool) is done in the caller thread
+        read& r = reads_[index];
+        if (!r.claimed->exchange(true)) {
+            r.future = std::future<read_completion>();
+            return read_at(file_, r.buffer, r.offset, r.length);
+        }
+        return r.future.get();
+    }
+
+private:
+
+    struct read
+    {
+        std::future<read_completion> future;
+
+        /// Set by whichever of the pool task and wait() starts the read
+        std::shared_ptr<std::atomic<bool>> claimed;
+
+        std::uint8_t* buffer = nullptr;
+        std::uint64_t offset = 0;
+        size_t length = 0;
+    };
+
+    std::intptr_t file_;
+    thread_pool* pool_;
+    std::unique_ptr<thread_pool> own_pool_;
+    std::vector<read> reads_;
+};
+
+
+#if defined(HELPERS_IO_URING)
+
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring, to_submit, min_complete, flags, nullptr, 0));
+}
+
+/// Reads via io_uring submission and completion rings shared with the kernel
+/// Only this thread writes SQ tail and CQ head, the kernel writes SQ head and CQ tail
+class uring_engine : public async_read_engine
+{
+public:
+
+    uring_engine(std::intptr_t file, size_t queue_depth) :
+        file_(static_cast<int>(file)),
+        reads_(queue_depth)
+    {
+        io_uring_params params{};
+        ring_ = io_uring_setup(static_cast<unsigned>(queue_depth), &params);
+        if (ring_ < 0) {
+            return;
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = 0 != (params.features & IORING_FEAT_SINGLE_MMAP);
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = map_ring(sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = single_mmap ? sq_ring_ : map_ring(cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map_ring(sqes_size_, IORING_OFF_SQES));
+        if (!sq_ring_ || !cq_ring_ || !sqes_) {
+            release();
+            return;
+        }
+
+        sq_tail_ = ring_field(sq_ring_, params.sq_off.tail);
+        sq_mask_ = *ring_field(sq_ring_, params.sq_off.ring_mask);
+        sq_array_ = ring_field(sq_ring_, params.sq_off.array);
+        cq_head_ = ring_field(cq_ring_, params.cq_off.head);
+        cq_tail_ = ring_field(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *ring_field(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<std::uint8_t*>(cq_ring_) + params.cq_off.cqes);
+    }
+
+    ~uring_engine() override
+    {
+        release();
+    }
+
+    bool valid() const
+    {
+        return ring_ >= 0;
+    }
+
+    void submit(size_t index, std::uint8_t* buffer, std::uint64_t offset, size_t length) override
+    {
+        read& r = reads_[index];
+        r.buffer = buffer;
+        r.offset = offset;
+        r.length = length;
+        r.completion = read_completion();
+        r.complete = false;
+        push(index);
+
+        // entries not taken by the busy kernel stay queued until the next enter()
+        enter(0, 0);
+    }
+
+    read_completion wait(size_t index) override
+    {
+        read& r = reads_[index];
+        while (!r.complete) {
+            reap();
+            if (r.complete) {
+                break;
+            }
+            const int error = enter(1, IORING_ENTER_GETEVENTS);
+            if (0 != error && EAGAIN != error && EBUSY != error) {
+                r.completion.error = error;
+                r.complete = true;
+            }
+        }
+        return r.completion;
+    }
+
+private:
+
+    struct read
+    {
+        std::uint8_t* buffer = nullptr;
+        std::uint64_t offset = 0;
+        size_t length = 0;
+
+        /// Kernel reads the vector until the completion
+        iovec vector{};
+
+        read_completion completion;
+        bool complete = true;
+    };
+
+    void* map_ring(size_t size, std::uint64_t offset)
+    {
+        void* ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_,
+            static_cast<off_t>(offset));
+        return (MAP_FAILED == ring) ? nullptr : ring;
+    }
+
+    static unsigned* ring_field(void* ring, std::uint32_t offset)
+    {
+        return reinterpret_cast<unsigned*>(static_cast<std::uint8_t*>(ring) + offset);
+    }
+
+    void release()
+    {
+        if (sqes_) {
+            ::munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_) {
+            ::munmap(sq_ring_, sq_ring_size_);
+        }
+        if (ring_ >= 0) {
+            ::close(ring_);
+        }
+        sqes_ = nullptr;
+        sq_ring_ = cq_ring_ = nullptr;
+        ring_ = -1;
+    }
+
+    /// Queue the read of the rest of the block
+    void push(size_t index)
+    {
+        read& r = reads_[index];
+        r.vector.iov_base = r.buffer + r.completion.bytes;
+        r.vector.iov_len = std::min(r.length - r.completion.bytes, max_io_chunk);
+
+        const unsigned tail = *sq_tail_;
+        const unsigned slot = tail & sq_mask_;
+        io_uring_sqe& sqe = sqes_[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = file_;
+        sqe.off = r.offset + r.completion.bytes;
+        sqe.addr = reinterpret_cast<std::uint64_t>(&r.vector);
+        sqe.len = 1;
+        sqe.user_data = index;
+        sq_array_[slot] = slot;
+
+        // the kernel sees the entry only after the tail is published
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted_;
+    }
+
+    /// Submit queued entries, wait for min_complete completions if GETEVENTS flag is passed
+    /// @return: errno, 0 on success
+    int enter(unsigned min_complete, unsigned flags)
+    {
+        int submitted = 0;
+        do {
+            submitted = io_uring_enter(ring_, unsubmitted_, min_complete, flags);
+        } while (submitted < 0 && EINTR == errno);
+
+        if (submitted < 0) {
+            return errno;
+        }
+        unsubmitted_ -= static_cast<unsigned>(submitted);
+        return 0;
+    }
+
+    /// Process all the completions, resubmit short reads
+    void reap()
+    {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            read& r = reads_[static_cast<size_t>(cqe.user_data)];
+            if (cqe.res < 0) {
+                if (-EINTR == cqe.res || -EAGAIN == cqe.res) {
+                    push(static_cast<size_t>(cqe.user_data));
+                    continue;
+                }
+                r.completion.error = -cqe.res;
+                r.complete = true;
+                continue;
+            }
+
+            r.completion.bytes += static_cast<size_t>(cqe.res);
+            if (0 == cqe.res || r.completion.bytes == r.length) {
+                r.complete = true;
+            }
+            else {
+                push(static_cast<size_t>(cqe.user_data));
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        if (unsubmitted_ > 0) {
+            enter(0, 0);
+        }
+    }
+
+    int file_;
+    int ring_ = -1;
+    std::vector<read> reads_;
+
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    /// Entries queued, but not consumed by the kernel yet
+    unsigned unsubmitted_ = 0;
+};
+
+#endif // HELPERS_IO_URING
+
+/// Create the engine of the requested backend, nullptr if it is unavailable
+std::unique_ptr<async_read_engine> make_engine(async_read_backend& backend, std::intptr_t file,
+    size_t queue_depth, thread_pool* pool)
+{
+#if defined(HELPERS_IO_URING)
+    if (async_read_backend::pool != backend) {
+        auto engine = std::make_unique<uring_engine>(file, queue_depth);
+        if (engine->valid()) {
+            backend = async_read_backend::io_uring;
+            return engine;
+        }
+    }
+#endif
+
+    if (async_read_backend::io_uring == backend) {
+        return nullptr;
+    }
+    backend = async_read_backend::pool;
+    return std::make_unique<pool_engine>(file, queue_depth, pool);
+}
+
+} // namespace
+
+
+async_file_reader::async_file_reader() = default;
+
+async_file_reader::~async_file_reader()
+{
+    close();
+}
+
+bool async_file_reader::open(const std::string& path, const async_read_options& options /*= async_read_options()*/)
+{
+    close();
+
+    file_ = open_file(path);
+    if (invalid_file == file_) {
+        return false;
+    }
+
+    const std::int64_t size = file_size(file_);
+    const size_t queue_depth = std::min(std::max<size_t>(options.queue_depth, 1), max_queue_depth);
+    backend_ = options.backend;
+    engine_ = (size < 0) ? nullptr : make_engine(backend_, file_, queue_depth, options.pool);
+    if (!engine_) {
+        close();
+        return false;
+    }
+
+    file_size_ = static_cast<std::uint64_t>(size);
+    block_size_ = std::min(std::max<size_t>(options.block_size, 1), max_io_chunk);
+    blocks_.resize(queue_depth);
+    for (block& b : blocks_) {
+        b.buffer = make_aligned_buffer(block_size_);
+    }
+    return seek(0);
+}
+
+void async_file_reader::close()
+{
+    if (engine_) {
+        drain();
+        engine_.reset();
+    }
+    blocks_.clear();
+
+    if (invalid_file != file_) {
+        close_file(file_);
+        file_ = invalid_file;
+    }
+    file_size_ = 0;
+    block_offset_ = 0;
+    next_offset_ = 0;
+    error_ = 0;
+}
+
+bool async_file_reader::is_open() const
+{
+    return invalid_file != file_;
+}
+
+std::uint64_t async_file_reader::size() const
+{
+    return file_size_;
+}
+
+async_read_backend async_file_reader::backend() const
+{
+    return backend_;
+}
+
+bool async_file_reader::seek(std::uint64_t offset)
+{
+    if (!engine_) {
+        return false;
+    }
+
+    drain();
+    next_offset_ = std::min(offset, file_size_);
+    block_offset_ = next_offset_;
+    head_ = 0;
+    delivered_ = static_cast<size_t>(-1);
+    error_ = 0;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        submit(i);
+    }
+    return true;
+}
+
+byte_view async_file_reader::next_block()
+{
+    if (!engine_) {
+        return byte_view();
+    }
+
+    // the consumer is done with the previous block, its buffer prefetches the next one
+    if (delivered_ < blocks_.size()) {
+        submit(delivered_);
+        delivered_ = static_cast<size_t>(-1);
+    }
+
+    block& b = blocks_[head_];
+    if (0 != error_ || !b.pending) {
+        return byte_view();
+    }
+
+    const read_completion completion = engine_->wait(head_);
+    b.pending = false;
+    if (0 != completion.error) {
+        error_ = completion.error;
+        return byte_view();
+    }
+
+    // the file is truncated after open(), stop there
+    if (completion.bytes < b.length) {
+        next_offset_ = file_size_;
+    }
+    if (0 == completion.bytes) {
+        return byte_view();
+    }
+
+    block_offset_ = b.offset;
+    delivered_ = head_;
+    head_ = (head_ + 1) % blocks_.size();
+    return byte_view(b.buffer.get(), completion.bytes);
+}
+
+std::uint64_t async_file_reader::block_offset() const
+{
+    return block_offset_;
+}
+
+bool async_file_reader::read(const callback& on_block)
+{
+    for (byte_view b = next_block(); !b.empty(); b = next_block()) {
+        if (!on_block(block_offset_, b)) {
+            return true;
+        }
+    }
+    return !failed();
+}
+
+bool async_file_reader::failed() const
+{
+    return 0 != error_;
+}
+
+int async_file_reader::error() const
+{
+    return error_;
+}
+
+bool async_file_reader::io_uring_available()
+{
+#if defined(HELPERS_IO_URING)
+    static const bool available = [] {
+        io_uring_params params{};
+        const int ring = io_uring_setup(1, &params);
+        if (ring < 0) {
+            return false;
+        }
+        ::close(ring);
+        return true;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+void async_file_reader::submit(size_t index)
+{
+    block& b = blocks_[index];
+    b.pending = false;
+    if (0 != error_ || next_offset_ >= file_size_) {
+        return;
+    }
+
+    b.offset = next_offset_;
+    b.length = static_cast<size_t>(std::min<std::uint64_t>(block_size_, file_size_ - next_offset_));
+    engine_->submit(index, b.buffer.get(), b.offset, b.length);
+    b.pending = true;
+    next_offset_ += b.length;
+}
+
+void async_file_reader::drain()
+{
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].pending) {
+            engine_->wait(i);
+            blocks_[i].pending = false;
+        }
+    }
+}
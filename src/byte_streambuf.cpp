@@ -0,0 +1,600 @@
+#include <winapi-helpers/byte_streambuf.h>
+#include <algorithm>
+#include <limits>
+#include <new>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#include <winapi-helpers/utf_transcoder.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+using namespace helpers;
+
+namespace {
+
+/// INVALID_HANDLE_VALUE under Windows, invalid descriptor under POSIX
+constexpr std::intptr_t invalid_file = -1;
+
+/// pbump() takes int, so the buffer should not exceed INT_MAX
+constexpr size_t max_buffer_size = size_t(1) << 30;
+
+/// Single system call limit, DWORD under Windows, ssize_t under POSIX
+constexpr size_t max_io_chunk = size_t(1) << 30;
+
+/// Reads and writes of this size already amortize the system call,
+/// copying them through the buffer only evicts the cache
+constexpr size_t direct_io_threshold = 64 * 1024;
+
+#if defined(_WIN32) || defined(_WIN64)
+
+HANDLE to_handle(std::intptr_t file)
+{
+    return reinterpret_cast<HANDLE>(file);
+}
+
+std::intptr_t open_file(const std::string& path, bool write, bool append)
+{
+    std::wstring wide_path;
+    if (!utf8_to_wide(path.data(), path.size(), wide_path)) {
+        return invalid_file;
+    }
+
+    HANDLE file = write ?
+        CreateFileW(wide_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) :
+        CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    return reinterpret_cast<std::intptr_t>(file);
+}
+
+void close_file(std::intptr_t file)
+{
+    CloseHandle(to_handle(file));
+}
+
+/// Read until the buffer is full or the end of file
+bool read_file(std::intptr_t file, std::uint8_t* buffer, size_t size, size_t& read)
+{
+    read = 0;
+    while (read < size) {
+        DWORD chunk = 0;
+        if (!ReadFile(to_handle(file), buffer + read, static_cast<DWORD>(std::min(size - read, max_io_chunk)), &chunk, nullptr)) {
+            return false;
+        }
+        if (0 == chunk) {
+            break;
+        }
+        read += chunk;
+    }
+    return true;
+}
+
+bool write_file(std::intptr_t file, const std::uint8_t* data, size_t size)
+{
+    size_t written = 0;
+    while (written < size) {
+        DWORD chunk = 0;
+        if (!WriteFile(to_handle(file), data + written, static_cast<DWORD>(std::min(size - written, max_io_chunk)), &chunk, nullptr)) {
+            return false;
+        }
+        written += chunk;
+    }
+    return true;
+}
+
+/// @return: new position or -1
+std::int64_t seek_file(std::intptr_t file, std::int64_t offset, std::ios_base::seekdir dir)
+{
+    LARGE_INTEGER distance{};
+    distance.QuadPart = offset;
+    LARGE_INTEGER position{};
+    const DWORD method = (std::ios_base::beg == dir) ? FILE_BEGIN : (std::ios_base::cur == dir) ? FILE_CURRENT : FILE_END;
+    if (!SetFilePointerEx(to_handle(file), distance, &position, method)) {
+        return -1;
+    }
+    return position.QuadPart;
+}
+
+std::int64_t file_size(std::intptr_t file)
+{
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(to_handle(file), &size)) {
+        return -1;
+    }
+    return size.QuadPart;
+}
+
+std::uint8_t* map_file(std::intptr_t file, size_t, void*& mapping_handle)
+{
+    mapping_handle = CreateFileMappingW(to_handle(file), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mapping_handle) {
+        return nullptr;
+    }
+
+    void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == view) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+    return static_cast<std::uint8_t*>(view);
+}
+
+void unmap_file(std::uint8_t* mapping, size_t, void*& mapping_handle)
+{
+    UnmapViewOfFile(mapping);
+    CloseHandle(mapping_handle);
+    mapping_handle = nullptr;
+}
+
+#else
+
+int to_descriptor(std::intptr_t file)
+{
+    return static_cast<int>(file);
+}
+
+std::intptr_t open_file(const std::string& path, bool write, bool append)
+{
+    // O_APPEND is not used, so that the appended file could be seeked
+    const int flags = write ? (O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC)) : O_RDONLY;
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return invalid_file;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (!write) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return fd;
+}
+
+void close_file(std::intptr_t file)
+{
+    ::close(to_descriptor(file));
+}
+
+/// Read until the buffer is full or the end of file
+bool read_file(std::intptr_t file, std::uint8_t* buffer, size_t size, size_t& read)
+{
+    read = 0;
+    while (read < size) {
+        ssize_t chunk = ::read(to_descriptor(file), buffer + read, std::min(size - read, max_io_chunk));
+        if (chunk < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        if (0 == chunk) {
+            break;
+        }
+        read += static_cast<size_t>(chunk);
+    }
+    return true;
+}
+
+bool write_file(std::intptr_t file, const std::uint8_t* data, size_t size)
+{
+    size_t written = 0;
+    while (written < size) {
+        ssize_t chunk = ::write(to_descriptor(file), data + written, std::min(size - written, max_io_chunk));
+        if (chunk < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(chunk);
+    }
+    return true;
+}
+
+/// @return: new position or -1
+std::int64_t seek_file(std::intptr_t file, std::int64_t offset, std::ios_base::seekdir dir)
+{
+    const int whence = (std::ios_base::beg == dir) ? SEEK_SET : (std::ios_base::cur == dir) ? SEEK_CUR : SEEK_END;
+    return static_cast<std::int64_t>(::lseek(to_descriptor(file), static_cast<off_t>(offset), whence));
+}
+
+std::int64_t file_size(std::intptr_t file)
+{
+    struct stat info{};
+    if (::fstat(to_descriptor(file), &info) != 0) {
+        return -1;
+    }
+    return static_cast<std::int64_t>(info.st_size);
+}
+
+std::uint8_t* map_file(std::intptr_t file, size_t size, void*&)
+{
+    void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, to_descriptor(file), 0);
+    if (MAP_FAILED == view) {
+        return nullptr;
+    }
+#if defined(MADV_SEQUENTIAL)
+    ::madvise(view, size, MADV_SEQUENTIAL);
+#endif
+    return static_cast<std::uint8_t*>(view);
+}
+
+void unmap_file(std::uint8_t* mapping, size_t size, void*&)
+{
+    ::munmap(mapping, size);
+}
+
+#endif
+
+} // namespace
+
+
+void helpers::aligned_buffer_deleter::operator()(std::uint8_t* buffer) const
+{
+    ::operator delete(buffer, std::align_val_t(byte_stream_buffer_alignment));
+}
+
+aligned_buffer helpers::make_aligned_buffer(size_t size)
+{
+    return aligned_buffer(static_cast<std::uint8_t*>(::operator new(size, std::align_val_t(byte_stream_buffer_alignment))));
+}
+
+
+byte_istreambuf::~byte_istreambuf()
+{
+    close();
+}
+
+bool byte_istreambuf::open(const std::string& path, byte_read_mode mode /*= byte_read_mode::buffered*/,
+    size_t buffer_size /*= byte_stream_buffer_size*/)
+{
+    close();
+    file_ = open_file(path, false, false);
+    if (invalid_file == file_) {
+        return false;
+    }
+
+    const std::int64_t size = file_size(file_);
+    if (size < 0) {
+        close();
+        return false;
+    }
+    file_size_ = static_cast<std::uint64_t>(size);
+
+    if (byte_read_mode::mapped == mode) {
+        if (file_size_ > std::numeric_limits<size_t>::max()) {
+            close();
+            return false;
+        }
+
+        // empty file could not be mapped, it is just an empty view
+        if (file_size_ > 0) {
+            mapping_ = map_file(file_, static_cast<size_t>(file_size_), mapping_handle_);
+            if (nullptr == mapping_) {
+                close();
+                return false;
+            }
+        }
+        setg(mapping_, mapping_, mapping_ + file_size_);
+        return true;
+    }
+
+    buffer_size_ = std::min(std::max<size_t>(buffer_size, 1), max_buffer_size);
+    buffer_ = make_aligned_buffer(buffer_size_);
+    buffer_offset_ = 0;
+    setg(buffer_.get(), buffer_.get(), buffer_.get());
+    return true;
+}
+
+void byte_istreambuf::close()
+{
+    if (nullptr != mapping_) {
+        unmap_file(mapping_, static_cast<size_t>(file_size_), mapping_handle_);
+        mapping_ = nullptr;
+    }
+    if (invalid_file != file_) {
+        close_file(file_);
+        file_ = invalid_file;
+    }
+    buffer_.reset();
+    buffer_size_ = 0;
+    buffer_offset_ = 0;
+    file_size_ = 0;
+    setg(nullptr, nullptr, nullptr);
+}
+
+bool byte_istreambuf::is_open() const
+{
+    return invalid_file != file_;
+}
+
+bool byte_istreambuf::is_mapped() const
+{
+    return is_open() && !buffer_;
+}
+
+std::uint64_t byte_istreambuf::size() const
+{
+    return file_size_;
+}
+
+byte_view byte_istreambuf::next_window(size_t max_length /*= static_cast<size_t>(-1)*/)
+{
+    if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+        return byte_view();
+    }
+
+    const size_t length = std::min(max_length, static_cast<size_t>(egptr() - gptr()));
+    byte_view window(gptr(), length);
+    setg(eback(), gptr() + length, egptr());
+    return window;
+}
+
+byte_view byte_istreambuf::mapped_view() const
+{
+    return (nullptr == mapping_) ? byte_view() : byte_view(mapping_, static_cast<size_t>(file_size_));
+}
+
+std::uint64_t byte_istreambuf::position() const
+{
+    return buffer_offset_ + static_cast<std::uint64_t>(gptr() - eback());
+}
+
+byte_istreambuf::int_type byte_istreambuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // mapped file has no more data, closed one has none
+    if (!buffer_) {
+        return traits_type::eof();
+    }
+
+    buffer_offset_ += static_cast<std::uint64_t>(egptr() - eback());
+    size_t read = 0;
+    if (!read_file(file_, buffer_.get(), buffer_size_, read) || 0 == read) {
+        setg(buffer_.get(), buffer_.get(), buffer_.get());
+        return traits_type::eof();
+    }
+
+    setg(buffer_.get(), buffer_.get(), buffer_.get() + read);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize byte_istreambuf::xsgetn(char_type* s, std::streamsize count)
+{
+    std::streamsize copied = 0;
+    while (copied < count) {
+        const std::streamsize available = egptr() - gptr();
+        if (available > 0) {
+            const std::streamsize length = std::min(available, count - copied);
+            traits_type::copy(s + copied, gptr(), static_cast<size_t>(length));
+            setg(eback(), gptr() + length, egptr());
+            copied += length;
+            continue;
+        }
+
+        if (!buffer_) {
+            break;
+        }
+
+        // large read goes directly into the destination, without copying through the buffer
+        const size_t remaining = static_cast<size_t>(count - copied);
+        if (remaining >= std::min(buffer_size_, direct_io_threshold)) {
+            buffer_offset_ += static_cast<std::uint64_t>(egptr() - eback());
+            setg(buffer_.get(), buffer_.get(), buffer_.get());
+
+            size_t read = 0;
+            read_file(file_, s + copied, remaining, read);
+            buffer_offset_ += read;
+            copied += static_cast<std::streamsize>(read);
+            break;
+        }
+
+        if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+            break;
+        }
+    }
+    return copied;
+}
+
+std::streamsize byte_istreambuf::showmanyc()
+{
+    if (!is_open() || position() >= file_size_) {
+        return -1;
+    }
+    return static_cast<std::streamsize>(file_size_ - position());
+}
+
+byte_istreambuf::pos_type byte_istreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which /*= std::ios_base::in*/)
+{
+    if (!is_open() || !(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+
+    const std::int64_t base = (std::ios_base::beg == dir) ? 0 :
+        (std::ios_base::cur == dir) ? static_cast<std::int64_t>(position()) : static_cast<std::int64_t>(file_size_);
+    return seekpos(pos_type(off_type(base + off)), which);
+}
+
+byte_istreambuf::pos_type byte_istreambuf::seekpos(pos_type pos,
+    std::ios_base::openmode which /*= std::ios_base::in*/)
+{
+    const std::int64_t target = static_cast<std::int64_t>(off_type(pos));
+    if (!is_open() || !(which & std::ios_base::in) || target < 0) {
+        return pos_type(off_type(-1));
+    }
+
+    if (!buffer_) {
+        if (static_cast<std::uint64_t>(target) > file_size_) {
+            return pos_type(off_type(-1));
+        }
+        setg(mapping_, mapping_ + target, mapping_ + file_size_);
+        return pos;
+    }
+
+    // inside the current block, tellg() always goes here, no system calls
+    const std::uint64_t block_end = buffer_offset_ + static_cast<std::uint64_t>(egptr() - eback());
+    if (static_cast<std::uint64_t>(target) >= buffer_offset_ && static_cast<std::uint64_t>(target) <= block_end) {
+        setg(eback(), eback() + (static_cast<std::uint64_t>(target) - buffer_offset_), egptr());
+        return pos;
+    }
+
+    if (seek_file(file_, target, std::ios_base::beg) < 0) {
+        return pos_type(off_type(-1));
+    }
+    buffer_offset_ = static_cast<std::uint64_t>(target);
+    setg(buffer_.get(), buffer_.get(), buffer_.get());
+    return pos;
+}
+
+
+byte_ostreambuf::~byte_ostreambuf()
+{
+    close();
+}
+
+bool byte_ostreambuf::open(const std::string& path, bool append /*= false*/,
+    size_t buffer_size /*= byte_stream_buffer_size*/)
+{
+    close();
+    file_ = open_file(path, true, append);
+    if (invalid_file == file_) {
+        return false;
+    }
+
+    const std::int64_t end = append ? seek_file(file_, 0, std::ios_base::end) : 0;
+    if (end < 0) {
+        close();
+        return false;
+    }
+
+    buffer_offset_ = static_cast<std::uint64_t>(end);
+    buffer_size_ = std::min(std::max<size_t>(buffer_size, 1), max_buffer_size);
+    buffer_ = make_aligned_buffer(buffer_size_);
+    setp(buffer_.get(), buffer_.get() + buffer_size_);
+    return true;
+}
+
+bool byte_ostreambuf::close()
+{
+    if (!is_open()) {
+        return true;
+    }
+
+    const bool flushed = flush_buffer();
+    close_file(file_);
+    file_ = invalid_file;
+    buffer_.reset();
+    buffer_size_ = 0;
+    buffer_offset_ = 0;
+    setp(nullptr, nullptr);
+    return flushed;
+}
+
+bool byte_ostreambuf::is_open() const
+{
+    return invalid_file != file_;
+}
+
+bool byte_ostreambuf::flush_buffer()
+{
+    const size_t size = static_cast<size_t>(pptr() - pbase());
+    if (0 == size) {
+        return true;
+    }
+
+    const bool written = write_file(file_, pbase(), size);
+    buffer_offset_ += size;
+    setp(buffer_.get(), buffer_.get() + buffer_size_);
+    return written;
+}
+
+byte_ostreambuf::int_type byte_ostreambuf::overflow(int_type ch)
+{
+    if (!is_open() || !flush_buffer()) {
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize byte_ostreambuf::xsputn(const char_type* s, std::streamsize count)
+{
+    if (!is_open() || count <= 0) {
+        return 0;
+    }
+
+    const bool direct = static_cast<size_t>(count) >= std::min(buffer_size_, direct_io_threshold);
+    if (!direct && count <= epptr() - pptr()) {
+        traits_type::copy(pptr(), s, static_cast<size_t>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+
+    if (!flush_buffer()) {
+        return 0;
+    }
+
+    // large write goes directly to the file, without copying through the buffer
+    if (direct) {
+        if (!write_file(file_, s, static_cast<size_t>(count))) {
+            return 0;
+        }
+        buffer_offset_ += static_cast<std::uint64_t>(count);
+        return count;
+    }
+
+    traits_type::copy(pptr(), s, static_cast<size_t>(count));
+    pbump(static_cast<int>(count));
+    return count;
+}
+
+int byte_ostreambuf::sync()
+{
+    if (!is_open()) {
+        return -1;
+    }
+    return flush_buffer() ? 0 : -1;
+}
+
+byte_ostreambuf::pos_type byte_ostreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which /*= std::ios_base::out*/)
+{
+    if (!is_open() || !(which & std::ios_base::out)) {
+        return pos_type(off_type(-1));
+    }
+
+    // tellp() does not flush
+    if (std::ios_base::cur == dir && 0 == off) {
+        return pos_type(off_type(buffer_offset_ + static_cast<std::uint64_t>(pptr() - pbase())));
+    }
+
+    if (!flush_buffer()) {
+        return pos_type(off_type(-1));
+    }
+
+    const std::int64_t position = seek_file(file_, static_cast<std::int64_t>(off), dir);
+    if (position < 0) {
+        return pos_type(off_type(-1));
+    }
+    buffer_offset_ = static_cast<std::uint64_t>(position);
+    return pos_type(off_type(position));
+}
+
+byte_ostreambuf::pos_type byte_ostreambuf::seekpos(pos_type pos,
+    std::ios_base::openmode which /*= std::ios_base::out*/)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
@@ -0,0 +1,285 @@
+#include <winapi-helpers/gzip_writer.h>
+#include <winapi-helpers/thread_pool.h>
+#include <zlib.h>
+#include <algorithm>
+#include <limits>
+
+using namespace helpers;
+
+namespace {
+
+/// Deflate window, the dictionary of a block is the tail of this size of the previous one
+constexpr size_t window_size = 32 * 1024;
+
+/// Empty stored block written by Z_SYNC_FLUSH, at most 5 bytes with the pending bits
+constexpr size_t sync_flush_size = 6;
+
+/// Member header: magic, deflate, no flags, no time, extra flags, unknown OS
+void make_header(int level, std::uint8_t (&header)[10])
+{
+    const std::uint8_t fields[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    std::copy(fields, fields + 10, header);
+
+    // the extra flags tell the slowest and the fastest levels
+    header[8] = (9 == level) ? 2 : (1 == level) ? 4 : 0;
+}
+
+/// 32-bit little-endian value
+void put_le32(std::uint8_t* out, std::uint32_t value)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+} // namespace
+
+
+gzip_writer::gzip_writer() = default;
+
+gzip_writer::~gzip_writer()
+{
+    close();
+}
+
+bool gzip_writer::open(const sink& output, const gzip_writer_options& options /*= gzip_writer_options()*/)
+{
+    close();
+
+    const size_t max_block_size = static_cast<size_t>(std::numeric_limits<int>::max());
+    if (!output || 0 == options.block_size || options.block_size > max_block_size ||
+        options.level < Z_DEFAULT_COMPRESSION || options.level > Z_BEST_COMPRESSION) {
+        return false;
+    }
+
+    options_ = options;
+    output_ = output;
+    pool_ = options_.pool;
+    if (!pool_) {
+        if (!own_pool_) {
+            own_pool_ = std::make_unique<thread_pool>();
+        }
+        pool_ = own_pool_.get();
+    }
+    if (0 == options_.queue_depth) {
+        options_.queue_depth = 2 * std::max<size_t>(pool_->threads_number(), 1);
+    }
+
+    crc_ = 0;
+    size_ = 0;
+    compressed_size_ = 0;
+    failed_ = false;
+    open_ = true;
+    previous_.reset();
+    current_ = std::make_shared<block>();
+    current_->input.reserve(options_.block_size);
+
+    std::uint8_t header[10];
+    make_header(options_.level, header);
+    emit(byte_view(header, sizeof(header)));
+    return !failed_;
+}
+
+bool gzip_writer::open(std::basic_ostream<std::uint8_t>& output,
+    const gzip_writer_options& options /*= gzip_writer_options()*/)
+{
+    return open([&output](byte_view data) {
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return output.good();
+    }, options);
+}
+
+bool gzip_writer::write(byte_view data)
+{
+    if (!open_ || failed_) {
+        return false;
+    }
+
+    while (!data.empty()) {
+        const size_t length = std::min(data.size(), options_.block_size - current_->input.size());
+        current_->input.insert(current_->input.end(), data.begin(), data.begin() + length);
+        data.remove_prefix(length);
+        size_ += length;
+        if (current_->input.size() == options_.block_size) {
+            submit(false);
+        }
+    }
+    return !failed_;
+}
+
+bool gzip_writer::close()
+{
+    if (!open_) {
+        return !failed_;
+    }
+
+    // the last block is queued even empty, it carries the final deflate block
+    submit(true);
+    while (!queue_.empty()) {
+        drain_one();
+    }
+
+    std::uint8_t trailer[8];
+    put_le32(trailer, crc_);
+    put_le32(trailer + 4, static_cast<std::uint32_t>(size_));
+    emit(byte_view(trailer, sizeof(trailer)));
+
+    open_ = false;
+    current_.reset();
+    previous_.reset();
+    return !failed_;
+}
+
+bool gzip_writer::is_open() const
+{
+    return open_;
+}
+
+bool gzip_writer::failed() const
+{
+    return failed_;
+}
+
+std::uint64_t gzip_writer::size() const
+{
+    return size_;
+}
+
+std::uint64_t gzip_writer::compressed_size() const
+{
+    return compressed_size_;
+}
+
+void gzip_writer::submit(bool last)
+{
+    // the oldest blocks are written first, so no more than queue_depth blocks are held
+    while (queue_.size() >= options_.queue_depth) {
+        drain_one();
+    }
+
+    std::shared_ptr<block> task = std::move(current_);
+    task->previous = std::move(previous_);
+    task->last = last;
+
+    // the task refers the block weakly: if the writer compresses the block itself,
+    // the task queued in the stopped pool does not keep it alive
+    std::future<bool> result;
+    if (!failed_) {
+        const int level = options_.level;
+        const std::weak_ptr<block> queued = task;
+        result = pool_->enqueue([queued, level] {
+            const std::shared_ptr<block> claimed = queued.lock();
+            return claimed && !claimed->claimed.exchange(true) && deflate_block(*claimed, level);
+        });
+    }
+    queue_.emplace_back(task, std::move(result));
+
+    previous_ = task;
+    if (!last) {
+        current_ = std::make_shared<block>();
+        current_->input.reserve(options_.block_size);
+    }
+}
+
+void gzip_writer::drain_one()
+{
+    std::shared_ptr<block> task = std::move(queue_.front().first);
+    std::future<bool> result = std::move(queue_.front().second);
+    queue_.pop_front();
+
+    // the pool which is stopped, busy or refused the task has not started the block, it is compressed here
+    bool compressed = false;
+    if (!task->claimed.exchange(true)) {
+        compressed = !failed_ && deflate_block(*task, options_.level);
+    }
+    else {
+        try {
+            compressed = result.get();
+        }
+        catch (const std::exception&) {
+            compressed = false;
+        }
+    }
+    if (!compressed) {
+        failed_ = true;
+    }
+    if (failed_) {
+        return;
+    }
+
+    emit(byte_view(task->output.data(), task->output.size()));
+    crc_ = static_cast<std::uint32_t>(crc32_combine(crc_, task->crc, static_cast<z_off_t>(task->input.size())));
+}
+
+void gzip_writer::emit(byte_view data)
+{
+    if (failed_ || data.empty()) {
+        return;
+    }
+    if (!output_(data)) {
+        failed_ = true;
+        return;
+    }
+    compressed_size_ += data.size();
+}
+
+bool gzip_writer::deflate_block(block& task, int level)
+{
+    const uInt length = static_cast<uInt>(task.input.size());
+    task.crc = static_cast<std::uint32_t>(crc32(0, task.input.data(), length));
+
+    z_stream stream = {};
+    if (Z_OK != deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) {
+        return false;
+    }
+
+    bool result = true;
+    if (task.previous && !task.previous->input.empty()) {
+        const std::vector<std::uint8_t>& dictionary = task.previous->input;
+        const size_t size = std::min(dictionary.size(), window_size);
+        result = Z_OK == deflateSetDictionary(&stream, dictionary.data() + dictionary.size() - size,
+            static_cast<uInt>(size));
+    }
+
+    // all but the last block end with the empty stored block, so the next one starts byte-aligned
+    const int flush = task.last ? Z_FINISH : Z_SYNC_FLUSH;
+    task.output.resize(deflateBound(&stream, length) + sync_flush_size);
+    stream.next_in = task.input.data();
+    stream.avail_in = length;
+    stream.next_out = task.output.data();
+    stream.avail_out = static_cast<uInt>(task.output.size());
+    while (result) {
+        const int status = deflate(&stream, flush);
+        if (task.last ? Z_STREAM_END == status : (Z_OK == status && 0 != stream.avail_out)) {
+            break;
+        }
+        if ((Z_OK != status && Z_BUF_ERROR != status) || 0 != stream.avail_out) {
+            result = false;
+            break;
+        }
+
+        // the bound is not exceeded in practice, the output grows just in case
+        task.output.resize(2 * task.output.size());
+        stream.next_out = task.output.data() + stream.total_out;
+        stream.avail_out = static_cast<uInt>(task.output.size() - stream.total_out);
+    }
+    task.output.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    // the dictionary is no longer needed, the chain of blocks is not kept alive
+    task.previous.reset();
+    return result;
+}
+
+bool helpers::gzip_compress(byte_view data, std::vector<std::uint8_t>& compressed,
+    const gzip_writer_options& options /*= gzip_writer_options()*/)
+{
+    compressed.clear();
+    gzip_writer writer;
+    const bool opened = writer.open([&compressed](byte_view piece) {
+        compressed.insert(compressed.end(), piece.begin(), piece.end());
+        return true;
+    }, options);
+    const bool written = opened && writer.write(data);
+    return writer.close() && written;
+}
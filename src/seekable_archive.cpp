@@ -0,0 +1,556 @@
+#include <winapi-helpers/seekable_archive.h>
+#include <zlib.h>
+#include <algorithm>
+#include <limits>
+
+using namespace helpers;
+
+namespace {
+
+/// Single deflate() or inflate() call limit, avail_in and avail_out are uInt
+constexpr size_t max_frame_size = size_t(1) << 30;
+
+/// Deflate expands the data at most 1032 times, larger frames in the index are damage
+constexpr std::uint64_t max_inflate_ratio = 1032;
+
+/// Index entry: uncompressed offset, compressed offset, CRC-32
+constexpr size_t entry_size = 20;
+
+/// Extra field is limited by 16-bit XLEN, including 4 bytes of the subfield header
+constexpr size_t max_entries_per_member = (0xFFFF - 4) / entry_size;
+
+/// Empty member: header, XLEN, subfield header, final empty deflate block, CRC-32 and ISIZE of nothing
+constexpr size_t empty_member_size = 10 + 2 + 4 + 2 + 8;
+
+/// Locator member keeps the index offset and the uncompressed size
+constexpr size_t locator_payload_size = 16;
+constexpr size_t locator_size = empty_member_size + locator_payload_size;
+
+/// Little-endian value of the given size
+void put_le(std::vector<std::uint8_t>& out, std::uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::uint64_t get_le(const std::uint8_t* in, size_t size)
+{
+    std::uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+/// Empty gzip member keeping the payload in the "SX" extra subfield, gunzip skips it
+void make_member(byte_view payload, std::vector<std::uint8_t>& member)
+{
+    // magic, deflate, FEXTRA, no time, no extra flags, unknown OS
+    const std::uint8_t header[10] = { 0x1F, 0x8B, 8, 4, 0, 0, 0, 0, 0, 0xFF };
+    member.assign(header, header + sizeof(header));
+    put_le(member, payload.size() + 4, 2);
+    member.push_back('S');
+    member.push_back('X');
+    put_le(member, payload.size(), 2);
+    member.insert(member.end(), payload.begin(), payload.end());
+
+    // final fixed block with the end code only, the checksum and the size of nothing are 0
+    member.push_back(3);
+    member.push_back(0);
+    member.insert(member.end(), 8, 0);
+}
+
+/// Check the empty member made by make_member() at the start of the data
+/// @return: size of the member, 0 if it is not such a member
+size_t parse_member(byte_view data, byte_view& payload)
+{
+    if (data.size() < empty_member_size || 0x1F != data[0] || 0x8B != data[1] || 8 != data[2] || 4 != data[3]) {
+        return 0;
+    }
+
+    const size_t extra_size = static_cast<size_t>(get_le(data.data() + 10, 2));
+    const size_t member_size = empty_member_size - 4 + extra_size;
+    if (extra_size < 4 || data.size() < member_size || 'S' != data[12] || 'X' != data[13] ||
+        get_le(data.data() + 14, 2) != extra_size - 4) {
+        return 0;
+    }
+
+    const byte_view tail = data.substr(12 + extra_size, 10);
+    if (3 != tail[0] || 0 != get_le(tail.data() + 1, 8) || 0 != tail[9]) {
+        return 0;
+    }
+    payload = data.substr(16, extra_size - 4);
+    return member_size;
+}
+
+} // namespace
+
+
+seekable_archive_writer::seekable_archive_writer() = default;
+
+seekable_archive_writer::~seekable_archive_writer()
+{
+    close();
+}
+
+bool seekable_archive_writer::open(const sink& output,
+    const seekable_archive_options& options /*= seekable_archive_options()*/)
+{
+    close();
+
+    if (!output || 0 == options.frame_size || options.frame_size > max_frame_size ||
+        options.level < Z_DEFAULT_COMPRESSION || options.level > Z_BEST_COMPRESSION) {
+        return false;
+    }
+
+    // every frame is the gzip member of its own, the stream is reset between them
+    stream_ = std::make_unique<z_stream_s>();
+    if (Z_OK != deflateInit2(stream_.get(), options.level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) {
+        stream_.reset();
+        return false;
+    }
+
+    output_ = output;
+    options_ = options;
+    frame_.clear();
+    frame_.reserve(options_.frame_size);
+    frames_.clear();
+    size_ = 0;
+    compressed_size_ = 0;
+    failed_ = false;
+    return true;
+}
+
+bool seekable_archive_writer::open(std::basic_ostream<std::uint8_t>& output,
+    const seekable_archive_options& options /*= seekable_archive_options()*/)
+{
+    return open([&output](byte_view data) {
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return output.good();
+    }, options);
+}
+
+bool seekable_archive_writer::write(byte_view data)
+{
+    if (!stream_ || failed_) {
+        return false;
+    }
+
+    while (!data.empty()) {
+        const size_t length = std::min(data.size(), options_.frame_size - frame_.size());
+        frame_.insert(frame_.end(), data.begin(), data.begin() + length);
+        data.remove_prefix(length);
+        size_ += length;
+        if (frame_.size() == options_.frame_size) {
+            write_frame();
+        }
+    }
+    return !failed_;
+}
+
+bool seekable_archive_writer::close()
+{
+    if (!stream_) {
+        return !failed_;
+    }
+
+    if (!frame_.empty()) {
+        write_frame();
+    }
+    deflateEnd(stream_.get());
+    stream_.reset();
+    std::vector<std::uint8_t>().swap(frame_);
+    std::vector<std::uint8_t>().swap(member_);
+
+    const std::uint64_t index_offset = compressed_size_;
+    std::vector<std::uint8_t> payload;
+    for (size_t first = 0; first < frames_.size() && !failed_; first += max_entries_per_member) {
+        const size_t last = std::min(frames_.size(), first + max_entries_per_member);
+        payload.clear();
+        for (size_t i = first; i < last; ++i) {
+            put_le(payload, frames_[i].offset, 8);
+            put_le(payload, frames_[i].compressed_offset, 8);
+            put_le(payload, frames_[i].crc, 4);
+        }
+        make_member(byte_view(payload.data(), payload.size()), member_);
+        emit(byte_view(member_.data(), member_.size()));
+    }
+
+    payload.clear();
+    put_le(payload, index_offset, 8);
+    put_le(payload, size_, 8);
+    make_member(byte_view(payload.data(), payload.size()), member_);
+    emit(byte_view(member_.data(), member_.size()));
+    return !failed_;
+}
+
+bool seekable_archive_writer::is_open() const
+{
+    return static_cast<bool>(stream_);
+}
+
+bool seekable_archive_writer::failed() const
+{
+    return failed_;
+}
+
+std::uint64_t seekable_archive_writer::size() const
+{
+    return size_;
+}
+
+std::uint64_t seekable_archive_writer::compressed_size() const
+{
+    return compressed_size_;
+}
+
+const std::vector<seekable_archive_frame>& seekable_archive_writer::frames() const
+{
+    return frames_;
+}
+
+void seekable_archive_writer::write_frame()
+{
+    if (failed_) {
+        frame_.clear();
+        return;
+    }
+
+    const uInt length = static_cast<uInt>(frame_.size());
+    seekable_archive_frame frame;
+    frame.offset = size_ - frame_.size();
+    frame.compressed_offset = compressed_size_;
+    frame.crc = static_cast<std::uint32_t>(crc32(0, frame_.data(), length));
+
+    // the bound includes the gzip header and trailer, so one call finishes the member
+    z_stream_s& stream = *stream_;
+    member_.resize(deflateBound(&stream, length));
+    stream.next_in = frame_.data();
+    stream.avail_in = length;
+    stream.next_out = member_.data();
+    stream.avail_out = static_cast<uInt>(member_.size());
+    const int status = deflate(&stream, Z_FINISH);
+    const size_t member_size = member_.size() - stream.avail_out;
+    frame_.clear();
+    if (Z_STREAM_END != status || Z_OK != deflateReset(&stream)) {
+        failed_ = true;
+        return;
+    }
+
+    emit(byte_view(member_.data(), member_size));
+    if (!failed_) {
+        frames_.push_back(frame);
+    }
+}
+
+void seekable_archive_writer::emit(byte_view data)
+{
+    if (failed_ || data.empty()) {
+        return;
+    }
+    if (!output_(data)) {
+        failed_ = true;
+        return;
+    }
+    compressed_size_ += data.size();
+}
+
+
+seekable_archive_istreambuf::seekable_archive_istreambuf() = default;
+
+seekable_archive_istreambuf::~seekable_archive_istreambuf()
+{
+    close();
+}
+
+bool seekable_archive_istreambuf::open(const std::string& path, byte_read_mode mode /*= byte_read_mode::mapped*/)
+{
+    close();
+    if (!file_.open(path, mode)) {
+        return false;
+    }
+
+    archive_ = file_.mapped_view();
+    archive_size_ = file_.size();
+    if (!read_index()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool seekable_archive_istreambuf::open(byte_view archive)
+{
+    close();
+    archive_ = archive;
+    archive_size_ = archive.size();
+    if (!read_index()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void seekable_archive_istreambuf::close()
+{
+    if (stream_) {
+        inflateEnd(stream_.get());
+        stream_.reset();
+    }
+    file_.close();
+    archive_ = byte_view();
+    archive_size_ = 0;
+    std::vector<std::uint8_t>().swap(compressed_);
+    frames_.clear();
+    size_ = 0;
+    index_offset_ = 0;
+    std::vector<std::uint8_t>().swap(frame_data_);
+    loaded_ = static_cast<size_t>(-1);
+    next_frame_ = 0;
+    buffer_offset_ = 0;
+    failed_ = false;
+    setg(nullptr, nullptr, nullptr);
+}
+
+bool seekable_archive_istreambuf::is_open() const
+{
+    return static_cast<bool>(stream_);
+}
+
+bool seekable_archive_istreambuf::failed() const
+{
+    return failed_;
+}
+
+std::uint64_t seekable_archive_istreambuf::size() const
+{
+    return size_;
+}
+
+const std::vector<seekable_archive_frame>& seekable_archive_istreambuf::frames() const
+{
+    return frames_;
+}
+
+byte_view seekable_archive_istreambuf::next_window(size_t max_length /*= static_cast<size_t>(-1)*/)
+{
+    if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+        return byte_view();
+    }
+
+    const size_t length = std::min(max_length, static_cast<size_t>(egptr() - gptr()));
+    byte_view window(gptr(), length);
+    setg(eback(), gptr() + length, egptr());
+    return window;
+}
+
+seekable_archive_istreambuf::int_type seekable_archive_istreambuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (!is_open() || next_frame_ >= frames_.size()) {
+        return traits_type::eof();
+    }
+
+    const size_t frame = next_frame_;
+    if (loaded_ != frame && !load_frame(frame)) {
+        return traits_type::eof();
+    }
+
+    std::uint8_t* data = frame_data_.data();
+    setg(data, data, data + frame_size(frame));
+    buffer_offset_ = frames_[frame].offset;
+    next_frame_ = frame + 1;
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize seekable_archive_istreambuf::showmanyc()
+{
+    const std::uint64_t position = buffer_offset_ + static_cast<std::uint64_t>(gptr() - eback());
+    if (!is_open() || position >= size_) {
+        return -1;
+    }
+    return static_cast<std::streamsize>(std::min<std::uint64_t>(size_ - position,
+        static_cast<std::uint64_t>(std::numeric_limits<std::streamsize>::max())));
+}
+
+seekable_archive_istreambuf::pos_type seekable_archive_istreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which /*= std::ios_base::in*/)
+{
+    if (!is_open() || !(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+
+    const std::int64_t position = static_cast<std::int64_t>(buffer_offset_) + (gptr() - eback());
+    std::int64_t base = 0;
+    switch (dir) {
+    case std::ios_base::beg:
+        base = 0;
+        break;
+    case std::ios_base::cur:
+        // tellg() should not decode the next frame
+        if (0 == off) {
+            return pos_type(off_type(position));
+        }
+        base = position;
+        break;
+    case std::ios_base::end:
+        base = static_cast<std::int64_t>(size_);
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+    return seekpos(pos_type(off_type(base + off)), which);
+}
+
+seekable_archive_istreambuf::pos_type seekable_archive_istreambuf::seekpos(pos_type pos,
+    std::ios_base::openmode which /*= std::ios_base::in*/)
+{
+    const std::int64_t target = static_cast<std::int64_t>(off_type(pos));
+    if (!is_open() || !(which & std::ios_base::in) || target < 0 || static_cast<std::uint64_t>(target) > size_) {
+        return pos_type(off_type(-1));
+    }
+
+    const std::uint64_t offset = static_cast<std::uint64_t>(target);
+    if (offset == size_) {
+        setg(nullptr, nullptr, nullptr);
+        buffer_offset_ = size_;
+        next_frame_ = frames_.size();
+        return pos;
+    }
+
+    // the last frame starting at or before the offset
+    const auto found = std::upper_bound(frames_.begin(), frames_.end(), offset,
+        [](std::uint64_t value, const seekable_archive_frame& frame) { return value < frame.offset; });
+    const size_t frame = static_cast<size_t>(found - frames_.begin()) - 1;
+    if (loaded_ != frame && !load_frame(frame)) {
+        return pos_type(off_type(-1));
+    }
+
+    std::uint8_t* data = frame_data_.data();
+    setg(data, data + (offset - frames_[frame].offset), data + frame_size(frame));
+    buffer_offset_ = frames_[frame].offset;
+    next_frame_ = frame + 1;
+    return pos;
+}
+
+bool seekable_archive_istreambuf::read_index()
+{
+    byte_view data;
+    byte_view payload;
+    if (archive_size_ < locator_size || !read_at(archive_size_ - locator_size, locator_size, data) ||
+        locator_size != parse_member(data, payload) || locator_payload_size != payload.size()) {
+        return false;
+    }
+
+    index_offset_ = get_le(payload.data(), 8);
+    size_ = get_le(payload.data() + 8, 8);
+    const std::uint64_t index_end = archive_size_ - locator_size;
+    if (index_offset_ > index_end || !read_at(index_offset_, static_cast<size_t>(index_end - index_offset_), data)) {
+        return false;
+    }
+
+    while (!data.empty()) {
+        const size_t member_size = parse_member(data, payload);
+        if (0 == member_size || 0 != payload.size() % entry_size) {
+            return false;
+        }
+        for (size_t i = 0; i < payload.size(); i += entry_size) {
+            seekable_archive_frame frame;
+            frame.offset = get_le(payload.data() + i, 8);
+            frame.compressed_offset = get_le(payload.data() + i + 8, 8);
+            frame.crc = static_cast<std::uint32_t>(get_le(payload.data() + i + 16, 4));
+            frames_.push_back(frame);
+        }
+        data.remove_prefix(member_size);
+    }
+
+    // the frames cover the data from the start without gaps, and the archive up to the index in order
+    if (frames_.empty() ? 0 != size_ : 0 != frames_.front().offset) {
+        return false;
+    }
+    size_t largest_frame = 0;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        const std::uint64_t end = (i + 1 < frames_.size()) ? frames_[i + 1].offset : size_;
+        const std::uint64_t compressed_end = (i + 1 < frames_.size()) ? frames_[i + 1].compressed_offset : index_offset_;
+        if (end <= frames_[i].offset || compressed_end <= frames_[i].compressed_offset ||
+            end - frames_[i].offset > max_frame_size ||
+            end - frames_[i].offset > (compressed_end - frames_[i].compressed_offset) * max_inflate_ratio) {
+            return false;
+        }
+        largest_frame = std::max(largest_frame, static_cast<size_t>(end - frames_[i].offset));
+    }
+
+    stream_ = std::make_unique<z_stream_s>();
+    if (Z_OK != inflateInit2(stream_.get(), 16 + MAX_WBITS)) {
+        stream_.reset();
+        return false;
+    }
+    frame_data_.resize(largest_frame);
+    return true;
+}
+
+bool seekable_archive_istreambuf::read_at(std::uint64_t offset, size_t length, byte_view& data)
+{
+    if (offset > archive_size_ || length > archive_size_ - offset) {
+        return false;
+    }
+    if (!archive_.empty()) {
+        data = archive_.substr(static_cast<size_t>(offset), length);
+        return true;
+    }
+
+    compressed_.resize(length);
+    if (file_.pubseekpos(pos_type(off_type(offset))) != pos_type(off_type(offset)) ||
+        file_.sgetn(compressed_.data(), static_cast<std::streamsize>(length)) != static_cast<std::streamsize>(length)) {
+        return false;
+    }
+    data = byte_view(compressed_.data(), length);
+    return true;
+}
+
+size_t seekable_archive_istreambuf::frame_size(size_t frame) const
+{
+    const std::uint64_t end = (frame + 1 < frames_.size()) ? frames_[frame + 1].offset : size_;
+    return static_cast<size_t>(end - frames_[frame].offset);
+}
+
+bool seekable_archive_istreambuf::load_frame(size_t frame)
+{
+    // the get area is overwritten, the read position is kept by the offset
+    buffer_offset_ += static_cast<std::uint64_t>(gptr() - eback());
+    setg(nullptr, nullptr, nullptr);
+    loaded_ = static_cast<size_t>(-1);
+
+    const std::uint64_t compressed_end = (frame + 1 < frames_.size()) ?
+        frames_[frame + 1].compressed_offset : index_offset_;
+    byte_view input;
+    if (!read_at(frames_[frame].compressed_offset,
+        static_cast<size_t>(compressed_end - frames_[frame].compressed_offset), input)) {
+        failed_ = true;
+        return false;
+    }
+
+    // the member should fill the frame exactly, inflate checks its CRC-32 and the index is checked too
+    const size_t size = frame_size(frame);
+    z_stream_s& stream = *stream_;
+    if (Z_OK != inflateReset(&stream)) {
+        failed_ = true;
+        return false;
+    }
+    stream.next_in = const_cast<Bytef*>(input.data());
+    stream.avail_in = static_cast<uInt>(std::min<size_t>(input.size(), std::numeric_limits<uInt>::max()));
+    stream.next_out = frame_data_.data();
+    stream.avail_out = static_cast<uInt>(size);
+    const int status = inflate(&stream, Z_FINISH);
+    if (Z_STREAM_END != status || 0 != stream.avail_out || stream.total_in != input.size() ||
+        crc32(0, frame_data_.data(), static_cast<uInt>(size)) != frames_[frame].crc) {
+        failed_ = true;
+        return false;
+    }
+
+    loaded_ = frame;
+    return true;
+}
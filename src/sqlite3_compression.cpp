@@ -0,0 +1,170 @@
+#include <winapi-helpers/sqlite3_compression.h>
+#include <sqlite3.h>
+#include <zlib.h>
+#include <algorithm>
+#include <limits>
+#include <new>
+
+using namespace helpers;
+
+namespace {
+
+/// Format tag: NUL, "ZB", version; text never starts with NUL, binary data starting with the tag is compressed anyway
+constexpr std::uint8_t blob_magic[] = { 0x00, 'Z', 'B', 0x01 };
+
+/// Tag and 64-bit little-endian original size
+constexpr size_t blob_header_size = sizeof(blob_magic) + 8;
+
+/// Deflate never compresses better than 1032:1, larger sizes are damaged headers
+constexpr std::uint64_t max_deflate_ratio = 1032;
+
+/// compress(x) and compress(x, level), the options of the registration are the user data
+void compress_function(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+    if (SQLITE_NULL == sqlite3_value_type(argv[0])) {
+        return;
+    }
+
+    sqlite3_compression_options options = *static_cast<const sqlite3_compression_options*>(sqlite3_user_data(context));
+    if (argc > 1) {
+        options.level = sqlite3_value_int(argv[1]);
+    }
+
+    const void* blob = sqlite3_value_blob(argv[0]);
+    const byte_view data(static_cast<const std::uint8_t*>(blob), static_cast<size_t>(sqlite3_value_bytes(argv[0])));
+    try {
+        std::vector<std::uint8_t> stored;
+        const int result = compress_blob(data, stored, options);
+        if (SQLITE_OK != result) {
+            sqlite3_result_error_code(context, result);
+            return;
+        }
+        sqlite3_result_blob64(context, stored.data(), stored.size(), SQLITE_TRANSIENT);
+    }
+    catch (const std::bad_alloc&) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void uncompress_function(sqlite3_context* context, int, sqlite3_value** argv)
+{
+    if (SQLITE_NULL == sqlite3_value_type(argv[0])) {
+        return;
+    }
+
+    const void* blob = sqlite3_value_blob(argv[0]);
+    const byte_view stored(static_cast<const std::uint8_t*>(blob), static_cast<size_t>(sqlite3_value_bytes(argv[0])));
+    try {
+        std::vector<std::uint8_t> data;
+        const int result = uncompress_blob(stored, data);
+        if (SQLITE_OK != result) {
+            sqlite3_result_error(context, "uncompress: damaged compressed blob", -1);
+            sqlite3_result_error_code(context, result);
+            return;
+        }
+        sqlite3_result_blob64(context, data.data(), data.size(), SQLITE_TRANSIENT);
+    }
+    catch (const std::bad_alloc&) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+void destroy_options(void* options)
+{
+    delete static_cast<sqlite3_compression_options*>(options);
+}
+
+} // namespace
+
+
+bool helpers::is_compressed_blob(byte_view stored)
+{
+    return stored.size() >= sizeof(blob_magic) && std::equal(blob_magic, blob_magic + sizeof(blob_magic), stored.begin());
+}
+
+int helpers::compress_blob(byte_view data, std::vector<std::uint8_t>& stored,
+    const sqlite3_compression_options& options /*= sqlite3_compression_options()*/)
+{
+    const bool tagged = is_compressed_blob(data);
+    if (!tagged && data.size() < options.threshold) {
+        stored.assign(data.begin(), data.end());
+        return SQLITE_OK;
+    }
+    if (data.size() > std::numeric_limits<uLong>::max()) {
+        return SQLITE_TOOBIG;
+    }
+
+    uLongf length = compressBound(static_cast<uLong>(data.size()));
+    stored.resize(blob_header_size + length);
+    std::copy(blob_magic, blob_magic + sizeof(blob_magic), stored.begin());
+    for (size_t i = 0; i < 8; ++i) {
+        stored[sizeof(blob_magic) + i] = static_cast<std::uint8_t>(static_cast<std::uint64_t>(data.size()) >> (8 * i));
+    }
+
+    const int result = compress2(stored.data() + blob_header_size, &length, data.data(),
+        static_cast<uLong>(data.size()), options.level);
+    if (Z_OK != result) {
+        stored.clear();
+        return (Z_MEM_ERROR == result) ? SQLITE_NOMEM : SQLITE_MISUSE;
+    }
+    stored.resize(blob_header_size + length);
+
+    // incompressible data is kept as is, unless it could be mistaken for the compressed one
+    if (!tagged && stored.size() >= data.size()) {
+        stored.assign(data.begin(), data.end());
+    }
+    return SQLITE_OK;
+}
+
+int helpers::uncompress_blob(byte_view stored, std::vector<std::uint8_t>& data)
+{
+    if (!is_compressed_blob(stored)) {
+        data.assign(stored.begin(), stored.end());
+        return SQLITE_OK;
+    }
+    if (stored.size() < blob_header_size) {
+        return SQLITE_CORRUPT;
+    }
+
+    std::uint64_t size = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        size |= static_cast<std::uint64_t>(stored[sizeof(blob_magic) + i]) << (8 * i);
+    }
+    const std::uint64_t compressed = stored.size() - blob_header_size;
+    if (size > compressed * max_deflate_ratio || size > std::numeric_limits<uLong>::max() ||
+        compressed > std::numeric_limits<uLong>::max()) {
+        return SQLITE_CORRUPT;
+    }
+
+    data.resize(static_cast<size_t>(size));
+    uLongf length = static_cast<uLongf>(size);
+    const int result = uncompress(data.data(), &length, stored.data() + blob_header_size, static_cast<uLong>(compressed));
+    if (Z_OK != result || length != size) {
+        data.clear();
+        return (Z_MEM_ERROR == result) ? SQLITE_NOMEM : SQLITE_CORRUPT;
+    }
+    return SQLITE_OK;
+}
+
+int helpers::register_compression_functions(sqlite3* db,
+    const sqlite3_compression_options& options /*= sqlite3_compression_options()*/)
+{
+    if (!db) {
+        return SQLITE_MISUSE;
+    }
+
+    // every registration owns its copy of the options, SQLite destroys it with the function
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+    for (int argc = 1; argc <= 2; ++argc) {
+        sqlite3_compression_options* copy = new (std::nothrow) sqlite3_compression_options(options);
+        if (!copy) {
+            return SQLITE_NOMEM;
+        }
+        const int result = sqlite3_create_function_v2(db, "compress", argc, flags, copy,
+            compress_function, nullptr, nullptr, destroy_options);
+        if (SQLITE_OK != result) {
+            return result;
+        }
+    }
+    return sqlite3_create_function_v2(db, "uncompress", 1, flags, nullptr, uncompress_function, nullptr, nullptr, nullptr);
+}
@@ -1,28 +1,82 @@
 #include <winapi-helpers/sqlite3_helper.h>
+#include <winapi-helpers/sqlite3_system_tables.h>
 #include <sqlite3.h>
+#include <algorithm>
+#include <cstring>
 
 using namespace helpers;
 
-sqlite3_helper::sqlite3_helper(const char* database_name) :
-    current_return_code_(sqlite3_open(database_name, &db_))
+sqlite3_open_options::sqlite3_open_options(sqlite3_profile profile /*= sqlite3_profile::defaults*/)
 {
+    switch (profile) {
+    case sqlite3_profile::bulk_load:
+        no_mutex = true;
+        journal_mode = "WAL";
+        synchronous = 0;
+        cache_size = -64 * 1024;
+        temp_store = 2;
+        busy_timeout_ms = 5000;
+        break;
+    case sqlite3_profile::read_mostly:
+        no_mutex = true;
+        journal_mode = "WAL";
+        synchronous = 1;
+        cache_size = -32 * 1024;
+        mmap_size = 256 * 1024 * 1024;
+        temp_store = 2;
+        busy_timeout_ms = 5000;
+        optimize_on_close = true;
+        break;
+    case sqlite3_profile::durable:
+        journal_mode = "WAL";
+        synchronous = 2;
+        busy_timeout_ms = 5000;
+        optimize_on_close = true;
+        break;
+    case sqlite3_profile::defaults:
+    default:
+        break;
+    }
+}
 
+
+sqlite3_helper::sqlite3_helper(const char* database_name)
+{
+    open(database_name);
+}
+
+sqlite3_helper::sqlite3_helper(const char* database_name, const sqlite3_open_options& options)
+{
+    open(database_name, options);
 }
 
 sqlite3_helper::sqlite3_helper(sqlite3_helper&& rhs) :
     db_(rhs.db_),
-    current_return_code_(rhs.current_return_code_)
+    current_return_code_(rhs.current_return_code_),
+    statement_cache_(std::move(rhs.statement_cache_)),
+    statement_cache_capacity_(rhs.statement_cache_capacity_),
+    optimize_on_close_(rhs.optimize_on_close_),
+    profiler_(std::move(rhs.profiler_))
 {
-    db_ = rhs.db_;
-    current_return_code_ = rhs.current_return_code_;
+    rhs.db_ = nullptr;
+    rhs.current_return_code_ = 0;
 }
 
 sqlite3_helper& sqlite3_helper::operator=(sqlite3_helper&& rhs)
 {
-    db_ = rhs.db_;
-    current_return_code_ = rhs.current_return_code_;
-    rhs.db_ = nullptr;
-    rhs.current_return_code_ = 0;
+    if (this != &rhs) {
+        if (db_) {
+            close();
+        }
+        db_ = rhs.db_;
+        current_return_code_ = rhs.current_return_code_;
+        statement_cache_ = std::move(rhs.statement_cache_);
+        statement_cache_capacity_ = rhs.statement_cache_capacity_;
+        optimize_on_close_ = rhs.optimize_on_close_;
+        profiler_ = std::move(rhs.profiler_);
+        rhs.db_ = nullptr;
+        rhs.current_return_code_ = 0;
+    }
     return (*this);
 }
 
@@ -33,25 +87,241 @@ sqlite3_helper::~sqlite3_helper()
 
 int sqlite3_helper::open(const char* database_name)
 {
-    current_return_code_ = sqlite3_open(database_name, &db_);
+    return open(database_name, sqlite3_open_options());
+}
+
+int sqlite3_helper::open(const char* database_name, const sqlite3_open_options& options)
+{
+    if (db_) {
+        close();
+    }
+
+    int flags = options.read_only ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (options.no_mutex) {
+        flags |= SQLITE_OPEN_NOMUTEX;
+    }
+    if (options.shared_cache) {
+        flags |= SQLITE_OPEN_SHAREDCACHE;
+    }
+
+    current_return_code_ = sqlite3_open_v2(database_name, &db_, flags, nullptr);
+    if (db_) {
+        statement_cache_ = std::make_unique<sqlite3_statement_cache>(db_, statement_cache_capacity_);
+    }
+    optimize_on_close_ = options.optimize_on_close;
+    if (SQLITE_OK != current_return_code_) {
+        return current_return_code_;
+    }
+    if (profiler_) {
+        profiler_->attach(db_);
+    }
+
+    if (options.busy_timeout_ms > 0) {
+        current_return_code_ = sqlite3_busy_timeout(db_, options.busy_timeout_ms);
+    }
+
+    // page size goes first, it could not be changed after the switch to WAL
+    std::string pragmas;
+    if (options.page_size > 0) {
+        pragmas += "PRAGMA page_size = " + std::to_string(options.page_size) + ";";
+    }
+    if (!options.journal_mode.empty()) {
+        pragmas += "PRAGMA journal_mode = " + options.journal_mode + ";";
+    }
+    if (options.synchronous >= 0) {
+        pragmas += "PRAGMA synchronous = " + std::to_string(options.synchronous) + ";";
+    }
+    if (0 != options.cache_size) {
+        pragmas += "PRAGMA cache_size = " + std::to_string(options.cache_size) + ";";
+    }
+    if (options.mmap_size >= 0) {
+        pragmas += "PRAGMA mmap_size = " + std::to_string(options.mmap_size) + ";";
+    }
+    if (options.temp_store >= 0) {
+        pragmas += "PRAGMA temp_store = " + std::to_string(options.temp_store) + ";";
+    }
+
+    if (SQLITE_OK == current_return_code_ && !pragmas.empty()) {
+        current_return_code_ = sqlite3_exec(db_, pragmas.c_str(), nullptr, nullptr, nullptr);
+    }
     return current_return_code_;
 }
 
 int sqlite3_helper::close()
 {
+    if (db_ && optimize_on_close_) {
+        sqlite3_exec(db_, "PRAGMA optimize", nullptr, nullptr, nullptr);
+    }
+
+    // statements in use keep the database opened, sqlite3_close() returns SQLITE_BUSY then
+    if (statement_cache_) {
+        statement_cache_->clear();
+    }
+
+    // the trace callback could not be unregistered from the closed database
+    if (profiler_) {
+        profiler_->attach(nullptr);
+    }
+
     current_return_code_ = sqlite3_close(db_);
     if (current_return_code_ == SQLITE_OK) {
         db_ = nullptr;
+        statement_cache_.reset();
+    }
+    else if (profiler_) {
+        profiler_->attach(db_);
+    }
+    return current_return_code_;
+}
+
+int sqlite3_helper::exec(const char* sql, sqlite3_callback callback /*= nullptr*/, void* context /*= nullptr*/)
+{
+    current_return_code_ = sqlite3_exec(db_, sql, callback, context, nullptr);
+    return current_return_code_;
+}
+
+sqlite3_statement sqlite3_helper::prepare(std::string_view sql)
+{
+    sqlite3_statement statement(db_, sql);
+    current_return_code_ = statement.get_last_error();
+    return statement;
+}
+
+sqlite3_statement sqlite3_helper::prepare_cached(std::string_view sql)
+{
+    if (!statement_cache_) {
+        return prepare(sql);
+    }
+
+    sqlite3_statement statement = statement_cache_->prepare(sql);
+    current_return_code_ = statement.get_last_error();
+    return statement;
+}
+
+void sqlite3_helper::set_statement_cache_capacity(size_t capacity)
+{
+    statement_cache_capacity_ = capacity;
+    if (statement_cache_) {
+        statement_cache_->set_capacity(capacity);
+    }
+}
+
+sqlite3_statement_cache* sqlite3_helper::statement_cache() const
+{
+    return statement_cache_.get();
+}
+
+int sqlite3_helper::backup_to(const char* path, int pages_per_step /*= 256*/, const backup_progress& progress /*= nullptr*/)
+{
+    sqlite3* destination = nullptr;
+    current_return_code_ = sqlite3_open_v2(path, &destination, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+    if (SQLITE_OK != current_return_code_) {
+        sqlite3_close(destination);
+        return current_return_code_;
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(destination, "main", db_, "main");
+    if (!backup) {
+        current_return_code_ = sqlite3_errcode(destination);
+        sqlite3_close(destination);
+        return current_return_code_;
+    }
+
+    int result = SQLITE_OK;
+    while (SQLITE_OK == result || SQLITE_BUSY == result || SQLITE_LOCKED == result) {
+        result = sqlite3_backup_step(backup, pages_per_step);
+        if (SQLITE_DONE == result) {
+            break;
+        }
+        if (progress && !progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup))) {
+            result = SQLITE_ABORT;
+            break;
+        }
+        // the other connection holds the lock, give it time to finish
+        if (SQLITE_BUSY == result || SQLITE_LOCKED == result) {
+            sqlite3_sleep(1);
+        }
+    }
+
+    const int finished = sqlite3_backup_finish(backup);
+    current_return_code_ = (SQLITE_DONE == result) ? finished : result;
+    sqlite3_close(destination);
+    return current_return_code_;
+}
+
+int sqlite3_helper::serialize(std::vector<std::uint8_t>& data, const char* schema /*= "main"*/)
+{
+    data.clear();
+    sqlite3_int64 size = 0;
+    unsigned char* content = sqlite3_serialize(db_, schema, &size, 0);
+    if (!content) {
+        // an empty database has no pages to serialize
+        current_return_code_ = (0 == size) ? SQLITE_OK : SQLITE_NOMEM;
+        return current_return_code_;
     }
+
+    data.assign(content, content + size);
+    sqlite3_free(content);
+    current_return_code_ = SQLITE_OK;
     return current_return_code_;
 }
 
-int sqlite3_helper::exec(const char* sql, sqlite3_callback callback /*= nullptr*/)
+int sqlite3_helper::deserialize(byte_view data, bool read_only /*= false*/, const char* schema /*= "main"*/)
 {
-    current_return_code_ = sqlite3_exec(db_, sql, callback, nullptr, nullptr);
+    // SQLite owns the copy and frees it on close
+    unsigned char* content = static_cast<unsigned char*>(sqlite3_malloc64(std::max<size_t>(data.size(), 1)));
+    if (!content) {
+        current_return_code_ = SQLITE_NOMEM;
+        return current_return_code_;
+    }
+    if (!data.empty()) {
+        std::memcpy(content, data.data(), data.size());
+    }
+
+    const unsigned flags = SQLITE_DESERIALIZE_FREEONCLOSE |
+        (read_only ? SQLITE_DESERIALIZE_READONLY : SQLITE_DESERIALIZE_RESIZEABLE);
+    const auto size = static_cast<sqlite3_int64>(data.size());
+    current_return_code_ = sqlite3_deserialize(db_, schema, content, size, size, flags);
     return current_return_code_;
 }
 
+sqlite3_profiler* sqlite3_helper::enable_profiling(const sqlite3_profiler_options& options /*= sqlite3_profiler_options()*/)
+{
+    if (!db_) {
+        return nullptr;
+    }
+    profiler_.reset();
+    profiler_ = std::make_unique<sqlite3_profiler>(db_, options);
+    return profiler_.get();
+}
+
+void sqlite3_helper::disable_profiling()
+{
+    profiler_.reset();
+}
+
+sqlite3_profiler* sqlite3_helper::profiler() const
+{
+    return profiler_.get();
+}
+
+int sqlite3_helper::register_system_tables()
+{
+    current_return_code_ = helpers::register_system_tables(db_);
+    return current_return_code_;
+}
+
+int sqlite3_helper::register_compression_functions(const sqlite3_compression_options& options /*= sqlite3_compression_options()*/)
+{
+    current_return_code_ = helpers::register_compression_functions(db_, options);
+    return current_return_code_;
+}
+
+sqlite3* sqlite3_helper::handle() const
+{
+    return db_;
+}
+
 sqlite3_helper::operator bool() const
 {
     return is_valid();
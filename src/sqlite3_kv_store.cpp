@@ -0,0 +1,403 @@
+#include <winapi-helpers/sqlite3_kv_store.h>
+#include <sqlite3.h>
+#include <algorithm>
+
+using namespace helpers;
+
+namespace {
+
+/// Quote the identifier for SQL text
+std::string quote(const std::string& identifier)
+{
+    std::string quoted = "\"";
+    for (char c : identifier) {
+        quoted += (c == '"') ? "\"\"" : std::string(1, c);
+    }
+    return quoted + "\"";
+}
+
+/// Value of the column as it was stored
+kv_value read_value(const sqlite3_row& row, int index)
+{
+    switch (row.type(index)) {
+    case SQLITE_INTEGER:
+        return row.as_int64(index);
+    case SQLITE_FLOAT:
+        return row.as_double(index);
+    case SQLITE_TEXT:
+        return std::string(row.as_text(index));
+    case SQLITE_BLOB:
+    {
+        const byte_view blob = row.as_blob(index);
+        return std::vector<std::uint8_t>(blob.begin(), blob.end());
+    }
+    default:
+        return kv_value();
+    }
+}
+
+/// Bind the value of the upsert statement
+int bind_value(sqlite3_statement& statement, int index, const kv_value& value)
+{
+    struct binder
+    {
+        sqlite3_statement& statement;
+        int index;
+
+        int operator()(std::monostate) const { return statement.bind(index, nullptr); }
+        int operator()(std::int64_t v) const { return statement.bind(index, v); }
+        int operator()(double v) const { return statement.bind(index, v); }
+        int operator()(const std::string& v) const { return statement.bind(index, std::string_view(v)); }
+        int operator()(const std::vector<std::uint8_t>& v) const
+        {
+            return statement.bind(index, byte_view(v.data(), v.size()));
+        }
+    };
+    return std::visit(binder{ statement, index }, value);
+}
+
+/// The least string greater than all the strings with the prefix, empty if there is no such string
+std::string prefix_end(std::string_view prefix)
+{
+    std::string end(prefix);
+    while (!end.empty() && static_cast<unsigned char>(end.back()) == 0xFF) {
+        end.pop_back();
+    }
+    if (!end.empty()) {
+        end.back() = static_cast<char>(static_cast<unsigned char>(end.back()) + 1);
+    }
+    return end;
+}
+
+} // namespace
+
+
+sqlite3_kv_store::~sqlite3_kv_store()
+{
+    close();
+}
+
+int sqlite3_kv_store::open(const char* database_name, const sqlite3_kv_options& options /*= sqlite3_kv_options()*/)
+{
+    close();
+
+    options_ = options;
+    const size_t shards_count = std::max<size_t>(options_.cache_shards, 1);
+    shard_capacity_ = (options_.cache_capacity + shards_count - 1) / shards_count;
+    shards_.clear();
+    for (size_t i = 0; i < shards_count; ++i) {
+        shards_.push_back(std::make_unique<cache_shard>());
+    }
+
+    // the store serializes access to the connection itself
+    sqlite3_open_options open_options = options_.open_options;
+    open_options.no_mutex = true;
+
+    int result = db_.open(database_name, open_options);
+    if (SQLITE_OK != result) {
+        db_.close();
+        return result;
+    }
+
+    const std::string table = quote(options_.table);
+    const std::string create_sql = "CREATE TABLE IF NOT EXISTS " + table +
+        " (key TEXT PRIMARY KEY NOT NULL, value) WITHOUT ROWID";
+    result = db_.execute(create_sql);
+    if (SQLITE_OK != result) {
+        db_.close();
+        return result;
+    }
+
+    select_sql_ = "SELECT value FROM " + table + " WHERE key = ?";
+    upsert_sql_ = "INSERT OR REPLACE INTO " + table + " (key, value) VALUES (?, ?)";
+    delete_sql_ = "DELETE FROM " + table + " WHERE key = ?";
+    scan_sql_ = "SELECT key, value FROM " + table + " WHERE key >= ?";
+    return result;
+}
+
+int sqlite3_kv_store::close()
+{
+    if (nullptr == db_.handle()) {
+        return SQLITE_OK;
+    }
+
+    const int result = flush();
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.clear();
+    }
+    shards_.clear();
+    db_.close();
+    return result;
+}
+
+kv_value sqlite3_kv_store::get_value(std::string_view key)
+{
+    kv_value value;
+    load(key, value);
+    return value;
+}
+
+bool sqlite3_kv_store::contains(std::string_view key)
+{
+    kv_value value;
+    load(key, value);
+    return !std::holds_alternative<std::monostate>(value);
+}
+
+int sqlite3_kv_store::put(std::string_view key, std::int64_t value)
+{
+    return store(key, value);
+}
+
+int sqlite3_kv_store::put(std::string_view key, double value)
+{
+    return store(key, value);
+}
+
+int sqlite3_kv_store::put(std::string_view key, std::string_view value)
+{
+    return store(key, std::string(value));
+}
+
+int sqlite3_kv_store::put(std::string_view key, const char* value)
+{
+    return store(key, std::string(value ? value : ""));
+}
+
+int sqlite3_kv_store::put(std::string_view key, byte_view value)
+{
+    return store(key, std::vector<std::uint8_t>(value.begin(), value.end()));
+}
+
+int sqlite3_kv_store::erase(std::string_view key)
+{
+    return store(key, kv_value());
+}
+
+int sqlite3_kv_store::scan(std::string_view prefix, const scan_callback& on_item)
+{
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    if (nullptr == db_.handle()) {
+        return SQLITE_MISUSE;
+    }
+
+    int result = flush_locked();
+    if (SQLITE_OK != result) {
+        return result;
+    }
+
+    const std::string end = prefix_end(prefix);
+    sqlite3_statement statement = end.empty() ?
+        db_.query(scan_sql_ + " ORDER BY key", prefix) :
+        db_.query(scan_sql_ + " AND key < ? ORDER BY key", prefix, std::string_view(end));
+
+    for (const sqlite3_row& row : statement) {
+        const std::string_view key = row.as_text(0);
+        if (!on_item(key, read_value(row, 1))) {
+            break;
+        }
+    }
+
+    result = statement.get_last_error();
+    statement.reset();
+    return (SQLITE_ROW == result || SQLITE_DONE == result) ? SQLITE_OK : result;
+}
+
+int sqlite3_kv_store::flush()
+{
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    if (nullptr == db_.handle()) {
+        return SQLITE_MISUSE;
+    }
+    return flush_locked();
+}
+
+size_t sqlite3_kv_store::pending() const
+{
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return pending_.size();
+}
+
+std::uint64_t sqlite3_kv_store::cache_hits() const
+{
+    std::uint64_t hits = 0;
+    for (const std::unique_ptr<cache_shard>& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        hits += shard->hits;
+    }
+    return hits;
+}
+
+std::uint64_t sqlite3_kv_store::cache_misses() const
+{
+    return cache_misses_;
+}
+
+int sqlite3_kv_store::get_last_error() const
+{
+    std::lock_guard<std::mutex> lock(db_mutex_);
+    return db_.get_last_error();
+}
+
+void sqlite3_kv_store::load(std::string_view key, kv_value& value)
+{
+    if (shards_.empty()) {
+        value = kv_value();
+        return;
+    }
+
+    cache_shard& shard = shard_of(key);
+    std::uint64_t generation = 0;
+    if (shard_capacity_ > 0) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            value = found->second->second;
+            ++shard.hits;
+            return;
+        }
+        generation = shard.generation;
+    }
+    ++cache_misses_;
+
+    // the buffer is checked and the database is read under the same lock as flush() moves
+    // writes from one to another, so the read sees the write in either of them
+    {
+        std::lock_guard<std::mutex> db_lock(db_mutex_);
+        bool buffered = false;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            auto found = pending_.find(std::string(key));
+            if (found != pending_.end()) {
+                value = found->second;
+                buffered = true;
+            }
+        }
+
+        if (!buffered) {
+            value = kv_value();
+            sqlite3_statement select = db_.query(select_sql_, key);
+            for (const sqlite3_row& row : select) {
+                value = read_value(row, 0);
+            }
+        }
+    }
+
+    // absent keys are cached too, so the repeated misses do not go to the database;
+    // the value read before a concurrent write to the shard may be stale and is not cached
+    if (shard_capacity_ > 0) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.generation == generation) {
+            cache(shard, key, value);
+        }
+    }
+}
+
+int sqlite3_kv_store::store(std::string_view key, kv_value value)
+{
+    if (shards_.empty()) {
+        return SQLITE_MISUSE;
+    }
+
+    // the write is buffered before it is cached, so a read missing the cache finds it in the buffer;
+    // the shard lock keeps the buffer and the cache in the same order of writes to the key
+    bool full = false;
+    cache_shard& shard = shard_of(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        {
+            std::lock_guard<std::mutex> pending_lock(pending_mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            if (pending_.empty()) {
+                pending_since_ = now;
+            }
+            pending_[std::string(key)] = value;
+            full = pending_.size() >= options_.flush_rows ||
+                (options_.max_delay.count() > 0 && now - pending_since_ >= options_.max_delay);
+        }
+
+        ++shard.generation;
+        if (shard_capacity_ > 0) {
+            cache(shard, key, value);
+        }
+    }
+
+    return full ? flush() : SQLITE_OK;
+}
+
+sqlite3_kv_store::cache_shard& sqlite3_kv_store::shard_of(std::string_view key)
+{
+    // the shard map hashes the key again, high bits are mixed in so shards do not follow its buckets
+    const size_t hash = std::hash<std::string_view>()(key);
+    return *shards_[((hash >> 16) ^ hash) % shards_.size()];
+}
+
+void sqlite3_kv_store::cache(cache_shard& shard, std::string_view key, const kv_value& value)
+{
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        found->second->second = value;
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        return;
+    }
+
+    shard.entries.emplace_front(std::string(key), value);
+    shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+    while (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+}
+
+int sqlite3_kv_store::flush_locked()
+{
+    std::unordered_map<std::string, kv_value> batch;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        batch.swap(pending_);
+    }
+    if (batch.empty()) {
+        return SQLITE_OK;
+    }
+
+    int result = db_.execute("BEGIN");
+    for (auto it = batch.begin(); it != batch.end() && SQLITE_OK == result; ++it) {
+        if (std::holds_alternative<std::monostate>(it->second)) {
+            result = db_.execute(delete_sql_, std::string_view(it->first));
+            continue;
+        }
+
+        sqlite3_statement upsert = db_.prepare_cached(upsert_sql_);
+        result = upsert.get_last_error();
+        if (SQLITE_OK == result) {
+            result = upsert.bind(1, std::string_view(it->first));
+        }
+        if (SQLITE_OK == result) {
+            result = bind_value(upsert, 2, it->second);
+        }
+        if (SQLITE_OK == result) {
+            result = upsert.execute();
+        }
+    }
+
+    if (SQLITE_OK == result) {
+        result = db_.execute("COMMIT");
+    }
+    if (SQLITE_OK == result) {
+        return result;
+    }
+
+    // the writes stay buffered for the next flush unless they are overwritten since;
+    // SQLite could have rolled the transaction back already on SQLITE_FULL or SQLITE_IOERR
+    if (0 == sqlite3_get_autocommit(db_.handle())) {
+        db_.execute("ROLLBACK");
+    }
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (pending_.empty()) {
+        pending_since_ = std::chrono::steady_clock::now();
+    }
+    pending_.merge(batch);
+    return result;
+}
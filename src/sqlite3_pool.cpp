@@ -0,0 +1,255 @@
+#include <winapi-helpers/sqlite3_pool.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <thread>
+
+using namespace helpers;
+
+sqlite3_pool::reader_lease::reader_lease(sqlite3_pool* pool, sqlite3_helper* connection) :
+    pool_(pool),
+    connection_(connection)
+{
+}
+
+sqlite3_pool::reader_lease::~reader_lease()
+{
+    release();
+}
+
+sqlite3_pool::reader_lease::reader_lease(reader_lease&& rhs) :
+    pool_(rhs.pool_),
+    connection_(rhs.connection_)
+{
+    rhs.pool_ = nullptr;
+    rhs.connection_ = nullptr;
+}
+
+sqlite3_pool::reader_lease& sqlite3_pool::reader_lease::operator=(reader_lease&& rhs)
+{
+    if (this != &rhs) {
+        release();
+        pool_ = rhs.pool_;
+        connection_ = rhs.connection_;
+        rhs.pool_ = nullptr;
+        rhs.connection_ = nullptr;
+    }
+    return (*this);
+}
+
+void sqlite3_pool::reader_lease::release()
+{
+    if (connection_) {
+        pool_->release_reader(connection_);
+        connection_ = nullptr;
+    }
+}
+
+
+sqlite3_pool::~sqlite3_pool()
+{
+    close();
+}
+
+int sqlite3_pool::open(const std::string& path, const sqlite3_pool_options& options /*= sqlite3_pool_options()*/)
+{
+    close();
+
+    // connections are used by one thread at a time, so they do not need SQLite mutexes;
+    // commits in WAL mode are consistent without fsync of every transaction
+    sqlite3_open_options writer_options;
+    writer_options.no_mutex = true;
+    writer_options.journal_mode = "WAL";
+    writer_options.synchronous = options.synchronous;
+    writer_options.busy_timeout_ms = options.busy_timeout_ms;
+
+    current_return_code_ = writer_.open(path.c_str(), writer_options);
+    if (SQLITE_OK != current_return_code_) {
+        writer_.close();
+        return current_return_code_;
+    }
+
+    // the mode is persistent, readers opened later use WAL too
+    bool wal = false;
+    for (const sqlite3_row& row : writer_.query("PRAGMA journal_mode")) {
+        wal = (row.as_text(0) == "wal");
+    }
+    if (!wal) {
+        current_return_code_ = writer_ ? SQLITE_ERROR : writer_.get_last_error();
+        writer_.close();
+        return current_return_code_;
+    }
+
+    sqlite3_open_options reader_options;
+    reader_options.read_only = true;
+    reader_options.no_mutex = true;
+    reader_options.busy_timeout_ms = options.busy_timeout_ms;
+
+    size_t readers_count = options.readers;
+    if (0 == readers_count) {
+        readers_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    readers_.resize(readers_count);
+    for (sqlite3_helper& reader : readers_) {
+        current_return_code_ = reader.open(path.c_str(), reader_options);
+        if (SQLITE_OK != current_return_code_) {
+            free_readers_.clear();
+            readers_.clear();
+            writer_.close();
+            return current_return_code_;
+        }
+        free_readers_.push_back(&reader);
+    }
+
+    writer_thread_ = std::make_unique<thread_pool>(1);
+    pool_ = options.pool;
+    if (!pool_) {
+        own_pool_ = std::make_unique<thread_pool>(readers_count);
+        pool_ = own_pool_.get();
+    }
+
+    opened_ = true;
+    return current_return_code_;
+}
+
+void sqlite3_pool::close()
+{
+    if (!opened_) {
+        return;
+    }
+
+    // threads waiting in acquire_reader() get empty leases
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        opened_ = false;
+    }
+    readers_condition_.notify_all();
+
+    // the writer runs tasks in order, so the last one finishes the queue
+    std::future<void> queued_writes = writer_thread_->enqueue([] {});
+    if (queued_writes.valid()) {
+        queued_writes.wait();
+    }
+    writer_thread_.reset();
+
+    // the own pool drops reads not started yet and joins the running ones
+    own_pool_.reset();
+    pool_ = nullptr;
+
+    std::unique_lock<std::mutex> lock(readers_mutex_);
+    readers_condition_.wait(lock, [this] { return free_readers_.size() == readers_.size(); });
+    free_readers_.clear();
+    readers_.clear();
+    lock.unlock();
+
+    writer_.close();
+}
+
+bool sqlite3_pool::is_open() const
+{
+    return opened_;
+}
+
+size_t sqlite3_pool::readers_count() const
+{
+    return readers_.size();
+}
+
+sqlite3_pool::reader_lease sqlite3_pool::acquire_reader()
+{
+    std::unique_lock<std::mutex> lock(readers_mutex_);
+    readers_condition_.wait(lock, [this] { return !opened_ || !free_readers_.empty(); });
+    if (!opened_) {
+        return reader_lease();
+    }
+
+    sqlite3_helper* connection = free_readers_.back();
+    free_readers_.pop_back();
+    return reader_lease(this, connection);
+}
+
+std::future<int> sqlite3_pool::write_coalesced(std::function<int(sqlite3_helper&)> f)
+{
+    if (!is_open()) {
+        return std::future<int>();
+    }
+
+    std::promise<int> result;
+    std::future<int> future = result.get_future();
+    bool first = false;
+    {
+        std::lock_guard<std::mutex> lock(coalesced_mutex_);
+        first = coalesced_.empty();
+        coalesced_.push_back(coalesced_write{ std::move(f), std::move(result) });
+    }
+
+    // the rest of writes join the batch until the writer takes it
+    if (first) {
+        writer_thread_->enqueue([this] { commit_coalesced(); });
+    }
+    return future;
+}
+
+int sqlite3_pool::get_last_error() const
+{
+    return current_return_code_;
+}
+
+void sqlite3_pool::commit_coalesced()
+{
+    std::vector<coalesced_write> batch;
+    {
+        std::lock_guard<std::mutex> lock(coalesced_mutex_);
+        batch.swap(coalesced_);
+    }
+
+    std::vector<int> results(batch.size(), SQLITE_OK);
+    std::vector<std::exception_ptr> errors(batch.size());
+
+    int transaction = writer_.exec("BEGIN");
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (SQLITE_OK != transaction) {
+            results[i] = transaction;
+            continue;
+        }
+
+        writer_.exec("SAVEPOINT coalesced_write");
+        try {
+            results[i] = batch[i].f(writer_);
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+
+        if (SQLITE_OK != results[i] || errors[i]) {
+            writer_.exec("ROLLBACK TO coalesced_write");
+        }
+        writer_.exec("RELEASE coalesced_write");
+    }
+
+    if (SQLITE_OK == transaction) {
+        transaction = writer_.exec("COMMIT");
+        if (SQLITE_OK != transaction) {
+            writer_.exec("ROLLBACK");
+        }
+    }
+
+    // successful writes are lost with the failed commit
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (errors[i]) {
+            batch[i].result.set_exception(errors[i]);
+        }
+        else {
+            batch[i].result.set_value(SQLITE_OK == results[i] ? transaction : results[i]);
+        }
+    }
+}
+
+void sqlite3_pool::release_reader(sqlite3_helper* connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        free_readers_.push_back(connection);
+    }
+    readers_condition_.notify_all();
+}
@@ -0,0 +1,206 @@
+#include <winapi-helpers/sqlite3_profiler.h>
+#include <sqlite3.h>
+#include <algorithm>
+
+using namespace helpers;
+
+namespace {
+
+/// Execution times kept per SQL text to estimate the percentile
+constexpr size_t samples_capacity = 1024;
+
+/// Read and reset the counter of the statement
+std::uint64_t take_status(sqlite3_stmt* stmt, int counter)
+{
+    return static_cast<std::uint64_t>(sqlite3_stmt_status(stmt, counter, 1));
+}
+
+} // namespace
+
+
+sqlite3_profiler::sqlite3_profiler(sqlite3* db, const sqlite3_profiler_options& options) :
+    options_(options)
+{
+    attach(db);
+}
+
+sqlite3_profiler::~sqlite3_profiler()
+{
+    attach(nullptr);
+}
+
+int sqlite3_profiler::attach(sqlite3* db)
+{
+    int result = SQLITE_OK;
+    if (db_ && db_ != db) {
+        result = sqlite3_trace_v2(db_, 0, nullptr, nullptr);
+    }
+    running_.clear();
+
+    db_ = db;
+    if (db_) {
+        const unsigned mask = SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | (options_.count_rows ? SQLITE_TRACE_ROW : 0);
+        result = sqlite3_trace_v2(db_, mask, &sqlite3_profiler::trace, this);
+    }
+    return result;
+}
+
+std::vector<sqlite3_query_stats> sqlite3_profiler::statistics() const
+{
+    std::vector<sqlite3_query_stats> result;
+    result.reserve(queries_.size());
+    for (const auto& q : queries_) {
+        result.push_back(q.second->stats);
+
+        std::vector<std::int64_t> samples = q.second->samples;
+        if (!samples.empty()) {
+            const size_t index = (samples.size() * 99 + 99) / 100 - 1;
+            std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+            result.back().p99_time = std::chrono::nanoseconds(samples[index]);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const sqlite3_query_stats& lhs, const sqlite3_query_stats& rhs) {
+        return lhs.total_time > rhs.total_time;
+    });
+    return result;
+}
+
+const std::deque<sqlite3_slow_query>& sqlite3_profiler::slow_queries() const
+{
+    return slow_queries_;
+}
+
+void sqlite3_profiler::reset()
+{
+    queries_.clear();
+    slow_queries_.clear();
+}
+
+const sqlite3_profiler_options& sqlite3_profiler::options() const
+{
+    return options_;
+}
+
+int sqlite3_profiler::trace(unsigned type, void* context, void* p, void* x)
+{
+    sqlite3_profiler* profiler = static_cast<sqlite3_profiler*>(context);
+    sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+    switch (type) {
+    case SQLITE_TRACE_STMT:
+        profiler->on_statement(stmt, static_cast<const char*>(x));
+        break;
+    case SQLITE_TRACE_ROW:
+        profiler->on_row(stmt);
+        break;
+    case SQLITE_TRACE_PROFILE:
+        profiler->on_profile(stmt);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void sqlite3_profiler::on_statement(sqlite3_stmt* stmt, const char* sql)
+{
+    // triggers report their statements as "-- comments" inside the execution of the outer one
+    if (sql && '-' == sql[0] && '-' == sql[1]) {
+        return;
+    }
+    running_[stmt] = execution{ std::chrono::steady_clock::now(), 0 };
+}
+
+void sqlite3_profiler::on_row(sqlite3_stmt* stmt)
+{
+    auto it = running_.find(stmt);
+    if (it != running_.end()) {
+        ++it->second.rows;
+    }
+}
+
+void sqlite3_profiler::on_profile(sqlite3_stmt* stmt)
+{
+    // SQLite time of the profile event has millisecond resolution, the own clock is used instead
+    const auto end = std::chrono::steady_clock::now();
+    auto it = running_.find(stmt);
+    if (it == running_.end()) {
+        return;
+    }
+    const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - it->second.start);
+
+    sqlite3_query_counters counters;
+    counters.rows_returned = it->second.rows;
+    counters.fullscan_steps = take_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP);
+    counters.sorts = take_status(stmt, SQLITE_STMTSTATUS_SORT);
+    counters.autoindex_rows = take_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX);
+    counters.vm_steps = take_status(stmt, SQLITE_STMTSTATUS_VM_STEP);
+    running_.erase(it);
+
+    const char* sql = sqlite3_sql(stmt);
+    const std::string_view key = sql ? sql : "";
+    auto found = queries_.find(key);
+    if (found == queries_.end()) {
+        auto q = std::make_unique<query>();
+        q->stats.sql = std::string(key);
+        const std::string_view stored = q->stats.sql;
+        found = queries_.emplace(stored, std::move(q)).first;
+    }
+
+    query& q = *found->second;
+    ++q.stats.executions;
+    q.stats.total_time += time;
+    q.stats.max_time = std::max(q.stats.max_time, time);
+    q.stats.counters.rows_returned += counters.rows_returned;
+    q.stats.counters.fullscan_steps += counters.fullscan_steps;
+    q.stats.counters.sorts += counters.sorts;
+    q.stats.counters.autoindex_rows += counters.autoindex_rows;
+    q.stats.counters.vm_steps += counters.vm_steps;
+    sample(q, time.count());
+
+    if (options_.slow_query_threshold.count() <= 0 || time < options_.slow_query_threshold) {
+        return;
+    }
+
+    sqlite3_slow_query slow;
+    slow.time = time;
+    slow.counters = counters;
+    if (options_.expand_slow_sql) {
+        // bindings are still there, the event comes from reset
+        char* expanded = sqlite3_expanded_sql(stmt);
+        slow.sql = expanded ? expanded : q.stats.sql;
+        sqlite3_free(expanded);
+    }
+    else {
+        slow.sql = q.stats.sql;
+    }
+
+    if (options_.on_slow_query) {
+        options_.on_slow_query(slow);
+        return;
+    }
+    if (0 == options_.slow_log_capacity) {
+        return;
+    }
+    if (slow_queries_.size() == options_.slow_log_capacity) {
+        slow_queries_.pop_front();
+    }
+    slow_queries_.push_back(std::move(slow));
+}
+
+void sqlite3_profiler::sample(query& q, std::int64_t nanoseconds)
+{
+    if (q.samples.size() < samples_capacity) {
+        q.samples.push_back(nanoseconds);
+        return;
+    }
+
+    // reservoir sampling keeps every execution in the sample with the same probability
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    const std::uint64_t index = random_ % q.stats.executions;
+    if (index < samples_capacity) {
+        q.samples[static_cast<size_t>(index)] = nanoseconds;
+    }
+}
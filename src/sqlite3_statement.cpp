@@ -0,0 +1,415 @@
+#include <winapi-helpers/sqlite3_statement.h>
+#include <winapi-helpers/sqlite3_compression.h>
+#include <sqlite3.h>
+#include <climits>
+#include <iterator>
+
+using namespace helpers;
+
+namespace {
+
+/// sqlite3_bind_text() and sqlite3_bind_blob() take int length
+bool fits_int(size_t length)
+{
+    return length <= static_cast<size_t>(INT_MAX);
+}
+
+} // namespace
+
+
+sqlite3_statement::sqlite3_statement(sqlite3* db, std::string_view sql)
+{
+    if (!fits_int(sql.size())) {
+        current_return_code_ = SQLITE_TOOBIG;
+        return;
+    }
+    current_return_code_ = sqlite3_prepare_v2(db, sql.data(), static_cast<int>(sql.size()), &stmt_, nullptr);
+}
+
+sqlite3_statement::sqlite3_statement(sqlite3_statement_cache* cache, sqlite3_statement_cache::entry_iterator cache_entry) :
+    stmt_(cache_entry->stmt),
+    cache_(cache),
+    cache_entry_(cache_entry)
+{
+}
+
+sqlite3_statement::~sqlite3_statement()
+{
+    release();
+}
+
+sqlite3_statement::sqlite3_statement(sqlite3_statement&& rhs) :
+    stmt_(rhs.stmt_),
+    cache_(rhs.cache_),
+    cache_entry_(rhs.cache_entry_),
+    current_return_code_(rhs.current_return_code_)
+{
+    rhs.stmt_ = nullptr;
+    rhs.cache_ = nullptr;
+    rhs.current_return_code_ = 0;
+}
+
+sqlite3_statement& sqlite3_statement::operator=(sqlite3_statement&& rhs)
+{
+    if (this != &rhs) {
+        release();
+        stmt_ = rhs.stmt_;
+        cache_ = rhs.cache_;
+        cache_entry_ = rhs.cache_entry_;
+        current_return_code_ = rhs.current_return_code_;
+        rhs.stmt_ = nullptr;
+        rhs.cache_ = nullptr;
+        rhs.current_return_code_ = 0;
+    }
+    return (*this);
+}
+
+int sqlite3_statement::bind(int index, int value)
+{
+    return check(sqlite3_bind_int(stmt_, index, value));
+}
+
+int sqlite3_statement::bind(int index, std::int64_t value)
+{
+    return check(sqlite3_bind_int64(stmt_, index, static_cast<sqlite3_int64>(value)));
+}
+
+int sqlite3_statement::bind(int index, double value)
+{
+    return check(sqlite3_bind_double(stmt_, index, value));
+}
+
+int sqlite3_statement::bind(int index, const char* value)
+{
+    return check(sqlite3_bind_text(stmt_, index, value, -1, SQLITE_TRANSIENT));
+}
+
+int sqlite3_statement::bind(int index, std::string_view value)
+{
+    if (!fits_int(value.size())) {
+        return check(SQLITE_TOOBIG);
+    }
+    return check(sqlite3_bind_text(stmt_, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT));
+}
+
+int sqlite3_statement::bind(int index, const std::string& value)
+{
+    return bind(index, std::string_view(value));
+}
+
+int sqlite3_statement::bind(int index, byte_view value)
+{
+    if (!fits_int(value.size())) {
+        return check(SQLITE_TOOBIG);
+    }
+    // NULL pointer binds NULL, empty blob should stay the empty blob
+    if (value.empty()) {
+        return check(sqlite3_bind_zeroblob(stmt_, index, 0));
+    }
+    return check(sqlite3_bind_blob(stmt_, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT));
+}
+
+int sqlite3_statement::bind(int index, const sqlite3_compressed_blob& value)
+{
+    std::vector<std::uint8_t> stored;
+    const int result = compress_blob(value.data, stored, value.options);
+    if (SQLITE_OK != result) {
+        return check(result);
+    }
+    return bind(index, byte_view(stored.data(), stored.size()));
+}
+
+int sqlite3_statement::bind(int index, std::nullptr_t)
+{
+    return check(sqlite3_bind_null(stmt_, index));
+}
+
+int sqlite3_statement::clear_bindings()
+{
+    return check(sqlite3_clear_bindings(stmt_));
+}
+
+int sqlite3_statement::step()
+{
+    return check(sqlite3_step(stmt_));
+}
+
+bool sqlite3_statement::next_row()
+{
+    return SQLITE_ROW == step();
+}
+
+int sqlite3_statement::reset()
+{
+    return check(sqlite3_reset(stmt_));
+}
+
+int sqlite3_statement::execute()
+{
+    int result = step();
+    while (SQLITE_ROW == result) {
+        result = step();
+    }
+
+    // reset() repeats the step() error, keep the first one
+    if (SQLITE_DONE != result) {
+        sqlite3_reset(stmt_);
+        return result;
+    }
+    return reset();
+}
+
+sqlite3_row_iterator sqlite3_statement::begin()
+{
+    return sqlite3_row_iterator(this);
+}
+
+sqlite3_row_iterator sqlite3_statement::end()
+{
+    return sqlite3_row_iterator();
+}
+
+template <>
+int sqlite3_statement::column<int>(int index) const
+{
+    return sqlite3_column_int(stmt_, index);
+}
+
+template <>
+std::int64_t sqlite3_statement::column<std::int64_t>(int index) const
+{
+    return static_cast<std::int64_t>(sqlite3_column_int64(stmt_, index));
+}
+
+template <>
+double sqlite3_statement::column<double>(int index) const
+{
+    return sqlite3_column_double(stmt_, index);
+}
+
+template <>
+std::string sqlite3_statement::column<std::string>(int index) const
+{
+    return std::string(column<std::string_view>(index));
+}
+
+template <>
+std::string_view sqlite3_statement::column<std::string_view>(int index) const
+{
+    // text first, then its size, as SQLite documentation requires
+    const unsigned char* text = sqlite3_column_text(stmt_, index);
+    if (!text) {
+        return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_column_bytes(stmt_, index)));
+}
+
+template <>
+byte_view sqlite3_statement::column<byte_view>(int index) const
+{
+    const void* blob = sqlite3_column_blob(stmt_, index);
+    if (!blob) {
+        return byte_view();
+    }
+    return byte_view(static_cast<const std::uint8_t*>(blob), static_cast<size_t>(sqlite3_column_bytes(stmt_, index)));
+}
+
+int sqlite3_statement::column_uncompressed(int index, std::vector<std::uint8_t>& value) const
+{
+    return uncompress_blob(column<byte_view>(index), value);
+}
+
+int sqlite3_statement::column_count() const
+{
+    return sqlite3_column_count(stmt_);
+}
+
+int sqlite3_statement::column_type(int index) const
+{
+    return sqlite3_column_type(stmt_, index);
+}
+
+const char* sqlite3_statement::column_name(int index) const
+{
+    return sqlite3_column_name(stmt_, index);
+}
+
+bool sqlite3_statement::is_null(int index) const
+{
+    return SQLITE_NULL == sqlite3_column_type(stmt_, index);
+}
+
+int sqlite3_statement::parameter_count() const
+{
+    return sqlite3_bind_parameter_count(stmt_);
+}
+
+const char* sqlite3_statement::sql() const
+{
+    return sqlite3_sql(stmt_);
+}
+
+sqlite3_stmt* sqlite3_statement::handle() const
+{
+    return stmt_;
+}
+
+sqlite3_statement::operator bool() const
+{
+    return (stmt_ != nullptr) && (current_return_code_ == SQLITE_OK);
+}
+
+int sqlite3_statement::get_last_error() const
+{
+    return current_return_code_;
+}
+
+const char* sqlite3_statement::get_last_error_message() const
+{
+    return sqlite3_errstr(current_return_code_);
+}
+
+void sqlite3_statement::release()
+{
+    if (!stmt_) {
+        return;
+    }
+
+    if (cache_) {
+        cache_->release(cache_entry_);
+    }
+    else {
+        sqlite3_finalize(stmt_);
+    }
+    stmt_ = nullptr;
+    cache_ = nullptr;
+}
+
+int sqlite3_statement::check(int return_code)
+{
+    current_return_code_ = (SQLITE_ROW == return_code || SQLITE_DONE == return_code) ? SQLITE_OK : return_code;
+    return return_code;
+}
+
+
+sqlite3_row_iterator::sqlite3_row_iterator(sqlite3_statement* statement) :
+    statement_(statement),
+    row_(statement)
+{
+    ++(*this);
+}
+
+sqlite3_row_iterator& sqlite3_row_iterator::operator++()
+{
+    // the statement failed to prepare or bind keeps its error code
+    if (statement_ && !(*statement_ && statement_->next_row())) {
+        statement_ = nullptr;
+    }
+    return (*this);
+}
+
+
+sqlite3_statement_cache::sqlite3_statement_cache(sqlite3* db, size_t capacity /*= default_capacity*/) :
+    db_(db),
+    capacity_(capacity)
+{
+}
+
+sqlite3_statement_cache::~sqlite3_statement_cache()
+{
+    clear();
+}
+
+sqlite3_statement sqlite3_statement_cache::prepare(std::string_view sql)
+{
+    auto it = index_.find(sql);
+    if (it != index_.end() && !it->second->in_use) {
+        ++hits_;
+        it->second->in_use = true;
+        in_use_.splice(in_use_.begin(), entries_, it->second);
+        return sqlite3_statement(this, it->second);
+    }
+
+    ++misses_;
+    if (!fits_int(sql.size())) {
+        sqlite3_statement failed;
+        failed.current_return_code_ = SQLITE_TOOBIG;
+        return failed;
+    }
+
+    // persistent flag tells SQLite the statement lives long, it avoids lookaside memory then
+    sqlite3_stmt* stmt = nullptr;
+    const int result = sqlite3_prepare_v3(db_, sql.data(), static_cast<int>(sql.size()),
+        SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+
+    // the same SQL is in use by the caller already, the second copy is not cached
+    if (!stmt || it != index_.end() || 0 == capacity_) {
+        sqlite3_statement statement;
+        statement.stmt_ = stmt;
+        statement.current_return_code_ = result;
+        return statement;
+    }
+
+    in_use_.push_front(entry{ std::string(sql), stmt, true });
+    index_.emplace(std::string_view(in_use_.front().sql), in_use_.begin());
+    sqlite3_statement statement(this, in_use_.begin());
+    statement.current_return_code_ = result;
+    return statement;
+}
+
+void sqlite3_statement_cache::clear()
+{
+    while (!entries_.empty()) {
+        erase(entries_.begin());
+    }
+}
+
+void sqlite3_statement_cache::set_capacity(size_t capacity)
+{
+    capacity_ = capacity;
+    evict();
+}
+
+size_t sqlite3_statement_cache::capacity() const
+{
+    return capacity_;
+}
+
+size_t sqlite3_statement_cache::size() const
+{
+    return entries_.size();
+}
+
+std::uint64_t sqlite3_statement_cache::hits() const
+{
+    return hits_;
+}
+
+std::uint64_t sqlite3_statement_cache::misses() const
+{
+    return misses_;
+}
+
+void sqlite3_statement_cache::release(entry_iterator statement)
+{
+    sqlite3_reset(statement->stmt);
+    sqlite3_clear_bindings(statement->stmt);
+
+    statement->in_use = false;
+    entries_.splice(entries_.begin(), in_use_, statement);
+    evict();
+}
+
+void sqlite3_statement_cache::evict()
+{
+    while (entries_.size() > capacity_) {
+        erase(std::prev(entries_.end()));
+    }
+}
+
+void sqlite3_statement_cache::erase(entry_iterator statement)
+{
+    index_.erase(std::string_view(statement->sql));
+    sqlite3_finalize(statement->stmt);
+    entries_.erase(statement);
+}
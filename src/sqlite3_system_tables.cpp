@@ -0,0 +1,1126 @@
+#include <winapi-helpers/sqlite3_system_tables.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <winapi-helpers/handle_ptr.h>
+#include <winapi-helpers/partition_information.h>
+#include <winapi-helpers/utilities.h>
+#include <Windows.h>
+#include <Tlhelp32.h>
+#include <Psapi.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include <fstream>
+
+extern char** environ;
+#endif
+
+using namespace helpers;
+
+namespace {
+
+/// Cursor streaming the rows of the system table, only the current row is kept
+class system_cursor : public sqlite3_vtab_cursor
+{
+public:
+
+    virtual ~system_cursor() = default;
+
+    /// Start the scan, key is the value of the pushed-down equality on the key column or nullptr
+    virtual void filter(sqlite3_value* key) = 0;
+
+    virtual void next() = 0;
+
+    virtual bool eof() const = 0;
+
+    virtual void column(sqlite3_context* context, int index) = 0;
+
+    sqlite3_int64 rowid() const
+    {
+        return rowid_;
+    }
+
+protected:
+
+    sqlite3_int64 rowid_ = 0;
+};
+
+/// Definition of the eponymous table
+struct system_table
+{
+    const char* name;
+    const char* schema;
+
+    /// Column of the equality push-down
+    int key_column;
+
+    /// Equality on the key selects one row at most
+    bool unique_key;
+
+    /// Rows of the full scan for the planner
+    sqlite3_int64 rows_estimate;
+
+    std::unique_ptr<system_cursor>(*open)();
+};
+
+struct system_vtab : sqlite3_vtab
+{
+    const system_table* table = nullptr;
+};
+
+void result_text(sqlite3_context* context, const std::string& text)
+{
+    sqlite3_result_text(context, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+}
+
+/// Integer value of the pushed-down key, false if the key could not be equal to an integer column
+bool integer_key(sqlite3_value* key, sqlite3_int64& value)
+{
+    if (SQLITE_INTEGER != sqlite3_value_numeric_type(key)) {
+        return false;
+    }
+    value = sqlite3_value_int64(key);
+    return true;
+}
+
+/// Text value of the pushed-down key, false for NULL
+bool text_key(sqlite3_value* key, std::string& value)
+{
+    const unsigned char* text = sqlite3_value_text(key);
+    if (!text) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(text), sqlite3_value_bytes(key));
+    return true;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+/// Read the small file of /proc or /sys, false if it does not exist
+bool read_file(const std::string& path, std::string& content)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    content.clear();
+    char buffer[4096];
+    ssize_t bytes = 0;
+    while ((bytes = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, static_cast<size_t>(bytes));
+    }
+    ::close(fd);
+    return bytes == 0;
+}
+
+/// Read the integer of the /sys attribute
+bool read_integer(const std::string& path, sqlite3_int64& value)
+{
+    std::string content;
+    if (!read_file(path, content) || content.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoll(content.c_str(), &end, 10);
+    return end != content.c_str();
+}
+
+bool is_number(const char* name)
+{
+    if (!*name) {
+        return false;
+    }
+    for (; *name; ++name) {
+        if (*name < '0' || *name > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Directory stream, entries are read one by one
+class directory
+{
+public:
+
+    ~directory()
+    {
+        close();
+    }
+
+    void open(const char* path)
+    {
+        close();
+        dir_ = ::opendir(path);
+    }
+
+    void close()
+    {
+        if (dir_) {
+            ::closedir(dir_);
+            dir_ = nullptr;
+        }
+    }
+
+    /// Next entry name, nullptr at the end
+    const char* next()
+    {
+        const dirent* entry = dir_ ? ::readdir(dir_) : nullptr;
+        if (!entry) {
+            close();
+            return nullptr;
+        }
+        return entry->d_name;
+    }
+
+private:
+
+    DIR* dir_ = nullptr;
+};
+
+/// processes: /proc/<pid>/stat, cmdline is read when selected
+class processes_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        single_ = (key != nullptr);
+        eof_ = false;
+        if (single_) {
+            // /proc/<tid> of a thread exists too, but readdir() lists processes only
+            sqlite3_int64 pid = 0;
+            eof_ = !integer_key(key, pid) || pid <= 0 || !is_process(pid) || !load(pid);
+            return;
+        }
+
+        proc_.open("/proc");
+        next();
+    }
+
+    void next() override
+    {
+        if (!single_) {
+            // processes could exit between readdir() and reading their stat
+            while (const char* name = proc_.next()) {
+                if (is_number(name) && load(std::strtoll(name, nullptr, 10))) {
+                    return;
+                }
+            }
+        }
+        eof_ = true;
+    }
+
+    bool eof() const override
+    {
+        return eof_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        switch (index) {
+        case 0:
+            sqlite3_result_int64(context, rowid_);
+            break;
+        case 1:
+            sqlite3_result_int64(context, ppid_);
+            break;
+        case 2:
+            result_text(context, name_);
+            break;
+        case 3:
+            sqlite3_result_text(context, &state_, 1, SQLITE_TRANSIENT);
+            break;
+        case 4:
+            sqlite3_result_int64(context, threads_);
+            break;
+        case 5:
+            sqlite3_result_int64(context, rss_pages_ * ::sysconf(_SC_PAGESIZE));
+            break;
+        case 6:
+            // arguments are separated by NUL, kernel threads have none
+            if (read_file("/proc/" + std::to_string(rowid_) + "/cmdline", buffer_) && !buffer_.empty()) {
+                while (!buffer_.empty() && buffer_.back() == '\0') {
+                    buffer_.pop_back();
+                }
+                std::replace(buffer_.begin(), buffer_.end(), '\0', ' ');
+                result_text(context, buffer_);
+            }
+            break;
+        }
+    }
+
+private:
+
+    /// Check whether the id is the thread group leader, Tgid of /proc/<pid>/status
+    bool is_process(sqlite3_int64 pid)
+    {
+        if (!read_file("/proc/" + std::to_string(pid) + "/status", buffer_)) {
+            return false;
+        }
+        const size_t tgid = buffer_.find("\nTgid:");
+        return tgid != std::string::npos && std::strtoll(buffer_.c_str() + tgid + 6, nullptr, 10) == pid;
+    }
+
+    /// Parse /proc/<pid>/stat: pid (comm) state ppid ... num_threads(20) ... rss(24)
+    bool load(sqlite3_int64 pid)
+    {
+        if (!read_file("/proc/" + std::to_string(pid) + "/stat", buffer_)) {
+            return false;
+        }
+
+        // comm could contain spaces and parentheses, it ends at the last ')'
+        const size_t open = buffer_.find('(');
+        const size_t close = buffer_.rfind(')');
+        if (open == std::string::npos || close == std::string::npos || close < open || close + 2 >= buffer_.size()) {
+            return false;
+        }
+        name_.assign(buffer_, open + 1, close - open - 1);
+        state_ = buffer_[close + 2];
+
+        // fields after the state, numbered from 4
+        const char* field = buffer_.c_str() + close + 3;
+        for (int number = 4; number <= 24 && *field; ++number) {
+            char* end = nullptr;
+            const long long value = std::strtoll(field, &end, 10);
+            if (4 == number) {
+                ppid_ = value;
+            }
+            else if (20 == number) {
+                threads_ = value;
+            }
+            else if (24 == number) {
+                rss_pages_ = value;
+            }
+            field = (*end == ' ') ? end + 1 : end;
+        }
+
+        rowid_ = pid;
+        return true;
+    }
+
+    directory proc_;
+    bool single_ = false;
+    bool eof_ = true;
+
+    std::string buffer_;
+    std::string name_;
+    char state_ = '?';
+    sqlite3_int64 ppid_ = 0;
+    sqlite3_int64 threads_ = 0;
+    sqlite3_int64 rss_pages_ = 0;
+};
+
+/// Decode octal escapes of /proc/self/mounts, e.g. \040 for space
+std::string unescape_mount_field(const std::string& field)
+{
+    std::string result;
+    result.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() && field[i + 1] >= '0' && field[i + 1] <= '3') {
+            result += static_cast<char>(((field[i + 1] - '0') << 6) | ((field[i + 2] - '0') << 3) | (field[i + 3] - '0'));
+            i += 3;
+        }
+        else {
+            result += field[i];
+        }
+    }
+    return result;
+}
+
+/// mounts: /proc/self/mounts, block device attributes and sizes are read when selected
+class mounts_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        filtered_ = (key != nullptr);
+        rowid_ = 0;
+        mounts_.close();
+        mounts_.clear();
+        if (filtered_ && !text_key(key, path_filter_)) {
+            eof_ = true;
+            return;
+        }
+
+        mounts_.open("/proc/self/mounts");
+        next();
+    }
+
+    void next() override
+    {
+        std::string line;
+        while (std::getline(mounts_, line)) {
+            // device path filesystem options dump pass
+            std::string fields[4];
+            size_t begin = 0;
+            for (std::string& field : fields) {
+                const size_t end = std::min(line.find(' ', begin), line.size());
+                field = line.substr(begin, end - begin);
+                begin = std::min(end + 1, line.size());
+            }
+
+            path_ = unescape_mount_field(fields[1]);
+            if (filtered_ && path_ != path_filter_) {
+                continue;
+            }
+            device_ = unescape_mount_field(fields[0]);
+            filesystem_ = fields[2];
+            options_ = fields[3];
+            stats_loaded_ = false;
+            ++rowid_;
+            eof_ = false;
+            return;
+        }
+        eof_ = true;
+    }
+
+    bool eof() const override
+    {
+        return eof_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        switch (index) {
+        case 0:
+            result_text(context, path_);
+            break;
+        case 1:
+            result_text(context, device_);
+            break;
+        case 2:
+            result_text(context, filesystem_);
+            break;
+        case 3:
+            result_text(context, options_);
+            break;
+        case 4:
+            result_text(context, placement());
+            break;
+        case 5:
+            disk_type(context);
+            break;
+        case 6:
+        case 7:
+        case 8:
+            if (load_stats()) {
+                const sqlite3_int64 blocks = (6 == index) ? stats_.f_blocks : (7 == index) ? stats_.f_bfree : stats_.f_bavail;
+                sqlite3_result_int64(context, blocks * static_cast<sqlite3_int64>(stats_.f_frsize));
+            }
+            break;
+        }
+    }
+
+private:
+
+    /// Block device directory of /sys, empty if the device is not a block device
+    std::string block_device() const
+    {
+        if (device_.compare(0, 5, "/dev/") != 0) {
+            return std::string();
+        }
+        const std::string name = device_.substr(device_.find_last_of('/') + 1);
+        return "/sys/class/block/" + name;
+    }
+
+    /// The attribute of the disk, partitions take it from the parent disk
+    bool read_disk_attribute(const std::string& attribute, sqlite3_int64& value) const
+    {
+        const std::string device = block_device();
+        return !device.empty() &&
+            (read_integer(device + "/" + attribute, value) || read_integer(device + "/../" + attribute, value));
+    }
+
+    std::string placement() const
+    {
+        static const char* const network[] = { "nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "afs", "9p", "fuse.sshfs" };
+        for (const char* type : network) {
+            if (filesystem_ == type) {
+                return "network";
+            }
+        }
+        if (filesystem_ == "iso9660" || filesystem_ == "udf") {
+            return "cdrom";
+        }
+        if (filesystem_ == "tmpfs" || filesystem_ == "ramfs" || filesystem_ == "devtmpfs") {
+            return "ram";
+        }
+
+        sqlite3_int64 removable = 0;
+        if (read_disk_attribute("removable", removable)) {
+            return removable ? "removable" : "fixed";
+        }
+        return "unknown";
+    }
+
+    void disk_type(sqlite3_context* context) const
+    {
+        sqlite3_int64 rotational = 0;
+        if (read_disk_attribute("queue/rotational", rotational)) {
+            sqlite3_result_text(context, rotational ? "hdd" : "ssd", -1, SQLITE_STATIC);
+        }
+    }
+
+    /// statvfs() could block on the unavailable network mount, so it is called only for the size columns
+    bool load_stats()
+    {
+        if (!stats_loaded_) {
+            stats_loaded_ = true;
+            stats_valid_ = (0 == ::statvfs(path_.c_str(), &stats_));
+        }
+        return stats_valid_;
+    }
+
+    std::ifstream mounts_;
+    bool filtered_ = false;
+    std::string path_filter_;
+    bool eof_ = true;
+
+    std::string path_;
+    std::string device_;
+    std::string filesystem_;
+    std::string options_;
+
+    struct statvfs stats_ {};
+    bool stats_loaded_ = false;
+    bool stats_valid_ = false;
+};
+
+/// cpu_topology: /sys/devices/system/cpu/cpu<N>, offline CPUs have no topology
+class cpu_topology_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        single_ = (key != nullptr);
+        eof_ = false;
+        if (single_) {
+            sqlite3_int64 cpu = 0;
+            eof_ = !integer_key(key, cpu) || cpu < 0 || !load(cpu);
+            return;
+        }
+
+        cpus_.open("/sys/devices/system/cpu");
+        next();
+    }
+
+    void next() override
+    {
+        if (!single_) {
+            while (const char* name = cpus_.next()) {
+                if (std::strncmp(name, "cpu", 3) == 0 && is_number(name + 3) && load(std::strtoll(name + 3, nullptr, 10))) {
+                    return;
+                }
+            }
+        }
+        eof_ = true;
+    }
+
+    bool eof() const override
+    {
+        return eof_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        switch (index) {
+        case 0:
+            sqlite3_result_int64(context, rowid_);
+            break;
+        case 1:
+        case 2:
+        {
+            sqlite3_int64 id = 0;
+            if (read_integer(directory_ + (1 == index ? "topology/physical_package_id" : "topology/core_id"), id)) {
+                sqlite3_result_int64(context, id);
+            }
+            break;
+        }
+        case 3:
+        {
+            // CPUs which could not be taken offline have no such file
+            sqlite3_int64 online = 1;
+            read_integer(directory_ + "online", online);
+            sqlite3_result_int64(context, online);
+            break;
+        }
+        }
+    }
+
+private:
+
+    bool load(sqlite3_int64 cpu)
+    {
+        directory_ = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/";
+        if (0 != ::access(directory_.c_str(), F_OK)) {
+            return false;
+        }
+        rowid_ = cpu;
+        return true;
+    }
+
+    directory cpus_;
+    bool single_ = false;
+    bool eof_ = true;
+    std::string directory_;
+};
+
+char** environment()
+{
+    return environ;
+}
+
+#else // defined(_WIN32) || defined(_WIN64)
+
+/// processes: Toolhelp32 snapshot, rss is read when selected
+class processes_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        filtered_ = (key != nullptr);
+        eof_ = true;
+        sqlite3_int64 pid = 0;
+        if (filtered_ && !integer_key(key, pid)) {
+            return;
+        }
+        pid_filter_ = pid;
+
+        snapshot_.set_handle(CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0));
+        entry_ = PROCESSENTRY32W{};
+        entry_.dwSize = sizeof(entry_);
+        if (!snapshot_ || !Process32FirstW(snapshot_, &entry_)) {
+            return;
+        }
+        eof_ = false;
+        skip_filtered();
+    }
+
+    void next() override
+    {
+        eof_ = !Process32NextW(snapshot_, &entry_);
+        skip_filtered();
+    }
+
+    bool eof() const override
+    {
+        return eof_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        switch (index) {
+        case 0:
+            sqlite3_result_int64(context, entry_.th32ProcessID);
+            break;
+        case 1:
+            sqlite3_result_int64(context, entry_.th32ParentProcessID);
+            break;
+        case 2:
+            result_text(context, wstring_to_utf8(entry_.szExeFile));
+            break;
+        case 4:
+            sqlite3_result_int64(context, entry_.cntThreads);
+            break;
+        case 5:
+        {
+            // processes of other users could not be opened
+            WinHandlePtr process(OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, entry_.th32ProcessID));
+            PROCESS_MEMORY_COUNTERS counters{};
+            if (process && K32GetProcessMemoryInfo(process, &counters, sizeof(counters))) {
+                sqlite3_result_int64(context, static_cast<sqlite3_int64>(counters.WorkingSetSize));
+            }
+            break;
+        }
+        }
+    }
+
+private:
+
+    /// The snapshot has no lookup by pid, other processes are skipped without reading their details
+    void skip_filtered()
+    {
+        while (!eof_ && filtered_ && entry_.th32ProcessID != pid_filter_) {
+            eof_ = !Process32NextW(snapshot_, &entry_);
+        }
+        rowid_ = entry_.th32ProcessID;
+    }
+
+    WinHandlePtr snapshot_;
+    PROCESSENTRY32W entry_{};
+    bool filtered_ = false;
+    sqlite3_int64 pid_filter_ = 0;
+    bool eof_ = true;
+};
+
+/// mounts: partitions of PartititonInformation, file system and sizes are read when selected
+class mounts_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        std::string path;
+        partitions_.clear();
+        if (!key || text_key(key, path)) {
+            partitions_ = PartititonInformation::instance().enumerate_partititons();
+        }
+
+        // the collector enumerates drive letters at once, other paths are dropped before their details are read
+        if (key) {
+            partitions_.erase(std::remove_if(partitions_.begin(), partitions_.end(),
+                [&path](const PartititonInformation::PortablePartititon& p) { return wstring_to_utf8(p.root) != path; }),
+                partitions_.end());
+        }
+        rowid_ = 0;
+        sizes_loaded_ = false;
+    }
+
+    void next() override
+    {
+        ++rowid_;
+        sizes_loaded_ = false;
+    }
+
+    bool eof() const override
+    {
+        return static_cast<size_t>(rowid_) >= partitions_.size();
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        const PartititonInformation::PortablePartititon& partition = partitions_[static_cast<size_t>(rowid_)];
+        switch (index) {
+        case 0:
+            result_text(context, wstring_to_utf8(partition.root));
+            break;
+        case 1:
+            if (partition.drive_number >= 0) {
+                result_text(context, "\\\\.\\PhysicalDrive" + std::to_string(partition.drive_number));
+            }
+            break;
+        case 2:
+        {
+            wchar_t filesystem[MAX_PATH + 1] = {};
+            if (GetVolumeInformationW(partition.root.c_str(), nullptr, 0, nullptr, nullptr, nullptr, filesystem, MAX_PATH)) {
+                result_text(context, wstring_to_utf8(filesystem));
+            }
+            break;
+        }
+        case 4:
+            result_text(context, placement(partition.placement_type));
+            break;
+        case 5:
+            if (partition.disk_type != PartititonInformation::UnknownType) {
+                sqlite3_result_text(context, partition.disk_type == PartititonInformation::SSD ? "ssd" : "hdd", -1, SQLITE_STATIC);
+            }
+            break;
+        case 6:
+        case 7:
+        case 8:
+            if (load_sizes()) {
+                sqlite3_result_int64(context, static_cast<sqlite3_int64>(
+                    (6 == index) ? total_.QuadPart : (7 == index) ? free_.QuadPart : available_.QuadPart));
+            }
+            break;
+        }
+    }
+
+private:
+
+    static std::string placement(PartititonInformation::PlacementType type)
+    {
+        switch (type) {
+        case PartititonInformation::FixedDisk:
+            return "fixed";
+        case PartititonInformation::RemovebleDisk:
+            return "removable";
+        case PartititonInformation::NetworkDisk:
+            return "network";
+        case PartititonInformation::CDROM:
+            return "cdrom";
+        case PartititonInformation::RamDisk:
+            return "ram";
+        default:
+            return "unknown";
+        }
+    }
+
+    /// GetDiskFreeSpaceEx() could wait for the network drive, so it is called only for the size columns
+    bool load_sizes()
+    {
+        if (!sizes_loaded_) {
+            sizes_loaded_ = true;
+            sizes_valid_ = GetDiskFreeSpaceExW(partitions_[static_cast<size_t>(rowid_)].root.c_str(),
+                &available_, &total_, &free_) != FALSE;
+        }
+        return sizes_valid_;
+    }
+
+    std::vector<PartititonInformation::PortablePartititon> partitions_;
+    ULARGE_INTEGER total_{};
+    ULARGE_INTEGER free_{};
+    ULARGE_INTEGER available_{};
+    bool sizes_loaded_ = false;
+    bool sizes_valid_ = false;
+};
+
+/// cpu_topology: packages and cores of GetLogicalProcessorInformation(), CPUs of the process group
+class cpu_topology_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        DWORD length = 0;
+        GetLogicalProcessorInformation(nullptr, &length);
+        relations_.resize(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        length = static_cast<DWORD>(relations_.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        if (relations_.empty() || !GetLogicalProcessorInformation(relations_.data(), &length)) {
+            relations_.clear();
+        }
+
+        last_ = sizeof(ULONG_PTR) * 8;
+        rowid_ = -1;
+        sqlite3_int64 cpu = 0;
+        if (key) {
+            if (integer_key(key, cpu) && cpu >= 0 && cpu < last_) {
+                rowid_ = cpu - 1;
+                last_ = cpu + 1;
+            }
+            else {
+                last_ = 0;
+            }
+        }
+        next();
+    }
+
+    void next() override
+    {
+        // CPUs are the bits of core masks
+        for (++rowid_; rowid_ < last_; ++rowid_) {
+            if (index_of(RelationProcessorCore, core_) >= 0) {
+                return;
+            }
+        }
+    }
+
+    bool eof() const override
+    {
+        return rowid_ >= last_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        switch (index) {
+        case 0:
+            sqlite3_result_int64(context, rowid_);
+            break;
+        case 1:
+        {
+            sqlite3_int64 package = 0;
+            if (index_of(RelationProcessorPackage, package) >= 0) {
+                sqlite3_result_int64(context, package);
+            }
+            break;
+        }
+        case 2:
+            index_of(RelationProcessorCore, core_);
+            sqlite3_result_int64(context, core_);
+            break;
+        case 3:
+            sqlite3_result_int64(context, 1);
+            break;
+        }
+    }
+
+private:
+
+    /// Number of the relation of the type including the current CPU, -1 if there is no such relation
+    sqlite3_int64 index_of(LOGICAL_PROCESSOR_RELATIONSHIP type, sqlite3_int64& number) const
+    {
+        number = -1;
+        sqlite3_int64 counted = 0;
+        for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& relation : relations_) {
+            if (relation.Relationship != type) {
+                continue;
+            }
+            if (relation.ProcessorMask & (static_cast<ULONG_PTR>(1) << rowid_)) {
+                number = counted;
+                break;
+            }
+            ++counted;
+        }
+        return number;
+    }
+
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> relations_;
+    sqlite3_int64 last_ = 0;
+    sqlite3_int64 core_ = -1;
+};
+
+char** environment()
+{
+    return _environ;
+}
+
+#endif // defined(_WIN32) || defined(_WIN64)
+
+/// env: NAME=VALUE strings of the environment, the name is looked up by getenv()
+class env_cursor : public system_cursor
+{
+public:
+
+    void filter(sqlite3_value* key) override
+    {
+        single_ = (key != nullptr);
+        rowid_ = 0;
+        if (single_) {
+            const char* value = text_key(key, name_) ? std::getenv(name_.c_str()) : nullptr;
+            eof_ = (value == nullptr);
+            value_ = value ? value : "";
+            return;
+        }
+
+        variable_ = environment();
+        eof_ = false;
+        load();
+    }
+
+    void next() override
+    {
+        if (single_) {
+            eof_ = true;
+            return;
+        }
+        ++variable_;
+        ++rowid_;
+        load();
+    }
+
+    bool eof() const override
+    {
+        return eof_;
+    }
+
+    void column(sqlite3_context* context, int index) override
+    {
+        result_text(context, 0 == index ? name_ : value_);
+    }
+
+private:
+
+    void load()
+    {
+        // Windows keeps per-drive directories as "=C:=C:\..." entries, the name starts after the first '='
+        if (!variable_ || !*variable_) {
+            eof_ = true;
+            return;
+        }
+        const char* variable = *variable_;
+        const char* separator = std::strchr(variable + 1, '=');
+        if (!separator) {
+            name_ = variable;
+            value_.clear();
+            return;
+        }
+        name_.assign(variable, separator);
+        value_ = separator + 1;
+    }
+
+    bool single_ = false;
+    bool eof_ = true;
+    char** variable_ = nullptr;
+    std::string name_;
+    std::string value_;
+};
+
+template <typename Cursor>
+std::unique_ptr<system_cursor> open_cursor()
+{
+    return std::make_unique<Cursor>();
+}
+
+const system_table system_tables[] = {
+    { "processes", "CREATE TABLE x(pid INTEGER, ppid INTEGER, name TEXT, state TEXT, threads INTEGER, rss INTEGER, cmdline TEXT)",
+        0, true, 1000, &open_cursor<processes_cursor> },
+    { "mounts", "CREATE TABLE x(path TEXT, device TEXT, filesystem TEXT, options TEXT, placement TEXT, disk_type TEXT, "
+        "total_bytes INTEGER, free_bytes INTEGER, available_bytes INTEGER)",
+        0, false, 100, &open_cursor<mounts_cursor> },
+    { "cpu_topology", "CREATE TABLE x(cpu INTEGER, package INTEGER, core INTEGER, online INTEGER)",
+        0, true, 64, &open_cursor<cpu_topology_cursor> },
+    { "env", "CREATE TABLE x(name TEXT, value TEXT)",
+        0, true, 100, &open_cursor<env_cursor> },
+};
+
+int system_connect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** vtab, char**)
+{
+    const system_table* table = static_cast<const system_table*>(aux);
+    const int result = sqlite3_declare_vtab(db, table->schema);
+    if (SQLITE_OK != result) {
+        return result;
+    }
+
+    system_vtab* created = new (std::nothrow) system_vtab();
+    if (!created) {
+        return SQLITE_NOMEM;
+    }
+    created->table = table;
+    *vtab = created;
+    return SQLITE_OK;
+}
+
+int system_disconnect(sqlite3_vtab* vtab)
+{
+    delete static_cast<system_vtab*>(vtab);
+    return SQLITE_OK;
+}
+
+/// Push down the equality on the key column, the cursor reads the only row or skips the rest cheaply
+int system_best_index(sqlite3_vtab* vtab, sqlite3_index_info* info)
+{
+    const system_table* table = static_cast<system_vtab*>(vtab)->table;
+    for (int i = 0; i < info->nConstraint; ++i) {
+        const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+        if (constraint.usable && constraint.iColumn == table->key_column && SQLITE_INDEX_CONSTRAINT_EQ == constraint.op) {
+            info->idxNum = 1;
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 1;
+            info->estimatedCost = table->unique_key ? 1.0 : 10.0;
+            info->estimatedRows = 1;
+            if (table->unique_key) {
+                info->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+            }
+            return SQLITE_OK;
+        }
+    }
+
+    info->idxNum = 0;
+    info->estimatedCost = static_cast<double>(table->rows_estimate) * 100.0;
+    info->estimatedRows = table->rows_estimate;
+    return SQLITE_OK;
+}
+
+int system_open(sqlite3_vtab* vtab, sqlite3_vtab_cursor** cursor)
+{
+    try {
+        *cursor = static_cast<system_vtab*>(vtab)->table->open().release();
+        return SQLITE_OK;
+    }
+    catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+}
+
+int system_close(sqlite3_vtab_cursor* cursor)
+{
+    delete static_cast<system_cursor*>(cursor);
+    return SQLITE_OK;
+}
+
+int system_filter(sqlite3_vtab_cursor* cursor, int index_number, const char*, int argc, sqlite3_value** argv)
+{
+    try {
+        static_cast<system_cursor*>(cursor)->filter((1 == index_number && argc > 0) ? argv[0] : nullptr);
+        return SQLITE_OK;
+    }
+    catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    catch (...) {
+        return SQLITE_ERROR;
+    }
+}
+
+int system_next(sqlite3_vtab_cursor* cursor)
+{
+    try {
+        static_cast<system_cursor*>(cursor)->next();
+        return SQLITE_OK;
+    }
+    catch (const std::bad_alloc&) {
+        return SQLITE_NOMEM;
+    }
+    catch (...) {
+        return SQLITE_ERROR;
+    }
+}
+
+int system_eof(sqlite3_vtab_cursor* cursor)
+{
+    return static_cast<system_cursor*>(cursor)->eof() ? 1 : 0;
+}
+
+int system_column(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int index)
+{
+    try {
+        static_cast<system_cursor*>(cursor)->column(context, index);
+        return SQLITE_OK;
+    }
+    catch (const std::bad_alloc&) {
+        sqlite3_result_error_nomem(context);
+        return SQLITE_NOMEM;
+    }
+    catch (...) {
+        return SQLITE_ERROR;
+    }
+}
+
+int system_rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid)
+{
+    *rowid = static_cast<system_cursor*>(cursor)->rowid();
+    return SQLITE_OK;
+}
+
+/// Eponymous-only module: no xCreate, the table exists in every schema by its module name
+sqlite3_module make_system_module()
+{
+    sqlite3_module module{};
+    module.xConnect = system_connect;
+    module.xBestIndex = system_best_index;
+    module.xDisconnect = system_disconnect;
+    module.xDestroy = system_disconnect;
+    module.xOpen = system_open;
+    module.xClose = system_close;
+    module.xFilter = system_filter;
+    module.xNext = system_next;
+    module.xEof = system_eof;
+    module.xColumn = system_column;
+    module.xRowid = system_rowid;
+    return module;
+}
+
+const sqlite3_module system_module = make_system_module();
+
+} // namespace
+
+
+int helpers::register_system_tables(sqlite3* db)
+{
+    if (!db) {
+        return SQLITE_MISUSE;
+    }
+
+    for (const system_table& table : system_tables) {
+        const int result = sqlite3_create_module(db, table.name, &system_module, const_cast<system_table*>(&table));
+        if (SQLITE_OK != result) {
+            return result;
+        }
+    }
+    return SQLITE_OK;
+}
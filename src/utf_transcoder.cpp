@@ -0,0 +1,1406 @@
+#include <winapi-helpers/utf_transcoder.h>
+#include <winapi-helpers/thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UTF_TRANSCODER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UTF_TRANSCODER_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC allows any intrinsics in any function, GCC and Clang need the target attribute
+#if defined(UTF_TRANSCODER_X86) && !defined(_MSC_VER)
+#define UTF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UTF_TARGET_AVX2
+#endif
+
+using namespace helpers;
+
+namespace {
+
+/// @brief ASCII fast path kernels. Every kernel processes whole blocks only,
+/// stops on the first block with non-ASCII code unit, and returns number of code units processed.
+/// Outputs are written with SIMD stores, so the output type does not matter
+struct ascii_kernels
+{
+    const char* name;
+
+    /// Length of ASCII prefix
+    size_t(*ascii_prefix)(const std::uint8_t* input, size_t length);
+
+    /// 8-bit ASCII to 16-bit code units
+    size_t(*widen_16)(const std::uint8_t* input, size_t length, void* output);
+
+    /// 8-bit ASCII to 32-bit code units
+    size_t(*widen_32)(const std::uint8_t* input, size_t length, void* output);
+
+    /// 16-bit code units below 0x80 to 8-bit
+    size_t(*narrow_16)(const void* input, size_t length, char* output);
+
+    /// 32-bit code units below 0x80 to 8-bit
+    size_t(*narrow_32)(const void* input, size_t length, char* output);
+
+    /// Count UTF-8 code points and 4-byte sequence leads (surrogate pairs in UTF-16)
+    size_t(*count_utf8)(const std::uint8_t* input, size_t length, size_t& code_points, size_t& four_byte_leads);
+
+    /// Count UTF-8 length of 16-bit code units, stops on the first block with surrogate
+    size_t(*count_utf16)(const void* input, size_t length, size_t& utf8_length);
+
+    /// Count UTF-8 length of 32-bit code units
+    size_t(*count_utf32)(const void* input, size_t length, size_t& utf8_length);
+};
+
+#if defined(UTF_TRANSCODER_X86)
+
+inline bool sse2_all_zeros(__m128i v)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+}
+
+size_t sse2_ascii_prefix(const std::uint8_t* input, size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+    }
+    return i;
+}
+
+size_t sse2_widen_16(const std::uint8_t* input, size_t length, void* output)
+{
+    __m128i* out = static_cast<__m128i*>(output);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16, out += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+        _mm_storeu_si128(out, _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(v, zero));
+    }
+    return i;
+}
+
+size_t sse2_widen_32(const std::uint8_t* input, size_t length, void* output)
+{
+    __m128i* out = static_cast<__m128i*>(output);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16, out += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+    return i;
+}
+
+size_t sse2_narrow_16(const void* input, size_t length, char* output)
+{
+    const __m128i* in = static_cast<const __m128i*>(input);
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16, in += 2) {
+        __m128i a = _mm_loadu_si128(in);
+        __m128i b = _mm_loadu_si128(in + 1);
+        if (!sse2_all_zeros(_mm_and_si128(_mm_or_si128(a, b), non_ascii))) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+size_t sse2_narrow_32(const void* input, size_t length, char* output)
+{
+    const __m128i* in = static_cast<const __m128i*>(input);
+    const __m128i non_ascii = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16, in += 4) {
+        __m128i a = _mm_loadu_si128(in);
+        __m128i b = _mm_loadu_si128(in + 1);
+        __m128i c = _mm_loadu_si128(in + 2);
+        __m128i d = _mm_loadu_si128(in + 3);
+        __m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (!sse2_all_zeros(_mm_and_si128(all, non_ascii))) {
+            break;
+        }
+        __m128i ab = _mm_packs_epi32(a, b);
+        __m128i cd = _mm_packs_epi32(c, d);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(ab, cd));
+    }
+    return i;
+}
+
+/// Sum of 16 unsigned bytes
+inline size_t sse2_sum_bytes(__m128i v)
+{
+    const __m128i sums = _mm_sad_epu8(v, _mm_setzero_si128());
+    return static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+}
+
+/// Sum of 4 signed dwords
+inline std::int64_t sse2_sum_dwords(__m128i v)
+{
+    alignas(16) std::int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return std::int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+size_t sse2_count_utf8(const std::uint8_t* input, size_t length, size_t& code_points, size_t& four_byte_leads)
+{
+    // 0x80..0xBF are the only bytes below -64 as signed
+    const __m128i continuation_limit = _mm_set1_epi8(-64);
+    const __m128i four_byte_lead = _mm_set1_epi8(static_cast<char>(0xF0));
+    size_t continuations = 0;
+    size_t i = 0;
+    while (i + 16 <= length) {
+        // byte counters are flushed before they could overflow
+        __m128i continuation_count = _mm_setzero_si128();
+        __m128i lead_count = _mm_setzero_si128();
+        for (size_t blocks = 0; blocks < 255 && i + 16 <= length; ++blocks, i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            continuation_count = _mm_sub_epi8(continuation_count, _mm_cmplt_epi8(v, continuation_limit));
+            lead_count = _mm_sub_epi8(lead_count, _mm_cmpeq_epi8(_mm_max_epu8(v, four_byte_lead), v));
+        }
+        continuations += sse2_sum_bytes(continuation_count);
+        four_byte_leads += sse2_sum_bytes(lead_count);
+    }
+    code_points += i - continuations;
+    return i;
+}
+
+size_t sse2_count_utf16(const void* input, size_t length, size_t& utf8_length)
+{
+    const __m128i* in = static_cast<const __m128i*>(input);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ascii_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i two_byte_mask = _mm_set1_epi16(static_cast<short>(0xF800));
+    const __m128i surrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+    const __m128i ones = _mm_set1_epi16(1);
+    std::int64_t saved = 0;
+    size_t i = 0;
+    bool has_surrogate = false;
+    while (!has_surrogate && i + 8 <= length) {
+        // every unit is 3 bytes minus one per matched mask, 16-bit counters are flushed every 8K blocks
+        __m128i saved_count = _mm_setzero_si128();
+        for (size_t blocks = 0; blocks < 8192 && i + 8 <= length; ++blocks, i += 8, ++in) {
+            __m128i v = _mm_loadu_si128(in);
+            __m128i high = _mm_and_si128(v, two_byte_mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, surrogate))) {
+                has_surrogate = true;
+                break;
+            }
+            __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, ascii_mask), zero);
+            __m128i below_0x800 = _mm_cmpeq_epi16(high, zero);
+            saved_count = _mm_add_epi16(saved_count, _mm_add_epi16(ascii, below_0x800));
+        }
+        saved += sse2_sum_dwords(_mm_madd_epi16(saved_count, ones));
+    }
+    utf8_length += 3 * i + saved;
+    return i;
+}
+
+size_t sse2_count_utf32(const void* input, size_t length, size_t& utf8_length)
+{
+    const __m128i* in = static_cast<const __m128i*>(input);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ascii_mask = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+    const __m128i two_byte_mask = _mm_set1_epi32(static_cast<int>(0xFFFFF800));
+    const __m128i three_byte_mask = _mm_set1_epi32(static_cast<int>(0xFFFF0000));
+    std::int64_t saved = 0;
+    size_t i = 0;
+    while (i + 4 <= length) {
+        __m128i saved_count = _mm_setzero_si128();
+        for (size_t blocks = 0; blocks < (size_t(1) << 24) && i + 4 <= length; ++blocks, i += 4, ++in) {
+            __m128i v = _mm_loadu_si128(in);
+            saved_count = _mm_add_epi32(saved_count, _mm_cmpeq_epi32(_mm_and_si128(v, ascii_mask), zero));
+            saved_count = _mm_add_epi32(saved_count, _mm_cmpeq_epi32(_mm_and_si128(v, two_byte_mask), zero));
+            saved_count = _mm_add_epi32(saved_count, _mm_cmpeq_epi32(_mm_and_si128(v, three_byte_mask), zero));
+        }
+        saved += sse2_sum_dwords(saved_count);
+    }
+    utf8_length += 4 * i + saved;
+    return i;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_ascii_prefix(const std::uint8_t* input, size_t length)
+{
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        if (_mm256_movemask_epi8(v)) {
+            break;
+        }
+    }
+    return i + sse2_ascii_prefix(input + i, length - i);
+}
+
+UTF_TARGET_AVX2
+size_t avx2_widen_16(const std::uint8_t* input, size_t length, void* output)
+{
+    __m256i* out = static_cast<__m256i*>(output);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32, out += 2) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        if (_mm256_movemask_epi8(v)) {
+            break;
+        }
+        _mm256_storeu_si256(out, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    return i;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_widen_32(const std::uint8_t* input, size_t length, void* output)
+{
+    __m256i* out = static_cast<__m256i*>(output);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32, out += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        if (_mm256_movemask_epi8(v)) {
+            break;
+        }
+        __m128i lo = _mm256_castsi256_si128(v);
+        __m128i hi = _mm256_extracti128_si256(v, 1);
+        _mm256_storeu_si256(out, _mm256_cvtepu8_epi32(lo));
+        _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+        _mm256_storeu_si256(out + 2, _mm256_cvtepu8_epi32(hi));
+        _mm256_storeu_si256(out + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+    }
+    return i;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_narrow_16(const void* input, size_t length, char* output)
+{
+    const __m256i* in = static_cast<const __m256i*>(input);
+    const __m256i non_ascii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32, in += 2) {
+        __m256i a = _mm256_loadu_si256(in);
+        __m256i b = _mm256_loadu_si256(in + 1);
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), non_ascii)) {
+            break;
+        }
+        // packus works inside 128-bit lanes, restore qwords order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+    }
+    return i;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_narrow_32(const void* input, size_t length, char* output)
+{
+    const __m256i* in = static_cast<const __m256i*>(input);
+    const __m256i non_ascii = _mm256_set1_epi32(static_cast<int>(0xFFFFFF80));
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32, in += 4) {
+        __m256i a = _mm256_loadu_si256(in);
+        __m256i b = _mm256_loadu_si256(in + 1);
+        __m256i c = _mm256_loadu_si256(in + 2);
+        __m256i d = _mm256_loadu_si256(in + 3);
+        __m256i all = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (!_mm256_testz_si256(all, non_ascii)) {
+            break;
+        }
+        // packs/packus work inside 128-bit lanes, restore dwords order
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    return i;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_count_utf8(const std::uint8_t* input, size_t length, size_t& code_points, size_t& four_byte_leads)
+{
+    const __m256i continuation_limit = _mm256_set1_epi8(-64);
+    const __m256i four_byte_lead = _mm256_set1_epi8(static_cast<char>(0xF0));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t continuations = 0;
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i continuation_count = zero;
+        __m256i lead_count = zero;
+        for (size_t blocks = 0; blocks < 255 && i + 32 <= length; ++blocks, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+            continuation_count = _mm256_sub_epi8(continuation_count, _mm256_cmpgt_epi8(continuation_limit, v));
+            lead_count = _mm256_sub_epi8(lead_count, _mm256_cmpeq_epi8(_mm256_max_epu8(v, four_byte_lead), v));
+        }
+        __m256i sums = _mm256_add_epi64(_mm256_sad_epu8(continuation_count, zero),
+            _mm256_slli_epi64(_mm256_sad_epu8(lead_count, zero), 32));
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sums);
+        for (std::uint64_t lane : lanes) {
+            continuations += static_cast<size_t>(lane & 0xFFFFFFFF);
+            four_byte_leads += static_cast<size_t>(lane >> 32);
+        }
+    }
+    code_points += i - continuations;
+
+    // GCC does not always clear upper halves before the call, avoid AVX-SSE transition penalty
+    _mm256_zeroupper();
+    size_t tail_code_points = 0;
+    size_t tail = sse2_count_utf8(input + i, length - i, tail_code_points, four_byte_leads);
+    code_points += tail_code_points;
+    return i + tail;
+}
+
+UTF_TARGET_AVX2
+size_t avx2_count_utf16(const void* input, size_t length, size_t& utf8_length)
+{
+    const __m256i* in = static_cast<const __m256i*>(input);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    const __m256i two_byte_mask = _mm256_set1_epi16(static_cast<short>(0xF800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+    const __m256i ones = _mm256_set1_epi16(1);
+    std::int64_t saved = 0;
+    size_t i = 0;
+    bool has_surrogate = false;
+    while (!has_surrogate && i + 16 <= length) {
+        __m256i saved_count = zero;
+        for (size_t blocks = 0; blocks < 8192 && i + 16 <= length; ++blocks, i += 16, ++in) {
+            __m256i v = _mm256_loadu_si256(in);
+            __m256i high = _mm256_and_si256(v, two_byte_mask);
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(high, surrogate))) {
+                has_surrogate = true;
+                break;
+            }
+            __m256i ascii = _mm256_cmpeq_epi16(_mm256_and_si256(v, ascii_mask), zero);
+            __m256i below_0x800 = _mm256_cmpeq_epi16(high, zero);
+            saved_count = _mm256_add_epi16(saved_count, _mm256_add_epi16(ascii, below_0x800));
+        }
+        __m256i dwords = _mm256_madd_epi16(saved_count, ones);
+        saved += sse2_sum_dwords(_mm_add_epi32(_mm256_castsi256_si128(dwords), _mm256_extracti128_si256(dwords, 1)));
+    }
+    utf8_length += 3 * i + saved;
+    if (has_surrogate) {
+        return i;
+    }
+    _mm256_zeroupper();
+    return i + sse2_count_utf16(reinterpret_cast<const std::uint16_t*>(input) + i, length - i, utf8_length);
+}
+
+UTF_TARGET_AVX2
+size_t avx2_count_utf32(const void* input, size_t length, size_t& utf8_length)
+{
+    const __m256i* in = static_cast<const __m256i*>(input);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_mask = _mm256_set1_epi32(static_cast<int>(0xFFFFFF80));
+    const __m256i two_byte_mask = _mm256_set1_epi32(static_cast<int>(0xFFFFF800));
+    const __m256i three_byte_mask = _mm256_set1_epi32(static_cast<int>(0xFFFF0000));
+    std::int64_t saved = 0;
+    size_t i = 0;
+    while (i + 8 <= length) {
+        __m256i saved_count = zero;
+        for (size_t blocks = 0; blocks < (size_t(1) << 24) && i + 8 <= length; ++blocks, i += 8, ++in) {
+            __m256i v = _mm256_loadu_si256(in);
+            saved_count = _mm256_add_epi32(saved_count, _mm256_cmpeq_epi32(_mm256_and_si256(v, ascii_mask), zero));
+            saved_count = _mm256_add_epi32(saved_count, _mm256_cmpeq_epi32(_mm256_and_si256(v, two_byte_mask), zero));
+            saved_count = _mm256_add_epi32(saved_count, _mm256_cmpeq_epi32(_mm256_and_si256(v, three_byte_mask), zero));
+        }
+        saved += sse2_sum_dwords(_mm_add_epi32(_mm256_castsi256_si128(saved_count), _mm256_extracti128_si256(saved_count, 1)));
+    }
+    utf8_length += 4 * i + saved;
+    _mm256_zeroupper();
+    return i + sse2_count_utf32(reinterpret_cast<const std::uint32_t*>(input) + i, length - i, utf8_length);
+}
+
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(UTF_TRANSCODER_NEON)
+
+size_t neon_ascii_prefix(const std::uint8_t* input, size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(input + i)) >= 0x80) {
+            break;
+        }
+    }
+    return i;
+}
+
+size_t neon_widen_16(const std::uint8_t* input, size_t length, void* output)
+{
+    std::uint16_t* out = static_cast<std::uint16_t*>(output);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(input + i);
+        if (vmaxvq_u8(v) >= 0x80) {
+            break;
+        }
+        vst1q_u16(out + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(out + i + 8, vmovl_high_u8(v));
+    }
+    return i;
+}
+
+size_t neon_widen_32(const std::uint8_t* input, size_t length, void* output)
+{
+    std::uint32_t* out = static_cast<std::uint32_t*>(output);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(input + i);
+        if (vmaxvq_u8(v) >= 0x80) {
+            break;
+        }
+        uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi = vmovl_high_u8(v);
+        vst1q_u32(out + i, vmovl_u16(vget_low_u16(lo)));
+        vst1q_u32(out + i + 4, vmovl_high_u16(lo));
+        vst1q_u32(out + i + 8, vmovl_u16(vget_low_u16(hi)));
+        vst1q_u32(out + i + 12, vmovl_high_u16(hi));
+    }
+    return i;
+}
+
+size_t neon_narrow_16(const void* input, size_t length, char* output)
+{
+    const std::uint16_t* in = static_cast<const std::uint16_t*>(input);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint16x8_t a = vld1q_u16(in + i);
+        uint16x8_t b = vld1q_u16(in + i + 8);
+        if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) {
+            break;
+        }
+        vst1q_u8(reinterpret_cast<std::uint8_t*>(output + i), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+    }
+    return i;
+}
+
+size_t neon_narrow_32(const void* input, size_t length, char* output)
+{
+    const std::uint32_t* in = static_cast<const std::uint32_t*>(input);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint32x4_t a = vld1q_u32(in + i);
+        uint32x4_t b = vld1q_u32(in + i + 4);
+        if (vmaxvq_u32(vorrq_u32(a, b)) >= 0x80) {
+            break;
+        }
+        uint16x8_t ab = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+        vst1_u8(reinterpret_cast<std::uint8_t*>(output + i), vmovn_u16(ab));
+    }
+    return i;
+}
+
+size_t neon_count_utf8(const std::uint8_t* input, size_t length, size_t& code_points, size_t& four_byte_leads)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    size_t continuations = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(input + i);
+        uint8x16_t continuation = vceqq_u8(vandq_u8(v, vdupq_n_u8(0xC0)), vdupq_n_u8(0x80));
+        continuations += vaddvq_u8(vandq_u8(continuation, one));
+        four_byte_leads += vaddvq_u8(vandq_u8(vcgeq_u8(v, vdupq_n_u8(0xF0)), one));
+    }
+    code_points += i - continuations;
+    return i;
+}
+
+size_t neon_count_utf16(const void* input, size_t length, size_t& utf8_length)
+{
+    const std::uint16_t* in = static_cast<const std::uint16_t*>(input);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint16x8_t v = vld1q_u16(in + i);
+        if (vmaxvq_u16(vceqq_u16(vandq_u16(v, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800)))) {
+            break;
+        }
+        uint16x8_t extra = vaddq_u16(vshrq_n_u16(vcgeq_u16(v, vdupq_n_u16(0x80)), 15),
+            vshrq_n_u16(vcgeq_u16(v, vdupq_n_u16(0x800)), 15));
+        utf8_length += 8 + vaddvq_u16(extra);
+    }
+    return i;
+}
+
+size_t neon_count_utf32(const void* input, size_t length, size_t& utf8_length)
+{
+    const std::uint32_t* in = static_cast<const std::uint32_t*>(input);
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        uint32x4_t v = vld1q_u32(in + i);
+        uint32x4_t extra = vaddq_u32(vshrq_n_u32(vcgeq_u32(v, vdupq_n_u32(0x80)), 31),
+            vaddq_u32(vshrq_n_u32(vcgeq_u32(v, vdupq_n_u32(0x800)), 31),
+                vshrq_n_u32(vcgeq_u32(v, vdupq_n_u32(0x10000)), 31)));
+        utf8_length += 4 + vaddvq_u32(extra);
+    }
+    return i;
+}
+
+#else
+
+size_t scalar_ascii_prefix(const std::uint8_t*, size_t)
+{
+    return 0;
+}
+
+size_t scalar_widen(const std::uint8_t*, size_t, void*)
+{
+    return 0;
+}
+
+size_t scalar_narrow(const void*, size_t, char*)
+{
+    return 0;
+}
+
+size_t scalar_count_utf8(const std::uint8_t*, size_t, size_t&, size_t&)
+{
+    return 0;
+}
+
+size_t scalar_count_wide(const void*, size_t, size_t&)
+{
+    return 0;
+}
+
+#endif
+
+ascii_kernels select_kernels()
+{
+#if defined(UTF_TRANSCODER_X86)
+    if (cpu_has_avx2()) {
+        return { "avx2", avx2_ascii_prefix, avx2_widen_16, avx2_widen_32, avx2_narrow_16, avx2_narrow_32,
+            avx2_count_utf8, avx2_count_utf16, avx2_count_utf32 };
+    }
+    return { "sse2", sse2_ascii_prefix, sse2_widen_16, sse2_widen_32, sse2_narrow_16, sse2_narrow_32,
+        sse2_count_utf8, sse2_count_utf16, sse2_count_utf32 };
+#elif defined(UTF_TRANSCODER_NEON)
+    return { "neon", neon_ascii_prefix, neon_widen_16, neon_widen_32, neon_narrow_16, neon_narrow_32,
+        neon_count_utf8, neon_count_utf16, neon_count_utf32 };
+#else
+    return { "scalar", scalar_ascii_prefix, scalar_widen, scalar_widen, scalar_narrow, scalar_narrow,
+        scalar_count_utf8, scalar_count_wide, scalar_count_wide };
+#endif
+}
+
+/// Selected once, on the first conversion
+const ascii_kernels& kernels()
+{
+    static const ascii_kernels selected = select_kernels();
+    return selected;
+}
+
+/// Decode one UTF-8 sequence starting with non-ASCII byte
+/// @return: sequence length, 0 if the sequence is invalid, -1 if it is truncated
+template <bool Validate>
+int decode_utf8(const std::uint8_t* input, size_t available, char32_t& code_point)
+{
+    const std::uint8_t lead = input[0];
+    int length = 0;
+    char32_t min_code_point = 0;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        code_point = lead & 0x1F;
+        min_code_point = 0x80;
+    }
+    else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        code_point = lead & 0x0F;
+        min_code_point = 0x800;
+    }
+    else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        code_point = lead & 0x07;
+        min_code_point = 0x10000;
+    }
+    else {
+        // continuation byte or 0xF8..0xFF
+        return 0;
+    }
+
+    for (int i = 1; i < length; ++i) {
+        if (static_cast<size_t>(i) >= available) {
+            return -1;
+        }
+        if (Validate && (input[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        code_point = (code_point << 6) | (input[i] & 0x3F);
+    }
+
+    if (Validate && (code_point < min_code_point || code_point > 0x10FFFF ||
+        (code_point >= 0xD800 && code_point <= 0xDFFF))) {
+        return 0;
+    }
+    return length;
+}
+
+/// Encode code point above 0x7F
+char* encode_utf8(char32_t code_point, char* output)
+{
+    if (code_point < 0x800) {
+        *output++ = static_cast<char>(0xC0 | (code_point >> 6));
+        *output++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000) {
+        *output++ = static_cast<char>(0xE0 | (code_point >> 12));
+        *output++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *output++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else {
+        *output++ = static_cast<char>(0xF0 | (code_point >> 18));
+        *output++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        *output++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *output++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    return output;
+}
+
+utf_result decode_error(int decoded, size_t input_offset, size_t output_count)
+{
+    utf_result result;
+    result.status = (decoded < 0) ? utf_status::truncated_sequence : utf_status::invalid_sequence;
+    result.input_offset = input_offset;
+    result.output_count = output_count;
+    return result;
+}
+
+utf_result success(size_t input_length, size_t output_count)
+{
+    utf_result result;
+    result.input_offset = input_length;
+    result.output_count = output_count;
+    return result;
+}
+
+template <bool Validate>
+utf_result validate_utf8_impl(const char* input, size_t length)
+{
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(input);
+    const ascii_kernels& simd = kernels();
+    size_t i = 0;
+    while (i < length) {
+        if (in[i] < 0x80) {
+            i += simd.ascii_prefix(in + i, length - i);
+            while (i < length && in[i] < 0x80) {
+                ++i;
+            }
+            continue;
+        }
+
+        char32_t code_point = 0;
+        int decoded = decode_utf8<Validate>(in + i, length - i, code_point);
+        if (decoded <= 0) {
+            return decode_error(decoded, i, 0);
+        }
+        i += static_cast<size_t>(decoded);
+    }
+    return success(length, 0);
+}
+
+template <bool Validate, typename Char16>
+utf_result utf8_to_utf16_impl(const char* input, size_t length, Char16* output)
+{
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(input);
+    const ascii_kernels& simd = kernels();
+    Char16* out = output;
+    size_t i = 0;
+    while (i < length) {
+        if (in[i] < 0x80) {
+            const size_t converted = simd.widen_16(in + i, length - i, out);
+            i += converted;
+            out += converted;
+            while (i < length && in[i] < 0x80) {
+                *out++ = static_cast<Char16>(in[i++]);
+            }
+            continue;
+        }
+
+        char32_t code_point = 0;
+        int decoded = decode_utf8<Validate>(in + i, length - i, code_point);
+        if (decoded <= 0) {
+            return decode_error(decoded, i, static_cast<size_t>(out - output));
+        }
+        if (code_point >= 0x10000) {
+            code_point -= 0x10000;
+            *out++ = static_cast<Char16>(0xD800 + (code_point >> 10));
+            *out++ = static_cast<Char16>(0xDC00 + (code_point & 0x3FF));
+        }
+        else {
+            *out++ = static_cast<Char16>(code_point);
+        }
+        i += static_cast<size_t>(decoded);
+    }
+    return success(length, static_cast<size_t>(out - output));
+}
+
+template <bool Validate, typename Char32>
+utf_result utf8_to_utf32_impl(const char* input, size_t length, Char32* output)
+{
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(input);
+    const ascii_kernels& simd = kernels();
+    Char32* out = output;
+    size_t i = 0;
+    while (i < length) {
+        if (in[i] < 0x80) {
+            const size_t converted = simd.widen_32(in + i, length - i, out);
+            i += converted;
+            out += converted;
+            while (i < length && in[i] < 0x80) {
+                *out++ = static_cast<Char32>(in[i++]);
+            }
+            continue;
+        }
+
+        char32_t code_point = 0;
+        int decoded = decode_utf8<Validate>(in + i, length - i, code_point);
+        if (decoded <= 0) {
+            return decode_error(decoded, i, static_cast<size_t>(out - output));
+        }
+        *out++ = static_cast<Char32>(code_point);
+        i += static_cast<size_t>(decoded);
+    }
+    return success(length, static_cast<size_t>(out - output));
+}
+
+template <bool Validate, typename Char16>
+utf_result utf16_to_utf8_impl(const Char16* input, size_t length, char* output)
+{
+    const ascii_kernels& simd = kernels();
+    char* out = output;
+    size_t i = 0;
+    while (i < length) {
+        const char32_t unit = static_cast<std::uint16_t>(input[i]);
+        if (unit < 0x80) {
+            const size_t converted = simd.narrow_16(input + i, length - i, out);
+            i += converted;
+            out += converted;
+            while (i < length && static_cast<std::uint16_t>(input[i]) < 0x80) {
+                *out++ = static_cast<char>(input[i++]);
+            }
+            continue;
+        }
+
+        if (unit >= 0xD800 && unit <= 0xDBFF) {
+            // high surrogate should be followed by low one
+            const char32_t next = (i + 1 < length) ? static_cast<std::uint16_t>(input[i + 1]) : 0;
+            if (next >= 0xDC00 && next <= 0xDFFF) {
+                out = encode_utf8(0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00), out);
+                i += 2;
+                continue;
+            }
+            if (Validate) {
+                return decode_error(i + 1 < length ? 0 : -1, i, static_cast<size_t>(out - output));
+            }
+        }
+        else if (Validate && unit >= 0xDC00 && unit <= 0xDFFF) {
+            return decode_error(0, i, static_cast<size_t>(out - output));
+        }
+
+        out = encode_utf8(unit, out);
+        ++i;
+    }
+    return success(length, static_cast<size_t>(out - output));
+}
+
+template <bool Validate, typename Char32>
+utf_result utf32_to_utf8_impl(const Char32* input, size_t length, char* output)
+{
+    const ascii_kernels& simd = kernels();
+    char* out = output;
+    size_t i = 0;
+    while (i < length) {
+        const char32_t unit = static_cast<std::uint32_t>(input[i]);
+        if (unit < 0x80) {
+            const size_t converted = simd.narrow_32(input + i, length - i, out);
+            i += converted;
+            out += converted;
+            while (i < length && static_cast<std::uint32_t>(input[i]) < 0x80) {
+                *out++ = static_cast<char>(input[i++]);
+            }
+            continue;
+        }
+
+        if (Validate && (unit > 0x10FFFF || (unit >= 0xD800 && unit <= 0xDFFF))) {
+            return decode_error(0, i, static_cast<size_t>(out - output));
+        }
+        if (!Validate && unit > 0x10FFFF) {
+            // never emit more than 4 bytes per unit
+            out = encode_utf8(0xFFFD, out);
+        }
+        else {
+            out = encode_utf8(unit, out);
+        }
+        ++i;
+    }
+    return success(length, static_cast<size_t>(out - output));
+}
+
+/// Output length of UTF-8 to UTF-16 (FourByteLeads) or UTF-32 conversion
+/// Every code point has one non-continuation byte, 4-byte sequences become surrogate pairs
+template <bool FourByteLeads>
+size_t utf8_required_length(const char* input, size_t length)
+{
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(input);
+    size_t code_points = 0;
+    size_t four_byte_leads = 0;
+    size_t i = kernels().count_utf8(in, length, code_points, four_byte_leads);
+    for (; i < length; ++i) {
+        code_points += ((in[i] & 0xC0) != 0x80) ? 1 : 0;
+        four_byte_leads += (in[i] >= 0xF0) ? 1 : 0;
+    }
+    return FourByteLeads ? code_points + four_byte_leads : code_points;
+}
+
+/// UTF-8 length of UTF-16 input, unpaired surrogates are counted as 3 bytes like the non-validating conversion writes
+template <typename Char16>
+size_t utf16_required_length(const Char16* input, size_t length)
+{
+    const ascii_kernels& simd = kernels();
+    size_t utf8_length = 0;
+    size_t i = 0;
+    while (i < length) {
+        i += simd.count_utf16(input + i, length - i, utf8_length);
+
+        // scalar tail, or the block with surrogates
+        const size_t block_end = (i + 16 < length) ? i + 16 : length;
+        while (i < block_end) {
+            const char32_t unit = static_cast<std::uint16_t>(input[i]);
+            if (unit >= 0xD800 && unit <= 0xDBFF && i + 1 < length &&
+                static_cast<std::uint16_t>(input[i + 1]) >= 0xDC00 && static_cast<std::uint16_t>(input[i + 1]) <= 0xDFFF) {
+                utf8_length += 4;
+                i += 2;
+                continue;
+            }
+            utf8_length += (unit < 0x80) ? 1 : (unit < 0x800) ? 2 : 3;
+            ++i;
+        }
+    }
+    return utf8_length;
+}
+
+/// UTF-8 length of UTF-32 input, code points above U+10FFFF are counted as 4 bytes
+template <typename Char32>
+size_t utf32_required_length(const Char32* input, size_t length)
+{
+    size_t utf8_length = 0;
+    size_t i = kernels().count_utf32(input, length, utf8_length);
+    for (; i < length; ++i) {
+        const char32_t unit = static_cast<std::uint32_t>(input[i]);
+        utf8_length += (unit < 0x80) ? 1 : (unit < 0x800) ? 2 : (unit < 0x10000) ? 3 : 4;
+    }
+    return utf8_length;
+}
+
+/// Convert into the caller buffer, checking the exact length only when the worst case does not fit
+template <typename Convert, typename Count>
+utf_result convert_bounded(size_t worst_case, size_t capacity, Convert convert, Count count)
+{
+    if (capacity < worst_case) {
+        const size_t required = count();
+        if (required > capacity) {
+            utf_result result;
+            result.status = utf_status::output_overflow;
+            result.output_count = required;
+            return result;
+        }
+    }
+    return convert();
+}
+
+/// Convert into the reusable string. Growing to the worst case is free while the capacity is enough,
+/// otherwise the exact length is counted first, so that the buffer is not over-allocated
+template <typename String, typename Convert, typename Count>
+utf_result convert_to_string(size_t worst_case, String& output, Convert convert, Count count)
+{
+    output.resize((output.capacity() >= worst_case) ? worst_case : count());
+    utf_result result = convert(&output[0]);
+    output.resize(result.output_count);
+    return result;
+}
+
+/// Batches with less input code units are converted in the caller thread
+constexpr size_t min_parallel_batch = 64 * 1024;
+
+/// Strings [begin, end) of the batch converted by one task
+struct batch_range
+{
+    size_t begin;
+    size_t end;
+
+    /// First ill-formed string of the range, end if none
+    size_t failed_index;
+    utf_result failed_result;
+
+    /// Strings shorter than counted (non-validating mode, ill-formed input): index and real length
+    std::vector<std::pair<size_t, size_t>> short_strings;
+};
+
+/// Split the batch into ranges of roughly equal input size, several ranges per pool thread
+template <typename InputChar>
+std::vector<batch_range> split_batch(const std::basic_string_view<InputChar>* inputs, size_t count, thread_pool* pool)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += inputs[i].size();
+    }
+
+    std::vector<batch_range> ranges;
+    if (nullptr == pool || total < min_parallel_batch) {
+        ranges.push_back({ 0, count, count, utf_result{}, {} });
+        return ranges;
+    }
+
+    const size_t target = std::max(min_parallel_batch / 4, total / (pool->threads_number() * 4));
+    size_t begin = 0;
+    size_t accumulated = 0;
+    for (size_t i = 0; i < count; ++i) {
+        accumulated += inputs[i].size();
+        if (accumulated >= target || i + 1 == count) {
+            ranges.push_back({ begin, i + 1, i + 1, utf_result{}, {} });
+            begin = i + 1;
+            accumulated = 0;
+        }
+    }
+    return ranges;
+}
+
+/// Run the function for every range, spread across the pool if there are several ranges.
+/// The caller takes the ranges too and runs the ones no worker picked up, so a busy or stopped pool
+/// and the call from a task of the same pool only slow the batch down
+template <typename Function>
+void run_ranges(std::vector<batch_range>& ranges, thread_pool* pool, Function run_range)
+{
+    if (nullptr == pool || ranges.size() < 2) {
+        for (batch_range& range : ranges) {
+            run_range(range);
+        }
+        return;
+    }
+
+    // Helpers and the caller take ranges by the shared counter. A helper started after the caller
+    // has closed the batch returns at once, so queued helpers never touch the local data later
+    struct BatchState
+    {
+        std::atomic<size_t> next_range{ 0 };
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t active_helpers = 0;
+        bool closed = false;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<BatchState>();
+
+    auto take_ranges = [&state, &ranges, &run_range]() {
+        for (size_t i = state->next_range++; i < ranges.size(); i = state->next_range++) {
+            try {
+                run_range(ranges[i]);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    const size_t helpers_count = std::min(pool->threads_number(), ranges.size() - 1);
+    for (size_t i = 0; i < helpers_count; ++i) {
+        // stopped pool does not take the task, the caller runs its ranges
+        pool->enqueue([state, &take_ranges]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->closed) {
+                    return;
+                }
+                ++state->active_helpers;
+            }
+            take_ranges();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (0 == --state->active_helpers) {
+                state->finished.notify_all();
+            }
+        });
+    }
+
+    take_ranges();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    state->finished.wait(lock, [&state] { return 0 == state->active_helpers; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+/// Count output lengths, allocate the buffer once, convert every string into its place
+template <typename OutputChar, typename InputChar, typename Convert, typename Count>
+packed_strings<OutputChar> transcode_batch_impl(const std::basic_string_view<InputChar>* inputs, size_t count,
+    thread_pool* pool, Convert convert, Count required)
+{
+    packed_strings<OutputChar> packed;
+    packed.offsets.resize(count + 1);
+    std::vector<batch_range> ranges = split_batch(inputs, count, pool);
+
+    run_ranges(ranges, pool, [&](batch_range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            packed.offsets[i + 1] = required(inputs[i].data(), inputs[i].size());
+        }
+    });
+    std::partial_sum(packed.offsets.begin(), packed.offsets.end(), packed.offsets.begin());
+    packed.data.resize(static_cast<size_t>(packed.offsets.back()));
+
+    run_ranges(ranges, pool, [&](batch_range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            const size_t slot = static_cast<size_t>(packed.offsets[i + 1] - packed.offsets[i]);
+            utf_result result = convert(inputs[i].data(), inputs[i].size(), &packed.data[0] + packed.offsets[i]);
+            if (!result) {
+                range.failed_index = i;
+                range.failed_result = result;
+                return;
+            }
+            if (result.output_count != slot) {
+                range.short_strings.emplace_back(i, result.output_count);
+            }
+        }
+    });
+
+    bool has_short_strings = false;
+    for (const batch_range& range : ranges) {
+        if (range.failed_index != range.end) {
+            packed_strings<OutputChar> failed;
+            failed.status = range.failed_result.status;
+            failed.failed_index = range.failed_index;
+            failed.input_offset = range.failed_result.input_offset;
+            return failed;
+        }
+        has_short_strings = has_short_strings || !range.short_strings.empty();
+    }
+    if (!has_short_strings) {
+        return packed;
+    }
+
+    // Ill-formed input in non-validating mode leaves gaps after some strings, close them
+    std::uint64_t read = 0;
+    std::uint64_t write = 0;
+    for (const batch_range& range : ranges) {
+        auto short_string = range.short_strings.begin();
+        for (size_t i = range.begin; i < range.end; ++i) {
+            const std::uint64_t next_read = packed.offsets[i + 1];
+            std::uint64_t length = next_read - read;
+            if (short_string != range.short_strings.end() && short_string->first == i) {
+                length = short_string->second;
+                ++short_string;
+            }
+            if (write != read) {
+                std::memmove(&packed.data[0] + write, packed.data.data() + read, static_cast<size_t>(length) * sizeof(OutputChar));
+            }
+            write += length;
+            packed.offsets[i + 1] = write;
+            read = next_read;
+        }
+    }
+    packed.data.resize(static_cast<size_t>(write));
+    return packed;
+}
+
+} // namespace
+
+
+utf_result helpers::validate_utf8(const char* input, size_t length)
+{
+    return validate_utf8_impl<true>(input, length);
+}
+
+utf_result helpers::utf8_to_utf16(const char* input, size_t length, char16_t* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    if (utf_validation::validating == validation) {
+        return utf8_to_utf16_impl<true>(input, length, output);
+    }
+    return utf8_to_utf16_impl<false>(input, length, output);
+}
+
+utf_result helpers::utf8_to_utf32(const char* input, size_t length, char32_t* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    if (utf_validation::validating == validation) {
+        return utf8_to_utf32_impl<true>(input, length, output);
+    }
+    return utf8_to_utf32_impl<false>(input, length, output);
+}
+
+utf_result helpers::utf16_to_utf8(const char16_t* input, size_t length, char* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    if (utf_validation::validating == validation) {
+        return utf16_to_utf8_impl<true>(input, length, output);
+    }
+    return utf16_to_utf8_impl<false>(input, length, output);
+}
+
+utf_result helpers::utf32_to_utf8(const char32_t* input, size_t length, char* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    if (utf_validation::validating == validation) {
+        return utf32_to_utf8_impl<true>(input, length, output);
+    }
+    return utf32_to_utf8_impl<false>(input, length, output);
+}
+
+utf_result helpers::utf8_to_wide(const char* input, size_t length, wchar_t* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    const bool validate = (utf_validation::validating == validation);
+    if constexpr (sizeof(wchar_t) == 2) {
+        return validate ? utf8_to_utf16_impl<true>(input, length, output) : utf8_to_utf16_impl<false>(input, length, output);
+    }
+    else {
+        return validate ? utf8_to_utf32_impl<true>(input, length, output) : utf8_to_utf32_impl<false>(input, length, output);
+    }
+}
+
+utf_result helpers::wide_to_utf8(const wchar_t* input, size_t length, char* output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    const bool validate = (utf_validation::validating == validation);
+    if constexpr (sizeof(wchar_t) == 2) {
+        return validate ? utf16_to_utf8_impl<true>(input, length, output) : utf16_to_utf8_impl<false>(input, length, output);
+    }
+    else {
+        return validate ? utf32_to_utf8_impl<true>(input, length, output) : utf32_to_utf8_impl<false>(input, length, output);
+    }
+}
+
+const char* helpers::utf_kernel_name()
+{
+    return kernels().name;
+}
+
+template <>
+size_t helpers::required_length<char16_t>(const char* input, size_t length)
+{
+    return utf8_required_length<true>(input, length);
+}
+
+template <>
+size_t helpers::required_length<char32_t>(const char* input, size_t length)
+{
+    return utf8_required_length<false>(input, length);
+}
+
+template <>
+size_t helpers::required_length<wchar_t>(const char* input, size_t length)
+{
+    return utf8_required_length<sizeof(wchar_t) == 2>(input, length);
+}
+
+size_t helpers::required_length(const char16_t* input, size_t length)
+{
+    return utf16_required_length(input, length);
+}
+
+size_t helpers::required_length(const char32_t* input, size_t length)
+{
+    return utf32_required_length(input, length);
+}
+
+size_t helpers::required_length(const wchar_t* input, size_t length)
+{
+    if constexpr (sizeof(wchar_t) == 2) {
+        return utf16_required_length(input, length);
+    }
+    else {
+        return utf32_required_length(input, length);
+    }
+}
+
+utf_result helpers::utf8_to_utf16(const char* input, size_t length, char16_t* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length * utf16_per_utf8_max, capacity,
+        [&] { return utf8_to_utf16(input, length, output, validation); },
+        [&] { return required_length<char16_t>(input, length); });
+}
+
+utf_result helpers::utf8_to_utf32(const char* input, size_t length, char32_t* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length * utf32_per_utf8_max, capacity,
+        [&] { return utf8_to_utf32(input, length, output, validation); },
+        [&] { return required_length<char32_t>(input, length); });
+}
+
+utf_result helpers::utf16_to_utf8(const char16_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length * utf8_per_utf16_max, capacity,
+        [&] { return utf16_to_utf8(input, length, output, validation); },
+        [&] { return required_length(input, length); });
+}
+
+utf_result helpers::utf32_to_utf8(const char32_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length * utf8_per_utf32_max, capacity,
+        [&] { return utf32_to_utf8(input, length, output, validation); },
+        [&] { return required_length(input, length); });
+}
+
+utf_result helpers::utf8_to_wide(const char* input, size_t length, wchar_t* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length, capacity,
+        [&] { return utf8_to_wide(input, length, output, validation); },
+        [&] { return required_length<wchar_t>(input, length); });
+}
+
+utf_result helpers::wide_to_utf8(const wchar_t* input, size_t length, char* output, size_t capacity,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_bounded(length * utf8_per_wide_max, capacity,
+        [&] { return wide_to_utf8(input, length, output, validation); },
+        [&] { return required_length(input, length); });
+}
+
+utf_result helpers::utf8_to_utf16(const char* input, size_t length, std::u16string& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length * utf16_per_utf8_max, output,
+        [&](char16_t* buffer) { return utf8_to_utf16(input, length, buffer, validation); },
+        [&] { return required_length<char16_t>(input, length); });
+}
+
+utf_result helpers::utf8_to_utf32(const char* input, size_t length, std::u32string& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length * utf32_per_utf8_max, output,
+        [&](char32_t* buffer) { return utf8_to_utf32(input, length, buffer, validation); },
+        [&] { return required_length<char32_t>(input, length); });
+}
+
+utf_result helpers::utf16_to_utf8(const char16_t* input, size_t length, std::string& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length * utf8_per_utf16_max, output,
+        [&](char* buffer) { return utf16_to_utf8(input, length, buffer, validation); },
+        [&] { return required_length(input, length); });
+}
+
+utf_result helpers::utf32_to_utf8(const char32_t* input, size_t length, std::string& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length * utf8_per_utf32_max, output,
+        [&](char* buffer) { return utf32_to_utf8(input, length, buffer, validation); },
+        [&] { return required_length(input, length); });
+}
+
+utf_result helpers::utf8_to_wide(const char* input, size_t length, std::wstring& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length, output,
+        [&](wchar_t* buffer) { return utf8_to_wide(input, length, buffer, validation); },
+        [&] { return required_length<wchar_t>(input, length); });
+}
+
+utf_result helpers::wide_to_utf8(const wchar_t* input, size_t length, std::string& output,
+    utf_validation validation /*= utf_validation::validating*/)
+{
+    return convert_to_string(length * utf8_per_wide_max, output,
+        [&](char* buffer) { return wide_to_utf8(input, length, buffer, validation); },
+        [&] { return required_length(input, length); });
+}
+
+template <>
+packed_strings<char16_t> helpers::transcode_batch<char16_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<char16_t>(inputs, count, pool,
+        [validation](const char* input, size_t length, char16_t* output) { return utf8_to_utf16(input, length, output, validation); },
+        [](const char* input, size_t length) { return required_length<char16_t>(input, length); });
+}
+
+template <>
+packed_strings<char32_t> helpers::transcode_batch<char32_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<char32_t>(inputs, count, pool,
+        [validation](const char* input, size_t length, char32_t* output) { return utf8_to_utf32(input, length, output, validation); },
+        [](const char* input, size_t length) { return required_length<char32_t>(input, length); });
+}
+
+template <>
+packed_strings<wchar_t> helpers::transcode_batch<wchar_t>(const std::string_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<wchar_t>(inputs, count, pool,
+        [validation](const char* input, size_t length, wchar_t* output) { return utf8_to_wide(input, length, output, validation); },
+        [](const char* input, size_t length) { return required_length<wchar_t>(input, length); });
+}
+
+packed_strings<char> helpers::transcode_batch(const std::u16string_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<char>(inputs, count, pool,
+        [validation](const char16_t* input, size_t length, char* output) { return utf16_to_utf8(input, length, output, validation); },
+        [](const char16_t* input, size_t length) { return required_length(input, length); });
+}
+
+packed_strings<char> helpers::transcode_batch(const std::u32string_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<char>(inputs, count, pool,
+        [validation](const char32_t* input, size_t length, char* output) { return utf32_to_utf8(input, length, output, validation); },
+        [](const char32_t* input, size_t length) { return required_length(input, length); });
+}
+
+packed_strings<char> helpers::transcode_batch(const std::wstring_view* inputs, size_t count,
+    thread_pool* pool /*= nullptr*/, utf_validation validation /*= utf_validation::validating*/)
+{
+    return transcode_batch_impl<char>(inputs, count, pool,
+        [validation](const wchar_t* input, size_t length, char* output) { return wide_to_utf8(input, length, output, validation); },
+        [](const wchar_t* input, size_t length) { return required_length(input, length); });
+}
@@ -1,4 +1,5 @@
 #include <winapi-helpers/utilities.h>
+#include <winapi-helpers/utf_transcoder.h>
 #include <stdexcept>
 #include <locale>
 #include <codecvt>
@@ -26,34 +27,32 @@ void helpers::set_console_ctrl_handler(PHANDLER_ROUTINE ctrl_handler)
 
 std::string helpers::wstring_to_utf8(const std::wstring &var)
 {
-    static std::locale loc("");
-    try {
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> cv;
-        return cv.to_bytes(var);
-    }
-    catch (const std::system_error& e) {
-        return std::string{};
-    }
-    catch (const std::exception& e) {
-        return std::string{};
-    }
-    return std::string{};
+    std::string result;
+    wstring_to_utf8(var.data(), var.size(), result);
+    return result;
 }
 
 std::wstring helpers::utf8_to_wstring(const std::string &var)
 {
-    static std::locale loc("");
-    try {
-        std::wstring_convert<std::codecvt_utf8<wchar_t>> cv;
-        return cv.from_bytes(var);
-    }
-    catch (const std::system_error& e) {
-        return std::wstring{};
+    std::wstring result;
+    utf8_to_wstring(var.data(), var.size(), result);
+    return result;
+}
+
+size_t helpers::wstring_to_utf8(const wchar_t* var, size_t length, std::string& result)
+{
+    if (!wide_to_utf8(var, length, result)) {
+        result.clear();
     }
-    catch (const std::exception& e) {
-        return std::wstring{};
+    return result.size();
+}
+
+size_t helpers::utf8_to_wstring(const char* var, size_t length, std::wstring& result)
+{
+    if (!utf8_to_wide(var, length, result)) {
+        result.clear();
     }
-    return std::wstring{};
+    return result.size();
 }
 
 std::string helpers::wstring_to_string(const std::wstring &var)
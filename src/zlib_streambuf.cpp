@@ -0,0 +1,509 @@
+#include <winapi-helpers/zlib_streambuf.h>
+#include <zlib.h>
+#include <algorithm>
+
+using namespace helpers;
+
+namespace {
+
+/// setg() and pbump() take int, so the buffers should not exceed INT_MAX
+constexpr size_t max_buffer_size = size_t(1) << 30;
+
+/// Single inflate() or deflate() call limit, avail_in and avail_out are uInt
+constexpr size_t max_zlib_chunk = size_t(1) << 30;
+
+/// Reads and writes of this size are inflated or deflated in place, not through the buffer
+constexpr size_t direct_threshold = 64 * 1024;
+
+/// windowBits of inflateInit2() and deflateInit2() selecting the container, the window is always the largest
+int window_bits(zlib_format format)
+{
+    switch (format) {
+    case zlib_format::zlib:
+        return MAX_WBITS;
+    case zlib_format::raw:
+        return -MAX_WBITS;
+    default:
+        return 16 + MAX_WBITS;
+    }
+}
+
+/// Check whether the bytes start the gzip member
+bool is_gzip_header(byte_view head)
+{
+    return head.size() >= 2 && 0x1F == head[0] && 0x8B == head[1];
+}
+
+/// Check whether the bytes start the zlib stream: deflate method, window up to 32 KB, valid check bits
+bool is_zlib_header(byte_view head)
+{
+    return head.size() >= 2 && 8 == (head[0] & 0x0F) && (head[0] >> 4) <= 7 && 0 == (head[0] * 256 + head[1]) % 31;
+}
+
+} // namespace
+
+
+zlib_istreambuf::zlib_istreambuf() = default;
+
+zlib_istreambuf::~zlib_istreambuf()
+{
+    close();
+}
+
+bool zlib_istreambuf::open(std::basic_streambuf<std::uint8_t>* source, zlib_format format /*= zlib_format::automatic*/,
+    size_t buffer_size /*= byte_stream_buffer_size*/)
+{
+    close();
+    if (!source) {
+        return false;
+    }
+
+    start(format, buffer_size);
+    source_ = source;
+    windows_ = dynamic_cast<byte_istreambuf*>(source);
+    if (!windows_) {
+        input_buffer_ = make_aligned_buffer(buffer_size_);
+        if (!input_buffer_) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool zlib_istreambuf::open(byte_view data, zlib_format format /*= zlib_format::automatic*/,
+    size_t buffer_size /*= byte_stream_buffer_size*/)
+{
+    close();
+    start(format, buffer_size);
+
+    // the whole input is the only window
+    input_ = data;
+    input_end_ = true;
+    return true;
+}
+
+void zlib_istreambuf::close()
+{
+    if (stream_ && detected_ && zlib_format::none != format_) {
+        inflateEnd(stream_.get());
+    }
+    stream_.reset();
+    source_ = nullptr;
+    windows_ = nullptr;
+    input_ = byte_view();
+    input_end_ = false;
+    input_buffer_.reset();
+    head_.clear();
+    buffer_.reset();
+    buffer_size_ = 0;
+    format_ = zlib_format::automatic;
+    detected_ = false;
+    finished_ = false;
+    failed_ = false;
+    buffer_offset_ = 0;
+    setg(nullptr, nullptr, nullptr);
+}
+
+bool zlib_istreambuf::is_open() const
+{
+    return static_cast<bool>(stream_);
+}
+
+zlib_format zlib_istreambuf::format() const
+{
+    return format_;
+}
+
+bool zlib_istreambuf::failed() const
+{
+    return failed_;
+}
+
+byte_view zlib_istreambuf::next_window(size_t max_length /*= static_cast<size_t>(-1)*/)
+{
+    if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+        return byte_view();
+    }
+
+    const size_t length = std::min(max_length, static_cast<size_t>(egptr() - gptr()));
+    byte_view window(gptr(), length);
+    setg(eback(), gptr() + length, egptr());
+    return window;
+}
+
+zlib_istreambuf::int_type zlib_istreambuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (!is_open() || (!detected_ && !detect())) {
+        return traits_type::eof();
+    }
+
+    buffer_offset_ += static_cast<std::uint64_t>(egptr() - eback());
+
+    // passed through input is handed over as is, the get area refers the source window
+    if (zlib_format::none == format_) {
+        if (!fill_input()) {
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+        const size_t length = std::min(input_.size(), max_buffer_size);
+        char_type* window = const_cast<char_type*>(input_.data());
+        input_.remove_prefix(length);
+        setg(window, window, window + length);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (!buffer_) {
+        buffer_ = make_aligned_buffer(buffer_size_);
+        if (!buffer_) {
+            failed_ = true;
+            return traits_type::eof();
+        }
+    }
+
+    const size_t produced = produce(buffer_.get(), buffer_size_);
+    setg(buffer_.get(), buffer_.get(), buffer_.get() + produced);
+    return (0 == produced) ? traits_type::eof() : traits_type::to_int_type(*gptr());
+}
+
+std::streamsize zlib_istreambuf::xsgetn(char_type* s, std::streamsize count)
+{
+    std::streamsize copied = 0;
+    while (copied < count) {
+        const std::streamsize available = egptr() - gptr();
+        if (available > 0) {
+            const std::streamsize length = std::min(available, count - copied);
+            traits_type::copy(s + copied, gptr(), static_cast<size_t>(length));
+            setg(eback(), gptr() + length, egptr());
+            copied += length;
+            continue;
+        }
+
+        if (!is_open() || (!detected_ && !detect())) {
+            break;
+        }
+
+        // large read is inflated directly into the destination, without copying through the buffer
+        const size_t remaining = static_cast<size_t>(count - copied);
+        if (zlib_format::none != format_ && remaining >= std::min(buffer_size_, direct_threshold)) {
+            buffer_offset_ += static_cast<std::uint64_t>(egptr() - eback());
+            setg(buffer_.get(), buffer_.get(), buffer_.get());
+
+            const size_t produced = produce(s + copied, remaining);
+            buffer_offset_ += produced;
+            copied += static_cast<std::streamsize>(produced);
+            if (0 == produced) {
+                break;
+            }
+            continue;
+        }
+
+        if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+            break;
+        }
+    }
+    return copied;
+}
+
+zlib_istreambuf::pos_type zlib_istreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which /*= std::ios_base::in*/)
+{
+    // the stream is not seekable, only tellg() is supported
+    if (!is_open() || !(which & std::ios_base::in) || std::ios_base::cur != dir || 0 != off) {
+        return pos_type(off_type(-1));
+    }
+    return pos_type(off_type(buffer_offset_ + static_cast<std::uint64_t>(gptr() - eback())));
+}
+
+void zlib_istreambuf::start(zlib_format format, size_t buffer_size)
+{
+    // inflate is initialized by the first read, when the format is known
+    stream_ = std::make_unique<z_stream_s>();
+    format_ = format;
+    buffer_size_ = std::min(std::max<size_t>(buffer_size, 1), max_buffer_size);
+}
+
+bool zlib_istreambuf::fill_input()
+{
+    if (!input_.empty()) {
+        return true;
+    }
+    if (input_end_) {
+        return false;
+    }
+
+    if (windows_) {
+        input_ = windows_->next_window(max_zlib_chunk);
+    }
+    else {
+        const std::streamsize read = source_->sgetn(input_buffer_.get(), static_cast<std::streamsize>(buffer_size_));
+        input_ = byte_view(input_buffer_.get(), static_cast<size_t>(std::max<std::streamsize>(read, 0)));
+    }
+    input_end_ = input_.empty();
+    return !input_end_;
+}
+
+bool zlib_istreambuf::detect()
+{
+    // the header could be split between the first windows, its bytes are collected then
+    fill_input();
+    if (input_.size() < 2 && !input_end_) {
+        head_.assign(input_.begin(), input_.end());
+        input_ = byte_view();
+        while (head_.size() < 2 && fill_input()) {
+            head_.insert(head_.end(), input_.begin(), input_.end());
+            input_ = byte_view();
+        }
+        input_ = byte_view(head_.data(), head_.size());
+    }
+
+    if (zlib_format::automatic == format_) {
+        format_ = is_gzip_header(input_) ? zlib_format::gzip :
+            is_zlib_header(input_) ? zlib_format::zlib : zlib_format::none;
+    }
+    detected_ = true;
+    if (zlib_format::none == format_) {
+        return true;
+    }
+
+    if (Z_OK != inflateInit2(stream_.get(), window_bits(format_))) {
+        // nothing is allocated by the failed init, the stream is not ended
+        format_ = zlib_format::none;
+        failed_ = true;
+        finished_ = true;
+        return false;
+    }
+    return true;
+}
+
+size_t zlib_istreambuf::produce(std::uint8_t* destination, size_t size)
+{
+    if (zlib_format::none == format_) {
+        size_t copied = 0;
+        while (copied < size && fill_input()) {
+            const size_t length = std::min(size - copied, input_.size());
+            traits_type::copy(destination + copied, input_.data(), length);
+            input_.remove_prefix(length);
+            copied += length;
+        }
+        return copied;
+    }
+
+    z_stream_s& stream = *stream_;
+    stream.next_out = destination;
+    stream.avail_out = static_cast<uInt>(std::min(size, max_zlib_chunk));
+    const uInt capacity = stream.avail_out;
+    while (!finished_ && stream.avail_out > 0) {
+        if (!fill_input()) {
+            // the source is over in the middle of the stream
+            failed_ = true;
+            finished_ = true;
+            break;
+        }
+
+        const uInt available = static_cast<uInt>(std::min(input_.size(), max_zlib_chunk));
+        stream.next_in = const_cast<Bytef*>(input_.data());
+        stream.avail_in = available;
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        input_.remove_prefix(available - stream.avail_in);
+
+        if (Z_STREAM_END == status) {
+            // the next gzip member continues the stream, anything else after it is ignored like gunzip does
+            finished_ = zlib_format::gzip != format_ || !fill_input() || 0x1F != input_[0] ||
+                Z_OK != inflateReset(&stream);
+            continue;
+        }
+        if (Z_OK != status && Z_BUF_ERROR != status) {
+            failed_ = true;
+            finished_ = true;
+        }
+    }
+    return capacity - stream.avail_out;
+}
+
+
+zlib_ostreambuf::zlib_ostreambuf() = default;
+
+zlib_ostreambuf::~zlib_ostreambuf()
+{
+    close();
+}
+
+bool zlib_ostreambuf::open(std::basic_streambuf<std::uint8_t>* target, zlib_format format /*= zlib_format::gzip*/,
+    int level /*= -1*/, size_t buffer_size /*= byte_stream_buffer_size*/)
+{
+    close();
+    if (!target) {
+        return false;
+    }
+
+    format_ = (zlib_format::automatic == format) ? zlib_format::gzip : format;
+    buffer_size_ = std::min(std::max<size_t>(buffer_size, 1), max_buffer_size);
+    buffer_ = make_aligned_buffer(buffer_size_);
+    if (zlib_format::none != format_) {
+        output_ = make_aligned_buffer(buffer_size_);
+    }
+    if (!buffer_ || (zlib_format::none != format_ && !output_)) {
+        close();
+        return false;
+    }
+
+    // the largest window and hash, zlib takes about 650 KB for them
+    stream_ = std::make_unique<z_stream_s>();
+    if (zlib_format::none != format_ &&
+        Z_OK != deflateInit2(stream_.get(), level, Z_DEFLATED, window_bits(format_), MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY)) {
+        stream_.reset();
+        close();
+        return false;
+    }
+
+    target_ = target;
+    setp(buffer_.get(), buffer_.get() + buffer_size_);
+    return true;
+}
+
+bool zlib_ostreambuf::close()
+{
+    bool result = true;
+    if (is_open()) {
+        result = flush_buffer(Z_FINISH) && 0 == target_->pubsync();
+        if (zlib_format::none != format_) {
+            deflateEnd(stream_.get());
+        }
+    }
+
+    stream_.reset();
+    target_ = nullptr;
+    buffer_.reset();
+    output_.reset();
+    buffer_size_ = 0;
+    format_ = zlib_format::gzip;
+    failed_ = false;
+    buffer_offset_ = 0;
+    setp(nullptr, nullptr);
+    return result;
+}
+
+bool zlib_ostreambuf::is_open() const
+{
+    return static_cast<bool>(stream_);
+}
+
+zlib_ostreambuf::int_type zlib_ostreambuf::overflow(int_type ch)
+{
+    if (!is_open() || !flush_buffer(Z_NO_FLUSH)) {
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize zlib_ostreambuf::xsputn(const char_type* s, std::streamsize count)
+{
+    if (!is_open() || count <= 0) {
+        return 0;
+    }
+
+    const bool direct = static_cast<size_t>(count) >= std::min(buffer_size_, direct_threshold);
+    if (!direct && count <= epptr() - pptr()) {
+        traits_type::copy(pptr(), s, static_cast<size_t>(count));
+        pbump(static_cast<int>(count));
+        return count;
+    }
+
+    if (!flush_buffer(Z_NO_FLUSH)) {
+        return 0;
+    }
+
+    // large write is deflated directly from the caller's memory, without copying through the buffer
+    if (direct) {
+        if (!consume(s, static_cast<size_t>(count), Z_NO_FLUSH)) {
+            return 0;
+        }
+        buffer_offset_ += static_cast<std::uint64_t>(count);
+        return count;
+    }
+
+    traits_type::copy(pptr(), s, static_cast<size_t>(count));
+    pbump(static_cast<int>(count));
+    return count;
+}
+
+int zlib_ostreambuf::sync()
+{
+    if (!is_open() || !flush_buffer(Z_SYNC_FLUSH)) {
+        return -1;
+    }
+    return target_->pubsync();
+}
+
+zlib_ostreambuf::pos_type zlib_ostreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which /*= std::ios_base::out*/)
+{
+    // the stream is not seekable, only tellp() is supported
+    if (!is_open() || !(which & std::ios_base::out) || std::ios_base::cur != dir || 0 != off) {
+        return pos_type(off_type(-1));
+    }
+    return pos_type(off_type(buffer_offset_ + static_cast<std::uint64_t>(pptr() - pbase())));
+}
+
+bool zlib_ostreambuf::consume(const std::uint8_t* data, size_t size, int flush)
+{
+    if (failed_) {
+        return false;
+    }
+
+    if (zlib_format::none == format_) {
+        failed_ = target_->sputn(data, static_cast<std::streamsize>(size)) != static_cast<std::streamsize>(size);
+        return !failed_;
+    }
+
+    z_stream_s& stream = *stream_;
+    do {
+        const size_t chunk = std::min(size, max_zlib_chunk);
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = static_cast<uInt>(chunk);
+        data += chunk;
+        size -= chunk;
+
+        // the last chunk carries the flush, the output is written block by block
+        const int mode = (0 == size) ? flush : Z_NO_FLUSH;
+        int status = Z_OK;
+        do {
+            stream.next_out = output_.get();
+            stream.avail_out = static_cast<uInt>(buffer_size_);
+            status = deflate(&stream, mode);
+            if (Z_STREAM_ERROR == status) {
+                failed_ = true;
+                return false;
+            }
+
+            const std::streamsize produced = static_cast<std::streamsize>(buffer_size_ - stream.avail_out);
+            if (produced > 0 && target_->sputn(output_.get(), produced) != produced) {
+                failed_ = true;
+                return false;
+            }
+        } while (0 != stream.avail_in || 0 == stream.avail_out || (Z_FINISH == mode && Z_STREAM_END != status));
+    } while (size > 0);
+    return true;
+}
+
+bool zlib_ostreambuf::flush_buffer(int flush)
+{
+    const size_t size = static_cast<size_t>(pptr() - pbase());
+    if (0 == size && Z_NO_FLUSH == flush) {
+        return !failed_;
+    }
+
+    const bool result = consume(pbase(), size, flush);
+    buffer_offset_ += size;
+    setp(buffer_.get(), buffer_.get() + buffer_size_);
+    return result;
+}
@@ -1,5 +1,7 @@
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 #include <winapi-helpers/win_special_path_helper.h>
 #include <winapi-helpers/win_ptrs.h>
 #include <winapi-helpers/win_errors.h>
@@ -8,6 +10,20 @@
 #include <winapi-helpers/system_information.h>
 #include <winapi-helpers/win_user_information.h>
 #include <winapi-helpers/win_partition_information.h>
+#include <winapi-helpers/static_handler_map.h>
+#include <winapi-helpers/concurrent_handler_map.h>
+#include <winapi-helpers/utf_transcoder.h>
+#include <winapi-helpers/byte_streambuf.h>
+#include <winapi-helpers/async_file_reader.h>
+#include <winapi-helpers/gzip_writer.h>
+#include <winapi-helpers/zlib_streambuf.h>
+#include <winapi-helpers/seekable_archive.h>
+#include <winapi-helpers/sqlite3_helper.h>
+#include <winapi-helpers/sqlite3_batch_writer.h>
+#include <winapi-helpers/sqlite3_pool.h>
+#include <winapi-helpers/sqlite3_kv_store.h>
+#include <zlib.h>
+#include <boost/filesystem.hpp>
 
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/unit_test.hpp>
@@ -468,3 +484,1982 @@ BOOST_AUTO_TEST_SUITE(RegistryHelperFunctionalTests);
 BOOST_AUTO_TEST_SUITE_END()
 
 #pragma endregion
+
+#pragma region HandlerMapTests
+
+BOOST_AUTO_TEST_SUITE(HandlerMapTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+enum class TestCommand { Start = 1, Stop = 2, Restart = 3, Shutdown = 100000 };
+
+int start_command(int param) { return param + 1; }
+int stop_command(int param) { return param * 2; }
+
+struct RestartCommand
+{
+    int operator()(int param) const { return param - 1; }
+};
+
+using TestStaticMap = StaticHandlerMap<TestCommand, int(int), StaticHandlerList<
+    StaticHandler<TestCommand::Start, &start_command>,
+    StaticHandler<TestCommand::Stop, &stop_command>,
+    StaticFunctor<TestCommand::Restart, RestartCommand>,
+    StaticHandler<TestCommand::Shutdown, nullptr>>>;
+
+///////////////////////////////////
+// Test cases
+
+BOOST_AUTO_TEST_CASE(StaticHandlerMapCallTest)
+{
+    static_assert(TestStaticMap::size() == 4, "Unexpected static handlers count");
+
+    BOOST_CHECK_EQUAL(TestStaticMap::call<TestCommand::Start>(1), 2);
+    BOOST_CHECK_EQUAL(TestStaticMap::call(TestCommand::Stop, 5), 10);
+    BOOST_CHECK_EQUAL(TestStaticMap::call(TestCommand::Restart, 5), 4);
+
+    // null handler, DefaultValuePolicy
+    BOOST_CHECK_EQUAL(TestStaticMap::call(TestCommand::Shutdown, 5), 0);
+
+    // no handler, ThrowPolicy
+    BOOST_CHECK_EQUAL(TestStaticMap::contains(static_cast<TestCommand>(50)), false);
+    BOOST_CHECK_THROW(TestStaticMap::call(static_cast<TestCommand>(50), 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentHandlerMapInsertTest)
+{
+    ConcurrentHandlerMap<int, std::function<int(int)>> handlers({ { 1, start_command } });
+    BOOST_CHECK_EQUAL(handlers.call(1, 1), 2);
+    BOOST_CHECK_THROW(handlers.call(2, 1), std::runtime_error);
+
+    // handler registers another handler from inside the read section
+    handlers.insert(3, [&handlers](int param) {
+        handlers.insert(2, stop_command);
+        return param;
+    });
+    BOOST_CHECK_EQUAL(handlers.call(3, 7), 7);
+    BOOST_CHECK_EQUAL(handlers.call(2, 5), 10);
+    BOOST_CHECK_EQUAL(handlers.size(), 3);
+
+    handlers.erase(3);
+    BOOST_CHECK_EQUAL(handlers.size(), 2);
+
+    // no readers left, all retired snapshots are deleted
+    BOOST_CHECK_EQUAL(handlers.reclaim(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(StringHandlerMapLookupTest)
+{
+    StringHandlerMap<std::function<int(int)>> handlers;
+    handlers("start", start_command)("stop", stop_command);
+
+    std::string_view start_key("start");
+    BOOST_CHECK_EQUAL(handlers.call(start_key, 1), 2);
+    BOOST_CHECK_EQUAL(handlers.call("stop", 5), 10);
+    BOOST_CHECK_THROW(handlers.call(std::string_view("restart"), 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(InternedHandlerMapTest)
+{
+    InternedHandlerMap<std::string, std::function<int(int)>> handlers;
+    auto start_id = handlers.insert("start", start_command);
+    auto stop_id = handlers.insert("stop", nullptr);
+
+    // re-registration keeps the id
+    BOOST_CHECK_EQUAL(handlers.insert("stop", stop_command), stop_id);
+    BOOST_CHECK_EQUAL(handlers.size(), 2);
+
+    auto found_id = handlers.find_id(std::string_view("start"));
+    BOOST_CHECK_EQUAL(found_id.has_value(), true);
+    BOOST_CHECK_EQUAL(found_id.value(), start_id);
+    BOOST_CHECK_EQUAL(handlers.find_id("restart").has_value(), false);
+
+    BOOST_CHECK_EQUAL(handlers.call_id(start_id, 1), 2);
+    BOOST_CHECK_EQUAL(handlers.call_id(stop_id, 5), 10);
+    BOOST_CHECK_EQUAL(handlers.call("stop", 5), 10);
+    BOOST_CHECK_THROW(handlers.call_id(100, 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(HandlerMapInsertFromHandlerTest)
+{
+    // the handler grows the map and reads its own state afterwards
+    InternedHandlerMap<int, std::function<int(int)>> interned;
+    const std::string name("grow");
+    interned.insert(0, [&interned, name](int count) {
+        for (int i = 1; i <= count; ++i) {
+            interned.insert(i, stop_command);
+        }
+        return static_cast<int>(name.size());
+    });
+    BOOST_CHECK_EQUAL(interned.call_id(0, 100), 4);
+    BOOST_CHECK_EQUAL(interned.size(), 101);
+    BOOST_CHECK_EQUAL(interned.call_id(100, 5), 10);
+
+    // the handler replaces itself
+    HandlerMap<int, std::function<int(int)>> handlers;
+    handlers.insert(1, [&handlers, name](int param) {
+        handlers.insert(1, start_command);
+        handlers.insert(2, stop_command);
+        return param + static_cast<int>(name.size());
+    });
+    BOOST_CHECK_EQUAL(handlers.call(1, 1), 5);
+    BOOST_CHECK_EQUAL(handlers.call(1, 1), 2);
+    BOOST_CHECK_EQUAL(handlers.call(2, 5), 10);
+}
+
+BOOST_AUTO_TEST_CASE(HandlerMapCallBatchTest)
+{
+    HandlerMap<int, std::function<std::string(int, const std::string&)>> handlers;
+    handlers(1, [](int number, const std::string& prefix) { return prefix + std::to_string(number); })
+        (2, nullptr)
+        (3, [](int number, const std::string&) { return std::to_string(-number); });
+
+    std::vector<std::pair<int, std::tuple<int, std::string>>> batch{
+        { 3, { 1, "a" } }, { 1, { 2, "b" } }, { 2, { 3, "c" } }, { 1, { 4, "d" } }, { 3, { 5, "e" } } };
+    std::vector<std::string> expected{ "-1", "b2", "", "d4", "-5" };
+
+    std::vector<std::string> results = handlers.call_batch(batch);
+    BOOST_CHECK_EQUAL_COLLECTIONS(results.begin(), results.end(), expected.begin(), expected.end());
+
+    thread_pool pool(4);
+    std::vector<std::string> pool_results = handlers.call_batch(batch, &pool);
+    BOOST_CHECK_EQUAL_COLLECTIONS(pool_results.begin(), pool_results.end(), expected.begin(), expected.end());
+
+    std::vector<std::pair<int, std::tuple<int, std::string>>> unknown_key{ { 1, { 1, "a" } }, { 7, { 1, "a" } } };
+    BOOST_CHECK_THROW(handlers.call_batch(unknown_key, &pool), std::runtime_error);
+
+    // the caller runs the groups itself if the workers are busy, stopped, or it is one of them
+    thread_pool busy(1);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    busy.enqueue([released] { released.wait(); });
+    pool_results = handlers.call_batch(batch, &busy);
+    BOOST_CHECK_EQUAL_COLLECTIONS(pool_results.begin(), pool_results.end(), expected.begin(), expected.end());
+    release.set_value();
+
+    std::future<std::vector<std::string>> nested = pool.enqueue([&] { return handlers.call_batch(batch, &pool); });
+    pool_results = nested.get();
+    BOOST_CHECK_EQUAL_COLLECTIONS(pool_results.begin(), pool_results.end(), expected.begin(), expected.end());
+
+    pool.stop();
+    pool_results = handlers.call_batch(batch, &pool);
+    BOOST_CHECK_EQUAL_COLLECTIONS(pool_results.begin(), pool_results.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(HandlerMapCallStatisticsTest)
+{
+    HandlerMap<std::string, std::function<int(int)>, ThrowPolicy, DefaultValuePolicy, std::less<>, CallStatistics> handlers;
+    handlers("start", start_command)("stop", nullptr);
+    handlers.statistics().set_sample_period(1);
+
+    for (int i = 0; i < 10; ++i) {
+        handlers.call("start", i);
+    }
+    handlers.call("stop", 1);
+    BOOST_CHECK_THROW(handlers.call("restart", 1), std::runtime_error);
+
+    BOOST_CHECK_THROW(handlers.call("reload", 1), std::runtime_error);
+
+    CallStatisticsSnapshot<std::string> snapshot = handlers.statistics().snapshot();
+    BOOST_CHECK_EQUAL(snapshot.handlers["start"].calls, 10);
+    BOOST_CHECK_EQUAL(snapshot.handlers["start"].sampled_calls, 10);
+    BOOST_CHECK_EQUAL(snapshot.handlers["stop"].calls, 0);
+    BOOST_CHECK_EQUAL(snapshot.handlers["stop"].null_handler_calls, 1);
+
+    // unknown keys are counted together, they do not add entries
+    BOOST_CHECK_EQUAL(snapshot.no_handler_calls, 2);
+    BOOST_CHECK_EQUAL(snapshot.handlers.size(), 2);
+
+    // the thread keeps counting into the right map while others are created and destroyed around it
+    for (int i = 0; i < 100; ++i) {
+        HandlerMap<std::string, std::function<int(int)>, ThrowPolicy, DefaultValuePolicy, std::less<>, CallStatistics> other;
+        other("start", start_command);
+        other.call("start", i);
+        handlers.call("start", i);
+        BOOST_CHECK_EQUAL(other.statistics().snapshot().handlers["start"].calls, 1);
+    }
+    BOOST_CHECK_EQUAL(handlers.statistics().snapshot().handlers["start"].calls, 110);
+
+    // the counters of the exited threads are merged, they do not keep the threads counters
+    for (int i = 0; i < 50; ++i) {
+        std::thread([&handlers, i] {
+            handlers.call("start", i);
+            try {
+                handlers.call("reload", i);
+            }
+            catch (const std::runtime_error&) {
+            }
+        }).join();
+    }
+    BOOST_CHECK_EQUAL(handlers.statistics().threads_count(), 2);
+    snapshot = handlers.statistics().snapshot();
+    BOOST_CHECK_EQUAL(snapshot.handlers["start"].calls, 160);
+    BOOST_CHECK_EQUAL(snapshot.no_handler_calls, 52);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#pragma region UtfTranscoderTests
+
+BOOST_AUTO_TEST_SUITE(UtfTranscoderTests);
+
+BOOST_AUTO_TEST_CASE(Utf8RoundTripTest)
+{
+    // long ASCII runs go through SIMD kernels, the rest through scalar path
+    std::string ascii(100, 'a');
+    std::string utf8 = ascii + "\xD0\x9F\xD1\x80\xD0\xB8\xE2\x82\xAC\xF0\x9F\x98\x80" + ascii + "z";
+
+    std::u16string utf16(utf8.size() * utf16_per_utf8_max, u'\0');
+    utf_result to16 = utf8_to_utf16(utf8.data(), utf8.size(), &utf16[0]);
+    BOOST_CHECK(to16);
+    BOOST_CHECK_EQUAL(to16.output_count, 100 + 3 + 1 + 2 + 100 + 1);
+    utf16.resize(to16.output_count);
+
+    std::u32string utf32(utf8.size() * utf32_per_utf8_max, U'\0');
+    utf_result to32 = utf8_to_utf32(utf8.data(), utf8.size(), &utf32[0]);
+    BOOST_CHECK(to32);
+    BOOST_CHECK_EQUAL(to32.output_count, 100 + 3 + 1 + 1 + 100 + 1);
+    utf32.resize(to32.output_count);
+    BOOST_CHECK(utf32[104] == U'\x1F600');
+
+    std::string from16(utf16.size() * utf8_per_utf16_max, '\0');
+    utf_result back16 = utf16_to_utf8(utf16.data(), utf16.size(), &from16[0]);
+    BOOST_CHECK(back16);
+    from16.resize(back16.output_count);
+    BOOST_CHECK_EQUAL(from16, utf8);
+
+    std::string from32(utf32.size() * utf8_per_utf32_max, '\0');
+    utf_result back32 = utf32_to_utf8(utf32.data(), utf32.size(), &from32[0]);
+    BOOST_CHECK(back32);
+    from32.resize(back32.output_count);
+    BOOST_CHECK_EQUAL(from32, utf8);
+}
+
+BOOST_AUTO_TEST_CASE(Utf8ErrorOffsetTest)
+{
+    // overlong '/'
+    std::string overlong("abc\xC0\xAF");
+    utf_result result = validate_utf8(overlong.data(), overlong.size());
+    BOOST_CHECK(result.status == utf_status::invalid_sequence);
+    BOOST_CHECK_EQUAL(result.input_offset, 3);
+
+    // encoded surrogate
+    std::string surrogate(std::string(40, 'x') + "\xED\xA0\x80");
+    result = validate_utf8(surrogate.data(), surrogate.size());
+    BOOST_CHECK(result.status == utf_status::invalid_sequence);
+    BOOST_CHECK_EQUAL(result.input_offset, 40);
+
+    std::string truncated("ab\xE2\x82");
+    std::u16string utf16(truncated.size(), u'\0');
+    result = utf8_to_utf16(truncated.data(), truncated.size(), &utf16[0]);
+    BOOST_CHECK(result.status == utf_status::truncated_sequence);
+    BOOST_CHECK_EQUAL(result.input_offset, 2);
+    BOOST_CHECK_EQUAL(result.output_count, 2);
+
+    // unpaired low surrogate
+    std::u16string unpaired{ u'a', static_cast<char16_t>(0xDC00), u'b' };
+    std::string utf8(unpaired.size() * utf8_per_utf16_max, '\0');
+    result = utf16_to_utf8(unpaired.data(), unpaired.size(), &utf8[0]);
+    BOOST_CHECK(result.status == utf_status::invalid_sequence);
+    BOOST_CHECK_EQUAL(result.input_offset, 1);
+
+    // non-validating mode passes it through
+    result = utf16_to_utf8(unpaired.data(), unpaired.size(), &utf8[0], utf_validation::non_validating);
+    BOOST_CHECK(result);
+    BOOST_CHECK_EQUAL(result.output_count, 5);
+}
+
+BOOST_AUTO_TEST_CASE(Utf8CallerBufferTest)
+{
+    std::string utf8 = std::string(50, 'a') + "\xD0\x9F\xE2\x82\xAC\xF0\x9F\x98\x80";
+    const size_t required16 = required_length<char16_t>(utf8.data(), utf8.size());
+    BOOST_CHECK_EQUAL(required16, 50 + 1 + 1 + 2);
+    BOOST_CHECK_EQUAL(required_length<char32_t>(utf8.data(), utf8.size()), 50 + 1 + 1 + 1);
+
+    // exact capacity is enough, one code unit less is not, and nothing is written
+    std::u16string utf16(required16, u'\0');
+    utf_result result = utf8_to_utf16(utf8.data(), utf8.size(), &utf16[0], required16 - 1);
+    BOOST_CHECK(result.status == utf_status::output_overflow);
+    BOOST_CHECK_EQUAL(result.output_count, required16);
+    BOOST_CHECK(utf16[0] == u'\0');
+
+    result = utf8_to_utf16(utf8.data(), utf8.size(), &utf16[0], required16);
+    BOOST_CHECK(result);
+    BOOST_CHECK_EQUAL(result.output_count, required16);
+    BOOST_CHECK_EQUAL(required_length(utf16.data(), utf16.size()), utf8.size());
+
+    // reusable buffer keeps its capacity between conversions
+    std::string buffer;
+    result = utf16_to_utf8(utf16.data(), utf16.size(), buffer);
+    BOOST_CHECK(result);
+    BOOST_CHECK_EQUAL(buffer, utf8);
+
+    const char* data = buffer.data();
+    std::u16string shorter(utf16.begin(), utf16.begin() + 10);
+    result = utf16_to_utf8(shorter.data(), shorter.size(), buffer);
+    BOOST_CHECK(result);
+    BOOST_CHECK_EQUAL(buffer, std::string(10, 'a'));
+    BOOST_CHECK(data == buffer.data());
+}
+
+BOOST_AUTO_TEST_CASE(TranscodeBatchTest)
+{
+    // large enough to be split across the pool
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 20000; ++i) {
+        names.push_back("key_" + std::to_string(i) + (i % 3 ? "\xD0\x9F\xE2\x82\xAC" : "\xF0\x9F\x98\x80"));
+    }
+    std::vector<std::string_view> views(names.begin(), names.end());
+
+    thread_pool pool(4);
+    for (thread_pool* p : { static_cast<thread_pool*>(nullptr), &pool }) {
+        packed_strings<char16_t> packed = transcode_batch<char16_t>(views, p);
+        BOOST_REQUIRE(packed);
+        BOOST_REQUIRE_EQUAL(packed.size(), names.size());
+        BOOST_CHECK_EQUAL(packed.offsets.back(), packed.data.size());
+
+        std::vector<std::u16string_view> utf16(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i) {
+            utf16[i] = packed[i];
+        }
+        packed_strings<char> back = transcode_batch(utf16, p);
+        BOOST_REQUIRE(back);
+        for (size_t i = 0; i < names.size(); ++i) {
+            BOOST_CHECK(back[i] == names[i]);
+        }
+    }
+
+    // the caller converts the ranges itself if it is the only worker of the pool, or the pool is stopped
+    const packed_strings<char16_t> expected = transcode_batch<char16_t>(views);
+    thread_pool single(1);
+    std::future<packed_strings<char16_t>> nested = single.enqueue([&] {
+        return transcode_batch<char16_t>(views, &single);
+    });
+    packed_strings<char16_t> converted = nested.get();
+    BOOST_CHECK(converted.offsets == expected.offsets);
+    BOOST_CHECK(converted.data == expected.data);
+
+    single.stop();
+    converted = transcode_batch<char16_t>(views, &single);
+    BOOST_CHECK(converted.offsets == expected.offsets);
+    BOOST_CHECK(converted.data == expected.data);
+
+    // the first ill-formed string is reported, no partial output
+    views[12345] = "bad \xC0\xAF";
+    packed_strings<wchar_t> failed = transcode_batch<wchar_t>(views, &pool);
+    BOOST_CHECK(failed.status == utf_status::invalid_sequence);
+    BOOST_CHECK_EQUAL(failed.failed_index, 12345);
+    BOOST_CHECK_EQUAL(failed.input_offset, 4);
+    BOOST_CHECK_EQUAL(failed.size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+
+#pragma region ByteStreamTests
+
+BOOST_AUTO_TEST_SUITE(ByteStreamTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+/// Temporary file removed at the end of the test
+struct TempFile
+{
+    TempFile() : path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()) {}
+
+    /// SQLite databases leave the WAL and the shared memory files next to the main one
+    ~TempFile()
+    {
+        boost::system::error_code ec;
+        for (const char* suffix : { "", "-wal", "-shm" }) {
+            boost::filesystem::remove(path.string() + suffix, ec);
+        }
+    }
+
+    boost::filesystem::path path;
+};
+
+} // namespace
+
+///////////////////////////////////
+// Test cases
+
+BOOST_AUTO_TEST_CASE(ByteStreamRoundTripTest)
+{
+    TempFile file;
+    std::vector<std::uint8_t> data(3 * 1000 * 1000 + 7);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 131 + i / 1000);
+    }
+
+    {
+        // small writes are buffered, large ones go directly to the file
+        byte_ofstream out(file.path.string(), false, 64 * 1024);
+        BOOST_REQUIRE(out.is_open());
+        out.put(data[0]);
+        out.write(data.data() + 1, 99);
+        out.write(data.data() + 100, 1000000);
+        out.write(data.data() + 1000100, data.size() - 1000100);
+        BOOST_CHECK_EQUAL(out.tellp(), data.size());
+        out.close();
+        BOOST_CHECK(out.good());
+    }
+
+    for (byte_read_mode mode : { byte_read_mode::buffered, byte_read_mode::mapped }) {
+        byte_ifstream in(file.path.string(), mode, 64 * 1024);
+        BOOST_REQUIRE(in.is_open());
+        BOOST_CHECK_EQUAL(in.rdbuf()->size(), data.size());
+        BOOST_CHECK_EQUAL(in.rdbuf()->is_mapped(), mode == byte_read_mode::mapped);
+
+        std::vector<std::uint8_t> read(data.size());
+        BOOST_CHECK_EQUAL(in.get(), data[0]);
+        in.read(read.data() + 1, 10);
+        in.read(read.data() + 11, read.size() - 11);
+        read[0] = data[0];
+        BOOST_CHECK_EQUAL(in.gcount(), read.size() - 11);
+        BOOST_CHECK(read == data);
+        BOOST_CHECK_EQUAL(in.get(), std::char_traits<std::uint8_t>::eof());
+
+        in.clear();
+        in.seekg(2000000);
+        BOOST_CHECK_EQUAL(in.tellg(), 2000000);
+        BOOST_CHECK_EQUAL(in.get(), data[2000000]);
+        in.seekg(-1, std::ios_base::end);
+        BOOST_CHECK_EQUAL(in.get(), data.back());
+
+        // windows cover the whole file without copying
+        in.seekg(0);
+        size_t offset = 0;
+        for (byte_view window = in.rdbuf()->next_window(100000); !window.empty();
+            window = in.rdbuf()->next_window(100000)) {
+            BOOST_REQUIRE(window.size() <= 100000);
+            BOOST_REQUIRE(std::equal(window.begin(), window.end(), data.begin() + offset));
+            offset += window.size();
+        }
+        BOOST_CHECK_EQUAL(offset, data.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ByteStreamAppendTest)
+{
+    TempFile file;
+    const std::uint8_t head[] = { 1, 2, 3 };
+    const std::uint8_t tail[] = { 4, 5 };
+    {
+        byte_ofstream out(file.path.string());
+        BOOST_REQUIRE(out.is_open());
+    }
+    {
+        byte_ifstream in(file.path.string(), byte_read_mode::mapped);
+        BOOST_REQUIRE(in.is_open());
+        BOOST_CHECK(in.rdbuf()->mapped_view().empty());
+        BOOST_CHECK_EQUAL(in.get(), std::char_traits<std::uint8_t>::eof());
+    }
+
+    byte_ofstream(file.path.string()).write(head, sizeof(head));
+    byte_ofstream appended(file.path.string(), true);
+    BOOST_CHECK_EQUAL(appended.tellp(), sizeof(head));
+    appended.write(tail, sizeof(tail));
+    appended.close();
+
+    byte_ifstream in(file.path.string(), byte_read_mode::mapped);
+    BOOST_CHECK(in.rdbuf()->mapped_view() == byte_view(reinterpret_cast<const std::uint8_t*>("\1\2\3\4\5"), 5));
+
+    byte_ifstream missing((file.path / "missing").string());
+    BOOST_CHECK(!missing);
+    BOOST_CHECK(!missing.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(AsyncFileReaderTest)
+{
+    TempFile file;
+    std::vector<std::uint8_t> data(1000 * 1000 + 3);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 7 + i / 4096);
+    }
+    byte_ofstream(file.path.string()).write(data.data(), data.size());
+
+    thread_pool pool(2);
+    std::vector<async_read_options> variants(3);
+    variants[0].backend = async_read_backend::pool;
+    variants[1].backend = async_read_backend::pool;
+    variants[1].pool = &pool;
+    variants[2].backend = async_read_backend::io_uring;
+    for (async_read_options& options : variants) {
+        options.block_size = 65536;
+        options.queue_depth = 3;
+
+        async_file_reader reader;
+        if (async_read_backend::io_uring == options.backend && !async_file_reader::io_uring_available()) {
+            BOOST_CHECK(!reader.open(file.path.string(), options));
+            continue;
+        }
+        BOOST_REQUIRE(reader.open(file.path.string(), options));
+        BOOST_CHECK(reader.backend() == options.backend);
+        BOOST_CHECK_EQUAL(reader.size(), data.size());
+
+        // blocks come in the file order, the last one is short
+        std::uint64_t expected = 0;
+        BOOST_CHECK(reader.read([&](std::uint64_t offset, byte_view block) {
+            BOOST_REQUIRE_EQUAL(offset, expected);
+            BOOST_REQUIRE_EQUAL(block.size(), std::min<std::uint64_t>(65536, data.size() - offset));
+            BOOST_REQUIRE(std::equal(block.begin(), block.end(), data.begin() + offset));
+            expected += block.size();
+            return true;
+        }));
+        BOOST_CHECK_EQUAL(expected, data.size());
+        BOOST_CHECK(reader.next_block().empty());
+        BOOST_CHECK(!reader.failed());
+
+        // restart in the middle, stop after the first block
+        BOOST_REQUIRE(reader.seek(500000));
+        size_t blocks = 0;
+        BOOST_CHECK(reader.read([&](std::uint64_t offset, byte_view block) {
+            BOOST_CHECK_EQUAL(offset, 500000);
+            BOOST_CHECK(std::equal(block.begin(), block.end(), data.begin() + 500000));
+            ++blocks;
+            return false;
+        }));
+        BOOST_CHECK_EQUAL(blocks, 1);
+    }
+
+    // the caller reads the blocks itself if it is the only worker of the pool, or the pool is stopped or cleared
+    thread_pool single(1);
+    async_read_options options;
+    options.backend = async_read_backend::pool;
+    options.block_size = 65536;
+    options.queue_depth = 3;
+    options.pool = &single;
+    auto read_all = [&](const std::function<void()>& after_first_block) {
+        async_file_reader reader;
+        if (!reader.open(file.path.string(), options)) {
+            return false;
+        }
+        std::uint64_t expected = 0;
+        const bool completed = reader.read([&](std::uint64_t offset, byte_view block) {
+            if (0 == offset) {
+                after_first_block();
+            }
+            const bool same = offset == expected && std::equal(block.begin(), block.end(), data.begin() + offset);
+            expected += block.size();
+            return same;
+        });
+        return completed && expected == data.size();
+    };
+    std::future<bool> nested = single.enqueue([&] { return read_all([] {}); });
+    BOOST_CHECK(nested.get());
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    single.enqueue([released] { released.wait(); });
+    BOOST_CHECK(read_all([&] { single.clear(); }));
+    release.set_value();
+
+    BOOST_CHECK(read_all([&] { single.stop(); }));
+    BOOST_CHECK(read_all([] {}));
+
+    async_file_reader missing;
+    BOOST_CHECK(!missing.open((file.path / "missing").string()));
+    BOOST_CHECK(missing.next_block().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#pragma region CompressionTests
+
+BOOST_AUTO_TEST_SUITE(CompressionTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+using ByteStreamTests::TempFile;
+
+/// Decompress the gzip stream with the reference zlib, false unless it is exactly one member
+bool reference_gunzip(const std::vector<std::uint8_t>& compressed, std::vector<std::uint8_t>& data)
+{
+    z_stream stream = {};
+    if (Z_OK != inflateInit2(&stream, 16 + MAX_WBITS)) {
+        return false;
+    }
+
+    data.clear();
+    std::uint8_t buffer[64 * 1024];
+    stream.next_in = const_cast<std::uint8_t*>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    int status = Z_OK;
+    while (Z_OK == status) {
+        stream.next_out = buffer;
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        data.insert(data.end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return Z_STREAM_END == status && 0 == stream.avail_in;
+}
+
+/// Log-like text with the repeats far apart, so the dictionaries of the blocks matter
+std::vector<std::uint8_t> make_log_text(size_t size)
+{
+    std::vector<std::uint8_t> text;
+    for (size_t i = 0; text.size() < size; ++i) {
+        const std::string line = "2024-05-" + std::to_string(10 + i % 20) + " pid=" + std::to_string(i * 7919 % 65536) +
+            " opened HKEY_LOCAL_MACHINE\\SOFTWARE\\Vendor\\Product" + std::to_string(i % 97) + "\n";
+        text.insert(text.end(), line.begin(), line.end());
+    }
+    text.resize(size);
+    return text;
+}
+
+} // namespace
+
+///////////////////////////////////
+// Test cases
+
+BOOST_AUTO_TEST_CASE(GzipWriterRoundTripTest)
+{
+    std::vector<std::uint8_t> data = make_log_text(1000 * 1000 + 17);
+    for (size_t i = 500000; i < 600000; ++i) {
+        data[i] = static_cast<std::uint8_t>((i * 2654435761u) >> 13);
+    }
+
+    thread_pool pool(3);
+    for (size_t block_size : { size_t(1), size_t(1000), size_t(64 * 1024), size_t(2 * 1024 * 1024) }) {
+        for (thread_pool* p : { static_cast<thread_pool*>(nullptr), &pool }) {
+            gzip_writer_options options;
+            options.block_size = block_size;
+            options.pool = p;
+            options.queue_depth = 5;
+
+            // a megabyte by one-byte blocks is too slow, the tiny blocks get the beginning only
+            const byte_view input(data.data(), (1 == block_size) ? 3000 : data.size());
+            std::vector<std::uint8_t> compressed;
+            BOOST_REQUIRE(gzip_compress(input, compressed, options));
+            BOOST_CHECK_EQUAL(compressed[0], 0x1F);
+            BOOST_CHECK_EQUAL(compressed[1], 0x8B);
+
+            std::vector<std::uint8_t> restored;
+            BOOST_REQUIRE(reference_gunzip(compressed, restored));
+            BOOST_REQUIRE(byte_view(restored.data(), restored.size()) == input);
+        }
+    }
+
+    // the dictionaries keep the ratio close to the single stream
+    gzip_writer_options options;
+    options.pool = &pool;
+    std::vector<std::uint8_t> compressed;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data(), data.size()), compressed, options));
+    uLongf single = compressBound(static_cast<uLong>(data.size()));
+    std::vector<std::uint8_t> reference(single);
+    BOOST_REQUIRE_EQUAL(compress(reference.data(), &single, data.data(), static_cast<uLong>(data.size())), Z_OK);
+    BOOST_CHECK_LT(compressed.size(), single + single / 50 + 1000);
+}
+
+BOOST_AUTO_TEST_CASE(GzipWriterStreamTest)
+{
+    const std::vector<std::uint8_t> data = make_log_text(300000);
+    thread_pool pool(2);
+    gzip_writer_options options;
+    options.block_size = 32 * 1024;
+    options.pool = &pool;
+
+    // pieces of any size are split into blocks, the output goes in order
+    std::vector<std::uint8_t> compressed;
+    gzip_writer writer;
+    BOOST_REQUIRE(writer.open([&compressed](byte_view piece) {
+        compressed.insert(compressed.end(), piece.begin(), piece.end());
+        return true;
+    }, options));
+    BOOST_CHECK(writer.is_open());
+    size_t offset = 0;
+    for (size_t piece = 1; offset < data.size(); piece = piece * 3 + 1) {
+        const size_t length = std::min(piece, data.size() - offset);
+        BOOST_REQUIRE(writer.write(byte_view(data.data() + offset, length)));
+        offset += length;
+    }
+    BOOST_CHECK(writer.close());
+    BOOST_CHECK(!writer.is_open());
+    BOOST_CHECK_EQUAL(writer.size(), data.size());
+    BOOST_CHECK_EQUAL(writer.compressed_size(), compressed.size());
+
+    std::vector<std::uint8_t> restored;
+    BOOST_REQUIRE(reference_gunzip(compressed, restored));
+    BOOST_CHECK(restored == data);
+
+    // the blocks the busy or stopped pool has not started are compressed by the writer
+    thread_pool busy(1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    busy.enqueue([opened] { opened.wait(); });
+    options.pool = &busy;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data(), data.size()), compressed, options));
+    gate.set_value();
+    BOOST_REQUIRE(reference_gunzip(compressed, restored));
+    BOOST_CHECK(restored == data);
+
+    thread_pool stopped(1);
+    options.pool = &stopped;
+    compressed.clear();
+    BOOST_REQUIRE(writer.open([&compressed](byte_view piece) {
+        compressed.insert(compressed.end(), piece.begin(), piece.end());
+        return true;
+    }, options));
+    BOOST_REQUIRE(writer.write(byte_view(data.data(), data.size() / 2)));
+    stopped.stop();
+    BOOST_REQUIRE(writer.write(byte_view(data.data() + data.size() / 2, data.size() - data.size() / 2)));
+    BOOST_CHECK(writer.close());
+    BOOST_REQUIRE(reference_gunzip(compressed, restored));
+    BOOST_CHECK(restored == data);
+    options.pool = &pool;
+
+    // empty input is the valid stream too
+    BOOST_REQUIRE(gzip_compress(byte_view(), compressed, options));
+    BOOST_REQUIRE(reference_gunzip(compressed, restored));
+    BOOST_CHECK(restored.empty());
+
+    // the failed output fails the writer
+    size_t calls = 0;
+    BOOST_REQUIRE(writer.open([&calls](byte_view) { return 0 == calls++; }, options));
+    writer.write(byte_view(data.data(), data.size()));
+    BOOST_CHECK(!writer.close());
+    BOOST_CHECK(writer.failed());
+    BOOST_CHECK(!writer.write(byte_view(data.data(), 1)));
+
+    options.level = 10;
+    BOOST_CHECK(!writer.open([](byte_view) { return true; }, options));
+}
+
+BOOST_AUTO_TEST_CASE(ZlibStreamRoundTripTest)
+{
+    const std::vector<std::uint8_t> data = make_log_text(2 * 1000 * 1000 + 5);
+    const zlib_format formats[] = { zlib_format::gzip, zlib_format::zlib, zlib_format::raw, zlib_format::none };
+    for (zlib_format format : formats) {
+        TempFile file;
+        {
+            // small writes are collected, large ones are deflated in place, flush keeps the stream valid
+            byte_ofstream target(file.path.string());
+            zlib_ostream out(target, format, 6, 64 * 1024);
+            BOOST_REQUIRE(out.is_open());
+            out.put(data[0]);
+            out.write(data.data() + 1, 999);
+            out.flush();
+            out.write(data.data() + 1000, 1000000);
+            out.write(data.data() + 1001000, data.size() - 1001000);
+            BOOST_CHECK_EQUAL(out.tellp(), data.size());
+            out.close();
+            BOOST_CHECK(out.good());
+        }
+
+        for (byte_read_mode mode : { byte_read_mode::buffered, byte_read_mode::mapped }) {
+            // raw deflate has no header, it is never detected
+            byte_ifstream source(file.path.string(), mode, 64 * 1024);
+            zlib_istream in(source, (zlib_format::raw == format) ? format : zlib_format::automatic, 64 * 1024);
+            BOOST_REQUIRE(in.is_open());
+
+            std::vector<std::uint8_t> read(data.size());
+            read[0] = static_cast<std::uint8_t>(in.get());
+            in.read(read.data() + 1, 10);
+            in.read(read.data() + 11, 500000);
+            BOOST_CHECK_EQUAL(in.tellg(), 500011);
+            in.read(read.data() + 500011, read.size() - 500011);
+            BOOST_CHECK_EQUAL(in.gcount(), read.size() - 500011);
+            BOOST_CHECK(read == data);
+            BOOST_CHECK_EQUAL(in.get(), std::char_traits<std::uint8_t>::eof());
+            BOOST_CHECK(in.rdbuf()->format() == format);
+            BOOST_CHECK(!in.rdbuf()->failed());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ZlibStreamInputTest)
+{
+    const std::vector<std::uint8_t> data = make_log_text(500000);
+
+    // multi-block gzip_writer output and concatenated members are read as one stream
+    std::vector<std::uint8_t> compressed;
+    gzip_writer_options options;
+    options.block_size = 64 * 1024;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data(), 300000), compressed, options));
+    std::vector<std::uint8_t> member;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data() + 300000, 200000), member, options));
+    compressed.insert(compressed.end(), member.begin(), member.end());
+
+    zlib_istreambuf buffer;
+    BOOST_REQUIRE(buffer.open(byte_view(compressed.data(), compressed.size()), zlib_format::automatic, 4096));
+    std::vector<std::uint8_t> read;
+    for (byte_view window = buffer.next_window(); !window.empty(); window = buffer.next_window()) {
+        BOOST_REQUIRE(window.size() <= 4096);
+        read.insert(read.end(), window.begin(), window.end());
+    }
+    BOOST_CHECK(read == data);
+    BOOST_CHECK(!buffer.failed());
+
+    // the source which does not give windows is read by blocks: zlib stream inside the gzip one
+    std::vector<std::uint8_t> nested;
+    uLongf nested_size = compressBound(static_cast<uLong>(data.size()));
+    nested.resize(nested_size);
+    BOOST_REQUIRE_EQUAL(compress(nested.data(), &nested_size, data.data(), static_cast<uLong>(data.size())), Z_OK);
+    BOOST_REQUIRE(gzip_compress(byte_view(nested.data(), nested_size), compressed, options));
+    zlib_istreambuf outer;
+    BOOST_REQUIRE(outer.open(byte_view(compressed.data(), compressed.size())));
+    std::basic_istream<std::uint8_t> in(&buffer);
+    BOOST_REQUIRE(buffer.open(&outer, zlib_format::automatic, 1000));
+    read.assign(data.size() + 1, 0);
+    in.read(read.data(), read.size());
+    BOOST_CHECK_EQUAL(in.gcount(), data.size());
+    BOOST_CHECK(std::equal(data.begin(), data.end(), read.begin()));
+    BOOST_CHECK(buffer.format() == zlib_format::zlib);
+    BOOST_CHECK(outer.format() == zlib_format::gzip);
+
+    // truncated and damaged streams deliver what they could and fail
+    compressed.resize(compressed.size() / 2);
+    BOOST_REQUIRE(buffer.open(byte_view(compressed.data(), compressed.size()), zlib_format::gzip));
+    in.clear();
+    in.read(read.data(), read.size());
+    BOOST_CHECK(in.gcount() > 0);
+    BOOST_CHECK(buffer.failed());
+    compressed[compressed.size() / 2] ^= 0x55;
+    compressed[compressed.size() / 2 + 1] ^= 0xAA;
+    BOOST_REQUIRE(buffer.open(byte_view(compressed.data(), compressed.size()), zlib_format::gzip));
+    in.clear();
+    in.read(read.data(), read.size());
+    BOOST_CHECK(buffer.failed());
+}
+
+BOOST_AUTO_TEST_CASE(ZlibStreamPassThroughTest)
+{
+    // uncompressed input is passed through as is, even by one-byte windows
+    const char* samples[] = { "", "x", "xml version", "\x1F" "binary" };
+    for (const char* sample : samples) {
+        TempFile file;
+        const std::string text(sample);
+        byte_ofstream(file.path.string()).write(reinterpret_cast<const std::uint8_t*>(text.data()), text.size());
+
+        byte_ifstream source(file.path.string(), byte_read_mode::buffered, 1);
+        zlib_istream in(source);
+        std::vector<std::uint8_t> read(text.size() + 1);
+        in.read(read.data(), read.size());
+        BOOST_CHECK_EQUAL(in.gcount(), text.size());
+        BOOST_CHECK(std::equal(text.begin(), text.end(), read.begin()));
+        BOOST_CHECK(in.rdbuf()->format() == zlib_format::none);
+        BOOST_CHECK(!in.rdbuf()->failed());
+    }
+
+    // gzip header split between one-byte windows is still detected
+    const std::vector<std::uint8_t> data = make_log_text(10000);
+    std::vector<std::uint8_t> compressed;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data(), data.size()), compressed));
+    TempFile file;
+    byte_ofstream(file.path.string()).write(compressed.data(), compressed.size());
+    byte_ifstream source(file.path.string(), byte_read_mode::buffered, 1);
+    zlib_istream in(source);
+    std::vector<std::uint8_t> read(data.size());
+    in.read(read.data(), read.size());
+    BOOST_CHECK(read == data);
+    BOOST_CHECK(in.rdbuf()->format() == zlib_format::gzip);
+
+    zlib_istream missing;
+    BOOST_CHECK(!missing.is_open());
+    BOOST_CHECK_EQUAL(missing.get(), std::char_traits<std::uint8_t>::eof());
+}
+
+BOOST_AUTO_TEST_CASE(ChecksumKernelTest)
+{
+    BOOST_TEST_MESSAGE("zlib SIMD checksums: " << ((zlib_simd_features() & Z_SIMD_CRC32) ? "CRC-32 " : "")
+        << ((zlib_simd_features() & Z_SIMD_ADLER32) ? "Adler-32" : ""));
+
+    const std::uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    BOOST_CHECK_EQUAL(crc32_z(0, check, sizeof(check)), 0xCBF43926u);
+    BOOST_CHECK_EQUAL(adler32_z(1, check, sizeof(check)), 0x091E01DEu);
+
+    // every length around the block sizes, at every alignment, and the long runs of 0xFF overflowing the sums
+    std::vector<std::uint8_t> data(200000 + 64);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>((i * 2654435761u) >> 13);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t length = 0; length < 300; ++length) {
+            for (size_t offset = 0; offset < 32; offset += 7) {
+                const std::uint8_t* buffer = data.data() + offset;
+                BOOST_REQUIRE_EQUAL(crc32_z(0x12345678, buffer, length), crc32_portable(0x12345678, buffer, length));
+                BOOST_REQUIRE_EQUAL(adler32_z(0xFFF0FFF0, buffer, length), adler32_portable(0xFFF0FFF0, buffer, length));
+            }
+        }
+        for (size_t length : { size_t(5552), size_t(5553), size_t(11104 + 31), size_t(65536 + 17), size_t(200000) }) {
+            BOOST_CHECK_EQUAL(crc32_z(0, data.data() + 3, length), crc32_portable(0, data.data() + 3, length));
+            BOOST_CHECK_EQUAL(adler32_z(1, data.data() + 3, length), adler32_portable(1, data.data() + 3, length));
+        }
+        std::fill(data.begin(), data.end(), 0xFF);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SeekableArchiveRoundTripTest)
+{
+    const std::vector<std::uint8_t> data = make_log_text(1000000);
+
+    // uneven writes, so the frames are cut across them
+    TempFile file;
+    seekable_archive_options options;
+    options.frame_size = 64 * 1024;
+    seekable_archive_writer writer;
+    {
+        byte_ofstream out(file.path.string());
+        BOOST_REQUIRE(writer.open(out, options));
+        for (size_t offset = 0; offset < data.size(); offset += 70001) {
+            const size_t length = std::min<size_t>(70001, data.size() - offset);
+            BOOST_REQUIRE(writer.write(byte_view(data.data() + offset, length)));
+        }
+        BOOST_REQUIRE(writer.close());
+    }
+    BOOST_CHECK_EQUAL(writer.size(), data.size());
+    BOOST_CHECK_EQUAL(writer.frames().size(), (data.size() + options.frame_size - 1) / options.frame_size);
+    BOOST_CHECK_EQUAL(writer.compressed_size(), boost::filesystem::file_size(file.path));
+
+    // the archive is the plain gzip file, the index members are empty
+    {
+        byte_ifstream source(file.path.string());
+        zlib_istream in(source);
+        std::vector<std::uint8_t> read(data.size() + 1);
+        in.read(read.data(), read.size());
+        BOOST_CHECK_EQUAL(in.gcount(), data.size());
+        BOOST_CHECK(std::equal(data.begin(), data.end(), read.begin()));
+        BOOST_CHECK(!in.rdbuf()->failed());
+    }
+
+    for (byte_read_mode mode : { byte_read_mode::mapped, byte_read_mode::buffered }) {
+        seekable_archive_ifstream in(file.path.string(), mode);
+        BOOST_REQUIRE(in.is_open());
+        BOOST_CHECK_EQUAL(in.rdbuf()->size(), data.size());
+        BOOST_CHECK_EQUAL(in.rdbuf()->frames().size(), writer.frames().size());
+
+        // random reads across the frame boundaries
+        std::vector<std::uint8_t> read(5000);
+        for (size_t i = 0; i < 200; ++i) {
+            const size_t offset = (i * 2654435761u) % data.size();
+            const size_t length = std::min(read.size(), data.size() - offset);
+            in.seekg(offset);
+            BOOST_REQUIRE_EQUAL(static_cast<size_t>(in.tellg()), offset);
+            in.read(read.data(), length);
+            BOOST_REQUIRE_EQUAL(static_cast<size_t>(in.gcount()), length);
+            BOOST_REQUIRE(std::equal(read.begin(), read.begin() + length, data.begin() + offset));
+            BOOST_REQUIRE_EQUAL(static_cast<size_t>(in.tellg()), offset + length);
+        }
+
+        // windows from the middle to the end
+        in.seekg(-300000, std::ios_base::end);
+        std::vector<std::uint8_t> tail;
+        for (byte_view window = in.rdbuf()->next_window(1000); !window.empty(); window = in.rdbuf()->next_window(1000)) {
+            BOOST_REQUIRE(window.size() <= 1000);
+            tail.insert(tail.end(), window.begin(), window.end());
+        }
+        BOOST_CHECK(std::equal(tail.begin(), tail.end(), data.end() - 300000, data.end()));
+        BOOST_CHECK_EQUAL(tail.size(), 300000);
+
+        in.seekg(0, std::ios_base::end);
+        BOOST_CHECK_EQUAL(static_cast<size_t>(in.tellg()), data.size());
+        BOOST_CHECK_EQUAL(in.get(), std::char_traits<std::uint8_t>::eof());
+        in.clear();
+        in.seekg(data.size() + 1);
+        BOOST_CHECK(in.fail());
+        BOOST_CHECK(!in.rdbuf()->failed());
+    }
+
+    // empty archive
+    std::vector<std::uint8_t> empty;
+    BOOST_REQUIRE(writer.open([&empty](byte_view piece) {
+        empty.insert(empty.end(), piece.begin(), piece.end());
+        return true;
+    }));
+    BOOST_REQUIRE(writer.close());
+    std::vector<std::uint8_t> unpacked;
+    BOOST_CHECK(reference_gunzip(empty, unpacked));
+    BOOST_CHECK(unpacked.empty());
+    seekable_archive_istreambuf buffer;
+    BOOST_REQUIRE(buffer.open(byte_view(empty.data(), empty.size())));
+    BOOST_CHECK_EQUAL(buffer.size(), 0);
+    BOOST_CHECK(buffer.next_window().empty());
+}
+
+BOOST_AUTO_TEST_CASE(SeekableArchiveDamageTest)
+{
+    const std::vector<std::uint8_t> data = make_log_text(300000);
+    std::vector<std::uint8_t> archive;
+    seekable_archive_options options;
+    options.frame_size = 100000;
+    seekable_archive_writer writer;
+    BOOST_REQUIRE(writer.open([&archive](byte_view piece) {
+        archive.insert(archive.end(), piece.begin(), piece.end());
+        return true;
+    }, options));
+    BOOST_REQUIRE(writer.write(byte_view(data.data(), data.size())));
+    BOOST_REQUIRE(writer.close());
+    BOOST_REQUIRE_EQUAL(writer.frames().size(), 3);
+
+    // the damaged frame fails alone, the others are still read
+    std::vector<std::uint8_t> damaged = archive;
+    damaged[writer.frames()[1].compressed_offset + 100] ^= 0x55;
+    seekable_archive_istreambuf buffer;
+    BOOST_REQUIRE(buffer.open(byte_view(damaged.data(), damaged.size())));
+    std::basic_istream<std::uint8_t> in(&buffer);
+    std::vector<std::uint8_t> read(options.frame_size);
+    in.read(read.data(), read.size());
+    BOOST_CHECK(read == std::vector<std::uint8_t>(data.begin(), data.begin() + options.frame_size));
+    BOOST_CHECK(!buffer.failed());
+    BOOST_CHECK_EQUAL(in.get(), std::char_traits<std::uint8_t>::eof());
+    BOOST_CHECK(buffer.failed());
+    in.clear();
+    in.seekg(options.frame_size + 10);
+    BOOST_CHECK(in.fail());
+    in.clear();
+    in.seekg(2 * options.frame_size);
+    in.read(read.data(), read.size());
+    BOOST_CHECK(read == std::vector<std::uint8_t>(data.begin() + 2 * options.frame_size, data.end()));
+
+    // the index is checked on open
+    const std::string text = "not an archive, just text long enough to hold the locator";
+    BOOST_CHECK(!buffer.open(byte_view(reinterpret_cast<const std::uint8_t*>(text.data()), text.size())));
+    BOOST_CHECK(!buffer.open(byte_view(archive.data(), archive.size() - 1)));
+    damaged = archive;
+    damaged[damaged.size() - 20] ^= 1;
+    BOOST_CHECK(!buffer.open(byte_view(damaged.data(), damaged.size())));
+    damaged = archive;
+    damaged[writer.compressed_size() - 42 - 10] ^= 1;
+    BOOST_CHECK(!buffer.open(byte_view(damaged.data(), damaged.size())));
+    std::vector<std::uint8_t> plain;
+    BOOST_REQUIRE(gzip_compress(byte_view(data.data(), data.size()), plain));
+    BOOST_CHECK(!buffer.open(byte_view(plain.data(), plain.size())));
+    BOOST_CHECK(!buffer.is_open());
+
+    TempFile missing;
+    seekable_archive_ifstream file(missing.path.string());
+    BOOST_CHECK(file.fail());
+    BOOST_CHECK(!file.is_open());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+
+
+#pragma region Sqlite3HelperTests
+
+BOOST_AUTO_TEST_SUITE(Sqlite3HelperTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+using ByteStreamTests::TempFile;
+
+} // namespace
+
+///////////////////////////////////
+// Test cases
+
+BOOST_AUTO_TEST_CASE(StatementBindColumnTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, value REAL, data BLOB)"), 0);
+
+    const std::uint8_t blob[] = { 0, 1, 2, 255 };
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?, ?, ?, ?)",
+            i, "name " + std::to_string(i), i * 0.5, byte_view(blob, sizeof(blob))), 0);
+    }
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?, ?, ?, ?)", 10, nullptr, nullptr, nullptr), 0);
+
+    sqlite3_statement select = db.prepare("SELECT id, name, value, data FROM t WHERE id >= ? ORDER BY id");
+    BOOST_REQUIRE(select);
+    BOOST_CHECK_EQUAL(select.parameter_count(), 1);
+    BOOST_CHECK_EQUAL(select.column_count(), 4);
+    BOOST_CHECK_EQUAL(select.bind(1, 5), 0);
+
+    int id = 5;
+    for (; select.next_row(); ++id) {
+        BOOST_CHECK_EQUAL(select.column<int>(0), id);
+        if (10 == id) {
+            BOOST_CHECK(select.is_null(1));
+            BOOST_CHECK(select.column<byte_view>(3).empty());
+            continue;
+        }
+        BOOST_CHECK_EQUAL(select.column<std::string_view>(1), "name " + std::to_string(id));
+        BOOST_CHECK_EQUAL(select.column<double>(2), id * 0.5);
+        BOOST_CHECK(select.column<byte_view>(3) == byte_view(blob, sizeof(blob)));
+    }
+    BOOST_CHECK_EQUAL(id, 11);
+    BOOST_CHECK(select);
+
+    // errors are reported as codes
+    BOOST_CHECK(!db.prepare("SELECT * FROM missing"));
+    BOOST_CHECK_NE(db.execute("INSERT INTO t (id) VALUES (?)", 1), 0);
+    BOOST_CHECK(!db);
+}
+
+BOOST_AUTO_TEST_CASE(StatementCacheTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE t (v INTEGER)"), 0);
+
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?)", i), 0);
+    }
+    sqlite3_statement_cache* cache = db.statement_cache();
+    BOOST_REQUIRE(cache);
+    BOOST_CHECK_EQUAL(cache->misses(), 1);
+    BOOST_CHECK_EQUAL(cache->hits(), 99);
+
+    {
+        // the statement in use leaves the cache, nested use of the same SQL gets another one
+        sqlite3_statement outer = db.prepare_cached("SELECT v FROM t ORDER BY v");
+        BOOST_CHECK_EQUAL(cache->size(), 1);
+        BOOST_REQUIRE(outer.next_row());
+        sqlite3_statement inner = db.prepare_cached("SELECT v FROM t ORDER BY v");
+        BOOST_REQUIRE(inner.next_row());
+        BOOST_CHECK_EQUAL(outer.column<int>(0), inner.column<int>(0));
+
+        // statements in use keep the database opened, idle ones are finalized
+        BOOST_CHECK_NE(db.close(), 0);
+        BOOST_CHECK_EQUAL(cache->size(), 0);
+    }
+    BOOST_CHECK_EQUAL(cache->size(), 1);
+
+    // least recently used statements are finalized
+    db.set_statement_cache_capacity(2);
+    for (int i = 0; i < 5; ++i) {
+        BOOST_CHECK(db.prepare_cached("SELECT " + std::to_string(i)));
+    }
+    BOOST_CHECK_EQUAL(cache->size(), 2);
+
+    sqlite3_helper moved(std::move(db));
+    BOOST_CHECK(!db.handle());
+    BOOST_CHECK_EQUAL(moved.execute("INSERT INTO t VALUES (?)", 100), 0);
+    BOOST_CHECK_EQUAL(moved.close(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BatchWriterTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE telemetry (id INTEGER, name TEXT, value REAL)"), 0);
+
+    auto count_rows = [&db] {
+        sqlite3_statement count = db.prepare("SELECT COUNT(*) FROM telemetry");
+        BOOST_REQUIRE(count.next_row());
+        return count.column<std::int64_t>(0);
+    };
+
+    sqlite3_batch_options options;
+    options.rows_per_transaction = 100;
+    options.rows_per_statement = 7;
+    options.max_delay = std::chrono::milliseconds(0);
+    {
+        sqlite3_batch_writer<std::int64_t, std::string, double> writer(db, "telemetry", { "id", "name", "value" }, options);
+        for (std::int64_t i = 0; i < 250; ++i) {
+            BOOST_CHECK_EQUAL(writer.write(i, "row " + std::to_string(i), i * 0.5), 0);
+        }
+        BOOST_CHECK_EQUAL(writer.committed(), 200);
+        BOOST_CHECK_EQUAL(writer.pending(), 50);
+
+        // the rest of rows is committed on destruction
+        BOOST_CHECK_EQUAL(writer.write(std::make_tuple(std::int64_t(250), std::string("tuple"), 0.0)), 0);
+    }
+    BOOST_CHECK_EQUAL(count_rows(), 251);
+
+    sqlite3_statement select = db.prepare("SELECT name, value FROM telemetry WHERE id = ?");
+    select.bind(1, 123);
+    BOOST_REQUIRE(select.next_row());
+    BOOST_CHECK_EQUAL(select.column<std::string_view>(0), "row 123");
+    BOOST_CHECK_EQUAL(select.column<double>(1), 61.5);
+    select = sqlite3_statement();
+
+    // the transaction older than max_delay is committed by the next write
+    options.rows_per_transaction = 1000;
+    options.max_delay = std::chrono::milliseconds(1);
+    sqlite3_batch_writer<int, std::string, double> delayed(db, "telemetry", { "id", "name", "value" }, options);
+    BOOST_CHECK_EQUAL(delayed.write(1000, "first", 1.0), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_CHECK_EQUAL(delayed.write(1001, "second", 2.0), 0);
+    BOOST_CHECK_EQUAL(delayed.pending(), 0);
+    BOOST_CHECK_EQUAL(delayed.committed(), 2);
+    BOOST_CHECK_EQUAL(count_rows(), 253);
+
+    // errors roll the transaction back
+    sqlite3_batch_writer<int> missing(db, "missing", { "id" }, options);
+    BOOST_CHECK_EQUAL(missing.write(1), 0);
+    BOOST_CHECK_EQUAL(missing.pending(), 1);
+    BOOST_CHECK_NE(missing.flush(), 0);
+    BOOST_CHECK_NE(missing.get_last_error(), 0);
+    BOOST_CHECK_EQUAL(missing.pending(), 0);
+    BOOST_CHECK_EQUAL(delayed.write(1002, "after error", 3.0), 0);
+    BOOST_CHECK_EQUAL(delayed.flush(), 0);
+    BOOST_CHECK_EQUAL(count_rows(), 254);
+}
+
+BOOST_AUTO_TEST_CASE(RowCursorTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE t (id INTEGER, name TEXT, value REAL, data BLOB)"), 0);
+
+    const std::uint8_t blob[] = { 0, 1, 2, 255 };
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?, ?, ?, ?)",
+            std::int64_t(i) << 40, "name " + std::to_string(i), i * 0.5, byte_view(blob, i % 5)), 0);
+    }
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?, ?, ?, ?)", nullptr, nullptr, nullptr, nullptr), 0);
+
+    std::int64_t id = 10;
+    for (const sqlite3_row& row : db.query("SELECT id, name, value, data FROM t WHERE id >= ? ORDER BY id", id << 40)) {
+        BOOST_CHECK_EQUAL(row.size(), 4);
+        BOOST_CHECK_EQUAL(row.as_int64(0), id << 40);
+        BOOST_CHECK_EQUAL(row.as_text(1), "name " + std::to_string(id));
+        BOOST_CHECK_EQUAL(row.as_double(2), id * 0.5);
+        BOOST_CHECK(row.as_blob(3) == byte_view(blob, id % 5));
+        BOOST_CHECK_EQUAL(row.get<int>(0), static_cast<int>(id << 40));
+        ++id;
+    }
+    BOOST_CHECK_EQUAL(id, 100);
+
+    // NULL row and column names
+    sqlite3_statement select = db.query("SELECT id AS key, name FROM t WHERE id IS NULL");
+    sqlite3_row_iterator it = select.begin();
+    BOOST_REQUIRE(it != select.end());
+    BOOST_CHECK_EQUAL(std::string(it->name(0)), "key");
+    BOOST_CHECK(it->is_null(0));
+    BOOST_CHECK(it->as_text(1).empty());
+    BOOST_CHECK(it->as_blob(1).empty());
+    BOOST_CHECK(++it == select.end());
+    BOOST_CHECK(select);
+
+    // the loop continues the partly read statement, reset() starts it again
+    select = db.query("SELECT id FROM t WHERE id IS NOT NULL");
+    BOOST_REQUIRE(select.next_row());
+    BOOST_CHECK_EQUAL(std::distance(select.begin(), select.end()), 99);
+    BOOST_CHECK_EQUAL(select.reset(), 0);
+    BOOST_CHECK_EQUAL(std::count_if(select.begin(), select.end(),
+        [](const sqlite3_row& row) { return row.as_int64(0) < (std::int64_t(50) << 40); }), 50);
+
+    // errors stop the loop
+    size_t rows = 0;
+    for (const sqlite3_row& row : db.query("SELECT id FROM missing")) {
+        (void) row;
+        ++rows;
+    }
+    BOOST_CHECK_EQUAL(rows, 0);
+    BOOST_CHECK(!db);
+
+    // exec() passes the context to the callback
+    std::vector<std::string> names;
+    BOOST_CHECK_EQUAL(db.exec("SELECT name FROM t WHERE id < 3 << 40 ORDER BY id", [](void* context, int, char** values, char**) {
+        static_cast<std::vector<std::string>*>(context)->push_back(values[0]);
+        return 0;
+    }, &names), 0);
+    BOOST_CHECK(names == std::vector<std::string>({ "name 0", "name 1", "name 2" }));
+}
+
+BOOST_AUTO_TEST_CASE(ConnectionPoolTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    {
+        sqlite3_pool_options options;
+        options.readers = 4;
+        sqlite3_pool pool;
+        BOOST_REQUIRE_EQUAL(pool.open(path.string(), options), 0);
+        BOOST_CHECK_EQUAL(pool.readers_count(), 4);
+
+        std::future<int> created = pool.write([](sqlite3_helper& db) {
+            db.exec("CREATE TABLE t (v INTEGER)");
+            sqlite3_batch_writer<int> writer(db, "t", { "v" });
+            for (int i = 0; i < 1000; ++i) {
+                writer.write(i);
+            }
+            return writer.flush();
+        });
+        BOOST_REQUIRE_EQUAL(created.get(), 0);
+
+        std::vector<std::future<std::int64_t>> sums;
+        for (int i = 0; i < 64; ++i) {
+            sums.push_back(pool.read([i](sqlite3_helper& db) {
+                std::int64_t sum = 0;
+                for (const sqlite3_row& row : db.query("SELECT v FROM t WHERE v % 64 = ?", i)) {
+                    sum += row.as_int64(0);
+                }
+                return sum;
+            }));
+        }
+        std::int64_t total = 0;
+        for (auto& sum : sums) {
+            total += sum.get();
+        }
+        BOOST_CHECK_EQUAL(total, 999 * 1000 / 2);
+
+        // readers are read-only and keep their snapshot while the writer commits
+        {
+            sqlite3_pool::reader_lease reader = pool.acquire_reader();
+            BOOST_REQUIRE(reader);
+            BOOST_CHECK_NE(reader->exec("INSERT INTO t VALUES (1)"), 0);
+
+            auto count = [&reader] {
+                sqlite3_statement select = reader->query("SELECT COUNT(*) FROM t");
+                return select.next_row() ? select.column<int>(0) : -1;
+            };
+            BOOST_CHECK_EQUAL(reader->exec("BEGIN"), 0);
+            BOOST_CHECK_EQUAL(count(), 1000);
+            BOOST_CHECK_EQUAL(pool.write([](sqlite3_helper& db) { return db.exec("INSERT INTO t VALUES (1000)"); }).get(), 0);
+            BOOST_CHECK_EQUAL(count(), 1000);
+            BOOST_CHECK_EQUAL(reader->exec("COMMIT"), 0);
+            BOOST_CHECK_EQUAL(count(), 1001);
+        }
+
+        // reads of the external thread pool
+        thread_pool threads(2);
+        options.readers = 2;
+        options.pool = &threads;
+        BOOST_REQUIRE_EQUAL(pool.open(path.string(), options), 0);
+        BOOST_CHECK_EQUAL(pool.read([](sqlite3_helper& db) { return db.is_valid(); }).get(), true);
+
+        // the stopped thread pool runs reads inline
+        threads.stop();
+        std::future<std::thread::id> inline_read = pool.read([](sqlite3_helper&) { return std::this_thread::get_id(); });
+        BOOST_CHECK(inline_read.get() == std::this_thread::get_id());
+
+        pool.close();
+        BOOST_CHECK(!pool.is_open());
+        BOOST_CHECK(!pool.acquire_reader());
+        BOOST_CHECK(!pool.write([](sqlite3_helper&) { return 0; }).valid());
+    }
+
+    // WAL mode needs the database file
+    sqlite3_pool memory;
+    BOOST_CHECK_NE(memory.open(":memory:"), 0);
+    BOOST_CHECK(!memory.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(OpenProfileTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    auto pragma = [](sqlite3_helper& db, const char* name) {
+        sqlite3_statement select = db.query(std::string("PRAGMA ") + name);
+        return select.next_row() ? select.column<std::string>(0) : std::string();
+    };
+    {
+        sqlite3_open_options options(sqlite3_profile::bulk_load);
+        options.page_size = 8192;
+        sqlite3_helper db(path.string().c_str(), options);
+        BOOST_REQUIRE(db);
+        BOOST_CHECK_EQUAL(pragma(db, "page_size"), "8192");
+        BOOST_CHECK_EQUAL(pragma(db, "journal_mode"), "wal");
+        BOOST_CHECK_EQUAL(pragma(db, "synchronous"), "0");
+        BOOST_CHECK_EQUAL(pragma(db, "cache_size"), "-65536");
+        BOOST_CHECK_EQUAL(pragma(db, "temp_store"), "2");
+        BOOST_CHECK_EQUAL(db.exec("CREATE TABLE t (v INTEGER)"), 0);
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO t VALUES (?)", 1), 0);
+    }
+    {
+        sqlite3_helper db(path.string().c_str(), sqlite3_profile::read_mostly);
+        BOOST_REQUIRE(db);
+        BOOST_CHECK_EQUAL(pragma(db, "synchronous"), "1");
+        BOOST_CHECK_EQUAL(pragma(db, "temp_store"), "2");
+        BOOST_CHECK_EQUAL(db.execute("SELECT v FROM t WHERE v = ?", 1), 0);
+        // PRAGMA optimize runs on close
+        BOOST_CHECK_EQUAL(db.close(), 0);
+
+        BOOST_REQUIRE_EQUAL(db.open(path.string().c_str(), sqlite3_profile::durable), 0);
+        BOOST_CHECK_EQUAL(pragma(db, "journal_mode"), "wal");
+        BOOST_CHECK_EQUAL(pragma(db, "synchronous"), "2");
+
+        sqlite3_open_options read_only;
+        read_only.read_only = true;
+        BOOST_REQUIRE_EQUAL(db.open(path.string().c_str(), read_only), 0);
+        BOOST_CHECK_EQUAL(pragma(db, "synchronous"), "2");
+        BOOST_CHECK_NE(db.exec("INSERT INTO t VALUES (2)"), 0);
+    }
+
+    // settings are applied to the opened database, errors are returned
+    sqlite3_open_options invalid;
+    invalid.journal_mode = "unknown mode";
+    sqlite3_helper db(":memory:", invalid);
+    BOOST_CHECK(db.handle());
+    BOOST_CHECK_NE(db.get_last_error(), 0);
+
+    sqlite3_open_options missing;
+    missing.read_only = true;
+    BOOST_CHECK_NE(db.open((path.string() + ".missing").c_str(), missing), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CoalescedWriteTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    {
+        sqlite3_pool_options options;
+        options.readers = 2;
+        sqlite3_pool pool;
+        BOOST_REQUIRE_EQUAL(pool.open(path.string(), options), 0);
+        BOOST_REQUIRE_EQUAL(pool.write([](sqlite3_helper& db) {
+            return db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT)");
+        }).get(), 0);
+
+        // the writer is busy, so the writes queued meanwhile go into one transaction
+        std::promise<void> unblock;
+        std::shared_future<void> blocked = unblock.get_future().share();
+        std::future<int> busy = pool.write([blocked](sqlite3_helper&) { blocked.wait(); return 0; });
+
+        std::vector<std::future<int>> results;
+        for (int i = 0; i < 100; ++i) {
+            results.push_back(pool.execute("INSERT INTO t VALUES (?, ?)", i, "name " + std::to_string(i)));
+        }
+        // failed writes are rolled back alone
+        std::future<int> duplicate = pool.execute("INSERT INTO t VALUES (?, ?)", 5, std::string("duplicate"));
+        std::future<int> thrown = pool.write_coalesced([](sqlite3_helper& db) -> int {
+            db.exec("INSERT INTO t VALUES (1000, 'thrown')");
+            throw std::runtime_error("write failed");
+        });
+        std::future<int> changes = pool.write_coalesced([](sqlite3_helper& db) {
+            sqlite3_statement count = db.query("SELECT COUNT(*) FROM t");
+            return (count.next_row() && 100 == count.column<int>(0)) ? 0 : 1;
+        });
+        unblock.set_value();
+
+        BOOST_CHECK_EQUAL(busy.get(), 0);
+        for (auto& result : results) {
+            BOOST_CHECK_EQUAL(result.get(), 0);
+        }
+        BOOST_CHECK_NE(duplicate.get(), 0);
+        BOOST_CHECK_THROW(thrown.get(), std::runtime_error);
+        BOOST_CHECK_EQUAL(changes.get(), 0);
+
+        std::future<int> count = pool.read([](sqlite3_helper& db) {
+            sqlite3_statement select = db.query("SELECT COUNT(*), SUM(name = 'duplicate') FROM t");
+            return (select.next_row() && 0 == select.column<int>(1)) ? select.column<int>(0) : -1;
+        });
+        BOOST_CHECK_EQUAL(count.get(), 100);
+
+        // the transaction fails to begin, every write gets its error
+        BOOST_REQUIRE_EQUAL(pool.write([](sqlite3_helper& db) { return db.exec("BEGIN"); }).get(), 0);
+        BOOST_CHECK_NE(pool.execute("INSERT INTO t VALUES (?, ?)", 200, std::string("in transaction")).get(), 0);
+        BOOST_REQUIRE_EQUAL(pool.write([](sqlite3_helper& db) { return db.exec("ROLLBACK"); }).get(), 0);
+
+        pool.close();
+        BOOST_CHECK(!pool.execute("DELETE FROM t").valid());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ProfilerTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_CHECK(!db.profiler());
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE a (x INTEGER, name TEXT); CREATE TABLE b (x INTEGER)"), 0);
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO a VALUES (?, ?)", i, "name " + std::to_string(99 - i)), 0);
+        BOOST_CHECK_EQUAL(db.execute("INSERT INTO b VALUES (?)", i % 10), 0);
+    }
+
+    sqlite3_profiler_options options;
+    options.slow_query_threshold = std::chrono::milliseconds(1);
+    sqlite3_profiler* profiler = db.enable_profiling(options);
+    BOOST_REQUIRE(profiler);
+
+    const char* scan = "SELECT name FROM a WHERE x >= ? ORDER BY name";
+    for (int i = 0; i < 10; ++i) {
+        size_t rows = 0;
+        for (const sqlite3_row& row : db.query(scan, 90)) {
+            rows += row.as_text(0).empty() ? 0 : 1;
+        }
+        BOOST_CHECK_EQUAL(rows, 10);
+    }
+    BOOST_CHECK_EQUAL(db.exec("SELECT COUNT(*) FROM a JOIN b ON a.x = b.x"), 0);
+    const char* slow = "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 1000000) SELECT SUM(x) + ? FROM c";
+    BOOST_CHECK_EQUAL(db.execute(slow, 42), 0);
+
+    std::vector<sqlite3_query_stats> stats = profiler->statistics();
+    auto find = [&stats](const char* sql) {
+        auto it = std::find_if(stats.begin(), stats.end(), [sql](const sqlite3_query_stats& s) { return s.sql == sql; });
+        BOOST_REQUIRE(it != stats.end());
+        return *it;
+    };
+
+    const sqlite3_query_stats scan_stats = find(scan);
+    BOOST_CHECK_EQUAL(scan_stats.executions, 10);
+    BOOST_CHECK_EQUAL(scan_stats.counters.rows_returned, 100);
+    BOOST_CHECK_EQUAL(scan_stats.counters.fullscan_steps, 10 * 99);
+    BOOST_CHECK_EQUAL(scan_stats.counters.sorts, 10);
+    BOOST_CHECK_GT(scan_stats.counters.vm_steps, 0);
+    BOOST_CHECK(scan_stats.max_time >= scan_stats.p99_time);
+    BOOST_CHECK(scan_stats.total_time >= scan_stats.max_time);
+
+    BOOST_CHECK_GT(find("SELECT COUNT(*) FROM a JOIN b ON a.x = b.x").counters.autoindex_rows, 0);
+
+    // the slowest query goes first and to the log with parameters
+    BOOST_CHECK_EQUAL(stats.front().sql, slow);
+    BOOST_REQUIRE(!profiler->slow_queries().empty());
+    const sqlite3_slow_query& logged = profiler->slow_queries().back();
+    BOOST_CHECK(logged.sql.find("SUM(x) + 42") != std::string::npos);
+    BOOST_CHECK(logged.time >= std::chrono::milliseconds(1));
+    BOOST_CHECK_EQUAL(logged.counters.rows_returned, 1);
+
+    profiler->reset();
+    BOOST_CHECK(profiler->statistics().empty());
+    BOOST_CHECK(profiler->slow_queries().empty());
+
+    // the callback gets slow queries instead of the log, the profiler survives reopening
+    std::vector<std::string> slow_sql;
+    options.on_slow_query = [&slow_sql](const sqlite3_slow_query& query) { slow_sql.push_back(query.sql); };
+    options.expand_slow_sql = false;
+    profiler = db.enable_profiling(options);
+    BOOST_REQUIRE_EQUAL(db.open(":memory:"), 0);
+    BOOST_CHECK_EQUAL(db.profiler(), profiler);
+    BOOST_CHECK_EQUAL(db.execute(slow, 42), 0);
+    BOOST_CHECK(slow_sql == std::vector<std::string>({ slow }));
+    BOOST_CHECK(profiler->slow_queries().empty());
+
+    db.disable_profiling();
+    BOOST_CHECK(!db.profiler());
+    BOOST_CHECK_EQUAL(db.execute(slow, 42), 0);
+    BOOST_CHECK_EQUAL(slow_sql.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(BackupSerializeTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    auto count_rows = [](sqlite3_helper& db) {
+        sqlite3_statement count = db.query("SELECT COUNT(*) FROM t");
+        return count.next_row() ? count.column<int>(0) : -1;
+    };
+
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE t (id INTEGER, name TEXT)"), 0);
+    {
+        sqlite3_batch_writer<int, std::string> writer(db, "t", { "id", "name" });
+        for (int i = 0; i < 10000; ++i) {
+            writer.write(i, "name " + std::to_string(i));
+        }
+    }
+
+    // incremental backup of the in-memory database to the file
+    int steps = 0;
+    int total = 0;
+    BOOST_CHECK_EQUAL(db.backup_to(path.string().c_str(), 8, [&](int remaining, int pages) {
+        BOOST_CHECK_LE(remaining, pages);
+        total = pages;
+        ++steps;
+        return true;
+    }), 0);
+    BOOST_CHECK_GT(total, 8);
+    BOOST_CHECK_EQUAL(steps, (total + 7) / 8 - 1);
+    {
+        sqlite3_helper copy(path.string().c_str());
+        BOOST_CHECK_EQUAL(count_rows(copy), 10000);
+    }
+    BOOST_CHECK_NE(db.backup_to(path.string().c_str(), 1, [](int, int) { return false; }), 0);
+    BOOST_CHECK_NE(db.backup_to((path / "missing" / "backup").string().c_str()), 0);
+
+    // serialized content is the database file
+    std::vector<std::uint8_t> data;
+    BOOST_REQUIRE_EQUAL(db.serialize(data), 0);
+    BOOST_CHECK_EQUAL(data.size() % 4096, 0);
+    BOOST_CHECK_EQUAL(std::string(data.begin(), data.begin() + 15), "SQLite format 3");
+
+    sqlite3_helper restored(":memory:");
+    BOOST_REQUIRE_EQUAL(restored.deserialize(byte_view(data.data(), data.size())), 0);
+    BOOST_CHECK_EQUAL(count_rows(restored), 10000);
+    BOOST_CHECK_EQUAL(restored.execute("INSERT INTO t VALUES (?, ?)", 10000, "grows"), 0);
+    BOOST_CHECK_EQUAL(count_rows(restored), 10001);
+
+    BOOST_REQUIRE_EQUAL(restored.deserialize(byte_view(data.data(), data.size()), true), 0);
+    BOOST_CHECK_EQUAL(count_rows(restored), 10000);
+    BOOST_CHECK_NE(restored.execute("INSERT INTO t VALUES (?, ?)", 10000, "read-only"), 0);
+
+    const std::uint8_t garbage[512] = { 1, 2, 3 };
+    BOOST_CHECK_EQUAL(restored.deserialize(byte_view(garbage, sizeof(garbage))), 0);
+    BOOST_CHECK_EQUAL(count_rows(restored), -1);
+    BOOST_CHECK_NE(restored.exec("SELECT COUNT(*) FROM t"), 0);
+}
+
+BOOST_AUTO_TEST_CASE(KeyValueStoreTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    sqlite3_kv_options options;
+    options.cache_capacity = 64;
+    options.cache_shards = 4;
+    options.flush_rows = 100;
+    options.max_delay = std::chrono::milliseconds(0);
+
+    const std::uint8_t blob[] = { 0, 1, 2, 255 };
+    {
+        sqlite3_kv_store store;
+        BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+
+        // typed values are read back with their own types only
+        BOOST_CHECK_EQUAL(store.put("user/1/name", "alice"), 0);
+        BOOST_CHECK_EQUAL(store.put("user/1/age", 42), 0);
+        BOOST_CHECK_EQUAL(store.put("user/1/score", 0.5), 0);
+        BOOST_CHECK_EQUAL(store.put("user/1/avatar", byte_view(blob, sizeof(blob))), 0);
+        BOOST_CHECK_EQUAL(store.put("user/2/name", std::string("bob")), 0);
+        BOOST_CHECK_EQUAL(store.pending(), 5);
+
+        BOOST_CHECK_EQUAL(*store.get<std::string>("user/1/name"), "alice");
+        BOOST_CHECK_EQUAL(*store.get<std::int64_t>("user/1/age"), 42);
+        BOOST_CHECK_EQUAL(*store.get<double>("user/1/score"), 0.5);
+        BOOST_CHECK(*store.get<std::vector<std::uint8_t>>("user/1/avatar") ==
+            std::vector<std::uint8_t>(blob, blob + sizeof(blob)));
+        BOOST_CHECK(!store.get<std::string>("user/1/age"));
+        BOOST_CHECK(!store.get<std::int64_t>("user/3/age"));
+        BOOST_CHECK(!store.contains("user/3/age"));
+
+        BOOST_CHECK_EQUAL(store.erase("user/2/name"), 0);
+        BOOST_CHECK(!store.contains("user/2/name"));
+
+        // prefix scan flushes the buffer and returns keys in order
+        std::vector<std::string> keys;
+        BOOST_CHECK_EQUAL(store.scan("user/1/", [&](std::string_view key, const kv_value&) {
+            keys.emplace_back(key);
+            return true;
+        }), 0);
+        BOOST_CHECK_EQUAL(store.pending(), 0);
+        BOOST_CHECK(keys == std::vector<std::string>({ "user/1/age", "user/1/avatar", "user/1/name", "user/1/score" }));
+
+        int visited = 0;
+        BOOST_CHECK_EQUAL(store.scan("", [&](std::string_view, const kv_value&) { return ++visited < 2; }), 0);
+        BOOST_CHECK_EQUAL(visited, 2);
+
+        // the buffer is flushed when it is full, evicted values are read from the buffer or the database
+        for (int i = 0; i < 250; ++i) {
+            BOOST_CHECK_EQUAL(store.put("counter/" + std::to_string(i), i), 0);
+        }
+        BOOST_CHECK_EQUAL(store.pending(), 50);
+        for (int i = 0; i < 250; ++i) {
+            BOOST_CHECK_EQUAL(store.get<std::int64_t>("counter/" + std::to_string(i)).value_or(-1), i);
+        }
+        BOOST_CHECK_GT(store.cache_misses(), 0);
+
+        const std::uint64_t hits = store.cache_hits();
+        BOOST_CHECK_EQUAL(*store.get<std::int64_t>("counter/249"), 249);
+        BOOST_CHECK_EQUAL(store.cache_hits(), hits + 1);
+    }
+
+    // the rest of the buffer is flushed on close
+    sqlite3_helper db(path.string().c_str());
+    sqlite3_statement count = db.query("SELECT COUNT(*) FROM kv");
+    BOOST_CHECK(count.next_row());
+    BOOST_CHECK_EQUAL(count.column<int>(0), 254);
+    count.reset();
+    db.close();
+
+    // write-through store sees the same data
+    {
+        options.flush_rows = 1;
+        sqlite3_kv_store store;
+        BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+        BOOST_CHECK_EQUAL(*store.get<std::string>("user/1/name"), "alice");
+        BOOST_CHECK_EQUAL(store.put("user/1/name", "carol"), 0);
+        BOOST_CHECK_EQUAL(store.pending(), 0);
+        BOOST_CHECK_EQUAL(*store.get<std::string>("user/1/name"), "carol");
+    }
+
+    BOOST_CHECK_NE(sqlite3_kv_store().open((path / "missing" / "kv").string().c_str()), 0);
+}
+
+BOOST_AUTO_TEST_CASE(KeyValueStoreFailedFlushTest)
+{
+    // the trigger rolls back the whole transaction writing the rejected key, so the store's own ROLLBACK fails
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    sqlite3_helper db(path.string().c_str());
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE kv (key TEXT PRIMARY KEY NOT NULL, value) WITHOUT ROWID"), 0);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TRIGGER reject BEFORE INSERT ON kv WHEN NEW.key = 'rejected' "
+        "BEGIN SELECT RAISE(ROLLBACK, 'rejected'); END"), 0);
+
+    sqlite3_kv_options options;
+    options.max_delay = std::chrono::milliseconds(0);
+    sqlite3_kv_store store;
+    BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+    BOOST_CHECK_EQUAL(store.put("a", 1), 0);
+    BOOST_CHECK_EQUAL(store.put("rejected", 2), 0);
+    BOOST_CHECK_NE(store.flush(), 0);
+    BOOST_CHECK_EQUAL(store.pending(), 2);
+
+    // the store is still open after the failure, the buffered writes are flushed once the rejected one is gone
+    BOOST_CHECK_EQUAL(store.erase("rejected"), 0);
+    BOOST_CHECK_EQUAL(store.flush(), 0);
+    BOOST_CHECK_EQUAL(store.pending(), 0);
+    BOOST_CHECK_EQUAL(*store.get<std::int64_t>("a"), 1);
+
+    // close flushes the rest after the failed flush too and reports its failure
+    BOOST_CHECK_EQUAL(store.put("rejected", 3), 0);
+    BOOST_CHECK_NE(store.flush(), 0);
+    BOOST_CHECK_EQUAL(store.erase("rejected"), 0);
+    BOOST_CHECK_EQUAL(store.put("b", 4), 0);
+    BOOST_CHECK_EQUAL(store.close(), 0);
+    BOOST_CHECK_EQUAL(store.open(path.string().c_str(), options), 0);
+    BOOST_CHECK_EQUAL(*store.get<std::int64_t>("b"), 4);
+    BOOST_CHECK_EQUAL(store.put("rejected", 5), 0);
+    BOOST_CHECK_NE(store.close(), 0);
+
+    sqlite3_statement count = db.query("SELECT COUNT(*) FROM kv");
+    BOOST_CHECK(count.next_row());
+    BOOST_CHECK_EQUAL(count.column<int>(0), 2);
+    count.reset();
+    db.close();
+}
+
+BOOST_AUTO_TEST_CASE(KeyValueStoreConcurrencyTest)
+{
+    TempFile file;
+    const boost::filesystem::path& path = file.path;
+    sqlite3_kv_options options;
+    options.open_options = sqlite3_profile::bulk_load;
+    options.cache_capacity = 256;
+    options.flush_rows = 64;
+
+    sqlite3_kv_store store;
+    BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+
+    // every writer owns its keys, readers of the other keys race with evictions and flushes,
+    // but never see the value older than the last one they observed
+    const int threads_count = 4;
+    const int keys_count = 200;
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{ 0 };
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<std::int64_t> seen(keys_count * threads_count, -1);
+            for (int round = 0; round < 5; ++round) {
+                for (int k = 0; k < keys_count; ++k) {
+                    const int own = t * keys_count + k;
+                    store.put("key/" + std::to_string(own), round);
+                    if (store.get<std::int64_t>("key/" + std::to_string(own)).value_or(-1) != round) {
+                        ++failures;
+                    }
+
+                    const int other = ((t + 1) % threads_count) * keys_count + k;
+                    const std::int64_t value = store.get<std::int64_t>("key/" + std::to_string(other)).value_or(-1);
+                    if (value < seen[other]) {
+                        ++failures;
+                    }
+                    seen[other] = value;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(failures, 0);
+
+    BOOST_CHECK_EQUAL(store.flush(), 0);
+    int total = 0;
+    BOOST_CHECK_EQUAL(store.scan("key/", [&](std::string_view, const kv_value& value) {
+        total += std::get<std::int64_t>(value) == 4 ? 1 : 0;
+        return true;
+    }), 0);
+    BOOST_CHECK_EQUAL(total, keys_count * threads_count);
+    store.close();
+}
+
+BOOST_AUTO_TEST_CASE(SystemTablesTest)
+{
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.register_system_tables(), 0);
+
+    auto count_rows = [&db](const std::string& sql, const std::string& key) {
+        int rows = 0;
+        for (const sqlite3_row& row : db.query(sql, key)) {
+            rows += row.size() > 0 ? 1 : 0;
+        }
+        return rows;
+    };
+    auto plan = [&db](const std::string& sql) {
+        std::string details;
+        for (const sqlite3_row& row : db.query("EXPLAIN QUERY PLAN " + sql)) {
+            details += row.as_text(3);
+        }
+        return details;
+    };
+
+    // the key lookup reads the same row as the full scan
+    std::int64_t pid = 0;
+    std::string name;
+    for (const sqlite3_row& row : db.query("SELECT pid, name, threads FROM processes")) {
+        pid = row.as_int64(0);
+        name = std::string(row.as_text(1));
+        BOOST_CHECK_GT(row.as_int64(2), 0);
+    }
+    BOOST_REQUIRE_GT(pid, 0);
+    sqlite3_statement process = db.query("SELECT name FROM processes WHERE pid = ?", pid);
+    BOOST_REQUIRE(process.next_row());
+    BOOST_CHECK_EQUAL(process.column<std::string>(0), name);
+    BOOST_CHECK(!process.next_row());
+    BOOST_CHECK_NE(plan("SELECT name FROM processes WHERE pid = 1").find("INDEX 1"), std::string::npos);
+    BOOST_CHECK_EQUAL(plan("SELECT name FROM processes WHERE pid + 0 = 1").find("INDEX 1"), std::string::npos);
+    BOOST_CHECK_EQUAL(count_rows("SELECT pid FROM processes WHERE pid = ?", "not a pid"), 0);
+
+#if defined(__linux__)
+    // the thread has /proc/<tid> too, but it is not the process with the key either
+    std::promise<void> finish;
+    std::shared_future<void> finished = finish.get_future().share();
+    std::thread worker([finished] { finished.wait(); });
+    const std::string self = boost::filesystem::read_symlink("/proc/self").string();
+    std::int64_t tid = 0;
+    for (const boost::filesystem::directory_entry& entry : boost::filesystem::directory_iterator("/proc/self/task")) {
+        if (entry.path().filename().string() != self) {
+            tid = std::stoll(entry.path().filename().string());
+        }
+    }
+    BOOST_CHECK_GT(tid, 0);
+    sqlite3_statement thread = db.query("SELECT name FROM processes WHERE pid = ?", tid);
+    BOOST_CHECK(!thread.next_row());
+    finish.set_value();
+    worker.join();
+#endif
+
+    // environment variables
+    std::string variable;
+    std::string value;
+    for (const sqlite3_row& row : db.query("SELECT name, value FROM env")) {
+        variable = std::string(row.as_text(0));
+        value = std::string(row.as_text(1));
+    }
+    BOOST_REQUIRE(!variable.empty());
+    sqlite3_statement env = db.query("SELECT value FROM env WHERE name = ?", variable);
+    BOOST_REQUIRE(env.next_row());
+    BOOST_CHECK_EQUAL(env.column<std::string>(0), value);
+    env.reset();
+    BOOST_CHECK_EQUAL(count_rows("SELECT value FROM env WHERE name = ?", "WINAPI_HELPERS_MISSING_VARIABLE"), 0);
+
+    // mounts, sizes are read for the selected rows
+    std::string path;
+    for (const sqlite3_row& row : db.query("SELECT path, placement FROM mounts")) {
+        path = std::string(row.as_text(0));
+        BOOST_CHECK(!row.is_null(1));
+    }
+    BOOST_REQUIRE(!path.empty());
+    BOOST_CHECK_GE(count_rows("SELECT path FROM mounts WHERE path = ?", path), 1);
+    BOOST_CHECK_EQUAL(count_rows("SELECT path FROM mounts WHERE path = ?", path + "/missing"), 0);
+    BOOST_CHECK_NE(plan("SELECT path FROM mounts WHERE path = '/'").find("INDEX 1"), std::string::npos);
+
+    // CPUs of the process
+    sqlite3_statement cpus = db.query("SELECT COUNT(*), MIN(cpu) FROM cpu_topology WHERE online = 1");
+    BOOST_REQUIRE(cpus.next_row());
+    BOOST_CHECK_GE(cpus.column<int>(0), 1);
+    const int first_cpu = cpus.column<int>(1);
+    cpus.reset();
+    sqlite3_statement cpu = db.query("SELECT package, core FROM cpu_topology WHERE cpu = ?", first_cpu);
+    BOOST_REQUIRE(cpu.next_row());
+    BOOST_CHECK_GE(cpu.column<int>(0), 0);
+    BOOST_CHECK(!cpu.next_row());
+
+    // joins use the key lookup for the inner table
+    sqlite3_statement parents = db.query(
+        "SELECT COUNT(*) FROM processes AS child JOIN processes AS parent ON parent.pid = child.ppid");
+    BOOST_REQUIRE(parents.next_row());
+    BOOST_CHECK_GE(parents.column<int>(0), 0);
+    parents.reset();
+
+    BOOST_CHECK_NE(sqlite3_helper().register_system_tables(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CompressedBlobTest)
+{
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "[HKEY_LOCAL_MACHINE\\SOFTWARE\\Vendor\\Product" + std::to_string(i % 7) + "]\n\"Version\"=\"1.0." +
+            std::to_string(i) + "\"\n";
+    }
+    const byte_view data(reinterpret_cast<const std::uint8_t*>(text.data()), text.size());
+    const std::uint8_t small[] = { 1, 2, 3 };
+    const std::uint8_t tagged[] = { 0, 'Z', 'B', 1, 5 };
+
+    // large blobs are compressed, small and tagged ones round-trip too
+    std::vector<std::uint8_t> stored;
+    std::vector<std::uint8_t> restored;
+    BOOST_REQUIRE_EQUAL(compress_blob(data, stored), 0);
+    BOOST_CHECK(is_compressed_blob(byte_view(stored.data(), stored.size())));
+    BOOST_CHECK_LT(stored.size(), text.size() / 4);
+    BOOST_REQUIRE_EQUAL(uncompress_blob(byte_view(stored.data(), stored.size()), restored), 0);
+    BOOST_CHECK(std::string(restored.begin(), restored.end()) == text);
+
+    BOOST_REQUIRE_EQUAL(compress_blob(byte_view(small, sizeof(small)), stored), 0);
+    BOOST_CHECK(!is_compressed_blob(byte_view(stored.data(), stored.size())));
+    BOOST_CHECK_EQUAL(stored.size(), sizeof(small));
+
+    BOOST_REQUIRE_EQUAL(compress_blob(byte_view(tagged, sizeof(tagged)), stored), 0);
+    BOOST_REQUIRE_EQUAL(uncompress_blob(byte_view(stored.data(), stored.size()), restored), 0);
+    BOOST_CHECK(restored == std::vector<std::uint8_t>(tagged, tagged + sizeof(tagged)));
+
+    BOOST_REQUIRE_EQUAL(compress_blob(data, stored), 0);
+    stored[stored.size() / 2] ^= 0xFF;
+    BOOST_CHECK_NE(uncompress_blob(byte_view(stored.data(), stored.size()), restored), 0);
+    BOOST_CHECK_NE(uncompress_blob(byte_view(tagged, sizeof(tagged)), restored), 0);
+
+    // statements compress on bind and uncompress on read
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE(db);
+    BOOST_REQUIRE_EQUAL(db.exec("CREATE TABLE dumps (id INTEGER PRIMARY KEY, content BLOB)"), 0);
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, ?)", 1, sqlite3_compressed_blob(data)), 0);
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, ?)", 2, byte_view(small, sizeof(small))), 0);
+
+    sqlite3_compressed_blob fast(data);
+    fast.options.level = 1;
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, ?)", 3, fast), 0);
+
+    int rows = 0;
+    for (const sqlite3_row& row : db.query("SELECT id, content FROM dumps ORDER BY id")) {
+        BOOST_REQUIRE_EQUAL(row.as_uncompressed(1, restored), 0);
+        BOOST_CHECK_EQUAL(restored.size(), 2 == row.as_int64(0) ? sizeof(small) : text.size());
+        ++rows;
+    }
+    BOOST_CHECK_EQUAL(rows, 3);
+
+    // SQL functions use the same format
+    BOOST_REQUIRE_EQUAL(db.register_compression_functions(), 0);
+    sqlite3_statement sizes = db.query("SELECT length(content), length(uncompress(content)) FROM dumps WHERE id = 1");
+    BOOST_REQUIRE(sizes.next_row());
+    BOOST_CHECK_LT(sizes.column<int>(0), sizes.column<int>(1));
+    BOOST_CHECK_EQUAL(sizes.column<int>(1), static_cast<int>(text.size()));
+    sizes.reset();
+
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, compress(?))", 4, std::string_view(text)), 0);
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, compress(?, 9))", 5, std::string_view(text)), 0);
+    sqlite3_statement same = db.query(
+        "SELECT COUNT(*) FROM dumps WHERE CAST(uncompress(content) AS TEXT) = ? AND length(content) < ?",
+        std::string_view(text), static_cast<int>(text.size()));
+    BOOST_REQUIRE(same.next_row());
+    BOOST_CHECK_EQUAL(same.column<int>(0), 4);
+    same.reset();
+
+    sqlite3_statement nulls = db.query("SELECT compress(NULL) IS NULL AND uncompress(NULL) IS NULL");
+    BOOST_REQUIRE(nulls.next_row());
+    BOOST_CHECK_EQUAL(nulls.column<int>(0), 1);
+    nulls.reset();
+
+    BOOST_CHECK_EQUAL(db.execute("INSERT INTO dumps VALUES (?, ?)", 6, byte_view(tagged, sizeof(tagged))), 0);
+    BOOST_CHECK_NE(db.exec("SELECT uncompress(content) FROM dumps WHERE id = 6"), 0);
+    BOOST_CHECK_NE(sqlite3_helper().register_compression_functions(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
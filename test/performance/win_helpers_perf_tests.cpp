@@ -0,0 +1,1406 @@
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <locale>
+#include <codecvt>
+#include <type_traits>
+#include <functional>
+#include <numeric>
+#include <cstring>
+#include <algorithm>
+#include <winapi-helpers/concurrent_handler_map.h>
+#include <winapi-helpers/utf_transcoder.h>
+#include <winapi-helpers/byte_streambuf.h>
+#include <winapi-helpers/async_file_reader.h>
+#include <winapi-helpers/gzip_writer.h>
+#include <winapi-helpers/zlib_streambuf.h>
+#include <winapi-helpers/seekable_archive.h>
+#include <winapi-helpers/sqlite3_helper.h>
+#include <winapi-helpers/sqlite3_batch_writer.h>
+#include <winapi-helpers/sqlite3_pool.h>
+#include <winapi-helpers/sqlite3_kv_store.h>
+#include <zlib.h>
+#include <boost/filesystem.hpp>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace helpers;
+using namespace boost::unit_test;
+
+// Performance tests, results are reported as test messages
+// Run with --log_level=message to see them
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+/// Run the same function in the number of threads, return elapsed seconds
+template <typename F>
+double run_concurrently(size_t threads_count, F f)
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> start{ false };
+    for (size_t i = 0; i < threads_count; ++i) {
+        threads.emplace_back([&start, &f, i] {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            f(i);
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/// Run the function repeatedly, return best elapsed seconds of one run
+template <typename F>
+double measure_best(size_t repeats, F f)
+{
+    double best = 0.0;
+    for (size_t i = 0; i < repeats; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        best = (0 == i || elapsed < best) ? elapsed : best;
+    }
+    return best;
+}
+
+/// Mostly ASCII text with some Cyrillic and emoji, like paths and registry values
+std::string make_mixed_utf8(size_t size)
+{
+    const char* pieces[] = { "C:\\Program Files\\Common Files\\", "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xBC\xD0\xB5\xD1\x80",
+        "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion", "\xF0\x9F\x98\x80" };
+    std::string text;
+    for (size_t i = 0; text.size() < size; ++i) {
+        text += pieces[(i % 7 == 3) ? 1 : (i % 29 == 5) ? 3 : (i % 2) * 2];
+    }
+    return text;
+}
+
+} // namespace
+
+#pragma region HandlerMapPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(HandlerMapPerformanceTests);
+
+// Read-heavy dispatch, 64 readers and one plugin thread registering handlers
+BOOST_AUTO_TEST_CASE(ConcurrentHandlerMapReadHeavyTest)
+{
+    constexpr size_t readers = 64;
+    constexpr size_t calls_per_reader = 200000;
+    constexpr int keys = 64;
+    constexpr int inserts = 100;
+
+    std::map<int, std::function<int(int)>> initial;
+    for (int k = 0; k < keys; ++k) {
+        initial[k] = [k](int v) { return v + k; };
+    }
+
+    // Baseline: std::map guarded by the mutex on every call
+    std::map<int, std::function<int(int)>> guarded_map(initial);
+    std::mutex guard;
+    std::atomic<long long> guarded_sum{ 0 };
+    double guarded_time = run_concurrently(readers + 1, [&](size_t thread_index) {
+        if (thread_index == readers) {
+            for (int i = 0; i < inserts; ++i) {
+                std::lock_guard<std::mutex> lock(guard);
+                guarded_map[keys + i] = [](int v) { return v; };
+            }
+            return;
+        }
+        long long sum = 0;
+        for (size_t i = 0; i < calls_per_reader; ++i) {
+            std::lock_guard<std::mutex> lock(guard);
+            sum += guarded_map.find(static_cast<int>(i % keys))->second(1);
+        }
+        guarded_sum += sum;
+    });
+
+    // Copy-on-write snapshots, wait-free readers
+    ConcurrentHandlerMap<int, std::function<int(int)>> concurrent_map(initial);
+    std::atomic<long long> concurrent_sum{ 0 };
+    double concurrent_time = run_concurrently(readers + 1, [&](size_t thread_index) {
+        if (thread_index == readers) {
+            for (int i = 0; i < inserts; ++i) {
+                concurrent_map.insert(keys + i, [](int v) { return v; });
+            }
+            return;
+        }
+        long long sum = 0;
+        for (size_t i = 0; i < calls_per_reader; ++i) {
+            sum += concurrent_map.call(static_cast<int>(i % keys), 1);
+        }
+        concurrent_sum += sum;
+    });
+
+    BOOST_CHECK_EQUAL(guarded_sum.load(), concurrent_sum.load());
+    BOOST_CHECK_EQUAL(concurrent_map.size(), static_cast<size_t>(keys + inserts));
+
+    const double total_calls = static_cast<double>(readers * calls_per_reader);
+    BOOST_TEST_MESSAGE("Mutex-guarded std::map: " << total_calls / guarded_time / 1e6 << " Mcalls/sec");
+    BOOST_TEST_MESSAGE("ConcurrentHandlerMap: " << total_calls / concurrent_time / 1e6 << " Mcalls/sec");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#pragma region UtfTranscoderPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(UtfTranscoderPerformanceTests);
+
+// Compare with std::wstring_convert, which was used by utf8_to_wstring() and wstring_to_utf8()
+BOOST_AUTO_TEST_CASE(Utf8WideThroughputTest)
+{
+    const std::string utf8 = make_mixed_utf8(16 * 1024 * 1024);
+    const double gigabytes = static_cast<double>(utf8.size()) / 1e9;
+    std::wstring wide;
+    std::string narrow;
+
+    // wchar_t is UTF-16 under Windows, UTF-32 under POSIX
+    using wide_codecvt = std::conditional_t<sizeof(wchar_t) == 2,
+        std::codecvt_utf8_utf16<wchar_t>, std::codecvt_utf8<wchar_t>>;
+
+    double convert_decode = measure_best(3, [&] {
+        std::wstring_convert<wide_codecvt> cv;
+        wide = cv.from_bytes(utf8);
+    });
+    double convert_encode = measure_best(3, [&] {
+        std::wstring_convert<wide_codecvt> cv;
+        narrow = cv.to_bytes(wide);
+    });
+    const std::wstring expected_wide = wide;
+
+    double simd_decode = measure_best(3, [&] {
+        wide.assign(utf8.size(), L'\0');
+        utf_result result = utf8_to_wide(utf8.data(), utf8.size(), &wide[0]);
+        wide.resize(result.output_count);
+    });
+    double simd_encode = measure_best(3, [&] {
+        narrow.assign(wide.size() * utf8_per_wide_max, '\0');
+        utf_result result = wide_to_utf8(wide.data(), wide.size(), &narrow[0]);
+        narrow.resize(result.output_count);
+    });
+
+    BOOST_CHECK(wide == expected_wide);
+    BOOST_CHECK(narrow == utf8);
+
+    BOOST_TEST_MESSAGE("UTF kernel: " << utf_kernel_name());
+    BOOST_TEST_MESSAGE("wstring_convert UTF-8 -> wide: " << gigabytes / convert_decode << " GB/s");
+    BOOST_TEST_MESSAGE("utf8_to_wide: " << gigabytes / simd_decode << " GB/s");
+    BOOST_TEST_MESSAGE("wstring_convert wide -> UTF-8: " << gigabytes / convert_encode << " GB/s");
+    BOOST_TEST_MESSAGE("wide_to_utf8: " << gigabytes / simd_encode << " GB/s");
+}
+
+// Registry-like enumeration of many short values: fresh string per value vs reusable buffer
+BOOST_AUTO_TEST_CASE(ShortStringsReusableBufferTest)
+{
+    const size_t values_count = 100000;
+    const std::string text = make_mixed_utf8(64 * values_count);
+    std::vector<std::wstring> values;
+    values.reserve(values_count);
+    for (size_t i = 0; i < values_count; ++i) {
+        std::wstring value(64, L'\0');
+        utf_result result = utf8_to_wide(text.data() + i * 64, 16 + i % 48, &value[0], utf_validation::non_validating);
+        value.resize(result.output_count);
+        values.push_back(std::move(value));
+    }
+
+    size_t total = 0;
+    double fresh = measure_best(3, [&] {
+        total = 0;
+        for (const std::wstring& value : values) {
+            std::string utf8(value.size() * utf8_per_wide_max, '\0');
+            utf_result result = wide_to_utf8(value.data(), value.size(), &utf8[0], utf_validation::non_validating);
+            utf8.resize(result.output_count);
+            total += utf8.size();
+        }
+    });
+
+    size_t reused_total = 0;
+    std::string buffer;
+    double reused = measure_best(3, [&] {
+        reused_total = 0;
+        for (const std::wstring& value : values) {
+            wide_to_utf8(value.data(), value.size(), buffer, utf_validation::non_validating);
+            reused_total += buffer.size();
+        }
+    });
+
+    size_t counted_total = 0;
+    double counted = measure_best(3, [&] {
+        counted_total = 0;
+        for (const std::wstring& value : values) {
+            counted_total += required_length(value.data(), value.size());
+        }
+    });
+
+    BOOST_CHECK_EQUAL(total, reused_total);
+    BOOST_CHECK_EQUAL(total, counted_total);
+
+    BOOST_TEST_MESSAGE("fresh string per value: " << fresh * 1e9 / values_count << " ns/value");
+    BOOST_TEST_MESSAGE("reusable buffer: " << reused * 1e9 / values_count << " ns/value");
+    BOOST_TEST_MESSAGE("required_length: " << counted * 1e9 / values_count << " ns/value");
+}
+
+// Vector of names converted one by one vs packed batch, in the caller thread and in the pool
+BOOST_AUTO_TEST_CASE(TranscodeBatchTest)
+{
+    const size_t names_count = 200000;
+    const std::string text = make_mixed_utf8(64 * names_count);
+    std::vector<std::string_view> names;
+    names.reserve(names_count);
+    for (size_t i = 0; i < names_count; ++i) {
+        // cut on the code point boundary
+        size_t begin = i * 64;
+        while ((text[begin] & 0xC0) == 0x80) {
+            ++begin;
+        }
+        size_t end = begin + 16 + i % 40;
+        while ((text[end] & 0xC0) == 0x80) {
+            ++end;
+        }
+        names.emplace_back(text.data() + begin, end - begin);
+    }
+
+    size_t separate_total = 0;
+    double separate = measure_best(3, [&] {
+        std::vector<std::wstring> converted;
+        converted.reserve(names.size());
+        for (std::string_view name : names) {
+            std::wstring value;
+            utf8_to_wide(name.data(), name.size(), value);
+            converted.push_back(std::move(value));
+        }
+        separate_total = converted.size();
+    });
+
+    size_t batch_total = 0;
+    double batch = measure_best(3, [&] {
+        batch_total = transcode_batch<wchar_t>(names).size();
+    });
+
+    thread_pool pool;
+    size_t parallel_total = 0;
+    double parallel = measure_best(3, [&] {
+        parallel_total = transcode_batch<wchar_t>(names, &pool).size();
+    });
+
+    BOOST_CHECK_EQUAL(separate_total, names_count);
+    BOOST_CHECK_EQUAL(batch_total, names_count);
+    BOOST_CHECK_EQUAL(parallel_total, names_count);
+
+    BOOST_TEST_MESSAGE("std::wstring per name: " << separate * 1e3 << " ms");
+    BOOST_TEST_MESSAGE("transcode_batch: " << batch * 1e3 << " ms");
+    BOOST_TEST_MESSAGE("transcode_batch, " << pool.threads_number() << " threads: " << parallel * 1e3 << " ms");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+
+#pragma region ByteStreamPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(ByteStreamPerformanceTests);
+
+// Sequential file scan: std::basic_ifstream<uint8_t> with uint8_t codecvt vs byte_ifstream,
+// every byte is summed, so the mapped pages are actually touched
+BOOST_AUTO_TEST_CASE(SequentialReadTest)
+{
+    const size_t file_size = 256 * 1024 * 1024;
+    const size_t chunk_size = 64 * 1024;
+    const size_t record_size = 16;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+    std::vector<std::uint8_t> chunk(chunk_size);
+    for (size_t i = 0; i < chunk_size; ++i) {
+        chunk[i] = static_cast<std::uint8_t>(i * 131);
+    }
+
+    double written = measure_best(1, [&] {
+        byte_ofstream out(path.string());
+        for (size_t i = 0; i < file_size; i += chunk_size) {
+            out.write(chunk.data(), chunk_size);
+        }
+    });
+
+    auto sum = [](const std::uint8_t* data, size_t length) {
+        return std::accumulate(data, data + length, std::uint64_t(0));
+    };
+
+    // reads by chunk_size or record_size into the caller buffer
+    auto read_all = [&](std::basic_istream<std::uint8_t>& in, size_t length) {
+        std::uint64_t total = 0;
+        while (in.read(chunk.data(), length) || in.gcount() > 0) {
+            total += sum(chunk.data(), static_cast<size_t>(in.gcount()));
+        }
+        return total;
+    };
+
+    auto open_codecvt = [&](std::basic_ifstream<std::uint8_t>& in) {
+        in.imbue(std::locale(in.getloc(), new std::codecvt<std::uint8_t, char, std::mbstate_t>));
+        in.open(path.string(), std::ios_base::binary);
+    };
+
+    std::uint64_t codecvt_sum = 0;
+    double codecvt = measure_best(3, [&] {
+        std::basic_ifstream<std::uint8_t> in;
+        open_codecvt(in);
+        codecvt_sum = read_all(in, chunk_size);
+    });
+
+    std::uint64_t codecvt_records_sum = 0;
+    double codecvt_records = measure_best(3, [&] {
+        std::basic_ifstream<std::uint8_t> in;
+        open_codecvt(in);
+        codecvt_records_sum = read_all(in, record_size);
+    });
+
+    std::uint64_t buffered_sum = 0;
+    double buffered = measure_best(3, [&] {
+        byte_ifstream in(path.string());
+        buffered_sum = read_all(in, chunk_size);
+    });
+
+    std::uint64_t buffered_records_sum = 0;
+    double buffered_records = measure_best(3, [&] {
+        byte_ifstream in(path.string());
+        buffered_records_sum = read_all(in, record_size);
+    });
+
+    std::uint64_t mapped_sum = 0;
+    double mapped = measure_best(3, [&] {
+        byte_ifstream in(path.string(), byte_read_mode::mapped);
+        mapped_sum = 0;
+        for (byte_view window = in.rdbuf()->next_window(chunk_size); !window.empty();
+            window = in.rdbuf()->next_window(chunk_size)) {
+            mapped_sum += sum(window.data(), window.size());
+        }
+    });
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+
+    BOOST_CHECK_EQUAL(codecvt_sum, codecvt_records_sum);
+    BOOST_CHECK_EQUAL(codecvt_sum, buffered_sum);
+    BOOST_CHECK_EQUAL(codecvt_sum, buffered_records_sum);
+    BOOST_CHECK_EQUAL(codecvt_sum, mapped_sum);
+
+    const double megabytes = static_cast<double>(file_size) / (1024 * 1024);
+    BOOST_TEST_MESSAGE("byte_ofstream write: " << megabytes / written << " MB/s");
+    BOOST_TEST_MESSAGE("std::basic_ifstream<uint8_t>, " << chunk_size << " bytes reads: " << megabytes / codecvt << " MB/s");
+    BOOST_TEST_MESSAGE("std::basic_ifstream<uint8_t>, " << record_size << " bytes reads: " << megabytes / codecvt_records << " MB/s");
+    BOOST_TEST_MESSAGE("byte_ifstream, " << chunk_size << " bytes reads: " << megabytes / buffered << " MB/s");
+    BOOST_TEST_MESSAGE("byte_ifstream, " << record_size << " bytes reads: " << megabytes / buffered_records << " MB/s");
+    BOOST_TEST_MESSAGE("byte_ifstream mapped windows: " << megabytes / mapped << " MB/s");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+
+#pragma region AsyncFileReaderPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(AsyncFileReaderPerformanceTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+/// Evict the file from the page cache, so the next read goes to the disk
+void drop_file_cache(const boost::filesystem::path& path)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    // opening without buffering flushes and purges the cached pages of the file
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (INVALID_HANDLE_VALUE != file) {
+        CloseHandle(file);
+    }
+#else
+    const int file = ::open(path.string().c_str(), O_RDONLY);
+    if (file >= 0) {
+        ::fdatasync(file);
+        ::posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(file);
+    }
+#endif
+}
+
+/// Parsing stand-in, touches every byte of the block
+std::uint64_t parse_block(byte_view block)
+{
+    return std::accumulate(block.begin(), block.end(), std::uint64_t(0));
+}
+
+} // namespace
+
+///////////////////////////////////
+// Test cases
+
+// Cold cache scan with parsing: synchronous byte_ifstream vs reads prefetched by async_file_reader
+BOOST_AUTO_TEST_CASE(ColdCacheSequentialReadTest)
+{
+    const size_t file_size = 512 * 1024 * 1024;
+    const size_t block_size = 1024 * 1024;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+    {
+        std::vector<std::uint8_t> block(block_size);
+        byte_ofstream out(path.string());
+        for (size_t i = 0; i < file_size; i += block_size) {
+            for (size_t j = 0; j < block_size; j += 512) {
+                block[j] = static_cast<std::uint8_t>(i + j);
+            }
+            out.write(block.data(), block_size);
+        }
+    }
+
+    // every run starts with the cold cache
+    auto measure_cold = [&](auto f) {
+        double best = 0.0;
+        for (size_t i = 0; i < 3; ++i) {
+            drop_file_cache(path);
+            const double elapsed = measure_best(1, f);
+            best = (0 == i || elapsed < best) ? elapsed : best;
+        }
+        return best;
+    };
+
+    std::uint64_t sync_hash = 0;
+    double sync = measure_cold([&] {
+        byte_ifstream in(path.string());
+        sync_hash = 0;
+        for (byte_view block = in.rdbuf()->next_window(block_size); !block.empty();
+            block = in.rdbuf()->next_window(block_size)) {
+            sync_hash += parse_block(block);
+        }
+    });
+
+    auto measure_async = [&](async_read_backend backend, std::uint64_t& hash) {
+        return measure_cold([&] {
+            async_read_options options;
+            options.block_size = block_size;
+            options.queue_depth = 4;
+            options.backend = backend;
+            async_file_reader reader;
+            BOOST_REQUIRE(reader.open(path.string(), options));
+            hash = 0;
+            BOOST_CHECK(reader.read([&hash](std::uint64_t, byte_view block) {
+                hash += parse_block(block);
+                return true;
+            }));
+        });
+    };
+
+    std::uint64_t pool_hash = 0;
+    double pool = measure_async(async_read_backend::pool, pool_hash);
+    BOOST_CHECK_EQUAL(sync_hash, pool_hash);
+
+    const double megabytes = static_cast<double>(file_size) / (1024 * 1024);
+    BOOST_TEST_MESSAGE("byte_ifstream: " << megabytes / sync << " MB/s");
+    BOOST_TEST_MESSAGE("async_file_reader, thread pool: " << megabytes / pool << " MB/s");
+
+    if (async_file_reader::io_uring_available()) {
+        std::uint64_t uring_hash = 0;
+        double uring = measure_async(async_read_backend::io_uring, uring_hash);
+        BOOST_CHECK_EQUAL(sync_hash, uring_hash);
+        BOOST_TEST_MESSAGE("async_file_reader, io_uring: " << megabytes / uring << " MB/s");
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+#pragma region CompressionPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(CompressionPerformanceTests);
+
+///////////////////////////////////
+// Helper functions and classes
+
+namespace {
+
+/// Dump-like data: log text mixed with binary records
+std::vector<std::uint8_t> make_dump(size_t size)
+{
+    std::vector<std::uint8_t> dump;
+    dump.reserve(size);
+    for (size_t i = 0; dump.size() < size; ++i) {
+        const std::string line = "pid=" + std::to_string(i * 7919 % 65536) + " " + make_mixed_utf8(40 + i % 50) + "\n";
+        dump.insert(dump.end(), line.begin(), line.end());
+        for (size_t j = 0; j < 32; ++j) {
+            dump.push_back(static_cast<std::uint8_t>((i * 2654435761u + j * 40503u) >> 11));
+        }
+    }
+    dump.resize(size);
+    return dump;
+}
+
+} // namespace
+
+///////////////////////////////////
+// Test cases
+
+// Single gzip stream by the single-threaded zlib deflate vs gzip_writer in pools of the growing size
+BOOST_AUTO_TEST_CASE(GzipWriterScalingTest)
+{
+    const size_t size = 64 * 1024 * 1024;
+    const std::vector<std::uint8_t> data = make_dump(size);
+    const double megabytes = static_cast<double>(size) / (1024 * 1024);
+
+    std::vector<std::uint8_t> reference(deflateBound(nullptr, static_cast<uLong>(size)) + 32);
+    size_t reference_size = 0;
+    const double single = measure_best(3, [&] {
+        z_stream stream = {};
+        BOOST_REQUIRE_EQUAL(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY), Z_OK);
+        stream.next_in = const_cast<std::uint8_t*>(data.data());
+        stream.avail_in = static_cast<uInt>(size);
+        stream.next_out = reference.data();
+        stream.avail_out = static_cast<uInt>(reference.size());
+        BOOST_REQUIRE_EQUAL(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        reference_size = stream.total_out;
+        deflateEnd(&stream);
+    });
+    BOOST_TEST_MESSAGE("zlib deflate, 1 thread: " << megabytes / single << " MB/s, "
+        << reference_size * 100.0 / size << "% of the input");
+
+    const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<size_t> threads_counts = { 1, 2, 4, 8 };
+    threads_counts.erase(std::remove_if(threads_counts.begin(), threads_counts.end(),
+        [cores](size_t threads) { return threads > cores; }), threads_counts.end());
+    if (threads_counts.back() != cores) {
+        threads_counts.push_back(cores);
+    }
+
+    for (size_t threads : threads_counts) {
+        thread_pool pool(threads);
+        gzip_writer_options options;
+        options.pool = &pool;
+        std::vector<std::uint8_t> compressed;
+        compressed.reserve(reference.size());
+        const double elapsed = measure_best(3, [&] {
+            BOOST_REQUIRE(gzip_compress(byte_view(data.data(), data.size()), compressed, options));
+        });
+        BOOST_TEST_MESSAGE("gzip_writer, " << threads << " threads: " << megabytes / elapsed << " MB/s, x"
+            << single / elapsed << " of zlib, " << compressed.size() * 100.0 / size << "% of the input");
+    }
+}
+
+// Decompression of the gzip dump: read the whole file and inflate it into the vector vs stream it by windows
+BOOST_AUTO_TEST_CASE(ZlibStreamInflateTest)
+{
+    const size_t size = 128 * 1024 * 1024;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    {
+        const std::vector<std::uint8_t> data = make_dump(size);
+        byte_ofstream out(path.string());
+        gzip_writer writer;
+        BOOST_REQUIRE(writer.open(out));
+        BOOST_REQUIRE(writer.write(byte_view(data.data(), data.size())));
+        BOOST_REQUIRE(writer.close());
+    }
+    const size_t compressed_size = static_cast<size_t>(boost::filesystem::file_size(path));
+
+    std::uint64_t vector_hash = 0;
+    const double in_vector = measure_best(3, [&] {
+        std::vector<std::uint8_t> compressed(compressed_size);
+        byte_ifstream(path.string()).read(compressed.data(), compressed.size());
+        std::vector<std::uint8_t> data(size);
+
+        z_stream stream = {};
+        BOOST_REQUIRE_EQUAL(inflateInit2(&stream, 16 + MAX_WBITS), Z_OK);
+        stream.next_in = compressed.data();
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        stream.next_out = data.data();
+        stream.avail_out = static_cast<uInt>(data.size());
+        BOOST_REQUIRE_EQUAL(inflate(&stream, Z_FINISH), Z_STREAM_END);
+        inflateEnd(&stream);
+        vector_hash = std::accumulate(data.begin(), data.end(), std::uint64_t(0));
+    });
+
+    auto measure_stream = [&](byte_read_mode mode, std::uint64_t& hash) {
+        return measure_best(3, [&] {
+            byte_ifstream file(path.string(), mode);
+            zlib_istream in(file);
+            hash = 0;
+            for (byte_view window = in.rdbuf()->next_window(); !window.empty(); window = in.rdbuf()->next_window()) {
+                hash = std::accumulate(window.begin(), window.end(), hash);
+            }
+            BOOST_CHECK(!in.rdbuf()->failed());
+        });
+    };
+
+    std::uint64_t buffered_hash = 0;
+    const double buffered = measure_stream(byte_read_mode::buffered, buffered_hash);
+    std::uint64_t mapped_hash = 0;
+    const double mapped = measure_stream(byte_read_mode::mapped, mapped_hash);
+    BOOST_CHECK_EQUAL(vector_hash, buffered_hash);
+    BOOST_CHECK_EQUAL(vector_hash, mapped_hash);
+
+    const double megabytes = static_cast<double>(size) / (1024 * 1024);
+    BOOST_TEST_MESSAGE("read and inflate into vector: " << megabytes / in_vector << " MB/s, "
+        << (size + compressed_size) / (1024 * 1024) << " MB held");
+    BOOST_TEST_MESSAGE("zlib_istream over buffered file: " << megabytes / buffered << " MB/s, "
+        << 2 * byte_stream_buffer_size / (1024 * 1024) << " MB held");
+    BOOST_TEST_MESSAGE("zlib_istream over mapped file: " << megabytes / mapped << " MB/s, "
+        << byte_stream_buffer_size / (1024 * 1024) << " MB held");
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+}
+
+// Checksums of the large buffer: the portable table-driven code vs the SIMD kernels selected by zlib
+BOOST_AUTO_TEST_CASE(ChecksumThroughputTest)
+{
+    const size_t size = 256 * 1024 * 1024;
+    const std::vector<std::uint8_t> data = make_dump(size);
+    const double megabytes = static_cast<double>(size) / (1024 * 1024);
+
+    uLong crc_portable = 0;
+    uLong crc_simd = 0;
+    uLong adler_portable = 0;
+    uLong adler_simd = 0;
+    const double crc_portable_time = measure_best(3, [&] { crc_portable = crc32_portable(0, data.data(), size); });
+    const double crc_simd_time = measure_best(3, [&] { crc_simd = crc32_z(0, data.data(), size); });
+    const double adler_portable_time = measure_best(3, [&] { adler_portable = adler32_portable(1, data.data(), size); });
+    const double adler_simd_time = measure_best(3, [&] { adler_simd = adler32_z(1, data.data(), size); });
+    BOOST_CHECK_EQUAL(crc_portable, crc_simd);
+    BOOST_CHECK_EQUAL(adler_portable, adler_simd);
+
+    // memory bandwidth for the reference: the buffer is only read
+    std::uint64_t sum = 0;
+    const double read_time = measure_best(3, [&] {
+        const std::uint64_t* words = reinterpret_cast<const std::uint64_t*>(data.data());
+        sum = std::accumulate(words, words + size / sizeof(std::uint64_t), std::uint64_t(0));
+    });
+    BOOST_CHECK_NE(sum, 0);
+
+    const int features = zlib_simd_features();
+    BOOST_TEST_MESSAGE("memory read: " << megabytes / read_time << " MB/s");
+    BOOST_TEST_MESSAGE("CRC-32, tables: " << megabytes / crc_portable_time << " MB/s");
+    BOOST_TEST_MESSAGE("CRC-32, " << ((features & Z_SIMD_CRC32) ? "PCLMULQDQ: " : "no SIMD: ")
+        << megabytes / crc_simd_time << " MB/s");
+    BOOST_TEST_MESSAGE("Adler-32, scalar: " << megabytes / adler_portable_time << " MB/s");
+    BOOST_TEST_MESSAGE("Adler-32, " << ((features & Z_SIMD_ADLER32) ? "AVX2: " : "no SIMD: ")
+        << megabytes / adler_simd_time << " MB/s");
+}
+
+// Restoring small records from the large dump: inflate the gzip stream up to the record vs seek in the seekable archive
+BOOST_AUTO_TEST_CASE(SeekableArchiveRandomAccessTest)
+{
+    const size_t size = 256 * 1024 * 1024;
+    const size_t record_size = 4096;
+    const boost::filesystem::path gzip_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    const boost::filesystem::path archive_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    const std::vector<std::uint8_t> data = make_dump(size);
+    {
+        byte_ofstream out(gzip_path.string());
+        gzip_writer writer;
+        BOOST_REQUIRE(writer.open(out));
+        BOOST_REQUIRE(writer.write(byte_view(data.data(), data.size())));
+        BOOST_REQUIRE(writer.close());
+    }
+    {
+        byte_ofstream out(archive_path.string());
+        seekable_archive_writer writer;
+        BOOST_REQUIRE(writer.open(out));
+        BOOST_REQUIRE(writer.write(byte_view(data.data(), data.size())));
+        BOOST_REQUIRE(writer.close());
+    }
+
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < 1000; ++i) {
+        offsets.push_back((i * 2654435761u) % (size - record_size));
+    }
+
+    // the gzip stream is inflated from the start, a few records are enough
+    const size_t gzip_records = 4;
+    std::vector<std::uint8_t> record(record_size);
+    const double gzip_time = measure_best(1, [&] {
+        for (size_t i = 0; i < gzip_records; ++i) {
+            byte_ifstream file(gzip_path.string(), byte_read_mode::mapped);
+            zlib_istream in(file);
+            in.ignore(static_cast<std::streamsize>(offsets[i]));
+            in.read(record.data(), record.size());
+            BOOST_REQUIRE(std::equal(record.begin(), record.end(), data.begin() + offsets[i]));
+        }
+    });
+
+    const double archive_time = measure_best(3, [&] {
+        seekable_archive_ifstream in(archive_path.string());
+        for (size_t offset : offsets) {
+            in.seekg(offset);
+            in.read(record.data(), record.size());
+            BOOST_REQUIRE(std::equal(record.begin(), record.end(), data.begin() + offset));
+        }
+    });
+
+    std::uint64_t gzip_hash = 0;
+    const double gzip_sequential = measure_best(3, [&] {
+        byte_ifstream file(gzip_path.string(), byte_read_mode::mapped);
+        zlib_istream in(file);
+        gzip_hash = 0;
+        for (byte_view window = in.rdbuf()->next_window(); !window.empty(); window = in.rdbuf()->next_window()) {
+            gzip_hash = std::accumulate(window.begin(), window.end(), gzip_hash);
+        }
+    });
+    std::uint64_t archive_hash = 0;
+    const double archive_sequential = measure_best(3, [&] {
+        seekable_archive_ifstream in(archive_path.string());
+        archive_hash = 0;
+        for (byte_view window = in.rdbuf()->next_window(); !window.empty(); window = in.rdbuf()->next_window()) {
+            archive_hash = std::accumulate(window.begin(), window.end(), archive_hash);
+        }
+    });
+    BOOST_CHECK_EQUAL(gzip_hash, archive_hash);
+
+    const double megabytes = static_cast<double>(size) / (1024 * 1024);
+    const double gzip_size = static_cast<double>(boost::filesystem::file_size(gzip_path));
+    const double archive_size = static_cast<double>(boost::filesystem::file_size(archive_path));
+    BOOST_TEST_MESSAGE("gzip stream, record at random offset: " << gzip_time * 1000 / gzip_records << " ms, "
+        << gzip_size * 100 / size << "% of the input");
+    BOOST_TEST_MESSAGE("seekable archive, record at random offset: " << archive_time * 1000 / offsets.size()
+        << " ms, " << archive_size * 100 / size << "% of the input");
+    BOOST_TEST_MESSAGE("sequential read, gzip stream: " << megabytes / gzip_sequential
+        << " MB/s, seekable archive: " << megabytes / archive_sequential << " MB/s");
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(gzip_path, ec);
+    boost::filesystem::remove(archive_path, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion
+
+
+
+#pragma region Sqlite3HelperPerformanceTests
+
+BOOST_AUTO_TEST_SUITE(Sqlite3HelperPerformanceTests);
+
+// Insert-heavy workload: SQL text formatted and parsed for every row vs cached prepared statement.
+// Rows go into one transaction, so the parse cost is not hidden by the commit
+BOOST_AUTO_TEST_CASE(PreparedStatementInsertTest)
+{
+    const size_t rows_count = 100000;
+    const std::string name = "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows";
+
+    auto measure = [&](auto insert_row) {
+        return measure_best(3, [&] {
+            sqlite3_helper db(":memory:");
+            db.exec("CREATE TABLE telemetry (id INTEGER, name TEXT, value REAL)");
+            db.exec("BEGIN");
+            for (size_t i = 0; i < rows_count; ++i) {
+                insert_row(db, i);
+            }
+            db.exec("COMMIT");
+            BOOST_CHECK(db);
+        });
+    };
+
+    double exec = measure([&](sqlite3_helper& db, size_t i) {
+        const std::string sql = "INSERT INTO telemetry VALUES (" + std::to_string(i) + ", '" + name + "', " +
+            std::to_string(i * 0.25) + ")";
+        db.exec(sql.c_str());
+    });
+
+    double cached = measure([&](sqlite3_helper& db, size_t i) {
+        db.execute("INSERT INTO telemetry VALUES (?, ?, ?)", i, name, i * 0.25);
+    });
+
+    // the lower bound: one statement prepared by the caller and kept
+    sqlite3_statement insert;
+    double reused = measure([&](sqlite3_helper& db, size_t i) {
+        if (0 == i) {
+            insert = db.prepare("INSERT INTO telemetry VALUES (?, ?, ?)");
+        }
+        insert.bind_values(i, name, i * 0.25);
+        insert.execute();
+        if (rows_count - 1 == i) {
+            insert = sqlite3_statement();
+        }
+    });
+
+    BOOST_TEST_MESSAGE("exec() with formatted SQL: " << rows_count / exec << " rows/s");
+    BOOST_TEST_MESSAGE("execute() with cached statement: " << rows_count / cached << " rows/s");
+    BOOST_TEST_MESSAGE("statement kept by the caller: " << rows_count / reused << " rows/s");
+    BOOST_TEST_MESSAGE("speedup: " << exec / cached << "x");
+}
+
+// Telemetry written to the database file: autocommit pays the commit and its fsync for every row,
+// the batch writer pays them once per batch and inserts rows by the multi-row statement
+BOOST_AUTO_TEST_CASE(BatchWriterInsertTest)
+{
+    const std::string name = "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows";
+
+    for (size_t batch_size : { 1, 100, 10000 }) {
+        // every row is synced with batch size 1, fewer rows keep the test short
+        const size_t rows_count = (1 == batch_size) ? 1000 : 200000;
+        const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+        double seconds = measure_best(1, [&] {
+            sqlite3_helper db(path.string().c_str());
+            db.exec("CREATE TABLE telemetry (id INTEGER, name TEXT, value REAL)");
+
+            sqlite3_batch_options options;
+            options.rows_per_transaction = batch_size;
+            options.max_delay = std::chrono::milliseconds(0);
+            sqlite3_batch_writer<std::int64_t, std::string, double> writer(db, "telemetry", { "id", "name", "value" }, options);
+            for (size_t i = 0; i < rows_count; ++i) {
+                writer.write(static_cast<std::int64_t>(i), name, i * 0.25);
+            }
+            BOOST_CHECK_EQUAL(writer.flush(), 0);
+            BOOST_CHECK_EQUAL(writer.committed(), rows_count);
+        });
+
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        BOOST_TEST_MESSAGE("batch size " << batch_size << ": " << rows_count / seconds << " rows/s");
+    }
+}
+
+// Read of the result set: exec() callback gets every column as text and parses numbers back,
+// the row cursor reads numbers natively and views text and blobs in SQLite buffers
+BOOST_AUTO_TEST_CASE(RowCursorReadTest)
+{
+    const size_t rows_count = 200000;
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE telemetry (id INTEGER, name TEXT, value REAL, data BLOB)");
+    {
+        const std::uint8_t blob[64] = {};
+        sqlite3_batch_writer<std::int64_t, std::string, double, byte_view> writer(db, "telemetry", { "id", "name", "value", "data" });
+        for (size_t i = 0; i < rows_count; ++i) {
+            writer.write(static_cast<std::int64_t>(i), "HKEY_LOCAL_MACHINE\\SOFTWARE\\" + std::to_string(i), i * 0.25,
+                byte_view(blob, sizeof(blob)));
+        }
+    }
+
+    struct totals
+    {
+        std::int64_t ids = 0;
+        double values = 0.0;
+        size_t bytes = 0;
+    };
+
+    const char* sql = "SELECT id, name, value, data FROM telemetry";
+    totals by_callback;
+    double callback = measure_best(3, [&] {
+        by_callback = totals();
+        db.exec(sql, [](void* context, int, char** values, char**) {
+            totals& t = *static_cast<totals*>(context);
+            t.ids += std::stoll(values[0]);
+            t.bytes += std::strlen(values[1]);
+            t.values += std::stod(values[2]);
+            // blobs are passed as text, cut at the first zero byte
+            t.bytes += values[3] ? std::strlen(values[3]) : 0;
+            return 0;
+        }, &by_callback);
+    });
+
+    totals by_cursor;
+    double cursor = measure_best(3, [&] {
+        by_cursor = totals();
+        for (const sqlite3_row& row : db.query(sql)) {
+            by_cursor.ids += row.as_int64(0);
+            by_cursor.bytes += row.as_text(1).size();
+            by_cursor.values += row.as_double(2);
+            by_cursor.bytes += row.as_blob(3).size();
+        }
+    });
+
+    BOOST_CHECK_EQUAL(by_callback.ids, by_cursor.ids);
+    BOOST_CHECK_EQUAL(by_callback.values, by_cursor.values);
+    BOOST_TEST_MESSAGE("exec() callback: " << rows_count / callback << " rows/s");
+    BOOST_TEST_MESSAGE("row cursor: " << rows_count / cursor << " rows/s");
+    BOOST_TEST_MESSAGE("speedup: " << callback / cursor << "x");
+}
+
+// Read-only inventory lookups from several threads: one connection guarded by the mutex
+// serializes them, the pool gives every thread its own reader in WAL mode
+BOOST_AUTO_TEST_CASE(ConnectionPoolReadScalingTest)
+{
+    const int rows_count = 100000;
+    const size_t queries_count = 200000;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    {
+        sqlite3_helper db(path.string().c_str());
+        db.exec("CREATE TABLE inventory (id INTEGER PRIMARY KEY, name TEXT)");
+        sqlite3_batch_writer<int, std::string> writer(db, "inventory", { "id", "name" });
+        for (int i = 0; i < rows_count; ++i) {
+            writer.write(i, "HKEY_LOCAL_MACHINE\\SOFTWARE\\" + std::to_string(i));
+        }
+    }
+
+    const char* sql = "SELECT name FROM inventory WHERE id = ?";
+    auto lookup = [sql](sqlite3_helper& db, size_t i) {
+        size_t length = 0;
+        for (const sqlite3_row& row : db.query(sql, static_cast<int>(i * 7919 % rows_count))) {
+            length += row.as_text(0).size();
+        }
+        return length;
+    };
+
+    const size_t max_threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    for (size_t threads_count = 1; threads_count <= max_threads; threads_count *= 2) {
+        const size_t queries_per_thread = queries_count / threads_count;
+
+        sqlite3_helper shared(path.string().c_str());
+        std::mutex shared_mutex;
+        double locked = run_concurrently(threads_count, [&](size_t thread) {
+            for (size_t i = 0; i < queries_per_thread; ++i) {
+                std::lock_guard<std::mutex> lock(shared_mutex);
+                lookup(shared, thread * queries_per_thread + i);
+            }
+        });
+
+        sqlite3_pool_options options;
+        options.readers = threads_count;
+        sqlite3_pool pool;
+        BOOST_REQUIRE_EQUAL(pool.open(path.string(), options), 0);
+        double pooled = run_concurrently(threads_count, [&](size_t thread) {
+            sqlite3_pool::reader_lease reader = pool.acquire_reader();
+            for (size_t i = 0; i < queries_per_thread; ++i) {
+                lookup(*reader, thread * queries_per_thread + i);
+            }
+        });
+
+        // the same queries as thread pool tasks, a batch of lookups per task
+        const size_t tasks_count = threads_count * 16;
+        double tasks = measure_best(1, [&] {
+            std::vector<std::future<size_t>> results;
+            for (size_t task = 0; task < tasks_count; ++task) {
+                results.push_back(pool.read([&, task](sqlite3_helper& db) {
+                    size_t length = 0;
+                    for (size_t i = 0; i < queries_count / tasks_count; ++i) {
+                        length += lookup(db, task * queries_count / tasks_count + i);
+                    }
+                    return length;
+                }));
+            }
+            for (auto& result : results) {
+                result.get();
+            }
+        });
+
+        BOOST_TEST_MESSAGE(threads_count << " threads, mutex-guarded connection: " << queries_count / locked << " queries/s");
+        BOOST_TEST_MESSAGE(threads_count << " threads, pool readers: " << queries_count / pooled << " queries/s");
+        BOOST_TEST_MESSAGE(threads_count << " threads, pool read() tasks: " << queries_count / tasks << " queries/s");
+    }
+
+    boost::system::error_code ec;
+    for (const char* suffix : { "", "-wal", "-shm" }) {
+        boost::filesystem::remove(path.string() + suffix, ec);
+    }
+}
+
+// Profiles on the telemetry writes (small transactions) and inventory reads (point lookups and scans)
+BOOST_AUTO_TEST_CASE(OpenProfileMatrixTest)
+{
+    const int rows_count = 50000;
+    const size_t lookups_count = 200000;
+    const std::pair<const char*, sqlite3_profile> profiles[] = { { "defaults", sqlite3_profile::defaults },
+        { "bulk_load", sqlite3_profile::bulk_load }, { "read_mostly", sqlite3_profile::read_mostly },
+        { "durable", sqlite3_profile::durable } };
+
+    for (const auto& profile : profiles) {
+        const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        sqlite3_helper db(path.string().c_str(), profile.second);
+        BOOST_REQUIRE(db);
+        db.exec("CREATE TABLE inventory (id INTEGER PRIMARY KEY, name TEXT, value REAL)");
+
+        double write = measure_best(1, [&] {
+            sqlite3_batch_options options;
+            options.rows_per_transaction = 100;
+            sqlite3_batch_writer<int, std::string, double> writer(db, "inventory", { "id", "name", "value" }, options);
+            for (int i = 0; i < rows_count; ++i) {
+                writer.write(i, "HKEY_LOCAL_MACHINE\\SOFTWARE\\" + std::to_string(i), i * 0.25);
+            }
+        });
+
+        size_t length = 0;
+        double lookup = measure_best(3, [&] {
+            for (size_t i = 0; i < lookups_count; ++i) {
+                for (const sqlite3_row& row : db.query("SELECT name FROM inventory WHERE id = ?", static_cast<int>(i * 7919 % rows_count))) {
+                    length += row.as_text(0).size();
+                }
+            }
+        });
+
+        double total = 0.0;
+        double scan = measure_best(3, [&] {
+            for (int i = 0; i < 10; ++i) {
+                for (const sqlite3_row& row : db.query("SELECT SUM(value), MAX(length(name)) FROM inventory WHERE id % 10 = ?", i)) {
+                    total += row.as_double(0);
+                }
+            }
+        });
+        BOOST_CHECK_GT(length + total, 0);
+
+        BOOST_TEST_MESSAGE(profile.first << ": writes " << rows_count / write << " rows/s, lookups "
+            << lookups_count / lookup << " queries/s, scans " << 10 * rows_count / scan << " rows/s");
+
+        BOOST_CHECK_EQUAL(db.close(), 0);
+        boost::system::error_code ec;
+        for (const char* suffix : { "", "-wal", "-shm" }) {
+            boost::filesystem::remove(path.string() + suffix, ec);
+        }
+    }
+}
+
+// Bursts of small telemetry writes from request threads: every write committed alone vs coalesced ones.
+// The writer syncs every commit, so the difference is the number of commits
+BOOST_AUTO_TEST_CASE(CoalescedWriteTest)
+{
+    const size_t threads_count = 8;
+    const size_t writes_per_thread = 500;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+    sqlite3_pool_options options;
+    options.readers = 1;
+    options.synchronous = 2;
+    sqlite3_pool pool;
+    BOOST_REQUIRE_EQUAL(pool.open(path.string(), options), 0);
+    pool.write([](sqlite3_helper& db) { return db.exec("CREATE TABLE telemetry (thread INTEGER, id INTEGER, name TEXT)"); }).get();
+
+    auto measure = [&](auto submit) {
+        return run_concurrently(threads_count, [&](size_t thread) {
+            std::vector<std::future<int>> results;
+            for (size_t i = 0; i < writes_per_thread; ++i) {
+                results.push_back(submit(thread, i));
+            }
+            for (auto& result : results) {
+                BOOST_CHECK_EQUAL(result.get(), 0);
+            }
+        });
+    };
+
+    const std::string name = "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows";
+    double separate = measure([&](size_t thread, size_t i) {
+        return pool.write([=](sqlite3_helper& db) { return db.execute("INSERT INTO telemetry VALUES (?, ?, ?)", thread, i, name); });
+    });
+    double coalesced = measure([&](size_t thread, size_t i) {
+        return pool.execute("INSERT INTO telemetry VALUES (?, ?, ?)", thread, i, name);
+    });
+
+    const size_t writes_count = threads_count * writes_per_thread;
+    BOOST_TEST_MESSAGE("commit per write: " << writes_count / separate << " writes/s");
+    BOOST_TEST_MESSAGE("coalesced writes: " << writes_count / coalesced << " writes/s");
+    BOOST_TEST_MESSAGE("speedup: " << separate / coalesced << "x");
+
+    pool.close();
+    boost::system::error_code ec;
+    for (const char* suffix : { "", "-wal", "-shm" }) {
+        boost::filesystem::remove(path.string() + suffix, ec);
+    }
+}
+
+// Cost of the profiler on short inventory lookups, the worst case for per-execution hooks
+BOOST_AUTO_TEST_CASE(ProfilerOverheadTest)
+{
+    const int rows_count = 10000;
+    const size_t lookups_count = 200000;
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE inventory (id INTEGER PRIMARY KEY, name TEXT)");
+    {
+        sqlite3_batch_writer<int, std::string> writer(db, "inventory", { "id", "name" });
+        for (int i = 0; i < rows_count; ++i) {
+            writer.write(i, "HKEY_LOCAL_MACHINE\\SOFTWARE\\" + std::to_string(i));
+        }
+    }
+
+    auto measure = [&] {
+        return measure_best(3, [&] {
+            for (size_t i = 0; i < lookups_count; ++i) {
+                for (const sqlite3_row& row : db.query("SELECT name FROM inventory WHERE id = ?", static_cast<int>(i * 7919 % rows_count))) {
+                    (void) row;
+                }
+            }
+        });
+    };
+
+    double plain = measure();
+
+    sqlite3_profiler_options options;
+    sqlite3_profiler* profiler = db.enable_profiling(options);
+    double profiled = measure();
+    BOOST_CHECK_EQUAL(profiler->statistics().front().executions, 3 * lookups_count);
+
+    options.count_rows = false;
+    db.enable_profiling(options);
+    double without_rows = measure();
+    db.disable_profiling();
+
+    BOOST_TEST_MESSAGE("no profiler: " << lookups_count / plain << " queries/s");
+    BOOST_TEST_MESSAGE("profiler: " << lookups_count / profiled << " queries/s");
+    BOOST_TEST_MESSAGE("profiler without row counting: " << lookups_count / without_rows << " queries/s");
+}
+
+// Inventory snapshot: file copy, backup at once and in steps, serialization to memory.
+// The longest step is the longest time the source is locked, writers of other connections wait for it
+BOOST_AUTO_TEST_CASE(SnapshotTest)
+{
+    const int rows_count = 500000;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    const boost::filesystem::path snapshot = path.string() + ".snapshot";
+
+    sqlite3_helper db(path.string().c_str());
+    db.exec("CREATE TABLE inventory (id INTEGER PRIMARY KEY, name TEXT)");
+    {
+        sqlite3_batch_writer<int, std::string> writer(db, "inventory", { "id", "name" });
+        for (int i = 0; i < rows_count; ++i) {
+            writer.write(i, make_mixed_utf8(64) + std::to_string(i));
+        }
+    }
+    const double megabytes = boost::filesystem::file_size(path) / (1024.0 * 1024.0);
+
+    double copy = measure_best(3, [&] {
+        boost::filesystem::copy_file(path, snapshot, boost::filesystem::copy_option::overwrite_if_exists);
+    });
+
+    auto measure_backup = [&](int pages_per_step, double& longest_step) {
+        return measure_best(3, [&] {
+            auto step_start = std::chrono::steady_clock::now();
+            longest_step = 0.0;
+            auto track = [&](int, int) {
+                auto now = std::chrono::steady_clock::now();
+                longest_step = std::max(longest_step, std::chrono::duration<double>(now - step_start).count());
+                step_start = now;
+                return true;
+            };
+            BOOST_CHECK_EQUAL(db.backup_to(snapshot.string().c_str(), pages_per_step, track), 0);
+            track(0, 0);
+        });
+    };
+    double at_once_step = 0.0;
+    double at_once = measure_backup(-1, at_once_step);
+    double stepwise_step = 0.0;
+    double stepwise = measure_backup(256, stepwise_step);
+
+    std::vector<std::uint8_t> data;
+    double serialize = measure_best(3, [&] {
+        BOOST_CHECK_EQUAL(db.serialize(data), 0);
+    });
+    sqlite3_helper memory(":memory:");
+    double deserialize = measure_best(3, [&] {
+        BOOST_CHECK_EQUAL(memory.deserialize(byte_view(data.data(), data.size())), 0);
+    });
+
+    BOOST_TEST_MESSAGE("database: " << megabytes << " MB");
+    BOOST_TEST_MESSAGE("file copy: " << megabytes / copy << " MB/s");
+    BOOST_TEST_MESSAGE("backup at once: " << megabytes / at_once << " MB/s, longest step " << at_once_step * 1000 << " ms");
+    BOOST_TEST_MESSAGE("backup by 256 pages: " << megabytes / stepwise << " MB/s, longest step " << stepwise_step * 1000 << " ms");
+    BOOST_TEST_MESSAGE("serialize: " << megabytes / serialize << " MB/s");
+    BOOST_TEST_MESSAGE("deserialize: " << megabytes / deserialize << " MB/s");
+
+    db.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+    boost::filesystem::remove(snapshot, ec);
+}
+
+BOOST_AUTO_TEST_CASE(KeyValueStoreTest)
+{
+    const int keys_count = 100000;
+    const int reads_count = 1000000;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    std::vector<std::string> keys;
+    for (int i = 0; i < keys_count; ++i) {
+        keys.push_back("device/" + std::to_string(i * 7919 % keys_count) + "/state");
+    }
+
+    auto measure_puts = [&](size_t flush_rows) {
+        sqlite3_kv_options options;
+        options.flush_rows = flush_rows;
+        sqlite3_kv_store store;
+        BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+        const int puts_count = flush_rows > 1 ? keys_count : 200;
+        double elapsed = measure_best(1, [&] {
+            for (int i = 0; i < puts_count; ++i) {
+                store.put(keys[i], i);
+            }
+            BOOST_CHECK_EQUAL(store.flush(), 0);
+        });
+        return puts_count / elapsed;
+    };
+    double write_through = measure_puts(1);
+    double write_back = measure_puts(1000);
+
+    // shards are not filled evenly, the cyclic reads would thrash the full one
+    sqlite3_kv_options options;
+    options.cache_capacity = keys_count * 2;
+    sqlite3_kv_store store;
+    BOOST_REQUIRE_EQUAL(store.open(path.string().c_str(), options), 0);
+
+    // the first pass misses the cache and reads the database, the next ones hit
+    double misses = measure_best(1, [&] {
+        for (int i = 0; i < keys_count; ++i) {
+            BOOST_CHECK(store.get<std::int64_t>(keys[i]));
+        }
+    });
+    double hits = measure_best(3, [&] {
+        for (int i = 0; i < reads_count; ++i) {
+            if (!store.get<std::int64_t>(keys[i % keys_count])) {
+                BOOST_FAIL("missing key");
+            }
+        }
+    });
+
+    const size_t threads_count = 4;
+    double concurrent_hits = run_concurrently(threads_count, [&](size_t thread_index) {
+        for (int i = 0; i < reads_count / 4; ++i) {
+            store.get<std::int64_t>(keys[(i + thread_index * 997) % keys_count]);
+        }
+    });
+
+    BOOST_CHECK_EQUAL(store.cache_misses(), keys_count);
+    BOOST_CHECK_LT(hits / reads_count, 1e-6);
+    BOOST_TEST_MESSAGE("put, write-through: " << write_through << " writes/s");
+    BOOST_TEST_MESSAGE("put, write-back by 1000: " << write_back << " writes/s");
+    BOOST_TEST_MESSAGE("get, cache miss: " << misses / keys_count * 1e9 << " ns");
+    BOOST_TEST_MESSAGE("get, cache hit: " << hits / reads_count * 1e9 << " ns");
+    BOOST_TEST_MESSAGE("get, cache hit in " << threads_count << " threads: " << reads_count / 4 * threads_count / concurrent_hits << " reads/s");
+
+    store.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+}
+
+BOOST_AUTO_TEST_CASE(SystemTablesTest)
+{
+    const int lookups_count = 1000;
+    sqlite3_helper db(":memory:");
+    BOOST_REQUIRE_EQUAL(db.register_system_tables(), 0);
+
+    std::vector<std::int64_t> pids;
+    for (const sqlite3_row& row : db.query("SELECT pid FROM processes")) {
+        pids.push_back(row.as_int64(0));
+    }
+    BOOST_REQUIRE(!pids.empty());
+
+    auto measure_lookups = [&](const std::string& sql) {
+        return measure_best(3, [&] {
+            for (int i = 0; i < lookups_count; ++i) {
+                sqlite3_statement lookup = db.query(sql, pids[i % pids.size()]);
+                for (const sqlite3_row& row : lookup) {
+                    BOOST_CHECK_GE(row.as_int64(0), 0);
+                }
+            }
+        }) / lookups_count;
+    };
+    double pushed_down = measure_lookups("SELECT threads FROM processes WHERE pid = ?");
+    double scanned = measure_lookups("SELECT threads FROM processes WHERE pid + 0 = ?");
+
+    auto measure_scan = [&](const std::string& sql) {
+        return measure_best(3, [&] {
+            for (const sqlite3_row& row : db.query(sql)) {
+                BOOST_CHECK_GE(row.size(), 1);
+            }
+        });
+    };
+    double narrow_scan = measure_scan("SELECT pid, name FROM processes");
+    double wide_scan = measure_scan("SELECT * FROM processes");
+    double mounts_scan = measure_scan("SELECT path, filesystem FROM mounts");
+    double mounts_sizes = measure_scan("SELECT path, total_bytes, free_bytes FROM mounts");
+
+    BOOST_TEST_MESSAGE("processes: " << pids.size());
+    BOOST_TEST_MESSAGE("lookup by pid, pushed down: " << pushed_down * 1e6 << " us");
+    BOOST_TEST_MESSAGE("lookup by pid, full scan: " << scanned * 1e6 << " us");
+    BOOST_TEST_MESSAGE("scan of pid and name: " << narrow_scan * 1e3 << " ms");
+    BOOST_TEST_MESSAGE("scan of all columns: " << wide_scan * 1e3 << " ms");
+    BOOST_TEST_MESSAGE("scan of mounts: " << mounts_scan * 1e3 << " ms, with sizes " << mounts_sizes * 1e3 << " ms");
+}
+
+BOOST_AUTO_TEST_CASE(CompressedBlobTest)
+{
+    const int rows_count = 2000;
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+    // registry exports: repeated key paths and value names with varying data
+    std::vector<std::string> exports;
+    for (int i = 0; i < rows_count; ++i) {
+        std::string text;
+        for (int j = 0; j < 100; ++j) {
+            text += "[HKEY_LOCAL_MACHINE\\SOFTWARE\\Vendor" + std::to_string(i % 13) + "\\Product\\" +
+                std::to_string(j) + "]\r\n\"InstallPath\"=\"C:\\\\Program Files\\\\" + make_mixed_utf8(8) +
+                "\"\r\n\"Build\"=dword:" + std::to_string(100000 + i * j) + "\r\n";
+        }
+        exports.push_back(text);
+    }
+
+    auto measure = [&](bool compressed, double& megabytes, double& read_time) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        sqlite3_helper db(path.string().c_str());
+        db.exec("CREATE TABLE exports (id INTEGER PRIMARY KEY, content BLOB)");
+        double write_time = measure_best(1, [&] {
+            db.exec("BEGIN");
+            for (int i = 0; i < rows_count; ++i) {
+                const byte_view data(reinterpret_cast<const std::uint8_t*>(exports[i].data()), exports[i].size());
+                if (compressed) {
+                    db.execute("INSERT INTO exports VALUES (?, ?)", i, sqlite3_compressed_blob(data));
+                }
+                else {
+                    db.execute("INSERT INTO exports VALUES (?, ?)", i, data);
+                }
+            }
+            db.exec("COMMIT");
+        });
+
+        std::vector<std::uint8_t> content;
+        read_time = measure_best(3, [&] {
+            for (const sqlite3_row& row : db.query("SELECT content FROM exports")) {
+                BOOST_CHECK_EQUAL(row.as_uncompressed(0, content), 0);
+            }
+        });
+        db.close();
+        megabytes = boost::filesystem::file_size(path) / (1024.0 * 1024.0);
+        return write_time;
+    };
+
+    double raw_size = 0.0;
+    double raw_read = 0.0;
+    double raw_write = measure(false, raw_size, raw_read);
+    double compressed_size = 0.0;
+    double compressed_read = 0.0;
+    double compressed_write = measure(true, compressed_size, compressed_read);
+
+    BOOST_CHECK_LT(compressed_size, raw_size / 2);
+    BOOST_TEST_MESSAGE("raw: " << raw_size << " MB, write " << raw_write * 1000 << " ms, read " << raw_read * 1000 << " ms");
+    BOOST_TEST_MESSAGE("compressed: " << compressed_size << " MB, write " << compressed_write * 1000 << " ms, read " << compressed_read * 1000 << " ms");
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#pragma endregion